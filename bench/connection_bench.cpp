@@ -0,0 +1,181 @@
+// Benchmark of the allocations of a request, from the bytes read to the response sent.
+// Each sample goes through the steps Server::handleRead takes for a static file: the bytes
+// are appended to the input buffer of a Connection, parsed, routed, answered with a Response
+// built in the arena of the connection (or a prebuilt error page), flushed to /dev/null and
+// consumed. It reports requests per second and heap allocations per request, with keep-alive
+// connections of 100 requests and with a new connection per request (the connection slab).
+// The first requests of a connection size its buffers and its arena; after them a request
+// should not allocate at all.
+// The "+access_log" runs also write each request to an access log in the combined format, as
+// Server::logRequest does: the difference with the run above is the cost of logging a request
+// on the event loop (formatting the line and copying it into the ring of the log). The lines
+// are written to a file by the thread of the log, with log_overflow=block so none is dropped.
+// Build and run it with: make bench
+
+#include "Connection.hpp"
+#include "Generation.hpp"
+#include "Response.hpp"
+#include "HotHeaders.hpp"
+#include "Log.hpp"
+#include "LogFormat.hpp"
+#include <fstream>      // For std::ofstream to create the served files
+#include <iostream>     // For std::cout and std::cerr
+#include <cstdio>       // For std::printf and std::remove
+#include <cstdlib>      // For std::malloc, std::free and std::exit
+#include <ctime>        // For std::time
+#include <new>          // For std::bad_alloc
+#include <fcntl.h>      // For open
+#include <unistd.h>     // For close and rmdir
+#include <sys/stat.h>   // For mkdir
+#include <sys/time.h>   // For gettimeofday
+
+static size_t g_allocations = 0;
+// Number of calls to operator new since the start of the program.
+static void (*volatile g_release)(void*) = std::free;
+// free() is called through a pointer so the compiler does not pair it with the inlined new.
+
+void* operator new(size_t size) throw(std::bad_alloc) {
+    ++g_allocations;
+    void* p = std::malloc(size ? size : 1);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) throw() {
+    g_release(p);
+}
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+struct AccessLog {
+    Log log;            // The log the lines are written to.
+    LogFormat format;   // The combined format.
+    std::string line;   // Line reused for every request, as in the Server.
+};
+
+static void serve(Connection& connection, FileCache& cache, const char* date, const std::string& raw,
+    AccessLog* access) {
+    // Answers one request as Server::handleRead does for a static file.
+    connection.input.append(raw);
+    if (connection.parseRequest() != Request::PARSE_COMPLETE) {
+        std::cerr << "cannot parse the request" << std::endl;
+        std::exit(1);
+    }
+    const Request& request = connection.request;
+    const Router& router = connection.generation->router;
+    bool keep_alive = connection.wantsKeepAlive(request);
+    Request::View host = request.getHeaderView("Host");
+    Request::View path = request.getPathView();
+    const Router::Location* location = router.findLocation(
+        router.findHost(connection.listener, host.data, host.length), path.data, path.length);
+    size_t queued = connection.output.getQueued();
+    Response response(request, *location, cache, connection.arena);
+    int status = response.getPrebuiltStatus();
+    if (status != 0) {
+        connection.generation->error_pages.enqueue(status, keep_alive, connection.output);
+    } else {
+        response.setHeader("Server", HotHeaders::getServer());
+        response.setHeader("Date", date);
+        response.setHeader("Connection", keep_alive ? "keep-alive" : "close");
+        response.enqueue(connection.output);
+        status = response.getStatus();
+    }
+    if (access != NULL) {
+        LogFormat::Record& record = connection.log_record;
+        LogFormat::capture(record, request);
+        record.address = connection.peer.sin_addr;
+        record.status = status;
+        record.requests = connection.requests_served + 1;
+        record.bytes_sent = connection.output.getQueued() - queued;
+        record.request_time = 0;
+        access->format.format(access->line, record, std::time(NULL));
+        access->log.write(access->line.data(), access->line.size());
+    }
+    ++connection.requests_served;
+    connection.consumeRequest();
+    connection.compactInput();
+    if (!connection.flushOutput() || connection.hasPendingOutput()) {
+        std::exit(1);
+    }
+}
+
+static void run(const char* name, const std::string& raw, Generation* generation, FileCache& cache,
+    const char* date, int sink, size_t iterations, size_t per_connection, AccessLog* access = NULL) {
+    Connection* warm = new Connection(sink, 0, generation);
+    serve(*warm, cache, date, raw, access);
+    delete warm;
+    // The first request loads the file (and its gzip variant) into the cache and fills the slab.
+    size_t allocations = g_allocations;
+    double start = now();
+    Connection* connection = NULL;
+    for (size_t i = 0; i < iterations; ++i) {
+        if (i % per_connection == 0) {
+            delete connection;
+            connection = new Connection(sink, 0, generation);
+        }
+        serve(*connection, cache, date, raw, access);
+    }
+    delete connection;
+    double seconds = now() - start;
+    std::printf("%-20s %5lu req/conn %12.0f req/s %8.2f allocs/req\n", name, static_cast<unsigned long>(per_connection),
+        iterations / seconds, static_cast<double>(g_allocations - allocations) / iterations);
+}
+
+static void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream file(path.c_str());
+    file << content;
+}
+
+int main() {
+    const size_t iterations = 200000;
+    const std::string root = "/tmp/webserv_connection_bench";
+    mkdir(root.c_str(), 0755);
+    writeFile(root + "/small.html", std::string(512, 'x'));
+    writeFile(root + "/page.css", std::string(16384, 'y'));
+    writeFile(root + "/bench.conf", "root=" + root + "\nindex=small.html\nerror_page_404=/404.html\n"
+        "gzip=on\ngzip_min_length=256\ngzip_types=text/css\n");
+    const char* date = "Thu, 01 Jan 2026 00:00:00 GMT";
+    Config config(root + "/bench.conf");
+    Generation* generation = new Generation(config, date, 1);
+    FileCache cache(64 * 1024 * 1024, 1024 * 1024, 256, 3600);
+    cache.setGzip(true, 256, "text/css", 6);
+    int sink = open("/dev/null", O_WRONLY);
+    const std::string etag = cache.get(root + "/small.html")->etag;
+
+    std::string samples[][2] = {
+        { "static", "GET /small.html HTTP/1.1\r\nHost: localhost\r\n\r\n" },
+        { "gzip", "GET /page.css HTTP/1.1\r\nHost: localhost\r\nAccept-Encoding: gzip, deflate, br\r\n\r\n" },
+        { "not-modified", "GET /small.html HTTP/1.1\r\nHost: localhost\r\nIf-None-Match: " + etag + "\r\n\r\n" },
+        { "range", "GET /page.css HTTP/1.1\r\nHost: localhost\r\nRange: bytes=100-1099\r\n\r\n" },
+        { "multirange", "GET /page.css HTTP/1.1\r\nHost: localhost\r\nRange: bytes=0-9, 100-199, -50\r\n\r\n" },
+        { "not-found", "GET /missing.html HTTP/1.1\r\nHost: localhost\r\n\r\n" }
+    };
+    std::cout << "sample               connections        throughput          allocations" << std::endl;
+    for (size_t i = 0; i < sizeof(samples) / sizeof(samples[0]); ++i) {
+        run(samples[i][0].c_str(), samples[i][1], generation, cache, date, sink, iterations, 100);
+    }
+    run("static", samples[0][1], generation, cache, date, sink, iterations, 1);
+    AccessLog access;
+    access.log.open(root + "/access.log", 256 * 1024, Log::POLICY_BLOCK, 1000);
+    const std::string logged = "GET /small.html HTTP/1.1\r\nHost: localhost\r\nReferer: http://localhost/\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n\r\n";
+    run("static", logged, generation, cache, date, sink, iterations, 100);
+    run("static+access_log", logged, generation, cache, date, sink, iterations, 100, &access);
+    access.log.close();
+    // The same request with the headers a browser sends, without and with the access log.
+
+    close(sink);
+    generation->release();
+    std::remove(std::string(root + "/small.html").c_str());
+    std::remove(std::string(root + "/page.css").c_str());
+    std::remove(std::string(root + "/bench.conf").c_str());
+    std::remove(std::string(root + "/access.log").c_str());
+    rmdir(root.c_str());
+    return 0;
+}
@@ -0,0 +1,93 @@
+#!/bin/sh
+# Checks the FastCGI mode of webserv against bench/fcgi_responder, run by make bench-fastcgi.
+# It starts the responder on a Unix socket and webserv with a location that passes to it,
+# then sends requests with curl and compares what comes back:
+#
+#   pooling      two requests from different clients use the same responder connection
+#   body         a POST body reaches the responder as FCGI_STDIN
+#   status       the Status header of the responder becomes the status of the response
+#   end_request  a response is complete only after FCGI_END_REQUEST, and FCGI_OVERLOADED is a 502
+#   stderr       an FCGI_STDERR record goes to the error log of webserv, not to the client
+#   closed       a connection the responder closes mid-request is a 502, the next one works
+#   down_up      with the responder stopped, fastcgi_max_fails failures mark it down: the
+#                next request is a 502 without a connect(), and after fastcgi_fail_timeout
+#                seconds the restarted responder gets requests again
+#
+# Usage: bench/fastcgi_check.sh <webserv> <fcgi_responder>
+
+WEBSERV=${1:-./webserv}
+RESPONDER=${2:-./obj/bench/fcgi_responder}
+PORT=${PORT:-18190}
+FAIL_TIMEOUT=2
+DIR=$(mktemp -d /tmp/webserv_fastcgi.XXXXXX)
+SOCKET="$DIR/responder.sock"
+URL="http://127.0.0.1:$PORT/app"
+failures=0
+
+trap 'kill "$pid" "$responder" 2> /dev/null; rm -rf "$DIR"' EXIT
+mkdir -p "$DIR/www"
+cat > "$DIR/webserv.conf" << EOF
+root $DIR/www;
+server {
+    listen $PORT;
+    location /app/ {
+        methods GET HEAD POST;
+        fastcgi_pass unix:$SOCKET;
+        fastcgi_pool_size 4;
+        fastcgi_max_fails 2;
+        fastcgi_fail_timeout $FAIL_TIMEOUT;
+    }
+}
+EOF
+
+start_responder() {
+    "$RESPONDER" "unix:$SOCKET" > "$DIR/responder.log" 2>&1 &
+    responder=$!
+    sleep 0.2
+}
+
+check() {
+    # check <name> <expected> <actual>: the actual output must contain the expected text.
+    case "$3" in
+        *"$2"*) echo "ok    $1" ;;
+        *) echo "FAIL  $1: expected \"$2\", got \"$3\""; failures=$((failures + 1)) ;;
+    esac
+}
+
+start_responder
+"$WEBSERV" "$DIR/webserv.conf" > /dev/null 2> "$DIR/error.log" &
+pid=$!
+sleep 1
+if ! kill -0 "$pid" 2> /dev/null; then
+    echo "webserv failed to start with $DIR/webserv.conf" >&2
+    exit 1
+fi
+
+check pooling "connection=1 request=1" "$(curl -s "$URL/first")"
+check pooling "connection=1 request=2" "$(curl -s "$URL/second")"
+check body "method=POST script=/app/form stdin=5" "$(curl -s -d hello "$URL/form" | sed 's/ query=[^ ]*//')"
+check status "404" "$(curl -s -o /dev/null -w '%{http_code}' "$URL/x?status=404")"
+check end_request "200 text/plain" "$(curl -s -o /dev/null -w '%{http_code} %{content_type}' "$URL/x")"
+check end_request "502" "$(curl -s -o /dev/null -w '%{http_code}' "$URL/x?overloaded")"
+check stderr "query=stderr" "$(curl -s "$URL/x?stderr")"
+sleep 1
+check stderr "FastCGI: fcgi_responder: message for the error log" "$(cat "$DIR/error.log")"
+check closed "502" "$(curl -s -o /dev/null -w '%{http_code}' "$URL/x?close")"
+check closed "request=1" "$(curl -s "$URL/x")"
+# The closed request was the only failure: the success after it resets the count.
+
+kill "$responder"
+wait "$responder" 2> /dev/null
+check down_up "502" "$(curl -s -o /dev/null -w '%{http_code}' "$URL/x")"
+check down_up "502" "$(curl -s -o /dev/null -w '%{http_code}' "$URL/x")"
+start_responder
+check down_up "502" "$(curl -s -o /dev/null -w '%{http_code}' "$URL/x")"
+check down_up "connections while down: 0" "connections while down: $(grep -c accepted "$DIR/responder.log")"
+sleep $((FAIL_TIMEOUT + 1))
+check down_up "connection=1 request=1" "$(curl -s "$URL/x")"
+
+if [ "$failures" -ne 0 ]; then
+    echo "$failures FastCGI checks failed"
+    exit 1
+fi
+echo "All FastCGI checks passed"
@@ -0,0 +1,277 @@
+// Small FastCGI responder to check the FastCGI mode of webserv (see fastcgi_check.sh).
+// It listens on a Unix socket (unix:/path) or on a TCP port of 127.0.0.1 and answers every
+// request with a text/plain body that tells which connection it came on and how many
+// requests that connection carried, so a client can see whether webserv reused a pooled
+// connection. It honors FCGI_KEEP_CONN: without it, the connection is closed after
+// FCGI_END_REQUEST.
+// The query string of the request chooses what the responder does, for the error paths:
+//   stderr      an FCGI_STDERR record is sent before the output (webserv logs it)
+//   status=N    the response has a "Status: N" header
+//   close       the connection is closed without a response (webserv answers 502)
+//   overloaded  FCGI_END_REQUEST with FCGI_OVERLOADED instead of a response (502)
+// The output is split into two FCGI_STDOUT records with padding, as php-fpm sends it.
+// Each accepted connection is printed on the standard output.
+//
+// Usage: fcgi_responder unix:/path | port
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <map>
+
+#define FCGI_BEGIN_REQUEST 1
+#define FCGI_END_REQUEST 3
+#define FCGI_PARAMS 4
+#define FCGI_STDIN 5
+#define FCGI_STDOUT 6
+#define FCGI_STDERR 7
+#define FCGI_KEEP_CONN 1
+#define FCGI_REQUEST_COMPLETE 0
+#define FCGI_OVERLOADED 2
+
+struct Peer {
+    int fd;
+    unsigned long number;				// Number of the connection, counted from 1.
+    unsigned long requests;				// Requests answered on the connection.
+    std::string input;					// Bytes received and not parsed yet.
+    unsigned request_id;				// Id of the current request, 0 if there is none.
+    bool keep_conn;						// FCGI_KEEP_CONN of the current request.
+    std::string params;					// FCGI_PARAMS stream of the current request.
+    size_t stdin_length;				// Bytes of the FCGI_STDIN stream.
+};
+
+static void appendRecord(std::string& out, unsigned char type, unsigned request_id, const std::string& content) {
+    size_t padding = (8 - content.size() % 8) % 8;
+    unsigned char header[8] = {1, type, static_cast<unsigned char>(request_id >> 8),
+        static_cast<unsigned char>(request_id & 0xff), static_cast<unsigned char>(content.size() >> 8),
+        static_cast<unsigned char>(content.size() & 0xff), static_cast<unsigned char>(padding), 0};
+    out.append(reinterpret_cast<char*>(header), sizeof(header));
+    out += content;
+    out.append(padding, '\0');
+}
+
+static size_t readLength(const std::string& data, size_t& position) {
+    if (position >= data.size()) {
+        return 0;
+    }
+    unsigned char first = data[position];
+    if (first < 128) {
+        ++position;
+        return first;
+    }
+    if (position + 4 > data.size()) {
+        position = data.size();
+        return 0;
+    }
+    size_t length = (first & 0x7f) << 24 | static_cast<unsigned char>(data[position + 1]) << 16
+        | static_cast<unsigned char>(data[position + 2]) << 8 | static_cast<unsigned char>(data[position + 3]);
+    position += 4;
+    return length;
+}
+
+static std::map<std::string, std::string> parseParams(const std::string& data) {
+    std::map<std::string, std::string> params;
+    size_t position = 0;
+    while (position < data.size()) {
+        size_t name_length = readLength(data, position);
+        size_t value_length = readLength(data, position);
+        if (position + name_length + value_length > data.size()) {
+            break;
+        }
+        params[data.substr(position, name_length)] = data.substr(position + name_length, value_length);
+        position += name_length + value_length;
+    }
+    return params;
+}
+
+static bool hasWord(const std::string& query, const std::string& word) {
+    size_t start = 0;
+    while (start <= query.size()) {
+        size_t end = query.find('&', start);
+        end = end == std::string::npos ? query.size() : end;
+        std::string item = query.substr(start, end - start);
+        if (item == word || item.compare(0, word.size() + 1, word + "=") == 0) {
+            return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
+
+static bool sendAll(int fd, const std::string& data) {
+    size_t sent = 0;
+    while (sent < data.size()) {
+        ssize_t bytes = write(fd, data.data() + sent, data.size() - sent);
+        if (bytes < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            return false;
+        }
+        sent += bytes;
+    }
+    return true;
+}
+
+static bool respond(Peer& peer) {
+    std::map<std::string, std::string> params = parseParams(peer.params);
+    std::string query = params["QUERY_STRING"];
+    std::string out;
+    unsigned id = peer.request_id;
+    peer.request_id = 0;
+    ++peer.requests;
+    if (hasWord(query, "close")) {
+        return false;
+    }
+    std::string end(8, '\0');
+    if (hasWord(query, "overloaded")) {
+        end[4] = FCGI_OVERLOADED;
+        appendRecord(out, FCGI_END_REQUEST, id, end);
+        return sendAll(peer.fd, out) && peer.keep_conn;
+    }
+    if (hasWord(query, "stderr")) {
+        appendRecord(out, FCGI_STDERR, id, "fcgi_responder: message for the error log\n");
+    }
+    std::string head = "Content-Type: text/plain\r\n";
+    size_t status = query.find("status=");
+    if (status != std::string::npos) {
+        head += "Status: " + query.substr(status + 7, 3) + "\r\n";
+    }
+    char body[512];
+    std::snprintf(body, sizeof(body), "connection=%lu request=%lu method=%s script=%s query=%s stdin=%lu\n",
+        peer.number, peer.requests, params["REQUEST_METHOD"].c_str(), params["SCRIPT_NAME"].c_str(),
+        query.c_str(), static_cast<unsigned long>(peer.stdin_length));
+    appendRecord(out, FCGI_STDOUT, id, head);
+    appendRecord(out, FCGI_STDOUT, id, "\r\n" + std::string(body));
+    appendRecord(out, FCGI_STDOUT, id, "");
+    end[4] = FCGI_REQUEST_COMPLETE;
+    appendRecord(out, FCGI_END_REQUEST, id, end);
+    return sendAll(peer.fd, out) && peer.keep_conn;
+}
+
+static bool handleRecords(Peer& peer) {
+    while (peer.input.size() >= 8) {
+        const unsigned char* header = reinterpret_cast<const unsigned char*>(peer.input.data());
+        size_t length = header[4] << 8 | header[5];
+        size_t size = 8 + length + header[6];
+        if (peer.input.size() < size) {
+            return true;
+        }
+        unsigned id = header[2] << 8 | header[3];
+        std::string content = peer.input.substr(8, length);
+        unsigned char type = header[1];
+        peer.input.erase(0, size);
+        if (type == FCGI_BEGIN_REQUEST && content.size() >= 8) {
+            peer.request_id = id;
+            peer.keep_conn = (content[2] & FCGI_KEEP_CONN) != 0;
+            peer.params.clear();
+            peer.stdin_length = 0;
+        } else if (type == FCGI_PARAMS && id == peer.request_id) {
+            peer.params += content;
+        } else if (type == FCGI_STDIN && id == peer.request_id) {
+            peer.stdin_length += content.size();
+            if (content.empty() && !respond(peer)) {
+                return false;
+                // The request ended without FCGI_KEEP_CONN, or close was asked for.
+            }
+        }
+    }
+    return true;
+}
+
+static int listenOn(const char* address) {
+    int fd;
+    if (std::strncmp(address, "unix:", 5) == 0) {
+        struct sockaddr_un sockaddr;
+        std::memset(&sockaddr, 0, sizeof(sockaddr));
+        sockaddr.sun_family = AF_UNIX;
+        std::strncpy(sockaddr.sun_path, address + 5, sizeof(sockaddr.sun_path) - 1);
+        unlink(sockaddr.sun_path);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd == -1 || bind(fd, reinterpret_cast<struct sockaddr*>(&sockaddr), sizeof(sockaddr)) == -1) {
+            return -1;
+        }
+    } else {
+        struct sockaddr_in sockaddr;
+        std::memset(&sockaddr, 0, sizeof(sockaddr));
+        sockaddr.sin_family = AF_INET;
+        sockaddr.sin_port = htons(std::atoi(address));
+        sockaddr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        int on = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+        if (fd == -1 || bind(fd, reinterpret_cast<struct sockaddr*>(&sockaddr), sizeof(sockaddr)) == -1) {
+            return -1;
+        }
+    }
+    return listen(fd, 64) == -1 ? -1 : fd;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        std::fprintf(stderr, "Usage: %s unix:/path | port\n", argv[0]);
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    int listener = listenOn(argv[1]);
+    if (listener == -1) {
+        std::perror("fcgi_responder: listen");
+        return 1;
+    }
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    std::vector<Peer> peers;
+    unsigned long accepted = 0;
+    while (true) {
+        std::vector<struct pollfd> fds(peers.size() + 1);
+        fds[0].fd = listener;
+        fds[0].events = POLLIN;
+        for (size_t i = 0; i < peers.size(); ++i) {
+            fds[i + 1].fd = peers[i].fd;
+            fds[i + 1].events = POLLIN;
+        }
+        if (poll(&fds[0], fds.size(), -1) == -1 && errno != EINTR) {
+            std::perror("fcgi_responder: poll");
+            return 1;
+        }
+        for (size_t i = peers.size(); i > 0; --i) {
+            if (fds[i].revents == 0) {
+                continue;
+            }
+            Peer& peer = peers[i - 1];
+            char buffer[16384];
+            ssize_t bytes = read(peer.fd, buffer, sizeof(buffer));
+            if (bytes > 0) {
+                peer.input.append(buffer, bytes);
+            }
+            if (bytes == 0 || (bytes < 0 && errno != EINTR) || !handleRecords(peer)) {
+                std::printf("connection %lu closed after %lu requests\n", peer.number, peer.requests);
+                close(peer.fd);
+                peers.erase(peers.begin() + (i - 1));
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            int fd = accept(listener, NULL, NULL);
+            if (fd != -1) {
+                Peer peer;
+                peer.fd = fd;
+                peer.number = ++accepted;
+                peer.requests = 0;
+                peer.request_id = 0;
+                peer.keep_conn = false;
+                peer.stdin_length = 0;
+                peers.push_back(peer);
+                std::printf("connection %lu accepted\n", peer.number);
+            }
+        }
+    }
+}
@@ -0,0 +1,42 @@
+#!/bin/sh
+# Compares two results of bench/load_suite.sh, e.g. of the previous commit and of this one:
+# for each scenario, prints the throughput and the p99 latency of both and their change.
+#
+# Usage: bench/load_compare.sh <old results> <new results>
+
+if [ $# -ne 2 ]; then
+    echo "usage: $0 <old results> <new results>" >&2
+    exit 2
+fi
+awk '
+function field(line, key,    start, value) {
+    if (!match(line, "\"" key "\":[^,}]*")) {
+        return ""
+    }
+    start = length(key) + 3
+    value = substr(line, RSTART + start, RLENGTH - start)
+    gsub(/"/, "", value)
+    return value
+}
+function change(old, new) {
+    return old == 0 ? "n/a" : sprintf("%+.1f%%", (new - old) * 100 / old)
+}
+FNR == NR {
+    name = field($0, "scenario")
+    rps[name] = field($0, "rps")
+    p99[name] = field($0, "p99_ms")
+    next
+}
+FNR == 1 {
+    printf "%-16s %12s %12s %9s %10s %10s %9s\n", "scenario", "old rps", "new rps", "change", "old p99", "new p99", "change"
+}
+{
+    name = field($0, "scenario")
+    if (!(name in rps)) {
+        next
+    }
+    new_rps = field($0, "rps")
+    new_p99 = field($0, "p99_ms")
+    printf "%-16s %12s %12s %9s %10s %10s %9s\n", name, rps[name], new_rps, change(rps[name], new_rps), \
+        p99[name], new_p99, change(p99[name], new_p99)
+}' "$1" "$2"
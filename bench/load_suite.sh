@@ -0,0 +1,62 @@
+#!/bin/sh
+# Load-test suite of webserv, the regression benchmark run by make bench.
+# It starts webserv on a temporary configuration whose root holds generated files, then runs
+# loadgen for each scenario below and writes one JSON object per scenario (throughput,
+# latency percentiles, status classes) to $RESULTS, tagged with the current commit, so the
+# results of two commits can be compared with bench/load_compare.sh.
+#
+#   small_static   keep-alive GETs of a 1 KB file, served from the file cache
+#   large_static   keep-alive GETs of a 2 MB file, sent from the disk
+#   not_found      GETs of a missing file (the 404 error page)
+#   malformed      requests with an invalid header line (400, then a new connection)
+#   slow_clients   small_static while $SLOW clients send their requests one byte every 50 ms
+#   constant_rate  small_static at $RATE requests per second (open loop)
+#
+# Usage: bench/load_suite.sh <webserv> <loadgen> [results file]
+
+WEBSERV=${1:-./webserv}
+LOADGEN=${2:-./obj/bench/loadgen}
+COMMIT=$(git rev-parse --short HEAD 2> /dev/null || echo unknown)
+RESULTS=${3:-${RESULTS:-obj/bench/load-$COMMIT.jsonl}}
+PORT=${PORT:-18180}
+DURATION=${DURATION:-5}
+CONNECTIONS=${CONNECTIONS:-64}
+PROCESSES=${PROCESSES:-2}
+SLOW=${SLOW:-256}
+RATE=${RATE:-10000}
+ROOT=$(mktemp -d /tmp/webserv_load.XXXXXX)
+CONF="$ROOT/webserv.conf"
+
+trap 'kill "$pid" 2> /dev/null; rm -rf "$ROOT"' EXIT
+mkdir -p "$ROOT/www"
+head -c 1024 /dev/zero | tr '\0' 'a' > "$ROOT/www/small.html"
+head -c 2097152 /dev/urandom > "$ROOT/www/large.bin"
+cp www/404.html "$ROOT/www/404.html"
+sed -e "s/^port=.*/port=$PORT/" -e "s|^root=.*|root=$ROOT/www|" -e "s/^keepalive_requests=.*/keepalive_requests=1000000/" \
+    config/default.conf > "$CONF"
+# The connections are kept for the whole run: the scenarios measure requests, not handshakes.
+
+"$WEBSERV" "$CONF" > /dev/null 2>&1 &
+pid=$!
+sleep 1
+if ! kill -0 "$pid" 2> /dev/null; then
+    echo "webserv failed to start with $CONF" >&2
+    exit 1
+fi
+mkdir -p "$(dirname "$RESULTS")"
+: > "$RESULTS"
+
+run() {
+    name=$1
+    shift
+    "$LOADGEN" -p "$PORT" -d "$DURATION" -t "$PROCESSES" -j "$name" "$@" \
+        | sed "s/^{/{\"commit\":\"$COMMIT\",/" | tee -a "$RESULTS"
+}
+
+run small_static -c "$CONNECTIONS" -u /small.html
+run large_static -c 16 -u /large.bin
+run not_found -c "$CONNECTIONS" -u /missing.html
+run malformed -c "$CONNECTIONS" -m malformed
+run slow_clients -c "$CONNECTIONS" -s "$SLOW" -u /small.html
+run constant_rate -c "$CONNECTIONS" -r "$RATE" -u /small.html
+echo "Results written to $RESULTS"
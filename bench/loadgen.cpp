@@ -0,0 +1,397 @@
+// HTTP load generator for webserv.
+// It keeps many keep-alive connections open and sends one request at a time on each
+// of them, then reports the throughput and the latency percentiles (p50, p99, p99.9).
+// By default it is a closed loop: a connection sends its next request as soon as the
+// previous response arrives. With -r it is an open loop at a constant rate: requests
+// are scheduled every 1/rate seconds whatever the server does, and the latency of each
+// one is counted from the time it was scheduled, so a server that stalls is not hidden
+// by the generator waiting for it (coordinated omission).
+// -m malformed sends a request with an invalid header line (the server answers 400 and
+// closes the connection, which is opened again). -s adds slow clients that send their
+// requests one byte every 50 ms; they are not measured, they only take server resources
+// while the other connections are measured.
+// Several processes can be used (-t) so the generator is not the bottleneck when the
+// server runs several workers.
+// The result is one line of key=value pairs, or a JSON object with -j (see load_suite.sh).
+//
+// Usage: loadgen [-h host] [-p port] [-c connections] [-d seconds] [-t processes] [-u path]
+//                [-r rate] [-m get|malformed] [-s slow clients] [-j name]
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <strings.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#define SLOW_BYTE_INTERVAL 0.05
+// Seconds between two bytes of the request of a slow client.
+
+struct Options {
+    std::string host;
+    int port;
+    int connections;
+    double duration;
+    int processes;
+    std::string path;
+    double rate;				// Requests per second of the open loop, 0 for a closed loop.
+    bool malformed;				// True to send an invalid request.
+    int slow;					// Number of slow clients.
+    std::string name;			// Name of the scenario for the JSON output, empty for key=value.
+};
+
+struct Result {
+    unsigned long requests;		// Complete responses received.
+    unsigned long errors;		// Connections that failed or were closed by the server.
+    unsigned long statuses[6];	// Responses by class of status code (index 1 to 5), 0 if unreadable.
+    unsigned long latencies;	// Number of latencies that follow the result in the pipe.
+};
+
+struct Client {
+    int fd;
+    bool busy;					// True while a request is being sent or its response received.
+    bool slow;					// True for a slow client, which is not measured.
+    size_t sent;				// Bytes of the request already sent.
+    std::string input;			// Bytes of the response received so far.
+    double started;				// Time the request was scheduled (open loop) or started.
+    double next_byte;			// Time a slow client sends its next byte.
+};
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static int connectTo(const Options& options) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
+        return -1;
+    }
+    int enable = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    inet_pton(AF_INET, options.host.c_str(), &address.sin_addr);
+    if (connect(fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+static size_t responseLength(const std::string& input, bool& closes) {
+    // Returns the length of the first complete response in input, or 0 if it is incomplete.
+    size_t headers_end = input.find("\r\n\r\n");
+    if (headers_end == std::string::npos) {
+        return 0;
+    }
+    size_t body_length = 0;
+    closes = false;
+    size_t line = input.find("\r\n") + 2;
+    while (line < headers_end) {
+        size_t end = input.find("\r\n", line);
+        if (strncasecmp(input.c_str() + line, "Content-Length:", 15) == 0) {
+            body_length = std::strtoul(input.c_str() + line + 15, NULL, 10);
+        } else if (strncasecmp(input.c_str() + line, "Connection: close", 17) == 0) {
+            closes = true;
+        }
+        line = end + 2;
+    }
+    size_t total = headers_end + 4 + body_length;
+    return input.size() >= total ? total : 0;
+}
+
+static void reconnect(Client& client, const Options& options) {
+    if (client.fd != -1) {
+        close(client.fd);
+    }
+    client.fd = connectTo(options);
+    client.input.clear();
+    client.sent = 0;
+    client.busy = false;
+}
+
+static Result runLoad(const Options& options, int connections, int slow, double rate,
+    std::vector<unsigned>& latencies) {
+    // Runs the connections (and the slow clients) of one process and fills latencies with the
+    // latency of every measured response, in microseconds.
+    Result result;
+    std::memset(&result, 0, sizeof(result));
+    std::string request = "GET " + options.path + " HTTP/1.1\r\nHost: " + options.host + "\r\n"
+        + (options.malformed ? "Broken header line\r\n" : "") + "\r\n";
+    std::vector<Client> clients(connections + slow);
+    std::vector<struct pollfd> fds(clients.size());
+    double start = now();
+    for (size_t i = 0; i < clients.size(); ++i) {
+        clients[i].fd = -1;
+        clients[i].slow = static_cast<int>(i) >= connections;
+        clients[i].next_byte = start;
+        reconnect(clients[i], options);
+        if (clients[i].fd == -1) {
+            ++result.errors;
+        }
+    }
+    unsigned long scheduled = 0;
+    // Requests of the open loop given to a connection so far.
+    char buffer[65536];
+    double end = start + options.duration;
+    double current;
+    while ((current = now()) < end) {
+        double wake = current + 0.1;
+        for (size_t i = 0; i < clients.size(); ++i) {
+            Client& client = clients[i];
+            if (client.fd == -1 || client.busy) {
+                continue;
+            }
+            if (client.slow) {
+                client.busy = true;
+                client.started = current;
+            } else if (rate == 0) {
+                client.busy = true;
+                client.started = current;
+            } else if (start + scheduled / rate <= current) {
+                client.busy = true;
+                client.started = start + scheduled / rate;
+                ++scheduled;
+                // The request waited for a free connection since it was scheduled: the wait is
+                // part of its latency.
+            }
+        }
+        for (size_t i = 0; i < clients.size(); ++i) {
+            Client& client = clients[i];
+            fds[i].fd = client.fd;
+            fds[i].events = POLLIN;
+            fds[i].revents = 0;
+            if (client.busy && client.sent < request.size()) {
+                if (!client.slow) {
+                    fds[i].events = POLLOUT;
+                } else if (client.next_byte <= current) {
+                    if (send(client.fd, request.data() + client.sent, 1, MSG_NOSIGNAL) == 1) {
+                        ++client.sent;
+                    }
+                    client.next_byte = current + SLOW_BYTE_INTERVAL;
+                }
+                if (client.slow) {
+                    wake = std::min(wake, client.next_byte);
+                }
+            }
+        }
+        if (rate != 0) {
+            wake = std::min(wake, start + scheduled / rate);
+        }
+        struct timespec timeout;
+        double delay = std::max(0.0, wake - now());
+        timeout.tv_sec = static_cast<time_t>(delay);
+        timeout.tv_nsec = static_cast<long>((delay - timeout.tv_sec) * 1e9);
+        if (ppoll(&fds[0], fds.size(), &timeout, NULL) <= 0) {
+            continue;
+            // ppoll waits with a precision of microseconds: the open loop does not send its
+            // requests in bursts of a millisecond.
+        }
+        for (size_t i = 0; i < clients.size(); ++i) {
+            Client& client = clients[i];
+            if (fds[i].revents == 0 || client.fd == -1) {
+                continue;
+            }
+            bool failed = false;
+            if (fds[i].revents & POLLOUT) {
+                ssize_t bytes = send(client.fd, request.data() + client.sent, request.size() - client.sent, MSG_NOSIGNAL);
+                if (bytes > 0) {
+                    client.sent += bytes;
+                } else if (bytes == -1 && errno != EAGAIN) {
+                    failed = true;
+                }
+            } else {
+                ssize_t bytes = recv(client.fd, buffer, sizeof(buffer), 0);
+                if (bytes > 0) {
+                    client.input.append(buffer, bytes);
+                    bool closes = false;
+                    size_t length = responseLength(client.input, closes);
+                    if (length != 0) {
+                        double finished = now();
+                        if (!client.slow) {
+                            ++result.requests;
+                            int status_class = client.input.size() > 9 ? client.input[9] - '0' : 0;
+                            ++result.statuses[status_class >= 1 && status_class <= 5 ? status_class : 0];
+                            latencies.push_back(static_cast<unsigned>((finished - client.started) * 1e6));
+                        }
+                        client.input.erase(0, length);
+                        client.sent = 0;
+                        client.busy = false;
+                        if (closes) {
+                            reconnect(client, options);
+                            // The server closed the connection: open a new one.
+                        }
+                    }
+                } else if (bytes == 0 || errno != EAGAIN) {
+                    failed = true;
+                }
+            }
+            if (failed) {
+                ++result.errors;
+                reconnect(client, options);
+            }
+        }
+    }
+    for (size_t i = 0; i < clients.size(); ++i) {
+        if (clients[i].fd != -1) {
+            close(clients[i].fd);
+        }
+    }
+    result.latencies = latencies.size();
+    return result;
+}
+
+static bool writeAll(int fd, const void* data, size_t length) {
+    const char* bytes = static_cast<const char*>(data);
+    while (length > 0) {
+        ssize_t written = write(fd, bytes, length);
+        if (written <= 0) {
+            return false;
+        }
+        bytes += written;
+        length -= written;
+    }
+    return true;
+}
+
+static bool readAll(int fd, void* data, size_t length) {
+    char* bytes = static_cast<char*>(data);
+    while (length > 0) {
+        ssize_t received = read(fd, bytes, length);
+        if (received <= 0) {
+            return false;
+        }
+        bytes += received;
+        length -= received;
+    }
+    return true;
+}
+
+static double percentile(const std::vector<unsigned>& sorted, double fraction) {
+    // Returns the latency below which this fraction of the responses are, in milliseconds.
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t rank = static_cast<size_t>(fraction * sorted.size());
+    return sorted[rank < sorted.size() ? rank : sorted.size() - 1] / 1000.0;
+}
+
+static void usage() {
+    std::fprintf(stderr, "usage: loadgen [-h host] [-p port] [-c connections] [-d seconds] [-t processes] [-u path]\n"
+        "               [-r rate] [-m get|malformed] [-s slow clients] [-j name]\n");
+    std::exit(2);
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    options.host = "127.0.0.1";
+    options.port = 8080;
+    options.connections = 64;
+    options.duration = 5;
+    options.processes = 1;
+    options.path = "/";
+    options.rate = 0;
+    options.malformed = false;
+    options.slow = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:c:d:t:u:r:m:s:j:")) != -1) {
+        switch (opt) {
+            case 'h': options.host = optarg; break;
+            case 'p': options.port = std::atoi(optarg); break;
+            case 'c': options.connections = std::atoi(optarg); break;
+            case 'd': options.duration = std::atof(optarg); break;
+            case 't': options.processes = std::atoi(optarg); break;
+            case 'u': options.path = optarg; break;
+            case 'r': options.rate = std::atof(optarg); break;
+            case 'm': options.malformed = std::strcmp(optarg, "malformed") == 0; break;
+            case 's': options.slow = std::atoi(optarg); break;
+            case 'j': options.name = optarg; break;
+            default: usage();
+        }
+    }
+    if (options.connections < 1 || options.processes < 1 || options.duration <= 0 || options.rate < 0
+        || options.slow < 0) {
+        usage();
+    }
+
+    // Each process runs its share of the connections and writes its result to a pipe,
+    // followed by its latencies.
+    std::vector<int> pipes;
+    for (int p = 0; p < options.processes; ++p) {
+        int fds[2];
+        if (pipe(fds) == -1) {
+            std::perror("pipe");
+            return 1;
+        }
+        int share = options.connections / options.processes + (p < options.connections % options.processes);
+        int slow = options.slow / options.processes + (p < options.slow % options.processes);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            std::vector<unsigned> latencies;
+            Result result = runLoad(options, share > 0 ? share : 1, slow, options.rate / options.processes, latencies);
+            if (!writeAll(fds[1], &result, sizeof(result))
+                || (!latencies.empty() && !writeAll(fds[1], &latencies[0], latencies.size() * sizeof(unsigned)))) {
+                _exit(1);
+            }
+            _exit(0);
+        }
+        close(fds[1]);
+        pipes.push_back(fds[0]);
+    }
+    Result total;
+    std::memset(&total, 0, sizeof(total));
+    std::vector<unsigned> latencies;
+    for (size_t p = 0; p < pipes.size(); ++p) {
+        Result result;
+        if (readAll(pipes[p], &result, sizeof(result))) {
+            total.requests += result.requests;
+            total.errors += result.errors;
+            for (size_t i = 0; i < 6; ++i) {
+                total.statuses[i] += result.statuses[i];
+            }
+            size_t offset = latencies.size();
+            latencies.resize(offset + result.latencies);
+            if (result.latencies != 0 && !readAll(pipes[p], &latencies[offset], result.latencies * sizeof(unsigned))) {
+                latencies.resize(offset);
+            }
+        }
+        close(pipes[p]);
+    }
+    while (wait(NULL) > 0) {
+    }
+    std::sort(latencies.begin(), latencies.end());
+    double p50 = percentile(latencies, 0.5);
+    double p99 = percentile(latencies, 0.99);
+    double p999 = percentile(latencies, 0.999);
+    double max = latencies.empty() ? 0 : latencies.back() / 1000.0;
+    if (!options.name.empty()) {
+        std::printf("{\"scenario\":\"%s\",\"connections\":%d,\"slow_clients\":%d,\"rate\":%.0f,\"seconds\":%.1f,"
+            "\"requests\":%lu,\"errors\":%lu,\"rps\":%.0f,\"p50_ms\":%.3f,\"p99_ms\":%.3f,\"p999_ms\":%.3f,"
+            "\"max_ms\":%.3f,\"status_2xx\":%lu,\"status_3xx\":%lu,\"status_4xx\":%lu,\"status_5xx\":%lu}\n",
+            options.name.c_str(), options.connections, options.slow, options.rate, options.duration,
+            total.requests, total.errors, total.requests / options.duration, p50, p99, p999, max,
+            total.statuses[2], total.statuses[3], total.statuses[4], total.statuses[5]);
+        return 0;
+    }
+    std::printf("connections=%d processes=%d seconds=%.1f requests=%lu errors=%lu rps=%.0f p50_ms=%.3f "
+        "p99_ms=%.3f p999_ms=%.3f max_ms=%.3f\n", options.connections, options.processes, options.duration,
+        total.requests, total.errors, total.requests / options.duration, p50, p99, p999, max);
+    return 0;
+}
@@ -0,0 +1,155 @@
+// Microbenchmark of the HTTP request parser.
+// It compares the istringstream-based parser that Request::parse used before
+// (kept below as LegacyRequest) with the incremental parser of the Request class.
+// It reports requests per second and heap allocations per request for each one.
+// Build and run it with: make bench
+
+#include "Request.hpp"
+#include <sstream>      // For std::istringstream, used by the legacy parser
+#include <map>          // For std::map, used by the legacy parser
+#include <iostream>     // For std::cout
+#include <cstdio>       // For std::printf
+#include <cstdlib>      // For std::malloc and std::free
+#include <new>          // For std::bad_alloc
+#include <sys/time.h>   // For gettimeofday
+
+static size_t g_allocations = 0;
+// Number of calls to operator new since the start of the program.
+static void (*volatile g_release)(void*) = std::free;
+// free() is called through a pointer so the compiler does not pair it with the inlined new.
+
+void* operator new(size_t size) throw(std::bad_alloc) {
+    ++g_allocations;
+    void* p = std::malloc(size ? size : 1);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) throw() {
+    g_release(p);
+}
+
+class LegacyRequest {
+    // The parser used by Request::parse before the incremental parser.
+    // It copies the buffer into an istringstream and every line into a std::string.
+public:
+    bool parse(const std::string& raw_request) {
+        std::istringstream stream(raw_request);
+        std::string line;
+        if (!std::getline(stream, line) || line.empty()) {
+            return false;
+        }
+        std::istringstream line_stream(line);
+        if (!(line_stream >> method >> uri >> version)) {
+            return false;
+        }
+        if (version != "HTTP/1.1" && version != "HTTP/1.0") {
+            return false;
+        }
+        while (std::getline(stream, line) && line != "\r" && line != "") {
+            size_t colon_pos = line.find(":");
+            if (colon_pos == std::string::npos) {
+                return false;
+            }
+            std::string key = line.substr(0, colon_pos);
+            std::string value = line.substr(colon_pos + 1);
+            size_t start = value.find_first_not_of(" \t");
+            size_t end = value.find_last_not_of(" \t\r");
+            if (start != std::string::npos && end != std::string::npos) {
+                value = value.substr(start, end - start + 1);
+            } else {
+                value = "";
+            }
+            headers[key] = value;
+        }
+        std::string body_content;
+        while (std::getline(stream, line)) {
+            body_content += line + "\n";
+        }
+        body = body_content;
+        return true;
+    }
+
+private:
+    std::string method;
+    std::string uri;
+    std::string version;
+    std::map<std::string, std::string> headers;
+    std::string body;
+};
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void report(const char* parser, const char* sample, size_t iterations, double seconds, size_t allocations) {
+    std::printf("%-8s %-8s %12.0f req/s %8.2f allocs/req\n", parser, sample,
+        iterations / seconds, static_cast<double>(allocations) / iterations);
+}
+
+static void run(const char* name, const std::string& raw, size_t iterations) {
+    // Legacy parser: a new object per request, as Server did with Request.
+    size_t allocations = g_allocations;
+    double start = now();
+    for (size_t i = 0; i < iterations; ++i) {
+        LegacyRequest request;
+        if (!request.parse(raw)) {
+            std::cerr << "legacy parser rejected the " << name << " sample" << std::endl;
+            std::exit(1);
+        }
+    }
+    report("legacy", name, iterations, now() - start, g_allocations - allocations);
+
+    // Incremental parser: one object reused per connection, as Connection does.
+    Request request;
+    request.parse(raw.data(), raw.size());
+    request.reset();
+    // The first parse sizes the header storage, as the first request of a connection does.
+    allocations = g_allocations;
+    start = now();
+    for (size_t i = 0; i < iterations; ++i) {
+        Request::ParseStatus status = request.parse(raw.data(), raw.size());
+        if (status == Request::PARSE_BODY) {
+            status = request.parse(raw.data(), raw.size());
+            // The body is buffered, as the Server does for a request that is not an upload.
+        }
+        if (status != Request::PARSE_COMPLETE) {
+            std::cerr << "incremental parser rejected the " << name << " sample" << std::endl;
+            std::exit(1);
+        }
+        request.reset();
+    }
+    report("request", name, iterations, now() - start, g_allocations - allocations);
+}
+
+int main() {
+    const size_t iterations = 200000;
+    std::string small = "GET / HTTP/1.1\r\nHost: localhost:8080\r\n\r\n";
+    std::string browser =
+        "GET /css/style.css?v=3 HTTP/1.1\r\n"
+        "Host: www.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:128.0) Gecko/20100101 Firefox/128.0\r\n"
+        "Accept: text/css,*/*;q=0.1\r\n"
+        "Accept-Language: en-US,en;q=0.5\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Referer: http://www.example.com/index.html\r\n"
+        "Connection: keep-alive\r\n"
+        "Cookie: session=0123456789abcdef; theme=dark\r\n"
+        "Cache-Control: max-age=0\r\n"
+        "\r\n";
+    std::string post =
+        "POST /upload HTTP/1.1\r\n"
+        "Host: localhost\r\n"
+        "Content-Type: application/octet-stream\r\n"
+        "Content-Length: 256\r\n"
+        "\r\n" + std::string(256, 'x');
+    std::cout << "parser   sample         throughput      allocations" << std::endl;
+    run("small", small, iterations);
+    run("browser", browser, iterations);
+    run("post", post, iterations);
+    return 0;
+}
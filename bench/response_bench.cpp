@@ -0,0 +1,200 @@
+// Microbenchmark of the response serializer.
+// It compares the ostringstream-based Response::generate used before (kept below as
+// LegacyResponse) with Response::enqueue, which writes the status line and the headers
+// into the reusable buffer of an OutputQueue and sends the body from the cache entry.
+// Every response is written to /dev/null, so the system calls are measured too.
+// "serialize" sends the same response again and again; "full" also builds the response
+// for each request (handler, file cache lookup and headers) in an arena that is reset after
+// each one, as the server does once the Router has found the location.
+// Build and run it with: make bench
+
+#include "Response.hpp"
+#include <sstream>      // For std::ostringstream, used by the legacy serializer
+#include <map>          // For std::map, used by the legacy serializer
+#include <fstream>      // For std::ofstream to create the served file
+#include <iostream>     // For std::cout
+#include <cstdio>       // For std::printf and std::remove
+#include <cstdlib>      // For std::malloc and std::free
+#include <new>          // For std::bad_alloc
+#include <fcntl.h>      // For open
+#include <unistd.h>     // For write, close and rmdir
+#include <sys/stat.h>   // For mkdir
+#include <sys/time.h>   // For gettimeofday
+
+static size_t g_allocations = 0;
+// Number of calls to operator new since the start of the program.
+static void (*volatile g_release)(void*) = std::free;
+// free() is called through a pointer so the compiler does not pair it with the inlined new.
+
+void* operator new(size_t size) throw(std::bad_alloc) {
+    ++g_allocations;
+    void* p = std::malloc(size ? size : 1);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) throw() {
+    g_release(p);
+}
+
+class LegacyResponse {
+    // The serializer used by Response before: headers in a map, the whole response
+    // (headers and body) joined in an ostringstream, then copied out with str().
+public:
+    LegacyResponse() : status_code(200), status_message("OK") {}
+
+    void setHeader(const std::string& key, const std::string& value) {
+        headers[key] = value;
+    }
+
+    void setBody(const std::string& body_content) {
+        body = body_content;
+        std::ostringstream oss;
+        oss << body.length();
+        setHeader("Content-Length", oss.str());
+    }
+
+    std::string generate() const {
+        std::ostringstream response;
+        response << "HTTP/1.1 " << status_code << " " << status_message << "\r\n";
+        for (std::map<std::string, std::string>::const_iterator it = headers.begin(); it != headers.end(); ++it) {
+            response << it->first << ": " << it->second << "\r\n";
+        }
+        response << "\r\n" << body;
+        return response.str();
+    }
+
+private:
+    int status_code;
+    std::string status_message;
+    std::map<std::string, std::string> headers;
+    std::string body;
+};
+
+static double now() {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void report(const char* serializer, const char* mode, size_t iterations, double seconds, size_t allocations) {
+    std::printf("%-8s %-10s %12.0f resp/s %8.2f allocs/resp\n", serializer, mode,
+        iterations / seconds, static_cast<double>(allocations) / iterations);
+}
+
+static void buildLegacy(LegacyResponse& response, const FileCache::Entry& entry) {
+    // Sets the headers of a static file response as the legacy handler did.
+    response.setHeader("Content-Type", entry.content_type);
+    response.setHeader("Accept-Ranges", "bytes");
+    response.setHeader("ETag", entry.etag);
+    response.setHeader("Last-Modified", entry.last_modified);
+    response.setHeader("Vary", "Accept-Encoding");
+    response.setHeader("Connection", "keep-alive");
+    response.setBody(entry.content);
+}
+
+static void run(const char* name, const Request& request, const Router::Location& location, FileCache& cache,
+    const std::string& path, int sink, size_t iterations) {
+    const FileCache::Entry* entry = cache.get(path);
+    if (entry == NULL) {
+        std::cerr << "cannot load " << path << std::endl;
+        std::exit(1);
+    }
+    std::cout << name << " (" << entry->size << " bytes)" << std::endl;
+
+    // Legacy serializer, same response every time.
+    LegacyResponse prepared;
+    buildLegacy(prepared, *entry);
+    size_t allocations = g_allocations;
+    double start = now();
+    for (size_t i = 0; i < iterations; ++i) {
+        std::string raw = prepared.generate();
+        if (write(sink, raw.data(), raw.size()) != static_cast<ssize_t>(raw.size())) {
+            std::exit(1);
+        }
+    }
+    report("legacy", "serialize", iterations, now() - start, g_allocations - allocations);
+
+    // Legacy serializer, a new response per request.
+    allocations = g_allocations;
+    start = now();
+    for (size_t i = 0; i < iterations; ++i) {
+        LegacyResponse response;
+        buildLegacy(response, *cache.get(path));
+        std::string raw = response.generate();
+        if (write(sink, raw.data(), raw.size()) != static_cast<ssize_t>(raw.size())) {
+            std::exit(1);
+        }
+    }
+    report("legacy", "full", iterations, now() - start, g_allocations - allocations);
+
+    // Response::enqueue into one OutputQueue, as a keep-alive connection does.
+    OutputQueue output;
+    Arena arena;
+    Response response(request, location, cache, arena);
+    response.setHeader("Connection", "keep-alive");
+    response.enqueue(output);
+    output.flush(sink);
+    // The first response sizes the buffer of the queue, as the first one of a connection does.
+    allocations = g_allocations;
+    start = now();
+    for (size_t i = 0; i < iterations; ++i) {
+        response.enqueue(output);
+        if (!output.flush(sink) || !output.empty()) {
+            std::exit(1);
+        }
+    }
+    report("enqueue", "serialize", iterations, now() - start, g_allocations - allocations);
+
+    allocations = g_allocations;
+    start = now();
+    for (size_t i = 0; i < iterations; ++i) {
+        Response fresh(request, location, cache, arena);
+        fresh.setHeader("Connection", "keep-alive");
+        fresh.enqueue(output);
+        if (!output.flush(sink) || !output.empty()) {
+            std::exit(1);
+        }
+        arena.reset();
+    }
+    report("enqueue", "full", iterations, now() - start, g_allocations - allocations);
+}
+
+static void writeFile(const std::string& path, const std::string& content) {
+    std::ofstream file(path.c_str());
+    file << content;
+}
+
+int main() {
+    const size_t iterations = 200000;
+    const std::string root = "/tmp/webserv_response_bench";
+    mkdir(root.c_str(), 0755);
+    writeFile(root + "/small.html", std::string(512, 'x'));
+    writeFile(root + "/page.css", std::string(16384, 'y'));
+    writeFile(root + "/bench.conf", "root=" + root + "\nindex=small.html\nerror_page_404=/404.html\ngzip=off\n");
+    Config config(root + "/bench.conf");
+    Router router(config);
+    const Router::Location& location = *router.findLocation(router.findHost(0, NULL, 0), "/", 1);
+    FileCache cache(64 * 1024 * 1024, 1024 * 1024, 256, 3600);
+    // A long validity keeps stat() out of the measure, as it is for a hot file.
+    int sink = open("/dev/null", O_WRONLY);
+
+    std::string small = "GET /small.html HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    std::string page = "GET /page.css HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    Request request;
+    std::cout << "serializer mode         throughput          allocations" << std::endl;
+    request.parse(small.data(), small.size());
+    run("small", request, location, cache, root + "/small.html", sink, iterations);
+    request.reset();
+    request.parse(page.data(), page.size());
+    run("page", request, location, cache, root + "/page.css", sink, iterations);
+
+    close(sink);
+    std::remove(std::string(root + "/small.html").c_str());
+    std::remove(std::string(root + "/page.css").c_str());
+    std::remove(std::string(root + "/bench.conf").c_str());
+    rmdir(root.c_str());
+    return 0;
+}
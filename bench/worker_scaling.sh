@@ -0,0 +1,38 @@
+#!/bin/sh
+# Measures how the throughput of webserv scales with the number of workers.
+# For worker counts from 1 up to the number of CPUs (or $MAX_WORKERS), it starts
+# webserv with workers=N on a temporary copy of the default configuration, runs
+# loadgen against it and prints one line per worker count.
+#
+# Usage: bench/worker_scaling.sh <webserv> <loadgen>
+
+WEBSERV=${1:-./webserv}
+LOADGEN=${2:-./obj/bench/loadgen}
+PORT=${PORT:-18080}
+DURATION=${DURATION:-5}
+CONNECTIONS=${CONNECTIONS:-256}
+MAX_WORKERS=${MAX_WORKERS:-$(getconf _NPROCESSORS_ONLN)}
+CONF=$(mktemp /tmp/webserv_bench.XXXXXX)
+
+trap 'rm -f "$CONF"' EXIT
+# Worker counts: powers of two up to MAX_WORKERS, then MAX_WORKERS itself.
+counts=1
+n=2
+while [ "$n" -lt "$MAX_WORKERS" ]; do
+    counts="$counts $n"
+    n=$((n * 2))
+done
+[ "$MAX_WORKERS" -gt 1 ] && counts="$counts $MAX_WORKERS"
+
+for workers in $counts; do
+    sed -e "s/^port=.*/port=$PORT/" -e "/^workers=/d" config/default.conf > "$CONF"
+    printf '\nworkers=%s\n' "$workers" >> "$CONF"
+    "$WEBSERV" "$CONF" > /dev/null 2>&1 &
+    pid=$!
+    sleep 1
+    printf 'workers=%-3s ' "$workers"
+    "$LOADGEN" -p "$PORT" -c "$CONNECTIONS" -d "$DURATION" -t "$workers" -u /index.html
+    kill "$pid"
+    wait "$pid" 2> /dev/null
+    PORT=$((PORT + 1))
+done
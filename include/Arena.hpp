@@ -0,0 +1,61 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+#include <cstddef>		// For size_t
+
+#define ARENA_BLOCK_SIZE 4096
+// Size of the first block of an arena. A static file response uses a few hundred bytes,
+// a multipart/byteranges one about 100 bytes per range.
+#define ARENA_MAX_KEEP 65536
+// Maximum size of the block an arena keeps between requests. A request that needed more
+// does not pin its memory on an idle keep-alive connection.
+
+class Arena {
+	// The Arena class is the memory of one request: the path of the file, the header values
+	// built for the response (Content-Range, the multipart boundaries) and the body of small
+	// error responses are taken from it with a pointer increment, and they are all freed at
+	// once by reset() when the request is consumed.
+	// Each connection has its own arena and reuses it for every request it serves. The first
+	// block is allocated by the first request that needs memory; when a request overflows it,
+	// reset() replaces the blocks with one big enough for both, so the following requests of
+	// the connection do not call malloc() at all.
+	// Nothing allocated from an arena is destroyed: it only holds characters and plain structs.
+public:
+    Arena();
+	// Constructor of an empty arena. No memory is allocated until it is used.
+    ~Arena();
+	// Destructor that frees the blocks.
+    void* allocate(size_t size);
+	// Returns size bytes, aligned for any type. They are valid until the next reset().
+    char* copy(const char* data, size_t length);
+	// Returns a copy of length bytes of data, followed by a null character.
+    void reset();
+	// Frees everything allocated since the last reset, keeping one block for the next request.
+    size_t getBlockCount() const;
+	// Returns the number of blocks the arena holds, for the benchmarks.
+
+private:
+    struct Block {
+        Block* next;		// Block allocated before this one, NULL for the first.
+        size_t size;		// Number of usable bytes after the header.
+    };
+
+    Block* blocks;
+	// Most recent block, the one allocations are taken from. NULL until the first allocation.
+    char* position;
+	// First free byte of the current block.
+    char* end;
+	// End of the current block.
+    size_t used;
+	// Bytes handed out since the last reset, in every block.
+
+    void addBlock(size_t size);
+	// Allocates a block of at least size bytes and makes it the current one.
+    void freeBlocks();
+	// Frees every block.
+    Arena(const Arena&);
+    Arena& operator=(const Arena&);
+	// An arena owns its blocks, it cannot be copied.
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef BODYDECODER_HPP
+#define BODYDECODER_HPP
+
+#include <cstddef>		// For size_t
+
+#define MAX_CHUNK_LINE 4096
+// Maximum size of a chunk-size line (with its extensions) or of a trailer line.
+
+class BodyDecoder {
+	// The BodyDecoder class removes the framing of a request body as its bytes arrive:
+	// Content-Length bytes, or the chunked transfer coding (RFC 9112, section 7.1).
+	// It does not copy anything: decode() returns the next piece of body as a pointer into
+	// the bytes it was given, and it keeps only a few counters between calls, so a body of
+	// any size is decoded in constant memory.
+	// The Request uses it to decode a chunked body in memory, and the Server uses it to
+	// stream an upload to disk.
+public:
+    enum Status {
+        BODY_AGAIN,	// More bytes are needed; the bytes not consumed must be given again.
+        BODY_DATA,	// A piece of body was returned; call decode() again with the rest.
+        BODY_DONE,	// The body is complete, consumed includes its last byte.
+        BODY_ERROR	// The framing is invalid or the body too large, see getErrorStatus().
+    };
+
+    BodyDecoder();
+	// Constructor of a decoder for an empty body.
+    void reset(bool chunked, size_t content_length, size_t max_size);
+	// Prepares the decoder for a new body: chunked, or content_length bytes.
+	// max_size is the maximum size of the decoded body (413), 0 means no limit.
+    Status decode(const char* data, size_t length, size_t& consumed, const char*& chunk, size_t& chunk_length);
+	// Decodes the body bytes in data. consumed is set to the number of bytes used, which may
+	// be less than length (an incomplete chunk-size line, or the bytes after the body).
+	// With BODY_DATA, chunk and chunk_length give the piece of body, inside data.
+    int getErrorStatus() const;
+	// Returns the HTTP status code to answer with after BODY_ERROR (400 or 413).
+    size_t getSize() const;
+	// Returns the number of body bytes decoded so far.
+
+private:
+    enum State {
+        STATE_LENGTH,		// Reading the rest of a Content-Length body.
+        STATE_SIZE,			// Waiting for a chunk-size line.
+        STATE_DATA,			// Reading the data of a chunk.
+        STATE_DATA_END,		// Waiting for the CRLF after the data of a chunk.
+        STATE_TRAILER,		// Reading the trailer lines after the last chunk.
+        STATE_DONE,			// The body is complete.
+        STATE_ERROR			// The body is invalid.
+    };
+    State state;
+	// Current state of the decoder.
+    size_t remaining;
+	// Bytes left in the Content-Length body or in the current chunk.
+    size_t size;
+	// Bytes of body decoded so far.
+    size_t max_size;
+	// Maximum size of the body, 0 means no limit.
+    int error_status;
+	// HTTP status code of the error, when state is STATE_ERROR.
+
+    const char* readLine(const char* data, size_t length, size_t& consumed, size_t& line_length);
+	// Returns the next complete line of data after consumed, without its CRLF, and moves
+	// consumed past it. Returns NULL if the line is not complete yet (or too long: an error).
+    Status fail(int status);
+	// Moves the decoder to the error state with the given HTTP status code.
+};
+
+#endif
@@ -0,0 +1,258 @@
+#ifndef CGI_HPP
+#define CGI_HPP
+
+#include "Request.hpp"		// Include the Request class for the environment of the script
+#include "OutputQueue.hpp"	// Include the OutputQueue class where the response is streamed
+#include "FastCGIPool.hpp"	// Include the FastCGIPool class for the FastCGI connections
+#include "UpstreamPool.hpp"	// Include the UpstreamPool class for the proxied connections
+#include "BodyDecoder.hpp"	// Include the BodyDecoder class to find the end of the proxied bodies
+#include <sys/types.h>		// For pid_t
+#include <string>			// For std::string
+#include <vector>			// For std::vector to build the environment
+#include <ctime>			// For time_t
+
+#define CGI_INPUT_BUFFER 65536
+// Bytes of a streamed request body taken from the client and not yet sent to the script, the
+// FastCGI responder or the upstream server.
+
+class CGI {
+	// The CGI class runs one CGI script (RFC 3875) for a request.
+	// The interpreter of the script is started with fork() and execve(), with the request
+	// described in its environment, the request body on its standard input and the response
+	// read from its standard output. Both pipes are non-blocking: the Server registers them
+	// in its event loop and calls writeInput() and readOutput() when they are ready, so a
+	// slow script never blocks the worker.
+	// The output is parsed as it arrives: the CGI headers (Status, Location, Content-Type...)
+	// become the HTTP response head, and the body is streamed into the output queue of the
+	// connection. Without a Content-Length, the body is sent with the chunked transfer coding
+	// (or until the connection is closed for HTTP/1.0).
+	// A location with fastcgi_pass sends its requests to a FastCGI responder instead of starting
+	// a process: the same request and response go as FastCGI records over one connection of
+	// the FastCGIPool, which is both the input and the output file descriptor.
+	// A location with proxy_pass forwards its requests to a server of an upstream group, as
+	// HTTP/1.1 over one connection of the UpstreamPool. A request body is streamed: it stays in
+	// the input buffer of the client until there is room for it, at most CGI_INPUT_BUFFER bytes
+	// wait to be sent, and the response body is parsed and queued as it is read, so neither
+	// body is ever kept whole in memory.
+	// A body with a Content-Length is streamed the same way to a script (on its standard input)
+	// and to a FastCGI responder (as FCGI_STDIN records). A chunked body is decoded whole in the
+	// input buffer first: CONTENT_LENGTH must be known before the script starts.
+public:
+    enum Status {
+        CGI_AGAIN,	// The pipe has no more data for now: wait for the event loop.
+        CGI_DONE,	// The body was written (input) or the script finished its response (output).
+        CGI_ERROR	// The pipe failed or the script sent an invalid response.
+    };
+    struct Params {
+        std::string interpreter;	// Program that runs the script (e.g., /usr/bin/php-cgi).
+        std::string path;			// Path of the script in the file system.
+        std::string script_name;	// URI path of the script (SCRIPT_NAME).
+        std::string path_info;		// Rest of the URI path after the script (PATH_INFO).
+        std::string document_root;	// Root of the location (DOCUMENT_ROOT).
+        std::string server_name;	// Name of the server the request was sent to (SERVER_NAME).
+        int server_port;			// Port of the listener that accepted the connection (SERVER_PORT).
+        std::string remote_addr;	// Address of the client (REMOTE_ADDR).
+        int remote_port;			// Port of the client (REMOTE_PORT).
+        bool keep_alive;			// True if the connection stays open after the response.
+        const char* date;			// Value of the Date header, kept up to date by the Server.
+    };
+
+    CGI();
+	// Constructor of a script that is not started yet.
+    ~CGI();
+	// Destructor that kills the script if it was not detached and closes its pipes.
+    bool start(const Request& request, const Params& params, bool streamed, size_t max_body_size);
+	// Starts the script. Returns false if the pipes or the process cannot be created.
+	// If the interpreter cannot be executed, the script exits without output (a 502).
+    bool startFastCGI(const Request& request, const Params& params, FastCGIPool& pool,
+        const Router::Location& location, bool streamed, size_t max_body_size);
+	// Sends the request to the FastCGI responder of the location, on a connection of the pool.
+	// Returns false if the responder is down or cannot be reached (a 502).
+    bool startProxy(const Request& request, const Params& params, UpstreamPool& pool,
+        const Router::Upstream& upstream, size_t group, bool streamed, size_t max_body_size);
+	// Sends the request to a server of the upstream group, on a connection of the pool. group
+	// is the index of the group in the pool (see UpstreamPool::findGroup).
+	// Returns false if every server of the group is down or unreachable (a 502).
+	// For the three start functions, if streamed is true the body is still in the input buffer
+	// of the client and is given with feedInput().
+    Status feedInput(const char* data, size_t length, size_t& consumed);
+	// Takes bytes of a streamed request body, while less than CGI_INPUT_BUFFER bytes wait to be
+	// sent. consumed is set to the number of bytes taken; the rest stays with the caller (the
+	// body of a slow script or server is not read from the client). Returns CGI_DONE once the
+	// whole body was taken, or CGI_ERROR if it is invalid or too large (see getInputError()).
+    Status writeInput();
+	// Writes as much of the request body as the pipe accepts. Returns CGI_DONE once it is all
+	// written (or the script closed its standard input without reading it), or CGI_ERROR if
+	// the connection to the FastCGI responder failed.
+    Status readOutput(OutputQueue& output, size_t limit);
+	// Reads the output of the script and queues the response, until the pipe is empty or the
+	// output queue holds limit bytes (backpressure: the rest is read when the client catches up).
+	// Returns CGI_DONE at the end of the output, and CGI_ERROR if the output is not a valid CGI
+	// response (e.g., the script exited before its headers).
+    void closeInput();
+    void closeOutput();
+	// Close the pipes. The Server removes them from the event loop first. For FastCGI,
+	// closeInput() only stops writing, and closeOutput() gives the connection back to the pool
+	// if the responder ended the request cleanly.
+    void kill();
+	// Kills the script (the client left or the script timed out). A FastCGI request is
+	// abandoned: its connection is closed instead of going back to the pool.
+    pid_t detach();
+	// Returns the process id of the script and forgets it, so the destructor does not kill it.
+	// The Server reaps the process with waitpid() when it exits.
+    int getInputFd() const;
+    int getOutputFd() const;
+	// Return the file descriptors of the pipes, or -1 once they are closed. For FastCGI both
+	// are the connection to the responder.
+    bool hasStarted() const;
+	// Returns true once the response head was queued. Before that, an error can still be
+	// answered with a 502 or a 504.
+    int getStatus() const;
+	// Returns the status code of the response of the script, once it has started.
+    bool keepsAlive() const;
+	// Returns true if the connection can stay open after the response: the client asked for it
+	// and the end of the body is known (Content-Length or chunked), and it was sent completely.
+    time_t getLastOutput() const;
+	// Returns the time the script was started or last sent output, for cgi_timeout. For a
+	// proxied request, sending the request body to the upstream server counts too.
+    bool acceptsInput() const;
+	// Returns true while the body of a streamed request is not completely taken.
+    bool isWaitingForInput() const;
+	// Returns true if everything taken was sent and the rest of the body must come from the client.
+    int getInputError() const;
+	// Returns the HTTP status code of an invalid streamed body (400 or 413).
+    bool canRetry() const;
+	// Returns true if a proxied request whose connection failed can be sent to another server:
+	// nothing of the response was received, and nothing was written yet (e.g., the connection
+	// was refused), or the request has no streamed body and was not completely sent or can be
+	// repeated (not a POST).
+    bool retry();
+	// Gives the failed connection back and sends the request again on a connection to the next
+	// server of the group. The Server removes the old connection from the event loop first.
+	// Returns false if no other server can be reached.
+    void reportTimeout();
+	// Counts a timeout of the FastCGI responder or of the upstream server as a failed request.
+
+private:
+    pid_t pid;
+	// Process id of the script, -1 if it is not running.
+    int input_fd;
+	// Write end of the standard input of the script, -1 once the body is written.
+    int output_fd;
+	// Read end of the standard output of the script, -1 once it is closed.
+    std::string body;
+	// Bytes waiting to be written: the request body of a script (copied because the request is
+	// consumed before the script reads it), the request encoded as FastCGI records, or the head
+	// of a proxied request. Of a streamed body, at most CGI_INPUT_BUFFER bytes at a time.
+    size_t body_sent;
+	// Bytes of body already written to the script.
+    std::string head;
+	// Output of the script until the end of its headers.
+    bool started;
+	// True once the response head was queued.
+    int status_code;
+	// Status code of the response head, once it was queued.
+    bool chunked;
+	// True if the body is sent with the chunked transfer coding.
+    bool head_only;
+	// True for a HEAD request: the body of the script is discarded.
+    bool keep_alive;
+	// True if the client asked to keep the connection open.
+    bool http10;
+	// True for an HTTP/1.0 request, which does not understand chunked.
+    long content_length;
+	// Content-Length given by the script, -1 if there is none.
+    long body_length;
+	// Bytes of body read from the script.
+    const char* date;
+	// Value of the Date header of the response.
+    time_t last_output;
+	// Time the script was started or last sent output.
+    FastCGIPool* pool;
+	// Pool of the FastCGI connection, NULL for a process.
+    size_t backend;
+	// Index of the FastCGI responder in the pool.
+    std::string records;
+	// FastCGI records received and not parsed yet (a record can arrive in several reads).
+    bool ended;
+	// True once the responder ended the request (FCGI_END_REQUEST) with nothing left to read,
+	// or the upstream server ended its keep-alive response, so the connection can be reused.
+    UpstreamPool* proxy;
+	// Pool of the upstream connection, NULL unless the request is proxied.
+    size_t peer;
+	// Index of the upstream server in the pool.
+    bool reused;
+	// True if the upstream connection was idle in the pool: if it fails before the response,
+	// the server probably closed it just before, which is not counted as a failure.
+    const Router::Upstream* upstream;
+	// Upstream group of the request, to send it to another server (it belongs to the
+	// generation the connection holds).
+    size_t upstream_group;
+	// Index of the group in the pool.
+    std::string key;
+	// Key of the request for a hash group.
+    bool idempotent;
+	// True if the request can be sent twice (every method but POST).
+    size_t tries;
+	// Servers the request was sent to.
+    bool streamed;
+	// True if the request body is given with feedInput().
+    bool input_sent;
+	// True once a byte of the proxied request was written: a streamed body cannot be sent again after.
+    bool input_done;
+	// True once the whole streamed body was taken.
+    int input_error;
+	// HTTP status code of an invalid streamed body.
+    BodyDecoder input_decoder;
+	// Decodes the streamed body. A proxied one is forwarded as it was received: the decoder
+	// only finds its end.
+    bool upstream_chunked;
+	// True if the response of the upstream server is chunked.
+    bool upstream_keep_alive;
+	// True if the upstream server keeps the connection open after its response.
+    BodyDecoder output_decoder;
+	// Decodes a chunked response of the upstream server.
+
+    CGI(const CGI&);
+    CGI& operator=(const CGI&);
+	// A running script is owned by one connection, it cannot be copied.
+
+    void setup(const Request& request, const Params& params);
+	// Keeps what the response needs to know about the request.
+    void setupInput(const Request& request, bool streamed, size_t max_body_size);
+	// Prepares feedInput() for a streamed body.
+    static std::vector<std::string> buildEnvironment(const Request& request, const Params& params);
+	// Builds the RFC 3875 meta-variables (REQUEST_METHOD, QUERY_STRING, HTTP_*...).
+    Status parseOutput(OutputQueue& output, const char* data, size_t length);
+	// Handles bytes of the output of the script: headers until the response head is queued,
+	// then body.
+    Status endOutput(OutputQueue& output);
+	// Ends the response once the script sent all its output.
+    Status parseRecords(OutputQueue& output);
+	// Handles the complete FastCGI records received: FCGI_STDOUT is the output of the script,
+	// FCGI_STDERR is logged and FCGI_END_REQUEST ends the response.
+    static void appendRecord(std::string& records, unsigned char type, const char* content, size_t length);
+	// Encodes content as FastCGI records of the given type (65535 bytes at most each).
+    static std::string buildProxyHead(const Request& request, const Params& params,
+        const Router::Upstream& upstream, bool streamed);
+	// Builds the request sent to the upstream server: the request line and the end-to-end
+	// headers of the client, with X-Forwarded-For, X-Real-IP and X-Forwarded-Proto added.
+    Status parseUpstream(OutputQueue& output);
+	// Handles the bytes of the upstream response in records: the status line and headers
+	// until the response head is queued, then the body (Content-Length, chunked, or until
+	// the server closes the connection).
+    int parseUpstreamHead(OutputQueue& output, size_t end);
+	// Parses the response head in records, which ends at end. Returns 1 once it is queued,
+	// 0 for an interim (1xx) response that is skipped, or -1 if it is invalid.
+    Status finishUpstream(OutputQueue& output, bool clean);
+	// Ends a complete upstream response. clean is false if the server sent more than the response.
+    Status failUpstream();
+	// Counts the failed request against the upstream server and returns CGI_ERROR.
+    bool parseHead(OutputQueue& output);
+	// Parses the CGI headers once they are complete and queues the HTTP response head.
+	// Returns false if they are invalid.
+    void appendBody(OutputQueue& output, const char* data, size_t length);
+	// Queues body bytes, as a chunk if the response is chunked.
+};
+
+#endif
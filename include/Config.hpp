@@ -13,7 +13,33 @@
 class Config {
 	// This class is responsible for reading configuration settings from a file.
 	// It stores the settings in a map for easy access by key.
+	// Two formats are accepted. The original one has a "key=value" setting per line.
+	// The block format is similar to nginx: "key value;" directives, and server blocks
+	// with location blocks inside them:
+	//     keepalive_timeout 15;
+	//     server {
+	//         listen 8080;
+	//         server_name example.com www.example.com;
+	//         root ./www;
+	//         location /images { root ./static; methods GET; }
+	//     }
+	//     upstream app { server 127.0.0.1:9001; server 127.0.0.1:9002 weight=2; least_conn; }
+	// Directives outside the blocks are the global settings returned by get().
+	// The blocks are only stored here; the Router compiles them into its lookup tables.
 public:
+    struct LocationBlock {
+        std::string prefix;								// URI prefix of the location (e.g., /images).
+        std::map<std::string, std::string> settings;	// Directives of the location.
+    };
+    struct ServerBlock {
+        std::map<std::string, std::string> settings;	// Directives of the server (listen, server_name...).
+        std::vector<LocationBlock> locations;			// Location blocks, in the order of the file.
+    };
+    struct UpstreamBlock {
+        std::string name;								// Name of the group, used by proxy_pass.
+        std::map<std::string, std::string> settings;	// Directives of the group (server, least_conn...).
+    };
+
 	Config(const std::string& filename);
 	// Constructor that takes a filename as an argument.
 	// It reads the configuration file and populates the settings map.
@@ -23,17 +49,46 @@ public:
 	// Retrieves the value associated with the given key.
 	// If the key does not exist, it throws a std::runtime_error.
 	// If the key exists, it returns the value as a std::string.
+    long getInt(const std::string& key, long default_value) const;
+	// Retrieves the value associated with the given key as a number.
+	// If the key does not exist or is not a valid number, it returns default_value.
+    size_t getSize(const std::string& key, size_t default_value) const;
+	// Retrieves the value associated with the given key as a size in bytes.
+	// The value can end with k, m or g (e.g., 8k, 1m) to multiply it by 1024, 1024^2 or 1024^3.
+	// If the key does not exist or is not a valid size, it returns default_value.
+    const std::vector<ServerBlock>& getServers() const;
+	// Returns the server blocks of the file, empty for a "key=value" file.
+    const std::vector<UpstreamBlock>& getUpstreams() const;
+	// Returns the upstream blocks of the file, the groups of servers a proxy_pass can name.
+    const std::string& getPath() const;
+	// Returns the name of the file the settings were read from, to read it again on reload.
+    static long toInt(const std::string& value, long default_value);
+    static size_t toSize(const std::string& value, size_t default_value);
+	// Convert a value as getInt() and getSize() do, for the settings of the blocks.
 
 private:
+    std::string path;
+	// Name of the configuration file.
 	std::map<std::string, std::string> settings;
 	// A map to store the configuration settings, where the key is a string
 	// and the value is also a string.
 	// The map allows for efficient retrieval of settings by key.
 	// The map is private to ensure that it can only be accessed through the public methods.
+    std::vector<ServerBlock> servers;
+	// The server blocks, in the order of the file.
+    std::vector<UpstreamBlock> upstreams;
+	// The upstream blocks, in the order of the file.
     void parse(const std::string& filename);
 	// Parses the configuration file and populates the settings map.
 	// It reads each line of the file, splits it into key and value,
 	// and stores them in the settings map.
+    void parseBlocks(const std::vector<std::string>& tokens, const std::vector<int>& lines);
+	// Parses the tokens of a file in the block format.
+	// Throws a std::runtime_error with the line number if the syntax is wrong.
+    static void addDirective(std::map<std::string, std::string>& settings, const std::vector<std::string>& words);
+	// Stores a directive in a settings map. The arguments are joined with spaces, and a
+	// repeated directive (e.g., listen) adds its arguments to the previous ones.
+	// "error_page 404 500 /error.html" is stored as error_page_404 and error_page_500.
 };
 
 #endif
\ No newline at end of file
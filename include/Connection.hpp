@@ -0,0 +1,133 @@
+#ifndef CONNECTION_HPP
+#define CONNECTION_HPP
+
+#include "Request.hpp"	// Include the Request class to decide the keep-alive policy
+#include "OutputQueue.hpp"	// Include the OutputQueue class for the pending responses
+#include "TimerWheel.hpp"	// Include the TimerWheel class for the timeout of the connection
+#include "Arena.hpp"	// Include the Arena class for the memory of the current request
+#include "LogFormat.hpp"	// Include the LogFormat class for the access log record of the request
+#include <string>		// For std::string
+#include <netinet/in.h>	// For sockaddr_in, the address of the client
+#include <ctime>		// For time_t
+
+#define CONNECTION_SLAB 64
+// Number of connections allocated together when the free list of connections is empty.
+
+class Generation;
+class CGI;
+class Upload;
+// Forward declarations: the connection only holds pointers to its generation, its CGI script
+// and its upload.
+
+class Connection {
+	// The Connection class holds the state of one client socket between poll wakeups.
+	// It lives alongside the pollfd entry of the client in the Server.
+	// It stores the bytes received but not yet consumed, so that pipelined
+	// requests and requests split across several reads are not lost.
+	// It also tracks how many requests were served and when the client was last active,
+	// so the Server can apply the timeouts and the max-requests limit.
+	// A connection is not copied: it is created with new and owns a reference to its generation.
+	// Connections are allocated from slabs of CONNECTION_SLAB and a deleted connection goes to
+	// a free list, so accepting a client reuses the memory of one that left instead of calling
+	// malloc(). The slabs are kept for the life of the worker: they never hold more
+	// connections than the busiest moment needed.
+public:
+    Connection(int fd, size_t listener, Generation* generation);
+	// Constructor that takes the file descriptor of the accepted client socket, the
+	// index of the listening socket that accepted it and the current configuration
+	// generation, which the connection holds a reference to.
+    ~Connection();
+	// Destructor that releases the generation of the connection and deletes its CGI script
+	// and its upload.
+    static void* operator new(size_t size);
+    static void operator delete(void* memory);
+	// Take a connection from the free list, allocating a new slab if it is empty, and give it back.
+    Request::ParseStatus parseRequest();
+	// Resumes parsing the current request with the bytes available in the input buffer.
+	// The framing of a chunked body already decoded is removed from the buffer.
+    void consumeRequest();
+	// Marks the bytes of the complete current request as consumed and resets the parser
+	// and the arena for the next pipelined request.
+    void compactInput();
+	// Removes the consumed bytes from the front of the input buffer.
+	// It is called once per read instead of once per request, so pipelined requests
+	// do not move the rest of the buffer every time.
+    bool flushOutput();
+	// Sends as much of the pending output as the socket accepts without blocking.
+	// Returns false if the client is gone.
+    bool hasPendingOutput() const;
+	// Returns true if part of the output was not sent yet.
+    bool wantsKeepAlive(const Request& request) const;
+	// Returns true if the connection must stay open after answering the request.
+	// HTTP/1.1 defaults to keep-alive and HTTP/1.0 defaults to close,
+	// unless the Connection header says otherwise.
+
+    int fd;
+	// File descriptor of the client socket.
+    size_t listener;
+	// Index of the listening socket (Router listener) that accepted the connection.
+	// It selects the virtual hosts the Host header is looked up in.
+    Generation* generation;
+	// Configuration generation of the last request of the connection. listener is an
+	// index in its Router. The Server moves the connection to the current generation
+	// when a new request starts.
+    int interest;
+	// Events the event loop watches for this connection (EVENT_READ or EVENT_WRITE).
+    std::string input;
+	// Bytes received from the client. The bytes before input_start were already consumed.
+    size_t input_start;
+	// Offset of the first byte of the current request in input.
+    Request request;
+	// Parser of the current request. It is reused for every request of the connection,
+	// and its views point into input.
+    OutputQueue output;
+	// Responses queued for the client and not sent yet.
+    Arena arena;
+	// Memory of the response to the current request (see Response). The response is copied
+	// into output before the request is consumed, so the arena is reset with the parser.
+    bool close_after_output;
+	// True if the connection must be closed once the output is sent
+	// (Connection: close, parse error, or the client closed its side).
+    bool head;
+	// True if the current request is a HEAD: its responses, errors included, have no body.
+    size_t requests_served;
+	// Number of requests answered on this connection.
+    size_t max_requests;
+	// Maximum number of requests allowed on this connection (keepalive_requests).
+    time_t last_activity;
+	// Time of the last read or write on this connection, used for the idle, body and send timeouts.
+    time_t request_started;
+	// Time the first bytes of the current request arrived (or the connection was accepted,
+	// for the first request), used for the header timeout.
+    TimerWheel::Timer timer;
+	// Deadline of the connection in the timer wheel of the Server.
+    struct sockaddr_in peer;
+	// Address of the client, given to CGI scripts (REMOTE_ADDR and REMOTE_PORT).
+    CGI* cgi;
+	// CGI script answering the current request, or NULL. While it runs, the next pipelined
+	// requests wait in the input buffer.
+    time_t cgi_timeout;
+	// Seconds the running script may go without sending output (cgi_timeout of its location).
+    Upload* upload;
+	// Upload receiving the body of the current request, or NULL. Its request was already
+	// consumed: the bytes after input_start are body, written to disk as they arrive.
+    LogFormat::Record log_record;
+	// Access log record of the current request. Its status is the one of the last response
+	// queued. Its views point into input until the request is consumed, and into log_storage
+	// for a request answered by a script, a proxied server or an upload (log_pending).
+    std::string log_storage;
+	// Copy of the request line and headers of log_record, for a request still being answered.
+    bool log_pending;
+	// True if the request of log_record is consumed but not logged yet.
+    unsigned long log_started;
+	// Time the request of log_record was parsed (Metrics::now), for $request_time.
+    size_t log_queued;
+	// Bytes ever queued in output when that request was parsed, for $bytes_sent.
+
+private:
+    Connection(const Connection&);
+    Connection& operator=(const Connection&);
+	// Copying would release the generation twice.
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef EPOLLLOOP_HPP
+#define EPOLLLOOP_HPP
+
+#include "EventLoop.hpp"	// Include the EventLoop interface implemented by this class
+#include <vector>			// For std::vector
+
+#ifdef __linux__
+# include <sys/epoll.h>		// For epoll_create, epoll_ctl and epoll_wait
+
+class EpollLoop : public EventLoop {
+	// The EpollLoop class implements the EventLoop with Linux epoll.
+	// The kernel keeps the interest list, so waiting costs O(ready descriptors)
+	// instead of O(registered descriptors).
+	// It can work level-triggered (like poll) or edge-triggered (EPOLLET), where an event is
+	// reported once per state change and the Server drains each socket until EAGAIN.
+public:
+    EpollLoop(bool edge_triggered);
+	// Creates the epoll instance. Throws std::runtime_error if it fails.
+    virtual ~EpollLoop();
+	// Closes the epoll instance.
+    virtual void add(int fd, int events);
+    virtual void modify(int fd, int events);
+    virtual void remove(int fd);
+    virtual int wait(std::vector<Event>& ready, int timeout_ms);
+    virtual bool isEdgeTriggered() const;
+    virtual const char* getName() const;
+
+private:
+    int epoll_fd;
+	// File descriptor of the epoll instance.
+    bool edge_triggered;
+	// True if the descriptors are registered with EPOLLET.
+    std::vector<struct epoll_event> buffer;
+	// Buffer filled by epoll_wait(), reused on every call.
+
+    void control(int operation, int fd, int events);
+	// Calls epoll_ctl() and throws std::runtime_error if it fails.
+};
+
+#endif
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef ERRORPAGES_HPP
+#define ERRORPAGES_HPP
+
+#include "Config.hpp"		// Include the Config class for the error_page_* settings
+#include "MimeTypes.hpp"	// Include the MimeTypes class for the Content-Type of the pages
+#include "OutputQueue.hpp"	// Include the OutputQueue class where the responses are queued
+#include "HotHeaders.hpp"	// Include the HotHeaders class for the length of the Date
+#include <string>			// For std::string
+#include <vector>			// For std::vector to store the prebuilt responses
+
+class ErrorPages {
+	// The ErrorPages class holds the complete error responses (status line, headers and
+	// body) the server sends most often, built once when the worker starts.
+	// The body is the file of the global error_page_<code> setting (relative to the global root) if it
+	// exists, or a small HTML page otherwise.
+	// Each response is kept twice, with "Connection: keep-alive" and with "Connection: close".
+	// Their Date header is rewritten in place, when a response is sent in a second that differs
+	// from the one they hold, so sending an error is a single copy into the output buffer,
+	// without reading any file. The Date is read from the worker's HotHeaders at that moment,
+	// so the pages of a generation that only old connections still use stay current too.
+public:
+    ErrorPages(const Config& config, const MimeTypes& types, const char* date);
+	// Constructor that builds the responses of every error code in the table, with the
+	// Content-Type of each page file from types. date is the value of the Date header kept
+	// by the HotHeaders of the worker (see HotHeaders::getDate), which must outlive the pages.
+    bool has(int code) const;
+	// Returns true if there is a prebuilt response for the code.
+    void enqueue(int code, bool keep_alive, bool head, OutputQueue& output);
+	// Queues the prebuilt response of the code (500 if there is none), only its status line
+	// and headers if head is true (the answer to a HEAD request).
+    const std::string& get(int code, bool keep_alive);
+	// Returns the prebuilt response of the code (500 if there is none), to send it on a
+	// socket that has no connection state (e.g., a connection rejected at the limit).
+
+private:
+    struct Page {
+        int code;					// HTTP status code of the response.
+        std::string response[2];	// Complete response with "Connection: close" (0) and "keep-alive" (1).
+        size_t date_offset[2];		// Offset of the value of the Date header in each response.
+        size_t head_length[2];		// Length of the status line and headers of each response.
+    };
+    std::vector<Page> pages;
+	// The prebuilt responses, sorted by status code.
+    const char* date;
+	// Current value of the Date header, owned by the HotHeaders of the worker.
+    char written_date[HTTP_DATE_LENGTH];
+	// Value of the Date header written in the responses.
+
+    void updateDate();
+	// Rewrites the Date header of every response if the current one is different.
+
+    const Page* find(int code) const;
+	// Returns the page of the code, or NULL if there is none.
+};
+
+#endif
@@ -0,0 +1,48 @@
+#ifndef EVENTLOOP_HPP
+#define EVENTLOOP_HPP
+
+#include "Config.hpp"	// Include the Config class to choose the backend
+#include <vector>		// For std::vector to return the ready events
+
+#define EVENT_READ	1	// The file descriptor is readable (or a listening socket has a connection).
+#define EVENT_WRITE	2	// The file descriptor is writable.
+#define EVENT_ERROR	4	// An error or a hangup happened on the file descriptor.
+
+class EventLoop {
+	// The EventLoop class is the interface between the Server and the readiness API of the system.
+	// The Server registers file descriptors with the events it is interested in,
+	// and wait() returns only the file descriptors that are ready, so the Server
+	// does not have to walk every connection on each wakeup.
+	// PollLoop implements it with poll() and EpollLoop with Linux epoll.
+public:
+    struct Event {
+        int fd;			// The file descriptor that is ready.
+        int events;		// A combination of EVENT_READ, EVENT_WRITE and EVENT_ERROR.
+    };
+
+    virtual ~EventLoop();
+	// Virtual destructor, so each backend releases its own resources.
+    virtual void add(int fd, int events) = 0;
+	// Starts watching fd for the given events (EVENT_READ and/or EVENT_WRITE).
+    virtual void modify(int fd, int events) = 0;
+	// Changes the events watched for fd.
+    virtual void remove(int fd) = 0;
+	// Stops watching fd. It must be called before fd is closed.
+    virtual int wait(std::vector<Event>& ready, int timeout_ms) = 0;
+	// Waits until at least one file descriptor is ready or timeout_ms milliseconds pass
+	// (-1 waits forever). ready is filled with the ready file descriptors.
+	// Returns the number of ready file descriptors, or -1 on error.
+    virtual bool isEdgeTriggered() const;
+	// Returns true if events are only reported when the state changes, so the
+	// Server must read and write until EAGAIN before waiting again.
+    virtual const char* getName() const = 0;
+	// Returns the name of the backend (e.g., "epoll"), for logging.
+
+    static EventLoop* create(const Config& config);
+	// Creates the backend selected by the event_loop key ("epoll" or "poll").
+	// edge_triggered=on selects edge-triggered mode for epoll.
+	// epoll is the default on Linux, poll is the fallback everywhere else.
+	// Throws std::runtime_error if the backend cannot be created.
+};
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef FASTCGIPOOL_HPP
+#define FASTCGIPOOL_HPP
+
+#include "Router.hpp"		// Include the Router class for the FastCGI settings of a location
+#include "KeepAlivePool.hpp"	// Include the KeepAlivePool class for the connections of each backend
+#include <vector>			// For std::vector
+
+class FastCGIPool {
+	// The FastCGIPool class keeps the connections of a worker to its FastCGI responders
+	// (e.g., php-fpm), one backend per fastcgi_pass address.
+	// A request borrows a connection and gives it back when the responder ended the request
+	// with the connection still usable (FCGI_KEEP_CONN). Up to fastcgi_pool_size idle
+	// connections are kept per backend, so most requests skip the connect() and the
+	// responder's accept(). Idle connections are closed after fastcgi_keepalive_timeout.
+	// The health of a backend is checked passively: after fastcgi_max_fails failed requests
+	// in a row it is marked down, and requests are answered at once with a 502 instead of
+	// waiting for it. After fastcgi_fail_timeout seconds the next request tries it again.
+	// Every socket is non-blocking and close-on-exec, and no call of the pool blocks.
+public:
+    FastCGIPool();
+	// Constructor of an empty pool. Backends are added when a location first uses them.
+    ~FastCGIPool();
+	// Destructor that closes the connections of every backend.
+    int acquire(const Router::Location& location, size_t& backend);
+	// Returns a connection to the responder of the location and sets backend to its index:
+	// an idle connection that is still open, or a new one whose connect() may still be in
+	// progress (it is writable once connected). Returns -1 if the backend is down or cannot
+	// be reached.
+    void release(size_t backend, int fd, bool reusable);
+	// Gives a connection back. It is kept for the next request if it is reusable and the
+	// pool is not full; otherwise it is closed.
+    void reportFailure(size_t backend);
+    void reportSuccess(size_t backend);
+	// Record the outcome of a request, for the passive health check.
+
+private:
+    std::vector<KeepAlivePool*> backends;
+	// Backends of the worker, one per fastcgi_pass address. There are a few, so they are found
+	// by address with a linear search.
+
+    FastCGIPool(const FastCGIPool&);
+    FastCGIPool& operator=(const FastCGIPool&);
+	// The pool owns its sockets, it cannot be copied.
+};
+
+#endif
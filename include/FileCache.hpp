@@ -0,0 +1,151 @@
+#ifndef FILECACHE_HPP
+#define FILECACHE_HPP
+
+#include "PathCache.hpp"	// Include the PathCache class that answers the lookups before the files
+#include "MimeTypes.hpp"	// Include the MimeTypes class for the Content-Type of the files
+#include <string>		// For std::string
+#include <map>			// For std::map to find an entry by path
+#include <list>			// For std::list to keep the entries in LRU order
+#include <ctime>		// For time_t
+#include <sys/types.h>	// For off_t and ino_t
+#include <sys/stat.h>	// For struct stat
+
+class FileCache {
+	// The FileCache class keeps static files ready to be sent.
+	// Small files are kept in memory. Big files are kept as an open file descriptor, so
+	// their body can be sent with sendfile() straight from the page cache, and the
+	// open() of the next download of the same file is saved.
+	// Entries are keyed by the resolved path and hold everything a response needs:
+	// the Content-Type, the Content-Length, the ETag and the Last-Modified date,
+	// all computed once when the file is loaded.
+	// An entry is revalidated with stat() at most once every validity seconds; if the
+	// modification time, the size or the inode changed, the file is loaded again.
+	// The total size of the content in memory and the number of open file descriptors
+	// are bounded, the least recently used entries are evicted first.
+	// An entry that is still being sent (see acquire) survives its eviction until it is released.
+	// Compressible entries can have a gzip variant: the foo.js.gz file next to foo.js if it exists,
+	// otherwise the content compressed with zlib the first time a client accepts gzip.
+	// The variant belongs to its entry and is dropped with it.
+	// Each worker process has its own cache, shared by all its connections.
+public:
+    struct Entry {
+        std::string path;				// Resolved path of the file.
+        std::string content;			// Content of the file, empty if fd is used.
+        int fd;							// Open file descriptor for big files, -1 if content is used.
+        std::string content_type;		// Value of the Content-Type header.
+        std::string content_length;		// Value of the Content-Length header.
+        std::string etag;				// Value of the ETag header (e.g., "5f3a2b1c-1a4").
+        std::string last_modified;		// Value of the Last-Modified header (an HTTP-date).
+        time_t mtime;					// Modification time of the file when it was loaded.
+        off_t size;						// Size of the file when it was loaded.
+        ino_t inode;					// Inode of the file when it was loaded.
+        time_t validated;				// Last time the entry was checked with stat().
+        int refs;						// Number of pending outputs that still use the entry.
+        bool cached;					// False once the entry was removed from the cache.
+        std::list<Entry*>::iterator lru;	// Position of the entry in its LRU list.
+        bool compressible;				// True if the Content-Type is in gzip_types.
+        Entry* gzip;					// Gzip variant of the entry, NULL if there is none yet.
+        bool gzip_tried;				// True once the entry was compressed, even if it did not shrink.
+        time_t gzip_checked;			// Last time the .gz file next to the entry was looked for.
+    };
+
+    FileCache(size_t max_bytes, size_t max_file_size, size_t max_fds, time_t validity);
+	// Constructor that takes the maximum total size of the content in memory, the maximum
+	// size of a file kept in memory, the maximum number of open file descriptors, and the
+	// number of seconds an entry is trusted without stat().
+    ~FileCache();
+	// Destructor that releases every entry that is not in use.
+    const Entry* get(const std::string& path);
+	// Returns the entry of the regular file at path, loading or revalidating it if needed.
+	// Returns NULL if the file does not exist or cannot be read.
+	// The entry stays valid until the next call to get(), unless it is acquired.
+    const Entry* get(const char* path, size_t length);
+	// Same as above for a path that is not a std::string (e.g., built in the arena of a request).
+	// The key is copied into a string reused by every lookup, so a hit does not allocate.
+    void setLimits(size_t max_bytes, size_t max_file_size, size_t max_fds, time_t validity);
+	// Changes the limits given to the constructor (on reload) and evicts what no longer fits.
+    void setGzip(bool enabled, size_t min_length, const std::string& types, int level);
+	// Enables the gzip variants for the Content-Types in types (a comma-separated list).
+	// Files without a .gz file are compressed at the given zlib level if they are kept in
+	// memory and have at least min_length bytes.
+	// If the settings change (on reload), the variants already built are dropped.
+    void setMimeTypes(const MimeTypes& types);
+	// Replaces the table of the Content-Types (on reload). The entries whose type changes get
+	// the new one, and lose their gzip variant if they had one.
+    const Entry* getGzip(const Entry* entry);
+	// Returns the gzip variant of an entry returned by get(), or NULL if it has none.
+	// The variant has the Content-Type and Last-Modified of the entry, and its own
+	// Content-Length and ETag. It stays valid as long as the entry.
+    static void acquire(const Entry* entry);
+	// Keeps the entry alive (and its file descriptor open) until release() is called,
+	// even if it is evicted in the meantime. Used by the output queue of a connection.
+    static void release(const Entry* entry);
+	// Releases an acquired entry. The entry is destroyed if it was evicted and nobody uses it.
+    size_t getHits() const;
+	// Returns the number of lookups answered without reading the file.
+    size_t getMisses() const;
+	// Returns the number of lookups that had to open the file (or found no file).
+    size_t getSize() const;
+	// Returns the total size of the content in memory, in bytes.
+    PathCache& getPaths();
+	// Returns the path cache of the worker, which says whether a path is a file, a directory
+	// or nothing before get() is asked for the file.
+
+private:
+    std::map<std::string, Entry*> entries;
+	// The entries, indexed by path.
+    std::string lookup;
+	// Key of the last lookup by pointer and length. It keeps its capacity between lookups.
+    std::list<Entry*> lru;
+	// The entries in memory from the most recently used (front) to the least recently used (back).
+    std::list<Entry*> fd_lru;
+	// The entries with an open file descriptor, in the same order.
+    size_t total_bytes;
+	// Total size of the content in memory.
+    size_t max_bytes;
+	// Maximum total size of the content in memory (file_cache_size).
+    size_t max_file_size;
+	// Maximum size of a file kept in memory (file_cache_max_file). Bigger files use fd.
+    size_t max_fds;
+	// Maximum number of open file descriptors (file_cache_max_fds).
+    time_t validity;
+	// Seconds an entry is used without checking the file again (file_cache_validity).
+    bool gzip_enabled;
+	// True if gzip variants are served (gzip).
+    size_t gzip_min_length;
+	// Smallest file compressed on the fly (gzip_min_length).
+    std::string gzip_types;
+	// Content-Types that are compressed, a comma-separated list (gzip_types).
+    int gzip_level;
+	// Compression level given to zlib, from 1 (fastest) to 9 (smallest) (gzip_comp_level).
+    size_t hits;
+	// Number of lookups answered without reading the file.
+    size_t misses;
+	// Number of lookups that had to go to the file system.
+    MimeTypes mime_types;
+	// Content-Types of the file extensions, looked up once per file loaded.
+    PathCache paths;
+	// Results of stat() for the paths of the requests, with the same validity as the entries.
+
+    FileCache(const FileCache&);
+    FileCache& operator=(const FileCache&);
+	// The cache owns its entries, so it cannot be copied.
+
+    bool load(Entry& entry, const struct stat& info);
+	// Opens the file, reads it into memory if it is small, and computes its headers.
+	// Returns false if it fails.
+    bool loadSidecar(Entry& entry);
+	// Loads the .gz file next to the entry as its gzip variant, if it is up to date.
+    void compress(Entry& entry);
+	// Compresses the content of the entry with zlib into its gzip variant, if it gets smaller.
+    void dropGzip(Entry& entry);
+	// Removes the gzip variant of the entry, and destroys it if nobody uses it.
+    void evict(const Entry* keep);
+	// Removes the least recently used entries, other than keep, until the limits are met.
+    void remove(Entry* entry);
+	// Removes an entry from the cache, and destroys it if nobody uses it.
+    static void destroy(Entry* entry);
+	// Closes the file descriptor of the entry, if any, and deletes it.
+};
+
+#endif
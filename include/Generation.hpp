@@ -0,0 +1,58 @@
+#ifndef GENERATION_HPP
+#define GENERATION_HPP
+
+#include "Config.hpp"		// Include the Config class with the settings of the generation
+#include "Router.hpp"		// Include the Router class compiled from the settings
+#include "MimeTypes.hpp"	// Include the MimeTypes class compiled from the settings
+#include "ErrorPages.hpp"	// Include the ErrorPages class built from the settings
+#include <cstddef>			// For size_t
+#include <vector>			// For std::vector
+
+class Generation {
+	// A Generation is one version of the configuration of a worker: the settings read from
+	// the file, the Router compiled from them, the table of the Content-Types and the prebuilt
+	// error pages.
+	// Everything is built in the constructor, so a configuration that does not compile is
+	// rejected before anything is changed. On SIGHUP the Server builds a new generation and
+	// makes it the current one in a single pointer assignment.
+	// Generations are reference counted. The Server holds the current one and every
+	// connection holds the one of its last request, so a request that started before a
+	// reload finishes with the settings it started with. An old generation is deleted when
+	// its last connection moves to the new one or is closed.
+public:
+    Generation(const Config& config, const char* date, unsigned number);
+	// Constructor that compiles the configuration, with the current value of the Date header
+	// for the error pages. number identifies the generation in the log (1 for the first one).
+	// The reference count starts at 1, held by the caller.
+	// Throws a std::runtime_error if the configuration is invalid.
+    void acquire();
+	// Adds a reference to the generation.
+    void release();
+	// Removes a reference. The generation is deleted when the last one is removed.
+
+    const Config config;
+	// Settings of this generation.
+    const Router router;
+	// Virtual hosts and locations compiled from the settings.
+    const MimeTypes mime_types;
+	// Content-Types of the file extensions (mime_types, default_type, charset).
+    ErrorPages error_pages;
+	// Prebuilt error responses of this generation.
+    const unsigned number;
+	// Number of the generation, incremented on every successful reload.
+    std::vector<size_t> upstream_groups;
+	// Index in the UpstreamPool of the worker of each upstream of the router, filled by the
+	// Server when the generation becomes the current one.
+
+private:
+    size_t refs;
+	// Number of holders of the generation (the Server and the connections).
+
+    ~Generation();
+	// Private: a generation is only deleted by release().
+    Generation(const Generation&);
+    Generation& operator=(const Generation&);
+	// A generation is shared through pointers, it cannot be copied.
+};
+
+#endif
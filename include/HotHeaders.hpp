@@ -0,0 +1,32 @@
+#ifndef HOTHEADERS_HPP
+#define HOTHEADERS_HPP
+
+#include <ctime>		// For time_t
+
+#define HTTP_DATE_LENGTH 29
+// Length of an HTTP-date, e.g., "Sun, 06 Nov 1994 08:49:37 GMT".
+
+class HotHeaders {
+	// The HotHeaders class keeps the values of the headers sent in every response
+	// already formatted. The Date header changes at most once per second, so it is
+	// formatted once per second instead of once per response.
+	// Each worker has its own instance, updated by its event loop after every wakeup.
+public:
+    HotHeaders();
+	// Constructor that formats the Date of the current time.
+    bool update(time_t now);
+	// Formats the Date again if the second changed. Returns true if it changed.
+    const char* getDate() const;
+	// Returns the value of the Date header (an HTTP-date). The pointer stays valid,
+	// its content changes on update().
+    static const char* getServer();
+	// Returns the value of the Server header.
+
+private:
+    time_t current;
+	// Second of the formatted Date.
+    char date[HTTP_DATE_LENGTH + 1];
+	// Formatted value of the Date header.
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef KEEPALIVEPOOL_HPP
+#define KEEPALIVEPOOL_HPP
+
+#include <sys/socket.h>		// For sockaddr_storage and socklen_t
+#include <string>			// For std::string
+#include <vector>			// For std::vector
+#include <ctime>			// For time_t
+
+class KeepAlivePool {
+	// The KeepAlivePool class keeps the connections of a worker to one backend address
+	// (unix:/path or host:port): the idle connections that can carry the next request, and
+	// the passive health check of the backend. The FastCGIPool has one per responder and the
+	// UpstreamPool one per server of its upstream groups.
+	// A request borrows a connection with connect() and gives it back with release() when it
+	// ended with the connection still usable. Up to size idle connections are kept, the most
+	// recent one is reused first, and they are closed after keepalive_timeout seconds.
+	// After max_fails failed requests in a row the backend is down for fail_timeout seconds:
+	// connect() does not open new connections to it until then.
+	// Every socket is non-blocking and close-on-exec, and no call blocks.
+public:
+    KeepAlivePool(const std::string& address, const char* name);
+	// Constructor that resolves the address once. name starts the messages of the error log
+	// (e.g., "FastCGI").
+    ~KeepAlivePool();
+	// Destructor that closes the idle connections.
+    void setLimits(size_t size, time_t keepalive_timeout, unsigned max_fails, time_t fail_timeout);
+	// Updates the settings, from the last location or group that used the backend (they can
+	// change on reload).
+    int connect(bool& reused);
+	// Returns an idle connection that is still open (reused is set to true), or a new one whose
+	// connect() may still be in progress (it is writable once connected). Returns -1 if the
+	// backend is down or its address is invalid, or if connect() failed at once, which counts
+	// as a failure.
+    void release(int fd, bool reusable);
+	// Gives a connection back. It is kept for the next request if it is reusable and the
+	// pool is not full; otherwise it is closed.
+    void reportFailure();
+    void reportSuccess();
+	// Record the outcome of a request, for the passive health check.
+    bool isDown(time_t now) const;
+	// Returns true if the backend failed recently and gets no new connections.
+    const std::string& getAddress() const;
+	// Returns the address of the backend, for the error log.
+    static bool resolve(const std::string& address, struct sockaddr_storage& sockaddr, socklen_t& length);
+	// Resolves unix:/path or host:port. Returns false if the address is invalid.
+
+private:
+    struct Idle {
+        int fd;			// Connection to the backend.
+        time_t since;	// Time it was given back.
+    };
+
+    std::string address;
+	// The address, as written in the configuration.
+    const char* name;
+	// Prefix of the messages of the error log.
+    struct sockaddr_storage sockaddr;
+	// Resolved address.
+    socklen_t sockaddr_length;
+	// Length of sockaddr, 0 if the address is invalid.
+    std::vector<Idle> idle;
+	// Idle connections, the most recent last.
+    size_t size;
+	// Settings of the last user of the backend.
+    time_t keepalive_timeout;
+    unsigned max_fails;
+    time_t fail_timeout;
+    unsigned fails;
+	// Failed requests in a row.
+    time_t down_until;
+	// Time until which the backend is down, 0 if it is up.
+
+    void closeIdle(time_t now);
+	// Closes the idle connections that passed their keepalive_timeout.
+    KeepAlivePool(const KeepAlivePool&);
+    KeepAlivePool& operator=(const KeepAlivePool&);
+	// The pool owns its sockets, it cannot be copied.
+};
+
+#endif
@@ -0,0 +1,134 @@
+#ifndef LOG_HPP
+#define LOG_HPP
+
+#include <cstddef>		// For size_t
+#include <string>		// For std::string
+#include <streambuf>	// For std::streambuf, the base of Log::Stream
+#include <pthread.h>	// For the writer thread, its mutex and its condition variables
+
+#define LOG_MIN_BUFFER 4096
+// Smallest ring buffer of a log. The sizes are rounded up to a power of two.
+
+class Log {
+	// The Log class writes a log file (access_log or error_log) without blocking the event loop
+	// on the disk.
+	// The worker copies each record into a ring buffer and returns; a writer thread owned by
+	// the log sends what the ring holds to the file with one writev() (two iovecs when the
+	// data wraps around the end of the ring), at most flush_interval milliseconds after the
+	// first record of the batch, or as soon as the ring is half full.
+	// The ring has one producer (the thread of the event loop) and one consumer (the writer):
+	// head and tail are counters that only grow, each written by one side and read by the
+	// other with atomic loads and stores, so appending a record takes no lock. The mutex is
+	// only taken to wake the writer up, once per batch, and by a producer that waits for room.
+	// When the ring has no room for a record, it is dropped and counted (POLICY_DROP), or the
+	// worker waits for the writer (POLICY_BLOCK), which keeps every record but lets a slow disk
+	// stall the event loop.
+	// reopen() makes the writer open the path again before its next batch, so a file renamed
+	// by logrotate is replaced by a new one (SIGUSR1).
+	// The writer thread blocks every signal: they are delivered to the event loop.
+public:
+    enum Policy {
+        POLICY_DROP,	// A record that does not fit is discarded and counted.
+        POLICY_BLOCK	// The worker waits until the writer makes room for the record.
+    };
+
+    class Stream : public std::streambuf {
+		// Stream buffer that turns each line written to it into a record of a log, prefixed
+		// with the local time and the process id. The Server installs it in std::cerr, so
+		// the error messages of the worker go to the error_log.
+    public:
+        Stream(Log& log);
+		// Constructor of a stream that writes its lines to log.
+
+    protected:
+        virtual int_type overflow(int_type c);
+        virtual std::streamsize xsputn(const char* data, std::streamsize length);
+		// Add characters to the current line, and write it to the log at every '\n'.
+		// sync() is not overridden: std::cerr flushes after every <<, and a line is only
+		// written once it is complete.
+
+    private:
+        Log& log;
+		// Log the lines are written to.
+        std::string line;
+		// Characters of the line being written, without its prefix.
+
+        void writeLine();
+		// Writes the prefix and the current line to the log as one record, and clears the line.
+    };
+
+    Log();
+	// Constructor of a closed log: write() returns false until open().
+    ~Log();
+	// Destructor that closes the log, writing what is still in the ring.
+    void open(const std::string& path, size_t buffer_size, Policy policy, unsigned flush_interval);
+	// Opens (or creates) the file in append mode, allocates a ring of buffer_size bytes and
+	// starts the writer, which waits at most flush_interval milliseconds before a batch.
+	// A log already open is closed first. Throws a std::runtime_error if the file cannot be
+	// opened or the thread cannot be started.
+    void close();
+	// Stops the writer once it wrote the whole ring, and closes the file.
+    bool isOpen() const;
+	// Returns true if the log was opened and not closed.
+    bool matches(const std::string& path, size_t buffer_size, Policy policy, unsigned flush_interval) const;
+	// Returns true if the log is open with these settings, so a reload does not reopen it.
+    bool write(const char* data, size_t length);
+	// Appends a record to the ring. Returns false if it was dropped (the ring is full with
+	// POLICY_DROP, or the record is bigger than the ring). It must always be called from the
+	// same thread.
+    void reopen();
+	// Asks the writer to open the path again before its next batch.
+    unsigned long getDropped() const;
+	// Returns the number of records dropped since the log was created (it is not reset by open).
+    static Policy parsePolicy(const std::string& value);
+	// Returns the policy named by log_overflow: "block", or POLICY_DROP for anything else.
+
+private:
+    std::string path;
+	// Path of the file, opened again by reopen().
+    int fd;
+	// File descriptor of the file, -1 if the log is closed. Only the writer uses it while it runs.
+    char* ring;
+	// The ring buffer, of capacity bytes.
+    size_t capacity;
+	// Size of the ring, a power of two so the position of a counter is counter & (capacity - 1).
+    Policy policy;
+	// What write() does when the ring is full.
+    unsigned flush_interval;
+	// Milliseconds the writer waits for a batch to grow after its first record.
+    unsigned long head;
+	// Bytes ever appended. Written by the producer, read by the writer.
+    unsigned long tail;
+	// Bytes ever written to the file (or discarded after a write error). Written by the writer.
+    int reopen_requested;
+	// Set by reopen(), cleared by the writer once it opened the path again.
+    bool stopping;
+	// Set by close() to make the writer exit once the ring is empty. Protected by mutex.
+    bool running;
+	// True while the writer thread exists.
+    unsigned long dropped;
+	// Records dropped. Only the producer writes and reads it.
+    pthread_t thread;
+	// The writer thread.
+    pthread_mutex_t mutex;
+	// Protects stopping, and the waits on wake and space.
+    pthread_cond_t wake;
+	// Signaled when the writer has work: a first record, a half-full ring, a reopen or a stop.
+    pthread_cond_t space;
+	// Broadcast by the writer after every batch, for a producer waiting for room.
+
+    static void* run(void* log);
+	// Body of the writer thread: calls writeLoop().
+    void writeLoop();
+	// Waits for records and writes them in batches until close().
+    void writeBatch(unsigned long from, unsigned long to);
+	// Writes the bytes of the ring between the counters from and to, with writev().
+    void reopenFile();
+	// Opens the path again and replaces the file descriptor. If the path cannot be opened,
+	// the old file is kept and the error is written to the standard error.
+    Log(const Log&);
+    Log& operator=(const Log&);
+	// A log owns its thread and its file, it cannot be copied.
+};
+
+#endif
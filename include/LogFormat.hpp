@@ -0,0 +1,93 @@
+#ifndef LOGFORMAT_HPP
+#define LOGFORMAT_HPP
+
+#include "Request.hpp"	// Include the Request class for the views the records point to
+#include <string>		// For std::string
+#include <vector>		// For std::vector to store the compiled format
+#include <ctime>		// For time_t
+#include <netinet/in.h>	// For in_addr, the address of the client
+
+class LogFormat {
+	// The LogFormat class turns a request and its response into a line of the access log.
+	// The format (log_format) is a template where $name is replaced with a variable of the
+	// request, like the log_format of nginx, or the name of a predefined one: "combined"
+	// (the default) or "common". It is compiled once into a list of literals and variables,
+	// so formatting a line only appends to a reused std::string, without any allocation once
+	// the string reached the size of a line.
+	// Variables: $remote_addr, $time_local, $time_iso8601, $request (method, URI and
+	// protocol), $request_method, $request_uri, $server_protocol, $status, $bytes_sent (status
+	// line, headers and body), $request_time (seconds, with milliseconds, from the end of the
+	// request headers to the end of the response), $connection_requests, $pid, $http_host,
+	// $http_referer and $http_user_agent. A name ends at the first character that is not a
+	// letter, a digit or _.
+	// The values sent by the client are escaped (", \ and the bytes that are not printable ASCII
+	// become \xHH) and a missing one is written as "-", so a line can always be split again.
+public:
+    struct Record {
+        Request::View method;		// Method of the request.
+        Request::View uri;			// Request URI, with its query string.
+        Request::View protocol;		// HTTP version of the request line.
+        Request::View host;			// Host header.
+        Request::View referer;		// Referer header.
+        Request::View user_agent;	// User-Agent header.
+        struct in_addr address;		// Address of the client.
+        int status;					// Status code of the response, 0 if none was sent yet.
+        size_t bytes_sent;			// Bytes of the response queued for the client.
+        unsigned long request_time;	// Nanoseconds from the end of the request headers to the response.
+        size_t requests;			// Number of the request on its connection, from 1.
+    };
+
+    LogFormat();
+	// Constructor of the "combined" format.
+    void compile(const std::string& format);
+	// Replaces the format with a predefined one or a template. Throws a std::runtime_error
+	// naming the variable if the template uses an unknown one; the format is then unchanged.
+    void format(std::string& line, const Record& record, time_t now);
+	// Replaces line with the record formatted, followed by a newline. now is the time written
+	// by $time_local and $time_iso8601, which are formatted at most once per second.
+    static void capture(Record& record, const Request& request);
+	// Sets the views of the record to the request line and headers of a parsed request.
+    static void save(Record& record, std::string& storage);
+	// Copies the bytes the views of the record point to into storage and points the views
+	// there, for a request answered after it is consumed (a script, a proxied server or an upload).
+
+private:
+    enum Variable {
+        TEXT,					// The literal text of the token.
+        REMOTE_ADDR,
+        TIME_LOCAL,
+        TIME_ISO8601,
+        REQUEST,
+        REQUEST_METHOD,
+        REQUEST_URI,
+        SERVER_PROTOCOL,
+        STATUS,
+        BYTES_SENT,
+        REQUEST_TIME,
+        CONNECTION_REQUESTS,
+        PID,
+        HTTP_HOST,
+        HTTP_REFERER,
+        HTTP_USER_AGENT
+    };
+    struct Token {
+        Variable variable;		// What the token is replaced with.
+        std::string text;		// Literal text, for TEXT.
+    };
+
+    std::vector<Token> tokens;
+	// The compiled format, in order.
+    time_t formatted;
+	// Second the time variables were last formatted for.
+    char time_local[32];
+	// $time_local of that second, e.g. 16/Oct/2026:13:55:36 +0200.
+    char time_iso8601[32];
+	// $time_iso8601 of that second, e.g. 2026-10-16T13:55:36+02:00.
+
+    static Variable findVariable(const std::string& name);
+	// Returns the variable of a name, or TEXT if there is no such variable.
+    static void appendEscaped(std::string& line, const Request::View& value);
+	// Appends a value sent by the client, escaped, or "-" if it is missing.
+};
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef MASTER_HPP
+#define MASTER_HPP
+
+#include "Config.hpp"	// Include the Config class for the worker settings
+#include "Metrics.hpp"	// Include the Metrics class shared by the workers
+#include <sys/types.h>	// For pid_t
+#include <ctime>		// For time_t
+#include <vector>		// For std::vector to store the workers
+
+class Master {
+	// The Master class runs the server on several cores.
+	// It forks one worker process per core (workers=N, or workers=auto for one per CPU).
+	// Each worker builds its own Server, with its own SO_REUSEPORT listening socket and
+	// event loop, so the kernel spreads the incoming connections across the workers.
+	// The master does not serve requests: it waits for its workers, restarts the ones that
+	// crash, and stops them all when it receives SIGINT or SIGTERM.
+	// On SIGHUP it checks the configuration file and, if it is valid, forwards the signal to
+	// every worker so each one reloads it (see Server::reload). Workers restarted later are
+	// started with the new configuration. SIGUSR1 is forwarded to every worker, which reopens
+	// its logs.
+public:
+    Master(const Config& config, Metrics& metrics);
+	// Constructor that takes the configuration shared by every worker and the metrics they
+	// write to, which must have a slot per worker.
+    int run();
+	// Starts the workers and supervises them until the master is asked to stop.
+	// Returns the exit status of the program.
+    static int workerCount(const Config& config);
+	// Returns the number of workers configured with the workers key.
+	// "auto" means one worker per online CPU. The default is 1 (no master process).
+
+private:
+    struct Worker {
+        pid_t pid;			// Process id of the worker, -1 if it is not running.
+        time_t started;		// Time the worker was started, to detect crash loops.
+    };
+    Config config;
+	// Configuration passed to every worker, replaced on a successful reload.
+    Metrics& metrics;
+	// Counters of the workers. A restarted worker goes on with the slot of the one it replaces.
+    std::vector<Worker> workers;
+	// The workers, indexed by worker number.
+    bool pin_cpus;
+	// True if each worker is pinned to one CPU (worker_cpu_affinity=on).
+
+    void spawn(size_t index);
+	// Forks the worker number index. The child never returns from this function.
+    void reload();
+	// Reads the configuration file again and forwards SIGHUP to the workers if it is valid.
+    void forward(int signal_number);
+	// Sends a signal to every running worker.
+    void stopAll();
+	// Sends SIGTERM to every worker and waits for them to exit.
+};
+
+#endif
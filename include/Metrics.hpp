@@ -0,0 +1,94 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+#include <cstddef>		// For size_t
+#include <string>		// For std::string
+
+#define METRICS_SUB_BUCKETS 4
+// Buckets per power of two of a histogram: the bound of a bucket is at most 25 % above its values.
+#define METRICS_BUCKETS 140
+// Buckets of a histogram, from 0 ns to 2^36 ns (about 69 s). Longer times go to the last one,
+// which is exported as +Inf: the highest finite bound is 7 * 2^33 ns (about 60 s).
+#define METRICS_MAX_STATUS 600
+// Status codes are counted one by one, from 0 to 599.
+
+class Metrics {
+	// The Metrics class holds the counters and latency histograms of every worker, and formats
+	// them for the metrics location (Prometheus text format).
+	// The counters live in a shared anonymous mapping created before the workers are forked,
+	// with one slot per worker. A worker only writes its own slot, with plain increments: there
+	// is no lock and no atomic instruction on the hot path. The worker that answers the metrics
+	// location reads every slot and adds them up; a slot being written at that moment is read
+	// a few increments behind, which is fine for counters that only grow.
+	// The histograms have an HDR-like layout: METRICS_SUB_BUCKETS linear buckets per power of two
+	// of nanoseconds, so the error is the same for 200 ns and for 2 s, and recording a value is a
+	// few shifts and an increment.
+	// A worker restarted after a crash keeps the slot of the one it replaces: its counters go on.
+public:
+    enum Method {
+        METHOD_GET,
+        METHOD_HEAD,
+        METHOD_POST,
+        METHOD_PUT,
+        METHOD_DELETE,
+        METHOD_OTHER,
+        METHOD_COUNT
+    };
+	// Methods the requests are counted by.
+    struct Histogram {
+        unsigned long buckets[METRICS_BUCKETS];	// Number of values in each bucket.
+        unsigned long count;					// Number of values.
+        unsigned long sum;						// Sum of the values, in nanoseconds.
+    };
+    struct Worker {
+        unsigned long accepted;			// Connections accepted.
+        unsigned long active;			// Connections open now.
+        unsigned long requests[METHOD_COUNT];	// Requests received, by method.
+        unsigned long responses[METRICS_MAX_STATUS];	// Responses sent, by status code.
+        unsigned long received;			// Bytes read from the clients.
+        unsigned long sent;				// Bytes written to the clients.
+        unsigned long cache_hits;		// Lookups of the file cache answered from memory.
+        unsigned long cache_misses;		// Lookups of the file cache that read the file system.
+        unsigned long write_stalls;		// Writes that left output because the socket was full.
+        unsigned long log_dropped;		// Log records dropped because the buffer of the log was full.
+        Histogram parse;				// Time to parse a request, per call that completes it.
+        Histogram handler;				// Time to route a request and queue its response (or start
+										// its script, upload or proxied request).
+    };
+
+    Metrics(size_t workers);
+	// Constructor that maps the slots of the given number of workers, all set to zero.
+	// It must run before the workers are forked. Throws a std::runtime_error if mmap fails.
+    ~Metrics();
+	// Destructor that unmaps the slots.
+    Worker& getWorker(size_t index);
+	// Returns the slot of a worker. The connections it had open when it stopped are forgotten.
+    void format(std::string& text) const;
+	// Replaces text with the metrics of all the workers, in the Prometheus text format.
+    static void record(Histogram& histogram, unsigned long nanoseconds);
+	// Adds a value to a histogram.
+    static unsigned long now();
+	// Returns the time of a monotonic clock, in nanoseconds.
+    static Method getMethod(const char* name, size_t length);
+	// Returns the method a request is counted under.
+    static void countResponse(Worker& worker, int status);
+	// Counts a response with this status code (codes out of range are counted as 0).
+
+private:
+    Worker* slots;
+	// The slots, in the shared mapping.
+    size_t worker_count;
+	// Number of slots.
+
+    static size_t findBucket(unsigned long nanoseconds);
+	// Returns the bucket of a value.
+    static unsigned long getBucketEnd(size_t bucket);
+	// Returns the first value above the bucket, in nanoseconds.
+    static void formatHistogram(std::string& text, const char* name, const char* help, const Histogram& histogram);
+	// Appends a histogram, in seconds, with one cumulative bucket per bucket of the layout from 1 µs.
+    Metrics(const Metrics&);
+    Metrics& operator=(const Metrics&);
+	// The slots are mapped once, the object cannot be copied.
+};
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef MIMETYPES_HPP
+#define MIMETYPES_HPP
+
+#include "Config.hpp"	// Include the Config class for the mime_types, default_type and charset settings
+#include <string>		// For std::string
+#include <vector>		// For std::vector, the table of extensions and the types
+
+class MimeTypes {
+	// The MimeTypes class gives the Content-Type of a file from the last extension of its name,
+	// case-insensitively: app.js.map is a source map, not JavaScript, and a directory called
+	// /html/ does not make its files HTML.
+	// The mapping is a built-in table of the common types, extended or overridden by the file of
+	// mime_types, in the mime.types format of Apache ("type ext1 ext2" lines) or of nginx
+	// ("types { type ext1 ext2; }"). A name without an extension, or with an unknown one, gets
+	// default_type. With charset set (e.g., utf-8), the types of charset_types (a comma-separated
+	// list) get a "; charset=" parameter.
+	// Everything is compiled in the constructor into an open-addressing hash table of the
+	// extensions, each one pointing to its complete header value, so a lookup is one hash of the
+	// extension and usually one comparison. The file cache looks the type up once per file it
+	// loads, and keeps it in its entry.
+public:
+    MimeTypes();
+	// Constructor of the built-in table, with default_type application/octet-stream and no charset.
+    explicit MimeTypes(const Config& config);
+	// Constructor that reads the settings. Throws a std::runtime_error if the mime_types file
+	// cannot be read or has an extension without a type.
+    const std::string& find(const std::string& path) const;
+	// Returns the value of the Content-Type header of the file at path.
+    static bool isType(const std::string& content_type, const std::string& list);
+	// Returns true if the type of a Content-Type value, without its parameters, is in list
+	// (a comma-separated list of types, e.g., gzip_types).
+
+private:
+    struct Slot {
+        std::string extension;	// Extension in lowercase, without the dot. Empty if the slot is free.
+        size_t type;			// Index of the Content-Type in types.
+    };
+
+    std::vector<Slot> slots;
+	// The hash table, a power of two at least twice as big as the number of extensions.
+    std::vector<std::string> types;
+	// The Content-Type values, with their charset; the last one is default_type.
+
+    void build(const std::string& file, const std::string& default_type, const std::string& charset,
+        const std::string& charset_types);
+	// Compiles the built-in table, the file (if not empty) and the settings into the hash table.
+    static unsigned hash(const char* extension, size_t length);
+	// Returns the hash of an extension in lowercase.
+};
+
+#endif
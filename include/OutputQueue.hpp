@@ -0,0 +1,74 @@
+#ifndef OUTPUTQUEUE_HPP
+#define OUTPUTQUEUE_HPP
+
+#include "FileCache.hpp"	// Include the FileCache class for the file segments
+#include <string>			// For std::string
+#include <vector>			// For std::vector to store the segments in order
+#include <sys/types.h>		// For off_t
+
+class OutputQueue {
+	// The OutputQueue class holds the bytes a connection still has to send, in order.
+	// A segment is either a part of the buffer of the queue (status lines, headers,
+	// generated bodies) or a range of a file cached by FileCache. Files kept in memory
+	// are sent from the cache entry, and files kept as a file descriptor with sendfile(),
+	// so the body of a static file is never copied into the queue. A file segment only
+	// stores the entry, an offset and a length, so the memory used by a download does
+	// not depend on the size of the file.
+	// The buffer and the segment list are cleared, not freed, once everything is sent,
+	// so a connection reuses the same memory for all its responses.
+	// flush() sends as much as the socket accepts and keeps the rest for the next call.
+public:
+    OutputQueue();
+    ~OutputQueue();
+	// Destructor that releases the file entries still queued.
+    void append(const std::string& data);
+	// Queues a copy of data. Consecutive buffers are merged into one segment.
+    void append(const char* data, size_t length);
+	// Queues a copy of length bytes starting at data.
+    void appendFile(const FileCache::Entry* file, off_t offset, size_t length);
+	// Queues length bytes of the file of a cache entry, starting at offset.
+	// The entry is acquired until the segment is sent or the queue is destroyed.
+    bool flush(int fd);
+	// Sends as much of the queue as the socket accepts without blocking.
+	// Consecutive segments in memory are sent together with writev().
+	// Returns false if the client is gone.
+    bool empty() const;
+	// Returns true if everything was sent.
+    size_t size() const;
+	// Returns the number of bytes still to send, including the file segments.
+    size_t getQueued() const;
+	// Returns the number of bytes ever queued. The difference between two calls is the size
+	// of what was queued in between (the $bytes_sent of the access log).
+
+private:
+    struct Segment {
+        const FileCache::Entry* file;	// Cache entry of the file, NULL for a part of the buffer.
+        off_t offset;					// Offset in the buffer or in the file of the next byte to send.
+        size_t length;					// Number of bytes left to send.
+    };
+    std::string buffer;
+	// Bytes of all the buffer segments, one after the other.
+    std::vector<Segment> segments;
+	// The segments, in the order they must be sent. The ones before head were sent.
+    size_t head;
+	// Index of the first segment not fully sent.
+    size_t pending;
+	// Total number of bytes left to send.
+    size_t queued;
+	// Total number of bytes queued since the queue was created.
+
+    OutputQueue(const OutputQueue&);
+    OutputQueue& operator=(const OutputQueue&);
+	// The queue holds references to cache entries, so it cannot be copied.
+
+    ssize_t sendFile(int fd, Segment& segment);
+	// Sends part of a file segment with sendfile(), or with pread() and send() where
+	// sendfile() is not available. Returns the number of bytes sent, or -1 with errno set.
+    ssize_t sendMemory(int fd);
+	// Sends the consecutive segments in memory from head with a single writev().
+	// Returns the number of bytes sent, or -1 with errno set.
+    void consume(size_t bytes);
+	// Advances head past bytes sent, releasing the entries of the segments fully sent.
+};
+
+#endif
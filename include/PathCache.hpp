@@ -0,0 +1,76 @@
+#ifndef PATHCACHE_HPP
+#define PATHCACHE_HPP
+
+#include <string>		// For std::string
+#include <vector>		// For std::vector, the slots of the table
+#include <ctime>		// For time_t
+
+class PathCache {
+	// The PathCache class remembers what stat() said about a path: a regular file, a directory,
+	// or nothing (a missing path, or one that cannot be reached). A static request looks its
+	// path up here before the file cache, so the 404s of a missing file, the index file of a
+	// directory and the redirect of a directory without its trailing slash are answered without
+	// a system call while the result is fresh (file_cache_validity seconds).
+	// The table has a fixed number of slots (path_cache_size, a power of two) and each path goes
+	// to the slot of its hash, replacing what was there: it never grows, and a lookup is one
+	// hash and one comparison. A slot keeps the capacity of its strings, so a warm table does
+	// not allocate.
+	// The slot of a directory also keeps its autoindex listing, built once and rebuilt when the
+	// modification time of the directory changes.
+	// Each worker process has its own table, owned by its file cache.
+public:
+    enum Kind {
+        KIND_MISSING,	// stat() failed: the path does not exist or cannot be reached.
+        KIND_FILE,		// A regular file.
+        KIND_DIRECTORY,	// A directory.
+        KIND_OTHER		// Something that is never served (a device, a socket, a FIFO).
+    };
+
+    explicit PathCache(size_t size);
+	// Constructor of a table of size slots, rounded up to a power of two.
+    void setLimits(size_t size, time_t validity);
+	// Changes the number of slots (on reload), forgetting every path if it changes, and the
+	// number of seconds a result is trusted. A validity of 0 makes every lookup call stat().
+    Kind find(const char* path, size_t length);
+	// Returns the kind of the path, calling stat() only if the slot does not hold a fresh
+	// result for it. path does not need to be null-terminated.
+    const std::string* findListing(const char* path, size_t length);
+	// Returns the rows of the autoindex listing of the directory at path, one <a> element
+	// per entry sorted by name, with its date and size. Returns NULL if the path is not a
+	// directory or cannot be read. The rows stay valid until the next lookup.
+    void clear();
+	// Forgets every result, e.g., after an upload created or removed a file.
+    size_t getHits() const;
+	// Returns the number of lookups answered without stat().
+    size_t getMisses() const;
+	// Returns the number of lookups that called stat().
+
+private:
+    struct Slot {
+        std::string path;		// Path of the result, empty if the slot was never used.
+        Kind kind;				// What stat() said.
+        time_t mtime;			// Modification time of the path, for a directory listing.
+        time_t checked;			// Last time stat() was called for the path.
+        std::string listing;	// Rows of the autoindex listing of a directory.
+        time_t listed;			// Modification time of the directory when listing was built.
+        bool has_listing;		// True if listing holds the rows of the directory.
+    };
+
+    std::vector<Slot> slots;
+	// The table, indexed by the hash of the path.
+    time_t validity;
+	// Seconds a result is used without calling stat() again (file_cache_validity).
+    size_t hits;
+	// Number of lookups answered from the table.
+    size_t misses;
+	// Number of lookups that called stat().
+
+    Slot& lookup(const char* path, size_t length);
+	// Returns the slot of the path with a fresh result, calling stat() if needed.
+    static bool buildListing(const std::string& path, std::string& listing);
+	// Reads the directory at path into rows of a listing. Returns false if it cannot be opened.
+    static size_t roundSize(size_t size);
+	// Returns the power of two at least as big as size, and at least 1.
+};
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef POLLLOOP_HPP
+#define POLLLOOP_HPP
+
+#include "EventLoop.hpp"	// Include the EventLoop interface implemented by this class
+#include <poll.h>			// For poll and struct pollfd
+#include <vector>			// For std::vector
+
+class PollLoop : public EventLoop {
+	// The PollLoop class implements the EventLoop with poll().
+	// It is the portable fallback: poll() scans every registered descriptor on each call,
+	// but adding and removing a descriptor are O(1), because the position of each fd in
+	// the pollfd array is stored in a table indexed by fd and removal swaps with the last entry.
+public:
+    PollLoop();
+    virtual void add(int fd, int events);
+    virtual void modify(int fd, int events);
+    virtual void remove(int fd);
+    virtual int wait(std::vector<Event>& ready, int timeout_ms);
+    virtual const char* getName() const;
+
+private:
+    std::vector<struct pollfd> fds;
+	// The array given to poll().
+    std::vector<int> positions;
+	// Position of each fd in fds, indexed by fd (-1 if the fd is not registered).
+};
+
+#endif
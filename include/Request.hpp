@@ -1,19 +1,71 @@
 #ifndef REQUEST_HPP
 #define REQUEST_HPP
 
+#include "BodyDecoder.hpp"	// Include the BodyDecoder class to decode a chunked body
 #include <string>		// For std::string
-#include <map>			// For std::map
+#include <vector>		// For std::vector
+#include <cstddef>		// For size_t
 
 class Request {
 	// The Request class represents an HTTP request.
-	// It is designed to parse and store the components of an HTTP request.
-	// It contains methods to parse the request line, headers, and body.
+	// It is an incremental parser: parse() can be called every time new bytes arrive,
+	// and it resumes where the previous call stopped.
+	// The request line, the headers and the body are not copied. They are kept as
+	// offset/length views into the buffer of the connection, and they are only copied
+	// into a std::string when an accessor is called.
 	// It provides accessors for the method, URI, version, headers, and body.
 public:
+    enum ParseStatus {
+        PARSE_INCOMPLETE,	// More bytes are needed to complete the request.
+        PARSE_COMPLETE,		// The request is complete, getLength() bytes were consumed.
+        PARSE_BODY,			// The headers are complete and a body follows. Returned once per request,
+							// so the caller can take the body over with streamBody().
+        PARSE_ERROR			// The request is malformed, getErrorStatus() has the HTTP status.
+    };
+    struct Slice {
+        size_t offset;		// Offset of the first byte, from the start of the request.
+        size_t length;		// Number of bytes.
+    };
+    struct Header {
+        Slice name;			// The header name (e.g., Host).
+        Slice value;		// The header value without surrounding whitespace (e.g., localhost).
+    };
+    struct View {
+        const char* data;	// First byte, in the buffer of the connection. NULL if there is nothing.
+        size_t length;		// Number of bytes.
+    };
+
     Request();			// Default constructor
-    bool parse(const std::string& raw_request);
-	// Parses the raw HTTP request string. It is boolean to indicate success or failure.
-	// Returns true if parsing was successful, false otherwise.
+    void setLimits(size_t max_header_size, size_t max_body_size);
+	// Sets the maximum size of the request line and headers together (431, or 414 for
+	// the request line alone) and the maximum size of the body (413). 0 means no limit.
+    void reset();
+	// Prepares the object to parse the next request of the connection.
+	// The header storage keeps its capacity, so reusing a Request does not allocate.
+    ParseStatus parse(const char* data, size_t length);
+	// Parses the bytes of the request received so far.
+	// data points to the first byte of the request and length is the number of bytes available.
+	// The same request must be passed again, with more bytes, after PARSE_INCOMPLETE.
+	// data may change between calls (the buffer can grow), the offsets stay valid.
+    size_t getLength() const;
+	// Returns the number of bytes of the complete request (request line, headers and body).
+    int getErrorStatus() const;
+	// Returns the HTTP status code to answer with after PARSE_ERROR (e.g., 400, 413, 431).
+    bool isReadingBody() const;
+	// Returns true if the headers are complete and the parser is waiting for the body.
+	// The Server applies client_body_timeout instead of client_header_timeout then.
+    size_t releaseDecoded();
+	// Returns the number of bytes that follow the headers and were already decoded into a
+	// chunked body, and forgets them: the caller removes them from the buffer before the next
+	// call of parse(). Returns 0 if the request is not receiving a chunked body.
+    void streamBody();
+	// Ends the request at its headers, after PARSE_BODY: the body is left in the buffer for
+	// the caller, which decodes it with a BodyDecoder (see isChunked and getContentLength).
+	// getLength() is then the size of the request line and headers.
+    bool isChunked() const;
+	// Returns true if the body is sent with the chunked transfer coding.
+    size_t getContentLength() const;
+	// Returns the value of the Content-Length header, 0 if there is none.
     std::string getMethod() const;
 	// Returns the HTTP method (e.g., GET, POST).
     std::string getUri() const;
@@ -23,29 +75,104 @@ public:
 	// Returns the HTTP version (e.g., HTTP/1.1).
     std::string getHeader(const std::string& key) const;
 	// Returns the value of a specific header by key (key is the name of the header).
-	// Headers is a map of header names to values (e.g., Host: localhost).
+	// The name is compared without taking the case into account (e.g., Host and host).
+    View getMethodView() const;
+    View getUriView() const;
+    View getVersionView() const;
+    View getPathView() const;
+    View getHeaderView(const char* name) const;
+	// Same as the accessors above, without copying: the views point into the buffer of the
+	// connection and are valid until the request is consumed. getPathView() returns the
+	// path of the URI normalized (see normalizePath), without its query string; it is the
+	// only view that does not point into the buffer. A missing header has a NULL data.
+    bool hasHeaderToken(const char* name, const char* token, size_t length) const;
+	// Returns true if a header with this name (any of them, if it is repeated) lists token in
+	// its comma-separated value, e.g., close in "Connection: TE, close". The name and the
+	// tokens are compared without taking the case into account.
+    size_t getHeaderCount() const;
+    View getHeaderName(size_t index) const;
+    View getHeaderValue(size_t index) const;
+	// Return the number of headers and the name and value of each one, in the order they
+	// were received (e.g., to pass them to a CGI script).
     std::string getBody() const;
 	// Returns the body of the request, which is the content sent with the request.
+	// The body is returned byte for byte, so binary bodies are preserved.
+	// A chunked body is returned decoded.
+    View getBodyView() const;
+	// Same as getBody(), without copying: a chunked body is in the decoded storage of the
+	// request, any other one in the buffer of the connection. It is empty once streamBody()
+	// was called.
+    static bool normalizePath(char* output, const char* path, size_t length, size_t& output_length);
+	// Percent-decodes the path of a URI and normalizes it in a single pass: "//" becomes "/",
+	// the "." segments are removed and each ".." removes the segment before it, so the result
+	// always stays under the root it is appended to. output may be path itself (the result is
+	// never longer), so a path can be normalized in place. Returns false, for a 400, if the
+	// path does not start with /, has an invalid or a %00 escape, or goes above the root.
 
 private:
-    std::string method;
+    enum State {
+        STATE_REQUEST_LINE,	// Waiting for the end of the request line.
+        STATE_HEADERS,		// Waiting for the next header line or the empty line.
+        STATE_BODY,			// Waiting for Content-Length bytes of body, or for the chunked body.
+        STATE_DONE,			// The request is complete.
+        STATE_ERROR			// The request is malformed.
+    };
+    const char* data;
+	// The bytes of the request, as given to the last call of parse().
+    State state;
+	// Current state of the parser.
+    size_t position;
+	// Offset of the next byte to examine.
+    size_t line_start;
+	// Offset of the first byte of the line being parsed.
+    int error_status;
+	// HTTP status code of the error, when state is STATE_ERROR.
+    Slice method;
 	// The HTTP method (e.g., GET, POST).
-    std::string uri;
+    Slice uri;
 	// The request URI, which identifies the resource being requested (e.g., /index.html).
-    std::string version;
+    Slice version;
 	// The HTTP version (e.g., HTTP/1.1).
-    std::map<std::string, std::string> headers;
-	// The map of headers, where the key is the header name and the value is the header value.
-	// Headers are case-insensitive, so they should be stored in a case-insensitive manner.
-    std::string body;
+    std::string path;
+	// The path of the URI, decoded and normalized. It keeps its capacity between requests.
+    std::vector<Header> headers;
+	// The headers in the order they were received.
+    Slice body;
 	// The body of the request, which contains the content sent with the request.
 	// The body is typically used in POST requests to send data to the server.
-    bool parseRequestLine(const std::string& line);
-	// Parses the request line (e.g., "GET /index.html HTTP/1.1").
+    size_t content_length;
+	// Value of the Content-Length header, 0 if there is none.
+    bool chunked;
+	// True if the body is sent with the chunked transfer coding.
+    BodyDecoder decoder;
+	// Decoder of a chunked body.
+    std::string decoded;
+	// The decoded chunked body. Unlike a Content-Length body it cannot be a view of the buffer.
+	// It keeps its capacity between requests.
+    size_t max_header_size;
+	// Maximum size of the request line and headers, 0 means no limit.
+    size_t max_body_size;
+	// Maximum size of the body, 0 means no limit.
+
+    bool parseRequestLine(size_t start, size_t end);
+	// Parses the request line (e.g., "GET /index.html HTTP/1.1") between start and end.
 	// Returns true if parsing was successful, false otherwise.
-    bool parseHeader(const std::string& line);
-	// Parses a single header line (e.g., "Host: example.com").
+    bool parseHeader(size_t start, size_t end);
+	// Parses a single header line (e.g., "Host: example.com") between start and end.
 	// Returns true if parsing was successful, false otherwise.
+    bool finishHeaders();
+	// Validates the headers once the empty line is found and prepares the body.
+	// Returns true if the request can continue, false otherwise.
+    ParseStatus parseChunkedBody(size_t length);
+	// Decodes the chunked body received so far into decoded.
+    ParseStatus fail(int status);
+	// Moves the parser to the error state with the given HTTP status code.
+    std::string copy(const Slice& slice) const;
+	// Copies the bytes of a slice into a std::string.
+    View view(const Slice& slice) const;
+	// Returns a view of the bytes of a slice.
+    const Header* findHeader(const char* name, size_t length) const;
+	// Returns the first header with the given name (compared without case), or NULL.
 };
 
-#endif
\ No newline at end of file
+#endif
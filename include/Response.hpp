@@ -1,49 +1,146 @@
 #ifndef RESPONSE_HPP
 #define RESPONSE_HPP
 
-#include "Config.hpp"	// Include the Config class for configuration settings
+#include "Router.hpp"	// Include the Router class for the settings of the location
 #include "Request.hpp"	// Include the Request class for handling HTTP requests
+#include "FileCache.hpp"	// Include the FileCache class to serve static files from memory
+#include "OutputQueue.hpp"	// Include the OutputQueue class where the response is queued
+#include "Arena.hpp"	// Include the Arena class for the memory of the response
 #include <string>		// Include the string class for handling strings
-#include <map>			// Include the map class for storing key-value pairs	
+
+#define MAX_RESPONSE_HEADERS 16
+// Maximum number of headers of a response. Responses never use more than about ten.
 
 class Response {
 	// The Response class represents an HTTP response.
-	// It is designed to generate a complete HTTP response based on the request and configuration.
+	// It is designed to generate a complete HTTP response based on the request and the settings
+	// of the location the Router selected for it.
 	// It contains methods to set the status, headers, and body of the response.
-	// It provides a method to generate the complete response string.
+	// It provides a method to queue the complete response on the connection.
+	// The headers are kept in a small fixed table of pointers to their values, and the
+	// status line comes from a precomputed table, so serializing a response does not
+	// allocate: the bytes are written straight into the output buffer of the connection.
+	// What the response builds (the path of the file, Content-Range, the parts of a
+	// multipart/byteranges body, the body of an error) is taken from the arena of the
+	// connection, which is reset when the request is consumed, so building it does not call
+	// malloc() either once the connection served its first request.
 public:
-    Response(const Request& request, const Config& config);
-	// Constructor that takes a Request object and a Config object.
-    std::string generate();
-	// Generates the complete HTTP response string.
-    void setStatus(int code, const std::string& message);
-	// Sets the HTTP status code and message for the response.
-	// e.g., setStatus(200, "OK") sets the status code to 200 and the message to "OK".
-    void setHeader(const std::string& key, const std::string& value);
-	// Sets a specific header in the response.
+    Response(const Request& request, const Router::Location& location, FileCache& cache, Arena& arena);
+	// Constructor that takes a Request object, the location that matches it, the file cache of
+	// the worker and the arena of the connection, which must not be reset before enqueue().
+    void enqueue(OutputQueue& output);
+	// Queues the complete HTTP response (status line, headers and body) for sending.
+	// The body of a cached file is queued as a file segment that points to the cache entry,
+	// so it is never copied: it goes to the socket with writev() or sendfile().
+    int getStatus() const;
+	// Returns the HTTP status code of the response.
+    int getPrebuiltStatus() const;
+	// Returns the status code if the answer is one of the prebuilt error responses
+	// (see ErrorPages), which the caller sends instead of this response; 0 otherwise.
+    void setStatus(int code);
+	// Sets the HTTP status code of the response. The reason phrase comes from the status table.
+	// e.g., setStatus(404) sends "HTTP/1.1 404 Not Found".
+    void setHeader(const char* name, const char* value);
+    void setHeader(const char* name, const std::string& value);
+	// Sets a specific header in the response, replacing the previous value if any.
 	// e.g., setHeader("Content-Type", "text/html") sets the Content-Type header to text/html.
-    void setBody(const std::string& body_content);
-	// Sets the body content of the response.
+	// Only a pointer to the value is kept: it must stay valid until enqueue() is called.
+    void setBody(const char* data, size_t length);
+	// Sets the body content of the response. Like a header value, it is not copied.
+    static std::string getStatusMessage(int code);
+	// Returns the reason phrase of an HTTP status code (e.g., 404 -> "Not Found"),
+	// or an empty string if the code is not one the server knows.
 
 private:
+    struct Field {
+        const char* name;		// Name of the header, a string literal.
+        const char* value;		// Value of the header, owned by the caller of setHeader().
+        size_t length;			// Length of the value.
+    };
+    struct Part {
+        off_t first;			// First byte of the range, in the file.
+        off_t last;				// Last byte of the range, inclusive.
+        const char* header;		// Header of the part in a multipart/byteranges body, NULL otherwise.
+        size_t header_length;	// Length of header.
+    };
+    struct StatusLine {
+        int code;				// HTTP status code.
+        const char* line;		// Complete status line, e.g., "HTTP/1.1 200 OK\r\n".
+        size_t length;			// Length of the status line.
+    };
+    static const StatusLine status_lines[];
+	// The status line of every status code the server sends, sorted by code.
+    static const size_t status_line_count;
+	// Number of entries of status_lines.
+
     int status_code;
 	// The HTTP status code (e.g., 200, 404) of the response.
-    std::string status_message;
-	// The HTTP status message (e.g., "OK", "Not Found") of the response.
-    std::map<std::string, std::string> headers;
-	// A map to store the headers of the response, where the key is the header name and the value is the header value.
-    std::string body;
+    int prebuilt_status;
+	// Status code of the prebuilt error response to send instead, 0 if there is none.
+    bool head;
+	// True for a HEAD request: the response is sent without its body.
+    Field fields[MAX_RESPONSE_HEADERS];
+	// The headers of the response, in the order they were first set.
+    size_t field_count;
+	// Number of headers in fields.
+    char content_length[24];
+	// Content-Length of a body that does not come from the file cache, in decimal.
+    const char* body;
 	// The body content of the response, which contains the actual data being sent back to the client.
+    size_t body_length;
+	// Length of body.
+    const FileCache::Entry* body_file;
+	// Cache entry that holds the body of a static file, NULL if the body is in body.
+    Part* parts;
+	// Byte ranges of body_file to send, in the arena. NULL for the whole file.
+    size_t part_count;
+	// Number of entries of parts.
+    const char* boundary;
+	// Boundary between the parts of a multipart/byteranges body, in the arena.
     const Request& request;
 	// Reference to the Request object that contains the details of the HTTP request.
-    const Config& config;
+    const Router::Location& location;
+	// Settings of the location that matches the request (root, index, methods).
+    FileCache* cache;
+	// The file cache used to serve static files.
+    Arena& arena;
+	// Memory of the connection for what the response builds.
 
-    std::string readFile(const std::string& path);
-	// Reads the content of a file and returns it as a string.
-    std::string getContentType(const std::string& path);
-	// Returns the content type based on the file extension.
     void handleGetRequest();
 	// Handles GET requests by reading the requested file and setting the appropriate headers.
+	// Files come from the file cache, with their headers already computed. The path cache says
+	// first whether the path is a file, a directory or nothing: a directory gets its index file,
+	// its autoindex listing or a 403, and a 301 to the same URI with a slash if it has none.
+    void redirectToDirectory();
+	// Answers with a 301 to the URI of the request followed by a slash.
+    void serveListing(const char* directory, size_t length, Request::View uri);
+	// Sets the body to the autoindex listing of the directory, titled with the path of the URI.
+    void handleDeleteRequest();
+	// Handles DELETE requests in a location with an upload_store by removing the file (204).
+    const FileCache::Entry* serveFile(const char* path, size_t length);
+	// Sets the body and headers from the file at path. Returns NULL if it cannot be read.
+	// Big files are not read: their body is sent from the cached file descriptor.
+    void serveEntry(const FileCache::Entry* entry);
+	// Sets the body and the headers of the file from its cache entry.
+    static bool acceptsGzip(Request::View accept_encoding);
+	// Returns true if the Accept-Encoding header of the request allows a gzip body.
+    bool isNotModified(const FileCache::Entry& entry) const;
+	// Returns true if If-None-Match or If-Modified-Since say the client's copy is current.
+    void setNotModified();
+	// Turns the response into a 304 Not Modified without a body.
+    void applyRange(const FileCache::Entry& entry);
+	// Handles the Range header: a 206 with one range, a 206 multipart/byteranges with several,
+	// or a 416 if no range overlaps the file. The ranges are sent as slices of the file.
+    void appendSlice(OutputQueue& output, off_t offset, size_t length);
+	// Queues length bytes of body_file starting at offset, from memory or from its file descriptor.
+    int findHeader(const char* name) const;
+	// Returns the index of the header in fields, or -1 if it is not set.
+    void removeHeader(const char* name);
+	// Removes a header from the response, if it is set.
+    void setError(int code);
+	// Sets the status and a small HTML body for the given error code.
+    static const StatusLine& getStatusLine(int code);
+	// Returns the precomputed status line of an HTTP status code (500 if it is unknown).
 };
 
 #endif
\ No newline at end of file
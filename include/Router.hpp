@@ -0,0 +1,141 @@
+#ifndef ROUTER_HPP
+#define ROUTER_HPP
+
+#include "Config.hpp"	// Include the Config class with the server and location blocks
+#include <string>		// For std::string
+#include <vector>		// For std::vector
+#include <utility>		// For std::pair
+#include <cstddef>		// For size_t
+#include <ctime>		// For time_t
+
+class Router {
+	// The Router class is the compiled form of the server and location blocks of the
+	// configuration. It is built when the worker starts (and again on every reload, see
+	// Generation) and never changes, so the settings of a request are found with lookups
+	// that do not allocate or copy strings:
+	// - each listening address has a table of server names sorted without case, searched
+	//   with a binary search on the Host header, and a default virtual host;
+	// - each virtual host has its locations sorted from the longest prefix to the shortest,
+	//   so the first prefix that matches the path is the most specific one.
+	// Settings are inherited: a location takes the value of its server when it does not set
+	// it, and a server takes the global value. A file in the "key=value" format is compiled
+	// as a single server listening on port, with one location for /.
+public:
+    enum Method {
+        METHOD_GET = 1,
+        METHOD_HEAD = 2,
+        METHOD_POST = 4,
+        METHOD_PUT = 8,
+        METHOD_DELETE = 16
+    };
+	// Methods that can be allowed in a location, as bits of Location::methods.
+    enum Balance {
+        BALANCE_ROUND_ROBIN,	// Weighted round-robin (the default).
+        BALANCE_LEAST_CONN,		// The server with the fewest active requests for its weight (least_conn).
+        BALANCE_HASH			// Consistent hash of the request URI or the client address (hash).
+    };
+	// How an upstream group chooses the server of each request.
+    struct UpstreamServer {
+        std::string address;	// Address of the server, host:port (server).
+        unsigned weight;		// Share of the requests, relative to the other servers (weight=).
+        unsigned max_fails;		// Failed requests in a row that eject the server, 0 never (max_fails=).
+        time_t fail_timeout;	// Seconds an ejected server gets no requests (fail_timeout=).
+    };
+    struct Upstream {
+        std::string name;		// Name of the group (upstream name), or the address of a proxy_pass without group.
+        std::vector<UpstreamServer> servers;	// Servers of the group, in the order of the file.
+        Balance balance;		// How the server of a request is chosen.
+        bool hash_client;		// For BALANCE_HASH, true to hash the client address ($remote_addr)
+								// instead of the request URI ($request_uri).
+        size_t keepalive;		// Idle connections kept open to each server, per worker (keepalive).
+        time_t keepalive_timeout;	// Seconds an idle connection is kept before closing it.
+    };
+    struct Location {
+        std::string prefix;		// URI prefix that selects the location (e.g., /images).
+        std::string root;		// Directory the URI is appended to (root).
+        std::string index;		// File served for a URI that ends with / (index).
+        bool autoindex;			// True to list a directory that has no index file (autoindex on).
+        unsigned methods;		// Allowed methods, a combination of Method bits (methods).
+        std::string allow;		// Value of the Allow header of a 405 response (e.g., "GET, HEAD").
+        std::vector<std::pair<std::string, std::string> > cgi;
+		// Extensions run as CGI scripts, with their interpreter (cgi .php /usr/bin/php-cgi).
+        time_t cgi_timeout;		// Seconds a CGI script may run without sending output (cgi_timeout).
+        std::string fastcgi_pass;
+		// FastCGI responder that answers every request of the location, as unix:/path or
+		// host:port (fastcgi_pass), or empty.
+        size_t fastcgi_pool_size;			// Idle connections kept open to the responder, per worker.
+        time_t fastcgi_keepalive_timeout;	// Seconds an idle connection is kept before closing it.
+        unsigned fastcgi_max_fails;			// Failed attempts in a row that mark the responder down.
+        time_t fastcgi_fail_timeout;		// Seconds the responder stays down before it is tried again.
+        std::string upload_store;
+		// Directory where PUT and POST store the request bodies and DELETE removes files
+		// (upload_store), or empty if the location does not accept uploads.
+        std::string proxy_pass;
+		// Upstream group (or host:port) that every request of the location is forwarded to
+		// (proxy_pass http://name), or empty.
+        size_t upstream;		// Index of the group of proxy_pass in getUpstreams().
+        time_t proxy_timeout;	// Seconds the upstream may go without reading or answering (proxy_timeout).
+        bool metrics;			// True if the location answers with the metrics of the workers (metrics on).
+    };
+    struct VirtualHost {
+        std::vector<std::string> names;		// Names of the server (server_name).
+        std::vector<Location> locations;	// Locations, from the longest prefix to the shortest.
+    };
+    struct Listener {
+        std::string address;	// Address to bind, empty for every interface.
+        int port;				// Port to bind.
+        std::vector<std::pair<std::string, size_t> > names;
+		// Server names of the virtual hosts of this address, in lowercase and sorted,
+		// with the index of their virtual host.
+        size_t default_host;
+		// Virtual host used when the Host header matches no name (default_server, or the first one).
+    };
+
+    explicit Router(const Config& config);
+	// Constructor that compiles the server blocks of the configuration.
+	// Throws a std::runtime_error if a listen directive is invalid.
+    const std::vector<Listener>& getListeners() const;
+	// Returns the addresses to listen on. A connection remembers the index of its listener.
+    const std::vector<Upstream>& getUpstreams() const;
+	// Returns the upstream groups: the upstream blocks, then one group per proxy_pass that
+	// names an address instead of a group. A location remembers the index of its group.
+    int findListener(const std::string& address, int port) const;
+	// Returns the index of the listener of an address and port, or -1 if there is none.
+	// Used on reload to keep the sockets whose address did not change.
+    const VirtualHost& findHost(size_t listener, const char* host, size_t length) const;
+	// Returns the virtual host of a request received on a listener, given its Host header
+	// (host may be NULL). The port of the Host header is ignored.
+    const Location* findLocation(const VirtualHost& host, const char* path, size_t length) const;
+	// Returns the location with the longest prefix of the path, or NULL if none matches.
+    static const std::string* findInterpreter(const Location& location, const char* path, size_t length,
+        size_t& script_length);
+	// Returns the interpreter of the CGI script named in the path, or NULL if the path is not
+	// a script of the location. The script is the first path segment that ends with a CGI
+	// extension; script_length is set to the length of the path up to its end, the rest of
+	// the path is the PATH_INFO (e.g., /cgi-bin/app.py/users/1).
+    static std::string findUploadPath(const Location& location, const char* path, size_t length);
+	// Returns the file of the upload store that a path names: the path without the prefix of
+	// the location, under upload_store. Returns an empty string if the path leaves the store.
+    static unsigned parseMethod(const char* name, size_t length);
+	// Returns the Method bit of a method name, or 0 if the method is not supported.
+
+private:
+    std::vector<VirtualHost> hosts;
+	// The virtual hosts, one per server block.
+    std::vector<Listener> listeners;
+	// The listening addresses, each one with the virtual hosts that listen on it.
+    std::vector<Upstream> upstreams;
+	// The upstream groups.
+
+    void addServer(const Config& config, const Config::ServerBlock& server);
+	// Compiles a server block into a virtual host and registers it on its listeners.
+    static Location compileLocation(const std::string& prefix, const std::map<std::string, std::string>& settings);
+	// Builds a location from its settings, already merged with the inherited ones.
+    void addUpstream(const Config::UpstreamBlock& block);
+	// Compiles an upstream block into a group.
+    size_t findUpstream(const std::string& proxy_pass);
+	// Returns the index of the group a proxy_pass names, adding a group of one server for
+	// host:port. Throws a std::runtime_error if it is neither.
+};
+
+#endif
@@ -4,41 +4,262 @@
 #include "Config.hpp"	 	// Include the Config class for configuration handling
 #include "Request.hpp"		// Include the Request class for handling HTTP requests
 #include "Response.hpp"		// Include the Response class for generating HTTP responses
+#include "Connection.hpp"	// Include the Connection class for the per-client state
+#include "EventLoop.hpp"		// Include the EventLoop interface (poll or epoll backend)
+#include "FileCache.hpp"		// Include the FileCache class shared by the connections of the worker
+#include "HotHeaders.hpp"	// Include the HotHeaders class for the Date and Server headers
+#include "ErrorPages.hpp"	// Include the ErrorPages class for the prebuilt error responses
+#include "Router.hpp"		// Include the Router class to find the settings of each request
+#include "Generation.hpp"	// Include the Generation class for the configuration that can be reloaded
+#include "TimerWheel.hpp"	// Include the TimerWheel class for the timeouts of the connections
+#include "CGI.hpp"			// Include the CGI class to run the scripts of the locations
+#include "FastCGIPool.hpp"	// Include the FastCGIPool class for the connections to FastCGI responders
+#include "Upload.hpp"		// Include the Upload class to stream request bodies to disk
+#include "UpstreamPool.hpp"	// Include the UpstreamPool class for the connections to the proxied servers
+#include "Metrics.hpp"		// Include the Metrics class for the counters of the worker
+#include "Log.hpp"			// Include the Log class for the access and error logs
+#include "LogFormat.hpp"		// Include the LogFormat class for the lines of the access log
+#include <sys/types.h>		// For pid_t
 #include <sys/socket.h>	 	// For socket programming
 #include <netinet/in.h>	 	// For sockaddr_in structure to define internet addresses
-#include <poll.h>	 		// For poll functionality to handle multiple file descriptors
 #include <vector>			// For using std::vector to manage multiple file descriptors
 #include <string>			// For using std::string to handle configuration keys and values
+#include <streambuf>		// For std::streambuf, the buffer std::cerr had before the error log
 
 
 
+#define OUTPUT_HIGH_WATER 65536
+// Bytes of queued output above which no more pipelined requests are answered until they are sent.
+#define READ_BATCH_SIZE 65536
+// Bytes read from a client before the requests received are processed. An upload is written to
+// disk after every batch, so its memory does not grow with the size of its body.
+
 class Server {
 	// This class is responsible for setting up and managing a server.
 	// It uses the Config class to read configuration settings from a file.
-	// The server listens for incoming connections and handles them using poll.
+	// The server listens for incoming connections and handles them with an EventLoop
+	// (epoll or poll, chosen in the configuration).
 	// It is designed to be efficient and scalable, allowing multiple connections to be handled simultaneously.
+	// SIGHUP reloads the configuration file without dropping connections (see reload).
+	// CGI scripts run as child processes whose pipes are watched by the same event loop.
+	// Uploads (PUT and POST to a location with upload_store) are written to disk as they arrive.
+	// Locations with proxy_pass forward their requests to upstream servers through the same
+	// event loop, streaming both bodies.
+	// The event loop backend (event_loop) is only chosen at start-up.
+	// Each request is written to the access_log when its response is queued (or, for a script,
+	// a proxied server or an upload, when it ends), and std::cerr goes to the error_log. Both
+	// are written by their own thread (see Log), so the event loop never waits for the disk.
+	// SIGUSR1 reopens them (logrotate). SIGTERM and SIGINT stop the event loop, so the
+	// destructor runs and the logs write what they hold before the process exits.
 public:
-    Server(const Config& config);
-	// Constructor that takes a Config object to initialize the server settings.
+    Server(const Config& config, Metrics& metrics, int worker = -1);
+	// Constructor that takes a Config object to initialize the server settings, and the
+	// metrics the worker counts its connections and requests in (the slot of the worker).
+	// worker is the number of the worker process running this server, or -1 if the
+	// server runs alone. Workers open their listening socket with SO_REUSEPORT so
+	// several of them can listen on the same port.
     ~Server();
 	// Destructor to clean up resources when the server is no longer needed.
     void start();
 	// Starts the server, setting up the socket and listening for incoming connections.
+	// Returns when SIGTERM or SIGINT is received.
 
 private:
-    int server_fd;
-	// File descriptor for the server socket.
-    struct sockaddr_in address;
-	// Structure to hold the server's address information.
-    std::vector<struct pollfd> fds;
-	// Vector to hold file descriptors for polling.
-    Config config;
-	// Instance of Config to access configuration settings.
-
-    void setupSocket();
-	// Sets up the server socket based on configuration settings.
+    std::vector<int> listen_fds;
+	// File descriptors of the listening sockets, one per listener of the Router (same index).
+    int worker;
+	// Number of the worker process running this server, -1 if there is no master.
+    EventLoop* loop;
+	// The event loop that reports which file descriptors are ready.
+    std::vector<EventLoop::Event> events;
+	// Ready events returned by the loop, reused on every wakeup.
+    std::vector<Connection*> connections;
+	// Connection state of each client, indexed by file descriptor (NULL if unused).
+	// Finding and removing a connection is O(1).
+    size_t connection_count;
+	// Number of open client connections.
+    TimerWheel timers;
+	// Deadline of every connection (header, body, send or keep-alive timeout).
+	// The event loop waits until the next one, and only expired connections are visited.
+    FileCache* file_cache;
+	// Cache of static files, shared by every connection of this server.
+    HotHeaders hot_headers;
+	// Date and Server headers, formatted at most once per second.
+    Generation* generation;
+	// Current configuration: the settings, the Router and the prebuilt error responses
+	// (with their Date kept up to date). New requests are served with it.
+    int signal_pipe;
+	// Read end of the pipe written by the signal handler, watched by the event loop.
+    bool stopping;
+	// True once SIGTERM or SIGINT was received: the event loop returns after the current wakeup.
+    struct Pipe {
+        Connection* connection;	// Connection whose script uses the file descriptor, NULL if unused.
+        int interest;			// Events the loop watches for it.
+    };
+    std::vector<Pipe> pipes;
+	// CGI pipes and FastCGI connections of the running scripts, indexed by file descriptor.
+    FastCGIPool fastcgi_pool;
+	// Idle connections to the FastCGI responders and their health.
+    UpstreamPool upstream_pool;
+	// Balancing state, idle connections and health of the upstream servers of proxy_pass.
+    std::vector<pid_t> children;
+	// CGI scripts that finished or were killed and are not reaped yet.
+    time_t keepalive_timeout;
+	// Seconds an idle keep-alive connection is kept open (keepalive_timeout).
+    size_t keepalive_requests;
+	// Maximum number of requests served on one connection (keepalive_requests).
+    size_t max_header_size;
+	// Maximum size of the request line and headers (client_max_header_size).
+    size_t max_body_size;
+	// Maximum size of a request body (client_max_body_size).
+    time_t client_header_timeout;
+	// Seconds to receive the request line and headers, counted from their first byte.
+    time_t client_body_timeout;
+	// Seconds allowed between two reads of a request body.
+    time_t send_timeout;
+	// Seconds allowed between two writes of a response the client does not read.
+    size_t worker_connections;
+	// Maximum number of open connections of this process; more are rejected with a 503.
+    int spare_fd;
+	// File descriptor kept open so a connection can still be accepted and closed when the
+	// process runs out of descriptors (EMFILE).
+    Metrics& metrics;
+	// Metrics of every worker, read by the metrics location.
+    Metrics::Worker& counters;
+	// Slot of this worker in metrics, the only one it writes.
+    std::string metrics_text;
+	// Body of the last metrics response, reused so it keeps its capacity.
+    Log access_log;
+	// Access log of the worker (access_log), closed if there is none.
+    Log error_log;
+	// Error log of the worker (error_log), closed if the messages go to the standard error.
+    Log::Stream error_stream;
+	// Stream buffer of std::cerr while error_log is open.
+    std::streambuf* saved_cerr;
+	// Buffer std::cerr had before error_stream was installed, NULL if it is not installed.
+    LogFormat log_format;
+	// Compiled format of the lines of the access log (log_format).
+    std::string log_line;
+	// Last line of the access log, reused so formatting a line does not allocate.
+
+    void applySettings(const Config& config);
+	// Reads the connection limits and the file cache settings, at start-up and on reload.
+    void applyLogs(const Config& config);
+	// Compiles log_format and opens, reopens or closes the access and error logs according to
+	// access_log, error_log, log_buffer_size, log_overflow and log_flush_interval, at start-up
+	// and on reload. A log whose settings did not change is kept. Throws a std::runtime_error
+	// if the format is invalid or a file cannot be opened; the format is then unchanged.
+    void setupSockets();
+	// Opens and registers a listening socket for every listener of the Router.
+    void setupSignals();
+	// Installs the SIGHUP, SIGCHLD, SIGUSR1, SIGTERM and SIGINT handler and registers its pipe
+	// in the event loop.
+    int openListener(const Router::Listener& listener, int backlog);
+	// Opens a non-blocking socket listening on the address of the listener and returns it.
+    void reload();
+	// Reads the configuration file again. If it compiles and its new addresses can be opened,
+	// it becomes the current generation: the sockets of the addresses that did not change
+	// are kept, the new ones are opened and the removed ones are closed. Otherwise nothing
+	// changes. The outcome and the time it took are printed.
+    void resolveUpstreams();
+	// Finds the group of each upstream of the current generation in the UpstreamPool, at
+	// start-up and on reload, so a proxied request does not look it up.
+    void adopt(Connection& connection);
+	// Moves a connection to the current generation before its next request. If its
+	// listening address was removed, it keeps the old one for that request and is closed after it.
+    int findListener(int fd) const;
+	// Returns the index of the listening socket fd, or -1 if fd is not a listening socket.
     void handleConnections();
-	// Handles incoming connections and manages them using poll.
+	// Handles incoming connections and dispatches the events reported by the loop.
+    void acceptConnections(size_t listener);
+	// Accepts every pending client of a listening socket (until EAGAIN) and registers them in the loop.
+    bool handleRead(Connection& connection);
+	// Reads everything available from the client (until EAGAIN)
+	// and answers every complete request received.
+	// Returns false if the connection must be closed.
+    bool handleWrite(Connection& connection);
+	// Sends more of the pending output of the client when its socket is writable.
+	// Returns false if the connection must be closed.
+    bool processRequests(Connection& connection);
+	// Answers the complete requests buffered by the client, queues the responses and
+	// sends as much as the socket accepts. While output is pending, the connection waits
+	// for EVENT_WRITE instead of EVENT_READ, so no more requests are read (backpressure).
+	// Returns false if the connection must be closed.
+    bool startCgi(Connection& connection, const Router::Location& location, bool keep_alive);
+	// Starts the CGI script of the request if the location runs its path as one, or sends it to
+	// the FastCGI responder of the location, and registers its pipes. Returns false if the
+	// request is not for a script. If the script is missing or cannot be started, the error
+	// response is queued instead.
+    bool startProxy(Connection& connection, const Router::Location& location, bool keep_alive);
+	// Forwards the request to the upstream group of the location if it has a proxy_pass, and
+	// registers the upstream connection like the pipes of a script. Returns false if the location
+	// does not proxy, or does not allow the method (405). A request with a body is started at its
+	// headers (Request::streamBody) and its body is given to the upstream by feedCgi.
+	// If no server of the group can be reached, a 502 is queued instead.
+    void feedCgi(Connection& connection);
+	// Gives the body bytes in the input buffer to the proxied request of the connection and drops
+	// the ones it took. An invalid body ends the request with its error and closes the connection.
+    size_t inputLimit(const Connection& connection) const;
+	// Returns the bytes the input buffer may hold before the client is not read anymore:
+	// READ_BATCH_SIZE while a proxied body is streamed, otherwise the largest request.
+    bool startUpload(Connection& connection, const Router::Location& location, bool keep_alive);
+	// Starts storing the body of the request if it is a PUT or POST to a location with an
+	// upload_store, and not for a script. The request ends at its headers (Request::streamBody)
+	// and its body is left to receiveUpload. Returns false if the request is not an upload.
+	// If the file cannot be created, the error response is queued and the connection closes.
+    bool receiveUpload(Connection& connection);
+	// Writes the body bytes in the input buffer to the upload of the connection and drops them
+	// from the buffer. Once the body is complete, moves the file into place and queues the
+	// response. Returns false if more bytes are needed.
+    void handleCgi(int fd, int events);
+	// Writes the request body to the script or reads its response, when one of its pipes is ready.
+    void watchCgi(Connection& connection);
+	// Watches the pipes of the script of the connection: for writing while the request body is
+	// being sent, and for reading while the output queue is below OUTPUT_HIGH_WATER.
+    void watchPipe(int fd, Connection* connection, int interest);
+	// Changes the events the loop watches for a pipe; 0 removes it from the loop.
+    bool retryCgi(Connection& connection);
+	// Sends a proxied request whose upstream connection failed to another server of its group,
+	// if CGI::canRetry allows it. Returns false if the request must fail instead.
+    void finishCgi(Connection& connection, CGI::Status status);
+	// Ends the script of the connection once its response is complete (or invalid: 502), and
+	// answers the requests that were waiting for it.
+    void stopCgi(Connection& connection);
+	// Removes the pipes of the script from the loop, closes them and leaves the process to reapChildren.
+    void reapChildren();
+	// Collects the exit status of the finished scripts with waitpid(), so no zombies remain.
+    void sendResponse(Connection& connection, Response& response, bool keep_alive);
+	// Queues a response with its Server, Date and Connection headers,
+	// or the prebuilt error response it asks for.
+    void queueError(Connection& connection, int code, bool keep_alive);
+	// Queues the prebuilt error response of the code from the generation of the connection.
+    void countResponse(Connection& connection, int code);
+	// Counts a response in the metrics and sets it as the status of the access log record.
+    void startLog(Connection& connection, unsigned long started);
+	// Fills the access log record of the request just parsed: its request line and headers,
+	// and the time and output size it starts at. Does nothing if there is no access log.
+    void logRequest(Connection& connection);
+	// Writes the access log record of the connection, with the bytes queued and the time
+	// elapsed since startLog. A record without a response (the client left) gets a 499.
+    void sendMetrics(Connection& connection, bool keep_alive);
+	// Queues the metrics of the workers in the Prometheus text format (a location with metrics on).
+    bool flush(Connection& connection);
+	// Sends the pending output of the connection (Connection::flushOutput) and counts the
+	// bytes sent, and a write stall if the socket did not take everything.
+	// Returns false if the client is gone.
+    void watch(Connection& connection, int interest);
+	// Changes the events the loop watches for the connection, only if they changed.
+    void closeConnection(int fd);
+	// Closes the client and removes it from the loop and the connection table.
+    void updateTimer(Connection& connection);
+	// Moves the deadline of the connection according to what it is waiting for: the rest of
+	// the headers, the body (or the upload), the client reading the response, or the next request.
+    void timeoutConnection(int fd);
+	// Closes a connection whose deadline passed, with a 408 if a request was incomplete
+	// or a 504 if its CGI script did not answer.
+    void sendError(int fd, int code);
+	// Sends the prebuilt "Connection: close" response of the code with a single non-blocking
+	// send(), for a connection that is closed right after.
 };
 
 #endif
\ No newline at end of file
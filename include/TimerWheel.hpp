@@ -0,0 +1,58 @@
+#ifndef TIMERWHEEL_HPP
+#define TIMERWHEEL_HPP
+
+#include <vector>		// For std::vector to store the slots and return the expired timers
+#include <ctime>		// For time_t
+#include <cstddef>		// For size_t
+
+#define TIMER_WHEEL_SLOTS 64
+// Number of one-second slots of the wheel. Deadlines further away wait for more turns.
+
+class TimerWheel {
+	// The TimerWheel class keeps the deadlines of the connections in a hashed timing wheel:
+	// a ring of one-second slots, where a timer is linked into the slot of its deadline
+	// modulo the number of slots. Scheduling, moving and cancelling a timer only relink it,
+	// so they are O(1), and expire() only visits the slots of the seconds that passed.
+	// The timers are stored in the objects they belong to (intrusive lists), so the wheel
+	// never allocates after it is built.
+	// The resolution is one second, like the timeouts of the configuration.
+public:
+    struct Timer {
+        Timer* prev;		// Previous timer of the slot, NULL if the timer is not scheduled.
+        Timer* next;		// Next timer of the slot.
+        time_t deadline;	// Second at which the timer expires.
+        int fd;				// File descriptor of the owner, returned by expire().
+    };
+
+    explicit TimerWheel(time_t now);
+	// Constructor that starts the wheel at the given second.
+    static void init(Timer& timer, int fd);
+	// Prepares a timer that is not scheduled yet, owned by fd.
+    void schedule(Timer& timer, time_t deadline);
+	// Schedules the timer at deadline, or moves it there if it was already scheduled.
+    void cancel(Timer& timer);
+	// Removes the timer from the wheel. Does nothing if it is not scheduled.
+    static bool isScheduled(const Timer& timer);
+	// Returns true if the timer is in the wheel.
+    void expire(time_t now, std::vector<int>& expired);
+	// Removes the timers whose deadline is now or earlier and appends their fd to expired.
+    int nextTimeout(time_t now) const;
+	// Returns the number of milliseconds until the next slot with timers is due, as the
+	// timeout of the event loop, or -1 if there are no timers.
+
+private:
+    std::vector<Timer> slots;
+	// Head of each slot: a circular list, empty when the head points to itself.
+    time_t current;
+	// Last second processed by expire().
+    size_t count;
+	// Number of scheduled timers.
+
+    static void unlink(Timer& timer);
+	// Removes the timer from its slot.
+    TimerWheel(const TimerWheel&);
+    TimerWheel& operator=(const TimerWheel&);
+	// The slots are linked to themselves, so the wheel cannot be copied.
+};
+
+#endif
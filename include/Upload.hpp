@@ -0,0 +1,82 @@
+#ifndef UPLOAD_HPP
+#define UPLOAD_HPP
+
+#include "Request.hpp"		// Include the Request class for the framing of the body
+#include "BodyDecoder.hpp"	// Include the BodyDecoder class to decode the body as it arrives
+#include "OutputQueue.hpp"	// Include the OutputQueue class where the response is queued
+#include <string>			// For std::string
+
+class Upload {
+	// The Upload class stores the body of a PUT or POST request in the upload_store of its
+	// location, while the body arrives.
+	// The body is never kept whole in memory: the Server gives it the bytes of each read, they
+	// are decoded (Content-Length or chunked) and written to a temporary file in the directory
+	// of the target, and the Server drops them from the input buffer. Once the body is complete
+	// the temporary file is renamed into place, so readers see the old file or the new one,
+	// never a partial one. A PUT creates or replaces the file named by the URI; a POST to a
+	// URI that ends with / creates a new file with a unique name in that directory.
+	// An upload that does not complete (the client leaves, a timeout, an invalid body) removes
+	// its temporary file.
+public:
+    enum Status {
+        UPLOAD_AGAIN,	// The body is not complete: wait for more bytes.
+        UPLOAD_DONE,	// The whole body was written, commit() can be called.
+        UPLOAD_ERROR	// The body is invalid or cannot be written, see getErrorStatus().
+    };
+
+    Upload();
+	// Constructor of an upload that is not started yet.
+    ~Upload();
+	// Destructor that closes the temporary file and removes it if it was not committed.
+    int open(const std::string& path, const std::string& uri, bool create, const Request& request,
+        size_t max_body_size, bool keep_alive);
+	// Creates the temporary file for the body of the request. path is the target file, or the
+	// directory to create a new file in if create is true; uri is the URI of the target.
+	// Returns 0, or the HTTP status code of the error: 409 if the directory does not exist
+	// or the target is a directory, 403 if it cannot be written, 500 otherwise.
+    Status write(const char* data, size_t length, size_t& consumed);
+	// Decodes and writes the body bytes in data. consumed is set to the number of bytes used;
+	// the rest (an incomplete chunk-size line, or the next pipelined request) stays with the caller.
+    int commit();
+	// Moves the complete file into place. Returns 201 if the file was created, 204 if it
+	// replaced an existing one, or 500 if it cannot be moved. If the new name of a POST is
+	// already taken, the file gets another one.
+    void respond(OutputQueue& output, int code, const char* date) const;
+	// Queues the response of a committed upload, with a Location header for a new file.
+    int getErrorStatus() const;
+	// Returns the HTTP status code to answer with after UPLOAD_ERROR (400, 413 or 500).
+    bool keepsAlive() const;
+	// Returns true if the client asked to keep the connection open.
+
+private:
+    int fd;
+	// Temporary file the body is written to, -1 once it is closed.
+    std::string temp_path;
+	// Name of the temporary file, empty once it was moved into place.
+    std::string path;
+	// Name of the target file.
+    std::string uri;
+	// URI of the target file, sent in the Location header of a 201.
+    bool create;
+	// True if the file gets a new name instead of replacing path (POST).
+    bool existed;
+	// True if the target file existed before the upload (204 instead of 201).
+    bool keep_alive;
+	// True if the client asked to keep the connection open.
+    BodyDecoder decoder;
+	// Decoder of the body, Content-Length or chunked.
+    int error_status;
+	// HTTP status code of the error, after UPLOAD_ERROR.
+
+    Upload(const Upload&);
+    Upload& operator=(const Upload&);
+	// An upload owns its temporary file, it cannot be copied.
+
+    bool createTemporary(const std::string& directory);
+	// Creates a temporary file in directory with mkstemp, and for a POST names the target after
+	// its unique part. Returns false if it cannot be created (errno tells why).
+    bool writeAll(const char* data, size_t length);
+	// Writes length bytes to the temporary file. Returns false if the disk is full or fails.
+};
+
+#endif
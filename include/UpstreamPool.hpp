@@ -0,0 +1,85 @@
+#ifndef UPSTREAMPOOL_HPP
+#define UPSTREAMPOOL_HPP
+
+#include "Router.hpp"		// Include the Router class for the upstream groups
+#include "KeepAlivePool.hpp"	// Include the KeepAlivePool class for the connections of each server
+#include <string>			// For std::string
+#include <vector>			// For std::vector
+#include <utility>			// For std::pair
+#include <ctime>			// For time_t
+
+class UpstreamPool {
+	// The UpstreamPool class chooses the server of each proxied request and keeps the
+	// connections of a worker to the servers of its upstream groups.
+	// The server is chosen by the balancing of the group: smooth weighted round-robin (the
+	// requests of a server are spread between the others, not sent in a burst), least
+	// connections (the fewest requests in progress for its weight), or a consistent hash of
+	// the URI or the client address (a ring of weight * 100 points per server, so removing a
+	// server only moves its own keys).
+	// A request borrows a connection and gives it back when the response ended with the
+	// connection still open (HTTP/1.1 keep-alive). Up to keepalive idle connections are kept
+	// per server and reused first, so most requests skip the connect() and the server's accept().
+	// The health of a server is checked passively: after max_fails failed requests in a row it
+	// is ejected from its groups for fail_timeout seconds, and its requests go to the others.
+	// Every socket is non-blocking and close-on-exec, and no call of the pool blocks.
+public:
+    UpstreamPool();
+	// Constructor of an empty pool. Servers are added when a group first uses them.
+    ~UpstreamPool();
+	// Destructor that closes the connections of every server.
+    size_t findGroup(const Router::Upstream& upstream);
+	// Returns the index of the group with the name and the servers of upstream, adding it if it
+	// is new, and updates the settings of its servers. The Server calls it once per generation,
+	// for each upstream of the Router, so choosing a server does not look the group up.
+    int acquire(size_t group, const Router::Upstream& upstream, const std::string& key, size_t& peer, bool& reused);
+	// Chooses a server of the group (the index returned by findGroup() for upstream) for the
+	// request (key is hashed by a hash group) and sets
+	// peer to its index: returns an idle connection that is still open (reused is set to true),
+	// or a new one whose connect() may still be in progress. A server that refuses the
+	// connection at once counts a failure and the next one is tried. Returns -1 if every
+	// server is down or unreachable.
+    void release(size_t peer, int fd, bool reusable);
+	// Gives a connection back. It is kept for the next request if it is reusable and the
+	// pool of the server is not full; otherwise it is closed.
+    void reportFailure(size_t peer);
+    void reportSuccess(size_t peer);
+	// Record the outcome of a request, for the passive health check.
+    const std::string& getAddress(size_t peer) const;
+	// Returns the address of a server, for the error log.
+
+private:
+    struct Peer {
+        KeepAlivePool* connections;			// Idle connections and health of the server.
+        size_t active;						// Requests in progress, for least_conn.
+    };
+    struct Group {
+        std::string name;					// Name of the upstream group.
+        std::string servers;				// Addresses and weights of its servers, to notice a reload.
+        std::vector<size_t> peers;			// Index of each server of the group in peers.
+        std::vector<long> current;			// Current weight of each server, for round-robin.
+        std::vector<std::pair<unsigned, size_t> > ring;
+		// Points of the hash ring, sorted, with the position of their server in the group.
+        size_t next;						// Server where least_conn starts looking, so ties rotate.
+    };
+
+    std::vector<Peer> peers;
+	// Servers of the worker, shared by the groups that list the same address.
+    std::vector<Group> groups;
+	// Groups of the worker. A group whose servers changed on reload is added again: the
+	// requests that started with the previous generation keep the index of the old one.
+    std::vector<bool> tried;
+	// Servers of the group already tried by acquire(), reused so that a request does not allocate.
+
+    size_t findPeer(const std::string& address);
+	// Returns the index of the server with this address, adding it if it is new.
+    long choose(Group& group, const Router::Upstream& upstream, unsigned hash, time_t now);
+	// Returns the position in the group of the server for the next request, among the servers
+	// that are up and not tried yet, or -1 if there is none.
+    static unsigned hash(const char* data, size_t length);
+	// Hash of the key of a request, and of the points of the ring (FNV-1a, then mixed).
+    UpstreamPool(const UpstreamPool&);
+    UpstreamPool& operator=(const UpstreamPool&);
+	// The pool owns its sockets, it cannot be copied.
+};
+
+#endif
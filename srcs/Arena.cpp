@@ -0,0 +1,82 @@
+#include "Arena.hpp"	// Include the header file for the Arena class
+#include <cstring>		// For std::memcpy
+#include <new>			// For operator new and operator delete
+
+#define ARENA_ALIGNMENT 16
+// Alignment of every allocation, the one malloc() guarantees on 64-bit systems.
+
+static size_t align(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~static_cast<size_t>(ARENA_ALIGNMENT - 1);
+}
+
+Arena::Arena() : blocks(NULL), position(NULL), end(NULL), used(0) {}
+
+Arena::~Arena() {
+    freeBlocks();
+}
+
+void* Arena::allocate(size_t size) {
+    size = align(size == 0 ? 1 : size);
+    if (static_cast<size_t>(end - position) < size) {
+        addBlock(size);
+    }
+    void* memory = position;
+    position += size;
+    used += size;
+    return memory;
+}
+
+char* Arena::copy(const char* data, size_t length) {
+    char* memory = static_cast<char*>(allocate(length + 1));
+    std::memcpy(memory, data, length);
+    memory[length] = '\0';
+    return memory;
+}
+
+void Arena::addBlock(size_t size) {
+    size_t block_size = blocks == NULL ? ARENA_BLOCK_SIZE : blocks->size * 2;
+    if (block_size < size) {
+        block_size = size;
+    }
+    Block* block = static_cast<Block*>(::operator new(align(sizeof(Block)) + block_size));
+    block->next = blocks;
+    block->size = block_size;
+    blocks = block;
+    position = reinterpret_cast<char*>(block) + align(sizeof(Block));
+    end = position + block_size;
+    // The rest of the previous block is lost until the reset; the blocks double, so that is
+    // at most half of the memory.
+}
+
+void Arena::reset() {
+    if (blocks != NULL && blocks->next != NULL) {
+        size_t size = used;
+        freeBlocks();
+        if (size <= ARENA_MAX_KEEP) {
+            addBlock(size);
+            // One block that holds what the request needed, so the next one like it fits.
+        }
+    }
+    if (blocks != NULL) {
+        position = reinterpret_cast<char*>(blocks) + align(sizeof(Block));
+    }
+    used = 0;
+}
+
+void Arena::freeBlocks() {
+    while (blocks != NULL) {
+        Block* next = blocks->next;
+        ::operator delete(blocks);
+        blocks = next;
+    }
+    position = NULL;
+    end = NULL;
+}
+
+size_t Arena::getBlockCount() const {
+    size_t count = 0;
+    for (Block* block = blocks; block != NULL; block = block->next) {
+        ++count;
+    }
+    return count;
+}
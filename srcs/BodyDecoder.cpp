@@ -0,0 +1,134 @@
+#include "BodyDecoder.hpp"	// Include the header file for the BodyDecoder class
+#include <cstring>			// For std::memchr
+
+BodyDecoder::BodyDecoder() {
+    reset(false, 0, 0);
+}
+
+void BodyDecoder::reset(bool chunked, size_t content_length, size_t max_body_size) {
+    state = chunked ? STATE_SIZE : STATE_LENGTH;
+    remaining = chunked ? 0 : content_length;
+    size = 0;
+    max_size = max_body_size;
+    error_status = 0;
+    if (!chunked && max_size != 0 && content_length > max_size) {
+        fail(413);
+        // The length is known before the body arrives, so it is rejected at once.
+    }
+}
+
+BodyDecoder::Status BodyDecoder::decode(const char* data, size_t length, size_t& consumed,
+    const char*& chunk, size_t& chunk_length) {
+    consumed = 0;
+    chunk = NULL;
+    chunk_length = 0;
+    while (true) {
+        if (state == STATE_LENGTH || state == STATE_DATA) {
+            if (remaining == 0) {
+                state = state == STATE_LENGTH ? STATE_DONE : STATE_DATA_END;
+                continue;
+            }
+            if (consumed == length) {
+                return BODY_AGAIN;
+            }
+            chunk_length = length - consumed < remaining ? length - consumed : remaining;
+            chunk = data + consumed;
+            consumed += chunk_length;
+            remaining -= chunk_length;
+            size += chunk_length;
+            return BODY_DATA;
+            // The data is returned where it is: the caller copies or writes it.
+        }
+        if (state == STATE_DONE) {
+            return BODY_DONE;
+        }
+        if (state == STATE_ERROR) {
+            return BODY_ERROR;
+        }
+        size_t line_length;
+        const char* line = readLine(data, length, consumed, line_length);
+        if (line == NULL) {
+            return state == STATE_ERROR ? BODY_ERROR : BODY_AGAIN;
+        }
+        if (state == STATE_DATA_END) {
+            if (line_length != 0) {
+                return fail(400);
+                // The data of a chunk must be followed by CRLF.
+            }
+            state = STATE_SIZE;
+        } else if (state == STATE_TRAILER) {
+            if (line_length == 0) {
+                state = STATE_DONE;
+            }
+            // Trailer fields are not used, they are skipped until the empty line.
+        } else {
+            size_t chunk_size = 0;
+            size_t i = 0;
+            for (; i < line_length; ++i) {
+                char c = line[i];
+                int digit;
+                if (c >= '0' && c <= '9') {
+                    digit = c - '0';
+                } else if (c >= 'a' && c <= 'f') {
+                    digit = c - 'a' + 10;
+                } else if (c >= 'A' && c <= 'F') {
+                    digit = c - 'A' + 10;
+                } else {
+                    break;
+                }
+                if (chunk_size > (static_cast<size_t>(-1) >> 4)) {
+                    return fail(400);
+                    // The size does not fit in a size_t.
+                }
+                chunk_size = chunk_size * 16 + digit;
+            }
+            while (i < line_length && (line[i] == ' ' || line[i] == '\t')) {
+                ++i;
+            }
+            if (i == 0 || (i < line_length && line[i] != ';')) {
+                return fail(400);
+                // The size must be a hexadecimal number, optionally followed by extensions.
+            }
+            if (chunk_size == 0) {
+                state = STATE_TRAILER;
+                // The last chunk: only the trailer section is left.
+            } else if (max_size != 0 && chunk_size > max_size - size) {
+                return fail(413);
+                // The body is rejected before the data of the chunk is received.
+            } else {
+                remaining = chunk_size;
+                state = STATE_DATA;
+            }
+        }
+    }
+}
+
+const char* BodyDecoder::readLine(const char* data, size_t length, size_t& consumed, size_t& line_length) {
+    const char* start = data + consumed;
+    const char* newline = static_cast<const char*>(std::memchr(start, '\n', length - consumed));
+    if (newline == NULL) {
+        if (length - consumed > MAX_CHUNK_LINE) {
+            fail(400);
+            // A line that never ends would make the caller keep its bytes forever.
+        }
+        return NULL;
+    }
+    line_length = newline - start;
+    consumed += line_length + 1;
+    if (line_length > 0 && start[line_length - 1] == '\r') {
+        --line_length;
+        // Lines end with CRLF, but a bare LF is accepted too, as in the headers.
+    }
+    return start;
+}
+
+BodyDecoder::Status BodyDecoder::fail(int status) {
+    state = STATE_ERROR;
+    error_status = status;
+    return BODY_ERROR;
+}
+
+int BodyDecoder::getErrorStatus() const { return error_status; }
+// Returns the HTTP status code of the error.
+size_t BodyDecoder::getSize() const { return size; }
+// Returns the number of body bytes decoded so far.
@@ -0,0 +1,902 @@
+#include "CGI.hpp"			// Include the header file for the CGI class
+#include "Response.hpp"		// Include the Response class for the reason phrases
+#include "HotHeaders.hpp"	// Include the HotHeaders class for the Server header
+#include <unistd.h>			// For fork, execve, pipe, dup2, chdir, read, write and close
+#include <fcntl.h>			// For fcntl to make the pipes non-blocking and close-on-exec
+#include <signal.h>			// For kill and signal
+#include <cerrno>			// For errno
+#include <cstdio>			// For std::snprintf
+#include <cstdlib>			// For std::strtol
+#include <cstring>			// For std::strlen
+#include <cctype>			// For std::toupper
+#include <strings.h>		// For strcasecmp and strncasecmp
+#include <iostream>			// For std::cerr to log the FCGI_STDERR records
+
+#define CGI_MAX_HEAD 8192
+// Maximum size of the headers of a CGI response. A script that sends more is a 502.
+
+#define FCGI_BEGIN_REQUEST 1
+#define FCGI_END_REQUEST 3
+#define FCGI_PARAMS 4
+#define FCGI_STDIN 5
+#define FCGI_STDOUT 6
+#define FCGI_STDERR 7
+// Types of the FastCGI records used by the server (FastCGI specification, section 8).
+#define FCGI_RESPONDER 1
+#define FCGI_KEEP_CONN 1
+#define FCGI_REQUEST_COMPLETE 0
+#define FCGI_REQUEST_ID 1
+// Each connection carries one request at a time, so every request has the same id.
+
+CGI::CGI() : pid(-1), input_fd(-1), output_fd(-1), body_sent(0), started(false), status_code(0), chunked(false), head_only(false),
+    keep_alive(false), http10(false), content_length(-1), body_length(0), date(NULL), last_output(0), pool(NULL),
+    backend(0), ended(false), proxy(NULL), peer(0), reused(false), upstream(NULL), upstream_group(0), idempotent(false), tries(0),
+    streamed(false), input_sent(false), input_done(true), input_error(0), upstream_chunked(false), upstream_keep_alive(false) {}
+
+CGI::~CGI() {
+    if (pid > 0) {
+        ::kill(pid, SIGKILL);
+        // The script was not detached: nobody would reap it, and it would keep running.
+    }
+    closeInput();
+    closeOutput();
+}
+
+static std::string toString(long number) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%ld", number);
+    return buffer;
+}
+
+std::vector<std::string> CGI::buildEnvironment(const Request& request, const Params& params) {
+    std::vector<std::string> env;
+    std::string uri = request.getUri();
+    size_t query = uri.find('?');
+    std::string content_type = request.getHeader("Content-Type");
+    if (request.isChunked() || !request.getHeader("Content-Length").empty()) {
+        env.push_back("CONTENT_LENGTH=" + toString(request.isChunked() ? request.getBodyView().length
+            : request.getContentLength()));
+    }
+    // A streamed body is not in the request yet, but its Content-Length is.
+    if (!content_type.empty()) {
+        env.push_back("CONTENT_TYPE=" + content_type);
+    }
+    env.push_back("GATEWAY_INTERFACE=CGI/1.1");
+    env.push_back("PATH_INFO=" + params.path_info);
+    if (!params.path_info.empty()) {
+        env.push_back("PATH_TRANSLATED=" + params.document_root + params.path_info);
+    }
+    env.push_back("QUERY_STRING=" + (query != std::string::npos ? uri.substr(query + 1) : ""));
+    env.push_back("REMOTE_ADDR=" + params.remote_addr);
+    env.push_back("REMOTE_PORT=" + toString(params.remote_port));
+    env.push_back("REQUEST_METHOD=" + request.getMethod());
+    env.push_back("REQUEST_URI=" + uri);
+    env.push_back("SCRIPT_NAME=" + params.script_name);
+    env.push_back("SCRIPT_FILENAME=" + params.path);
+    env.push_back("SERVER_NAME=" + params.server_name);
+    env.push_back("SERVER_PORT=" + toString(params.server_port));
+    env.push_back("SERVER_PROTOCOL=" + request.getVersion());
+    env.push_back(std::string("SERVER_SOFTWARE=") + HotHeaders::getServer());
+    env.push_back("DOCUMENT_ROOT=" + params.document_root);
+    env.push_back("REDIRECT_STATUS=200");
+    // php-cgi refuses to run a script without REDIRECT_STATUS (force-cgi-redirect).
+    env.push_back("PATH=/usr/local/bin:/usr/bin:/bin");
+    for (size_t i = 0; i < request.getHeaderCount(); ++i) {
+        Request::View name = request.getHeaderName(i);
+        std::string variable = "HTTP_";
+        for (size_t c = 0; c < name.length; ++c) {
+            variable += name.data[c] == '-' ? '_' : static_cast<char>(std::toupper(static_cast<unsigned char>(name.data[c])));
+        }
+        if (variable == "HTTP_CONTENT_LENGTH" || variable == "HTTP_CONTENT_TYPE" || variable == "HTTP_PROXY") {
+            continue;
+            // Content-Length and Content-Type are CONTENT_LENGTH and CONTENT_TYPE. A "Proxy" header
+            // would set HTTP_PROXY, which many HTTP libraries use as their proxy (httpoxy).
+        }
+        Request::View value = request.getHeaderValue(i);
+        env.push_back(variable + "=" + std::string(value.data, value.length));
+    }
+    return env;
+}
+
+void CGI::setup(const Request& request, const Params& params) {
+    head_only = request.getMethod() == "HEAD";
+    http10 = request.getVersion() == "HTTP/1.0";
+    keep_alive = params.keep_alive;
+    date = params.date;
+    last_output = std::time(NULL);
+}
+
+void CGI::setupInput(const Request& request, bool streamed_body, size_t max_body_size) {
+    streamed = streamed_body;
+    input_done = !streamed;
+    if (streamed) {
+        input_decoder.reset(request.isChunked(), request.getContentLength(), max_body_size);
+    }
+}
+
+bool CGI::start(const Request& request, const Params& params, bool streamed_body, size_t max_body_size) {
+    setup(request, params);
+    setupInput(request, streamed_body, max_body_size);
+    if (!streamed) {
+        Request::View input = request.getBodyView();
+        body.assign(input.data != NULL ? input.data : "", input.length);
+    }
+    std::vector<std::string> env = buildEnvironment(request, params);
+    std::vector<char*> envp;
+    for (size_t i = 0; i < env.size(); ++i) {
+        envp.push_back(const_cast<char*>(env[i].c_str()));
+    }
+    envp.push_back(NULL);
+    size_t slash = params.path.rfind('/');
+    std::string directory = slash != std::string::npos ? params.path.substr(0, slash + 1) : "./";
+    std::string file = params.path.substr(slash != std::string::npos ? slash + 1 : 0);
+    char* argv[] = {const_cast<char*>(params.interpreter.c_str()), const_cast<char*>(file.c_str()), NULL};
+    // Everything the child needs is built before fork(), so the child only calls async-signal-safe functions.
+
+    int input[2];
+    int output[2];
+    if (pipe(input) == -1) {
+        return false;
+    }
+    if (pipe(output) == -1) {
+        close(input[0]);
+        close(input[1]);
+        return false;
+    }
+    for (int i = 0; i < 2; ++i) {
+        fcntl(input[i], F_SETFD, FD_CLOEXEC);
+        fcntl(output[i], F_SETFD, FD_CLOEXEC);
+    }
+    fcntl(input[1], F_SETFL, O_NONBLOCK);
+    fcntl(output[0], F_SETFL, O_NONBLOCK);
+    // Only the ends kept by the server are non-blocking; the script sees ordinary pipes.
+    pid = fork();
+    if (pid == -1) {
+        close(input[0]);
+        close(input[1]);
+        close(output[0]);
+        close(output[1]);
+        return false;
+    }
+    if (pid == 0) {
+        dup2(input[0], STDIN_FILENO);
+        dup2(output[1], STDOUT_FILENO);
+        // dup2 clears close-on-exec on the copies, every other descriptor of the worker is closed by execve.
+        signal(SIGPIPE, SIG_DFL);
+        // The worker ignores SIGPIPE, and an ignored signal stays ignored across execve.
+        if (chdir(directory.c_str()) == 0) {
+            execve(argv[0], argv, &envp[0]);
+        }
+        // RFC 3875 asks to run the script in its own directory, so it can open its files with relative paths.
+        const char message[] = "CGI: cannot execute the interpreter\n";
+        if (write(STDERR_FILENO, message, sizeof(message) - 1) == -1) {
+            // Nothing else can be done in the child.
+        }
+        _exit(127);
+        // The script produced no output: the server answers 502.
+    }
+    close(input[0]);
+    close(output[1]);
+    input_fd = input[1];
+    output_fd = output[0];
+    if (body.empty() && !streamed) {
+        closeInput();
+        // Without a body, the script reads end-of-file at once.
+    }
+    return true;
+}
+
+void CGI::appendRecord(std::string& out, unsigned char type, const char* content, size_t length) {
+    size_t position = 0;
+    do {
+        size_t size = length - position < 65535 ? length - position : 65535;
+        unsigned char header[8] = {1, type, 0, FCGI_REQUEST_ID, static_cast<unsigned char>(size >> 8),
+            static_cast<unsigned char>(size & 0xff), 0, 0};
+        out.append(reinterpret_cast<char*>(header), sizeof(header));
+        out.append(content + position, size);
+        position += size;
+    } while (position < length);
+    // An empty content gives one empty record, which ends the FCGI_PARAMS and FCGI_STDIN streams.
+}
+
+static void appendLength(std::string& out, size_t length) {
+    if (length < 128) {
+        out += static_cast<char>(length);
+        return;
+    }
+    out += static_cast<char>((length >> 24) | 0x80);
+    out += static_cast<char>(length >> 16);
+    out += static_cast<char>(length >> 8);
+    out += static_cast<char>(length);
+    // Lengths of 128 bytes or more take four bytes, with the high bit set.
+}
+
+bool CGI::startFastCGI(const Request& request, const Params& params, FastCGIPool& fastcgi_pool,
+    const Router::Location& location, bool streamed_body, size_t max_body_size) {
+    int fd = fastcgi_pool.acquire(location, backend);
+    if (fd == -1) {
+        return false;
+    }
+    setup(request, params);
+    setupInput(request, streamed_body, max_body_size);
+    pool = &fastcgi_pool;
+    input_fd = fd;
+    output_fd = fd;
+    std::string content(8, '\0');
+    content[1] = FCGI_RESPONDER;
+    content[2] = FCGI_KEEP_CONN;
+    appendRecord(body, FCGI_BEGIN_REQUEST, content.data(), content.size());
+    // FCGI_KEEP_CONN asks the responder to leave the connection open for the next request.
+    std::vector<std::string> env = buildEnvironment(request, params);
+    content.clear();
+    for (size_t i = 0; i < env.size(); ++i) {
+        size_t equals = env[i].find('=');
+        appendLength(content, equals);
+        appendLength(content, env[i].size() - equals - 1);
+        content.append(env[i], 0, equals).append(env[i], equals + 1, std::string::npos);
+    }
+    appendRecord(body, FCGI_PARAMS, content.data(), content.size());
+    if (!content.empty()) {
+        appendRecord(body, FCGI_PARAMS, "", 0);
+    }
+    if (streamed) {
+        return true;
+        // feedInput() adds the FCGI_STDIN records as the body arrives.
+    }
+    Request::View input = request.getBodyView();
+    if (input.length != 0) {
+        appendRecord(body, FCGI_STDIN, input.data, input.length);
+    }
+    appendRecord(body, FCGI_STDIN, "", 0);
+    return true;
+    // The request is sent by writeInput() once the connection is writable.
+}
+
+static bool isHopByHop(const char* name, size_t length) {
+    static const char* const names[] = {"Connection", "Keep-Alive", "Proxy-Connection", "TE", "Trailer",
+        "Transfer-Encoding", "Upgrade", "Expect", "Content-Length", "X-Real-IP", "X-Forwarded-Proto", NULL};
+    for (size_t i = 0; names[i] != NULL; ++i) {
+        if (std::strlen(names[i]) == length && strncasecmp(names[i], name, length) == 0) {
+            return true;
+        }
+    }
+    return false;
+    // Headers about this connection only (RFC 9110, section 7.6.1), and the ones the server sets itself.
+}
+
+std::string CGI::buildProxyHead(const Request& request, const Params& params, const Router::Upstream& upstream,
+    bool streamed) {
+    std::string head = request.getMethod() + " " + request.getUri() + " HTTP/1.1\r\n";
+    std::string forwarded_for = params.remote_addr;
+    bool has_host = false;
+    for (size_t i = 0; i < request.getHeaderCount(); ++i) {
+        Request::View name = request.getHeaderName(i);
+        Request::View value = request.getHeaderValue(i);
+        if (isHopByHop(name.data, name.length) || request.hasHeaderToken("Connection", name.data, name.length)) {
+            continue;
+            // The headers named in the Connection header of the client are hop-by-hop too.
+        }
+        if (name.length == 15 && strncasecmp(name.data, "X-Forwarded-For", 15) == 0) {
+            forwarded_for = std::string(value.data, value.length) + ", " + params.remote_addr;
+            continue;
+            // Each proxy appends the address of its client.
+        }
+        has_host = has_host || (name.length == 4 && strncasecmp(name.data, "Host", 4) == 0);
+        head.append(name.data, name.length).append(": ").append(value.data, value.length).append("\r\n");
+    }
+    if (!has_host) {
+        head += "Host: " + upstream.name + "\r\n";
+        // HTTP/1.1 requires a Host; an HTTP/1.0 client may not have sent one.
+    }
+    head += "X-Real-IP: " + params.remote_addr + "\r\n";
+    head += "X-Forwarded-For: " + forwarded_for + "\r\n";
+    head += "X-Forwarded-Proto: http\r\n";
+    if (streamed && request.isChunked()) {
+        head += "Transfer-Encoding: chunked\r\n";
+    } else if (streamed || !request.getHeader("Content-Length").empty()) {
+        head += "Content-Length: " + toString(request.getContentLength()) + "\r\n";
+    }
+    head += "Connection: keep-alive\r\n\r\n";
+    // The connection to the upstream server is kept open for the next request, whatever the client asked.
+    return head;
+}
+
+bool CGI::startProxy(const Request& request, const Params& params, UpstreamPool& upstream_pool,
+    const Router::Upstream& group, size_t group_index, bool streamed_body, size_t max_body_size) {
+    key = group.hash_client ? params.remote_addr : request.getUri();
+    int fd = upstream_pool.acquire(group_index, group, key, peer, reused);
+    if (fd == -1) {
+        return false;
+    }
+    setup(request, params);
+    proxy = &upstream_pool;
+    upstream = &group;
+    upstream_group = group_index;
+    idempotent = request.getMethod() != "POST";
+    tries = 1;
+    input_fd = fd;
+    output_fd = fd;
+    body = buildProxyHead(request, params, group, streamed_body);
+    setupInput(request, streamed_body, max_body_size);
+    return true;
+    // The request is sent by writeInput() once the connection is writable.
+}
+
+CGI::Status CGI::feedInput(const char* data, size_t length, size_t& consumed) {
+    consumed = 0;
+    if (body_sent > 0) {
+        body.erase(0, body_sent);
+        body_sent = 0;
+    }
+    while (!input_done && body.size() < CGI_INPUT_BUFFER) {
+        size_t room = CGI_INPUT_BUFFER - body.size();
+        size_t used;
+        const char* chunk;
+        size_t chunk_length;
+        BodyDecoder::Status status = input_decoder.decode(data + consumed,
+            length - consumed < room ? length - consumed : room, used, chunk, chunk_length);
+        if (proxy != NULL) {
+            body.append(data + consumed, used);
+            // The body is forwarded as the client sent it, chunked or not.
+        } else if (pool != NULL && chunk_length != 0) {
+            appendRecord(body, FCGI_STDIN, chunk, chunk_length);
+        } else if (pool == NULL) {
+            body.append(chunk, chunk_length);
+        }
+        consumed += used;
+        if (status == BodyDecoder::BODY_ERROR) {
+            input_error = input_decoder.getErrorStatus();
+            return CGI_ERROR;
+        }
+        if (status == BodyDecoder::BODY_DONE) {
+            input_done = true;
+            if (pool != NULL) {
+                appendRecord(body, FCGI_STDIN, "", 0);
+                // The empty record ends the FCGI_STDIN stream.
+            }
+        } else if (status == BodyDecoder::BODY_AGAIN) {
+            break;
+        }
+    }
+    return input_done ? CGI_DONE : CGI_AGAIN;
+}
+
+CGI::Status CGI::writeInput() {
+    while (body_sent < body.size()) {
+        ssize_t bytes = write(input_fd, body.data() + body_sent, body.size() - body_sent);
+        if (bytes > 0) {
+            body_sent += bytes;
+            if (proxy != NULL || streamed) {
+                input_sent = true;
+                last_output = std::time(NULL);
+                // A script or an upstream server that reads a long body slowly is not timed out
+                // while it reads.
+            }
+            continue;
+        }
+        if (bytes == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return CGI_AGAIN;
+            // The pipe is full: the rest is written when the script reads.
+        }
+        if (pool != NULL) {
+            pool->reportFailure(backend);
+            return CGI_ERROR;
+            // The connection to the responder failed (e.g., the connect() was refused).
+        }
+        if (proxy != NULL) {
+            return failUpstream();
+        }
+        break;
+        // EPIPE: the script exited or closed its standard input without reading the body.
+        // Its output is still read.
+    }
+    if (!input_done) {
+        body.clear();
+        body_sent = 0;
+        return CGI_AGAIN;
+        // Everything taken from the client was sent: the rest of the body comes with feedInput().
+    }
+    if (proxy == NULL || streamed) {
+        std::string().swap(body);
+        // The body is not needed anymore: its memory is released while the script runs. The
+        // head of a proxied request is kept, to send it again if the connection fails.
+    }
+    return CGI_DONE;
+}
+
+CGI::Status CGI::readOutput(OutputQueue& output, size_t limit) {
+    char buffer[16384];
+    while (output.size() < limit) {
+        ssize_t bytes = read(output_fd, buffer, sizeof(buffer));
+        if (bytes > 0) {
+            last_output = std::time(NULL);
+            Status status;
+            if (proxy != NULL) {
+                records.append(buffer, bytes);
+                status = parseUpstream(output);
+            } else if (pool != NULL) {
+                records.append(buffer, bytes);
+                status = parseRecords(output);
+            } else {
+                status = parseOutput(output, buffer, bytes);
+            }
+            if (status != CGI_AGAIN) {
+                return status;
+            }
+            continue;
+        }
+        if (bytes == 0 && proxy != NULL && started && content_length < 0 && !upstream_chunked) {
+            proxy->reportSuccess(peer);
+            return endOutput(output);
+            // A response without Content-Length and not chunked ends when the server closes.
+        }
+        if (bytes == 0 && pool == NULL && proxy == NULL) {
+            return endOutput(output);
+            // The script exited, closing its standard output.
+        }
+        if (bytes == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return CGI_AGAIN;
+        }
+        if (pool != NULL) {
+            pool->reportFailure(backend);
+            // The responder closed the connection before the end of the request.
+        }
+        if (proxy != NULL) {
+            return failUpstream();
+            // The upstream server closed the connection before the end of its response.
+        }
+        return CGI_ERROR;
+    }
+    return CGI_AGAIN;
+    // The client is slower than the script: reading resumes when the output queue drains.
+}
+
+CGI::Status CGI::parseOutput(OutputQueue& output, const char* data, size_t length) {
+    if (started) {
+        appendBody(output, data, length);
+        return CGI_AGAIN;
+    }
+    head.append(data, length);
+    return parseHead(output) ? CGI_AGAIN : CGI_ERROR;
+}
+
+CGI::Status CGI::endOutput(OutputQueue& output) {
+    if (!started) {
+        return CGI_ERROR;
+        // The script exited before the end of its headers.
+    }
+    if (chunked && !head_only) {
+        output.append("0\r\n\r\n", 5);
+        // Last chunk: the client knows the response is complete.
+    }
+    return CGI_DONE;
+}
+
+CGI::Status CGI::parseRecords(OutputQueue& output) {
+    size_t position = 0;
+    Status status = CGI_AGAIN;
+    while (status == CGI_AGAIN && records.size() - position >= 8) {
+        const unsigned char* header = reinterpret_cast<const unsigned char*>(records.data() + position);
+        size_t length = header[4] << 8 | header[5];
+        size_t size = 8 + length + header[6];
+        // Header, content and padding.
+        if (records.size() - position < size) {
+            break;
+            // The rest of the record has not arrived yet.
+        }
+        const char* content = records.data() + position + 8;
+        position += size;
+        if (header[0] != 1) {
+            status = CGI_ERROR;
+        } else if (header[1] == FCGI_STDOUT) {
+            status = parseOutput(output, content, length);
+        } else if (header[1] == FCGI_STDERR && length > 0) {
+            std::cerr << "FastCGI: " << std::string(content, length - (content[length - 1] == '\n'))
+                << std::endl;
+            // Errors and warnings of the script go to the error log, not to the client.
+        } else if (header[1] == FCGI_END_REQUEST) {
+            if (length >= 5 && content[4] != FCGI_REQUEST_COMPLETE) {
+                return CGI_ERROR;
+                // The responder rejected the request (overloaded, or the role is not supported).
+            }
+            pool->reportSuccess(backend);
+            ended = position == records.size();
+            status = endOutput(output);
+        }
+        // Other records (e.g., FCGI_GET_VALUES_RESULT) are not expected and are skipped.
+    }
+    records.erase(0, position);
+    return status;
+}
+
+CGI::Status CGI::parseUpstream(OutputQueue& output) {
+    while (!started) {
+        size_t end = records.find("\r\n\r\n");
+        if (end == std::string::npos) {
+            return records.size() <= CGI_MAX_HEAD ? CGI_AGAIN : failUpstream();
+        }
+        int result = parseUpstreamHead(output, end);
+        if (result == -1) {
+            return failUpstream();
+        }
+        records.erase(0, end + 4);
+        // An interim response (100 Continue) is dropped, and the final one follows it.
+    }
+    if (upstream_chunked) {
+        size_t position = 0;
+        while (true) {
+            size_t used;
+            const char* chunk;
+            size_t chunk_length;
+            BodyDecoder::Status status = output_decoder.decode(records.data() + position, records.size() - position,
+                used, chunk, chunk_length);
+            position += used;
+            if (status == BodyDecoder::BODY_DATA) {
+                appendBody(output, chunk, chunk_length);
+                continue;
+                // Each chunk of the server is queued as it is decoded, re-chunked for the client.
+            }
+            if (status == BodyDecoder::BODY_ERROR) {
+                return failUpstream();
+            }
+            if (status == BodyDecoder::BODY_DONE) {
+                return finishUpstream(output, position == records.size());
+            }
+            break;
+        }
+        records.erase(0, position);
+        // An incomplete chunk-size line waits for the next read.
+        return CGI_AGAIN;
+    }
+    long before = body_length;
+    appendBody(output, records.data(), records.size());
+    bool clean = static_cast<size_t>(body_length - before) == records.size();
+    records.clear();
+    if (content_length >= 0 && body_length >= content_length) {
+        return finishUpstream(output, clean);
+    }
+    return CGI_AGAIN;
+}
+
+int CGI::parseUpstreamHead(OutputQueue& output, size_t end) {
+    size_t line_end = records.find('\n');
+    std::string line = records.substr(0, line_end);
+    if (!line.empty() && line[line.size() - 1] == '\r') {
+        line.erase(line.size() - 1);
+    }
+    if (line.size() < 12 || line.compare(0, 7, "HTTP/1.") != 0 || line[8] != ' ' || (line.size() > 12 && line[12] != ' ')) {
+        return -1;
+        // "HTTP/1.1 200 OK"; the reason phrase may be empty.
+    }
+    char* code_end;
+    long status = std::strtol(line.c_str() + 9, &code_end, 10);
+    if (code_end != line.c_str() + 12 || status < 100 || status > 999) {
+        return -1;
+    }
+    if (status < 200) {
+        return 0;
+        // Expect and Upgrade are not forwarded, so interim responses are not for the client.
+    }
+    std::string reason = line.size() > 13 ? line.substr(13) : Response::getStatusMessage(status);
+    bool close = line[7] == '0';
+    // An HTTP/1.0 server closes after its response, unless it says keep-alive.
+    std::string fields;
+    size_t position = line_end + 1;
+    while (position < end + 2) {
+        line_end = records.find('\n', position);
+        line = records.substr(position, line_end - position);
+        position = line_end + 1;
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+        size_t colon = line.find(':');
+        if (colon == std::string::npos || colon == 0) {
+            return -1;
+        }
+        std::string name = line.substr(0, colon);
+        size_t value_start = line.find_first_not_of(" \t", colon + 1);
+        std::string value = value_start != std::string::npos ? line.substr(value_start) : "";
+        if (strcasecmp(name.c_str(), "Connection") == 0) {
+            close = strcasecmp(value.c_str(), "close") == 0 || (close && strcasecmp(value.c_str(), "keep-alive") != 0);
+            continue;
+        }
+        if (strcasecmp(name.c_str(), "Transfer-Encoding") == 0) {
+            if (strcasecmp(value.c_str(), "chunked") != 0) {
+                return -1;
+            }
+            upstream_chunked = true;
+            continue;
+        }
+        if (strcasecmp(name.c_str(), "Keep-Alive") == 0 || strcasecmp(name.c_str(), "Server") == 0
+            || strcasecmp(name.c_str(), "Date") == 0 || strcasecmp(name.c_str(), "Trailer") == 0
+            || strcasecmp(name.c_str(), "Upgrade") == 0 || strcasecmp(name.c_str(), "Proxy-Connection") == 0) {
+            continue;
+            // Hop-by-hop headers are decided by this server, which also sends its own Server and Date.
+        }
+        if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+            char* length_end;
+            content_length = std::strtol(value.c_str(), &length_end, 10);
+            if (length_end == value.c_str() || *length_end != '\0' || content_length < 0) {
+                return -1;
+            }
+        }
+        fields += name + ": " + value + "\r\n";
+    }
+    if (upstream_chunked && content_length >= 0) {
+        return -1;
+        // A response with both could be read two ways (response smuggling).
+    }
+    upstream_keep_alive = !close;
+    if (head_only || status == 204 || status == 304) {
+        head_only = true;
+        content_length = 0;
+        upstream_chunked = false;
+        // These responses never have a body, whatever their headers say.
+    } else if (content_length < 0 && !http10) {
+        chunked = true;
+        // A chunked body is decoded and sent again in chunks; a body that ends when the
+        // server closes is sent in chunks too, so the client connection stays open.
+    }
+    if (upstream_chunked) {
+        output_decoder.reset(true, 0, 0);
+    }
+    bool persistent = keep_alive && (chunked || content_length >= 0);
+    std::string response = "HTTP/1.1 " + toString(status) + " " + reason + "\r\n";
+    response += std::string("Server: ") + HotHeaders::getServer() + "\r\n";
+    response += std::string("Date: ") + date + "\r\n";
+    response += fields;
+    response += persistent ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    if (chunked) {
+        response += "Transfer-Encoding: chunked\r\n";
+    }
+    response += "\r\n";
+    output.append(response);
+    keep_alive = persistent;
+    started = true;
+    status_code = status;
+    return 1;
+}
+
+CGI::Status CGI::finishUpstream(OutputQueue& output, bool clean) {
+    ended = upstream_keep_alive && clean && input_fd == -1 && input_done;
+    // The connection is reused only if the server read the whole request and sent nothing more.
+    proxy->reportSuccess(peer);
+    records.clear();
+    return endOutput(output);
+}
+
+CGI::Status CGI::failUpstream() {
+    if (!reused || started || !records.empty()) {
+        proxy->reportFailure(peer);
+    }
+    return CGI_ERROR;
+}
+
+bool CGI::parseHead(OutputQueue& output) {
+    size_t end = head.find("\n\n");
+    size_t crlf = head.find("\r\n\r\n");
+    size_t body_start;
+    if (crlf != std::string::npos && (end == std::string::npos || crlf < end)) {
+        end = crlf;
+        body_start = crlf + 4;
+    } else if (end != std::string::npos) {
+        body_start = end + 2;
+    } else {
+        return head.size() <= CGI_MAX_HEAD;
+        // The headers are not complete yet.
+    }
+    // Scripts end their header lines with LF or CRLF (RFC 3875, section 6.3).
+    int status = 200;
+    std::string reason;
+    bool has_status = false;
+    bool has_location = false;
+    std::string fields;
+    size_t position = 0;
+    while (position < end) {
+        size_t line_end = head.find('\n', position);
+        if (line_end == std::string::npos || line_end > end) {
+            line_end = end;
+        }
+        std::string line = head.substr(position, line_end - position);
+        position = line_end + 1;
+        if (!line.empty() && line[line.size() - 1] == '\r') {
+            line.erase(line.size() - 1);
+        }
+        size_t colon = line.find(':');
+        if (colon == std::string::npos || colon == 0) {
+            return false;
+        }
+        std::string name = line.substr(0, colon);
+        size_t value_start = line.find_first_not_of(" \t", colon + 1);
+        std::string value = value_start != std::string::npos ? line.substr(value_start) : "";
+        if (strcasecmp(name.c_str(), "Status") == 0) {
+            char* code_end;
+            status = std::strtol(value.c_str(), &code_end, 10);
+            if (code_end != value.c_str() + 3 || status < 100 || status > 999) {
+                return false;
+            }
+            reason = value.substr(value.find_first_not_of(' ', 3) != std::string::npos ? value.find_first_not_of(' ', 3) : value.size());
+            has_status = true;
+            continue;
+        }
+        if (strcasecmp(name.c_str(), "Connection") == 0 || strcasecmp(name.c_str(), "Transfer-Encoding") == 0) {
+            continue;
+            // Hop-by-hop headers are decided by the server, not by the script.
+        }
+        if (strcasecmp(name.c_str(), "Content-Length") == 0) {
+            content_length = std::strtol(value.c_str(), NULL, 10);
+        }
+        if (strcasecmp(name.c_str(), "Location") == 0) {
+            has_location = true;
+        }
+        fields += name + ": " + value + "\r\n";
+    }
+    if (!has_status && has_location) {
+        status = 302;
+        reason = "Found";
+        // A script that only sends a Location asks for a redirection (RFC 3875, section 6.2.3).
+    }
+    if (reason.empty()) {
+        reason = Response::getStatusMessage(status);
+    }
+    if (status < 200 || status == 204 || status == 304) {
+        head_only = true;
+        content_length = 0;
+        // These responses never have a body.
+    } else if (content_length < 0 && !http10) {
+        chunked = true;
+        // The length of the body is not known: each read of the script is sent as a chunk.
+    }
+    bool persistent = keep_alive && (chunked || content_length >= 0);
+    // Without a length, an HTTP/1.0 client only knows the body ended when the connection closes.
+    std::string response = "HTTP/1.1 " + toString(status) + " " + reason + "\r\n";
+    response += std::string("Server: ") + HotHeaders::getServer() + "\r\n";
+    response += std::string("Date: ") + date + "\r\n";
+    response += fields;
+    response += persistent ? "Connection: keep-alive\r\n" : "Connection: close\r\n";
+    if (chunked) {
+        response += "Transfer-Encoding: chunked\r\n";
+    }
+    response += "\r\n";
+    output.append(response);
+    keep_alive = persistent;
+    started = true;
+    status_code = status;
+    if (body_start < head.size()) {
+        appendBody(output, head.data() + body_start, head.size() - body_start);
+        // Bytes of body read together with the headers.
+    }
+    std::string().swap(head);
+    return true;
+}
+
+void CGI::appendBody(OutputQueue& output, const char* data, size_t length) {
+    if (content_length >= 0 && body_length + static_cast<long>(length) > content_length) {
+        length = content_length - body_length;
+        // Bytes beyond the Content-Length of the script would be read as the next response.
+    }
+    body_length += length;
+    if (head_only || length == 0) {
+        return;
+    }
+    if (chunked) {
+        char size[24];
+        int size_length = std::snprintf(size, sizeof(size), "%lx\r\n", static_cast<unsigned long>(length));
+        output.append(size, size_length);
+        output.append(data, length);
+        output.append("\r\n", 2);
+        return;
+    }
+    output.append(data, length);
+}
+
+void CGI::closeInput() {
+    if (input_fd != -1 && input_fd != output_fd) {
+        close(input_fd);
+    }
+    input_fd = -1;
+}
+
+void CGI::closeOutput() {
+    if (output_fd != -1 && proxy != NULL) {
+        proxy->release(peer, output_fd, ended);
+        input_fd = -1;
+    } else if (output_fd != -1 && pool != NULL) {
+        pool->release(backend, output_fd, ended);
+        input_fd = -1;
+        // Only a connection whose request ended cleanly can carry the next one.
+    } else if (output_fd != -1) {
+        close(output_fd);
+    }
+    output_fd = -1;
+}
+
+void CGI::kill() {
+    ended = false;
+    if (pid > 0) {
+        ::kill(pid, SIGKILL);
+        // The process is not reaped yet, so its pid cannot belong to another process.
+    }
+}
+
+pid_t CGI::detach() {
+    pid_t process = pid;
+    pid = -1;
+    return process;
+}
+
+int CGI::getInputFd() const {
+    return input_fd;
+}
+
+int CGI::getOutputFd() const {
+    return output_fd;
+}
+
+bool CGI::hasStarted() const {
+    return started;
+}
+
+int CGI::getStatus() const {
+    return status_code;
+}
+
+bool CGI::keepsAlive() const {
+    if (!keep_alive) {
+        return false;
+    }
+    return chunked || head_only || body_length == content_length;
+    // A script that sent less than its Content-Length leaves the client waiting: the connection is closed.
+}
+
+time_t CGI::getLastOutput() const {
+    return last_output;
+}
+
+bool CGI::acceptsInput() const {
+    return !input_done;
+}
+
+bool CGI::isWaitingForInput() const {
+    return !input_done && body_sent == body.size();
+}
+
+int CGI::getInputError() const {
+    return input_error;
+}
+
+bool CGI::canRetry() const {
+    return proxy != NULL && !started && records.empty() && output_fd != -1 && tries < upstream->servers.size()
+        && (!input_sent || (!streamed && (idempotent || input_fd != -1)));
+}
+
+bool CGI::retry() {
+    proxy->release(peer, output_fd, false);
+    input_fd = -1;
+    output_fd = -1;
+    ++tries;
+    int fd = proxy->acquire(upstream_group, *upstream, key, peer, reused);
+    if (fd == -1) {
+        return false;
+    }
+    input_fd = fd;
+    output_fd = fd;
+    body_sent = 0;
+    input_sent = false;
+    last_output = std::time(NULL);
+    return true;
+}
+
+void CGI::reportTimeout() {
+    if (proxy != NULL && output_fd != -1) {
+        proxy->reportFailure(peer);
+    } else if (pool != NULL && output_fd != -1) {
+        pool->reportFailure(backend);
+    }
+}
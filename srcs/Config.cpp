@@ -1,6 +1,9 @@
 #include "Config.hpp"
+#include <cstdlib>	// For std::strtol and std::strtoul
+#include <cctype>	// For std::tolower and std::isspace
+#include <sstream>	// For std::ostringstream to read the whole file and build error messages
 
-Config::Config(const std::string& filename) {
+Config::Config(const std::string& filename) : path(filename) {
     parse(filename);
 	// Constructor call to parse with the name of the faile.
 }
@@ -12,8 +15,47 @@ void Config::parse(const std::string& filename) {
         throw std::runtime_error("Cannot open config file: " + filename);
 		// If the file cannot be opened, throw an error.
     }
+    std::ostringstream content;
+    content << file.rdbuf();
+    std::string text = content.str();
+    std::vector<std::string> tokens;
+    std::vector<int> lines;
+    int line_number = 1;
+    for (size_t i = 0; i < text.size(); ) {
+		// Split the file into words and the symbols { } ; to detect the block format
+        char c = text[i];
+        if (c == '\n') {
+            ++line_number;
+        }
+        if (std::isspace(static_cast<unsigned char>(c))) {
+            ++i;
+        } else if (c == '#') {
+            while (i < text.size() && text[i] != '\n') {
+                ++i;
+            }
+        } else if (c == '{' || c == '}' || c == ';') {
+            tokens.push_back(std::string(1, c));
+            lines.push_back(line_number);
+            ++i;
+        } else {
+            size_t start = i;
+            while (i < text.size() && !std::isspace(static_cast<unsigned char>(text[i]))
+                && text[i] != '{' && text[i] != '}' && text[i] != ';' && text[i] != '#') {
+                ++i;
+            }
+            tokens.push_back(text.substr(start, i - start));
+            lines.push_back(line_number);
+        }
+    }
+    if (std::find(tokens.begin(), tokens.end(), ";") != tokens.end()
+        || std::find(tokens.begin(), tokens.end(), "{") != tokens.end()) {
+        parseBlocks(tokens, lines);
+        return;
+		// A file with ; or { uses the block format.
+    }
+    std::istringstream stream(text);
     std::string line;
-    while (std::getline(file, line)) {
+    while (std::getline(stream, line)) {
         // Remove whitespace and skip empty lines or comments
         line.erase(std::remove_if(line.begin(), line.end(), ::isspace), line.end());
         if (line.empty() || line[0] == '#') {
@@ -31,8 +73,96 @@ void Config::parse(const std::string& filename) {
             settings[key] = value;
         }
     }
-    file.close();
-	// Close the file after reading all lines
+}
+
+void Config::parseBlocks(const std::vector<std::string>& tokens, const std::vector<int>& lines) {
+    std::vector<std::string> words;
+	// Words of the directive being read.
+    int depth = 0;
+	// 0 outside the blocks, 1 inside a server or upstream block, 2 inside a location block.
+    bool in_upstream = false;
+	// True inside an upstream block.
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        const std::string& token = tokens[i];
+        std::ostringstream where;
+        where << " at line " << lines[i];
+        if (token == ";") {
+            if (words.empty()) {
+                throw std::runtime_error("Empty directive in config file" + where.str());
+            }
+            if (depth == 0) {
+                addDirective(settings, words);
+            } else if (in_upstream) {
+                addDirective(upstreams.back().settings, words);
+            } else if (depth == 1) {
+                addDirective(servers.back().settings, words);
+            } else {
+                addDirective(servers.back().locations.back().settings, words);
+            }
+            words.clear();
+        } else if (token == "{") {
+            if (depth == 0 && words.size() == 1 && words[0] == "server") {
+                servers.push_back(ServerBlock());
+            } else if (depth == 0 && words.size() == 2 && words[0] == "upstream") {
+                UpstreamBlock upstream;
+                upstream.name = words[1];
+                upstreams.push_back(upstream);
+                in_upstream = true;
+            } else if (depth == 1 && !in_upstream && words.size() == 2 && words[0] == "location") {
+                LocationBlock location;
+                location.prefix = words[1];
+                servers.back().locations.push_back(location);
+            } else {
+                throw std::runtime_error("Unexpected block in config file" + where.str());
+				// Only "server {" and "upstream name {" at the top and "location /prefix {" inside a
+				// server are blocks.
+            }
+            ++depth;
+            words.clear();
+        } else if (token == "}") {
+            if (depth == 0 || !words.empty()) {
+                throw std::runtime_error("Unexpected } in config file" + where.str());
+            }
+            --depth;
+            in_upstream = false;
+        } else {
+            words.push_back(token);
+        }
+    }
+    if (depth != 0 || !words.empty()) {
+        throw std::runtime_error("Unexpected end of config file (missing ; or })");
+    }
+}
+
+void Config::addDirective(std::map<std::string, std::string>& target, const std::vector<std::string>& words) {
+    if (words[0] == "error_page" && words.size() >= 3) {
+        for (size_t i = 1; i + 1 < words.size(); ++i) {
+            target["error_page_" + words[i]] = words.back();
+        }
+        return;
+    }
+    std::string value;
+    for (size_t i = 1; i < words.size(); ++i) {
+        value += (i > 1 ? " " : "") + words[i];
+    }
+    std::map<std::string, std::string>::iterator it = target.find(words[0]);
+    if (it != target.end()) {
+        it->second += " " + value;
+    } else {
+        target[words[0]] = value;
+    }
+}
+
+const std::vector<Config::ServerBlock>& Config::getServers() const {
+    return servers;
+}
+
+const std::vector<Config::UpstreamBlock>& Config::getUpstreams() const {
+    return upstreams;
+}
+
+const std::string& Config::getPath() const {
+    return path;
 }
 
 std::string Config::get(const std::string& key) const {
@@ -45,4 +175,51 @@ std::string Config::get(const std::string& key) const {
     }
     return "";
 	// If the key is not found, return an empty string
-}
\ No newline at end of file
+}
+
+long Config::getInt(const std::string& key, long default_value) const {
+	// Recover the value associated with the given key as a number
+    return toInt(get(key), default_value);
+}
+
+size_t Config::getSize(const std::string& key, size_t default_value) const {
+	// Recover the value associated with the given key as a size in bytes
+    return toSize(get(key), default_value);
+}
+
+long Config::toInt(const std::string& value, long default_value) {
+    if (value.empty()) {
+        return default_value;
+		// If the key is not found, use the default value
+    }
+    char* end;
+    long number = std::strtol(value.c_str(), &end, 10);
+    if (*end != '\0') {
+        return default_value;
+		// If the value is not a number, use the default value
+    }
+    return number;
+}
+
+size_t Config::toSize(const std::string& value, size_t default_value) {
+    if (value.empty() || value[0] < '0' || value[0] > '9') {
+        return default_value;
+		// If the key is not found or does not start with a digit, use the default value
+    }
+    char* end;
+    size_t size = std::strtoul(value.c_str(), &end, 10);
+    const std::string units = "kmg";
+	// Each unit is 1024 times the previous one
+    size_t unit = *end != '\0' ? units.find(std::tolower(*end)) : std::string::npos;
+    if (unit != std::string::npos) {
+        for (size_t i = 0; i <= unit; ++i) {
+            size *= 1024;
+        }
+        ++end;
+    }
+    if (*end != '\0') {
+        return default_value;
+		// If there is anything after the unit, use the default value
+    }
+    return size;
+}
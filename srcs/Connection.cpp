@@ -0,0 +1,120 @@
+#include "Connection.hpp"  // Include the header file for the Connection class
+#include "Generation.hpp"  // Include the Generation class to hold a reference to it
+#include "CGI.hpp"         // Include the CGI class to delete the script of the connection
+#include "Upload.hpp"      // Include the Upload class to delete the upload of the connection
+#include <cstring>         // For std::memset
+#include <new>              // For operator new and operator delete
+
+struct FreeConnection {
+    FreeConnection* next;
+};
+// A free slot of a slab: its first bytes link it to the next free one.
+
+static FreeConnection* free_connections = NULL;
+// Free list of the slots of the slabs. Each worker is a single thread, so it needs no lock.
+
+Connection::Connection(int client_fd, size_t listener_index, Generation* current)
+    : fd(client_fd), listener(listener_index), generation(current), interest(0), input_start(0), close_after_output(false), head(false), requests_served(0), max_requests(0), last_activity(std::time(NULL)), cgi(NULL), cgi_timeout(0), upload(NULL), log_pending(false), log_started(0), log_queued(0) {
+    request_started = last_activity;
+    std::memset(&peer, 0, sizeof(peer));
+    std::memset(&log_record, 0, sizeof(log_record));
+    TimerWheel::init(timer, fd);
+    generation->acquire();
+}
+// Constructor stores the client socket and marks the connection as active now.
+
+Connection::~Connection() {
+    delete cgi;
+    // The Server normally stops the script first; otherwise the CGI destructor kills it.
+    delete upload;
+    // An upload that did not complete removes its temporary file.
+    generation->release();
+    // The last connection of an old generation deletes it.
+}
+
+void* Connection::operator new(size_t size) {
+    if (free_connections == NULL) {
+        char* slab = static_cast<char*>(::operator new(size * CONNECTION_SLAB));
+        for (size_t i = 0; i < CONNECTION_SLAB; ++i) {
+            FreeConnection* slot = reinterpret_cast<FreeConnection*>(slab + i * size);
+            slot->next = free_connections;
+            free_connections = slot;
+        }
+    }
+    FreeConnection* slot = free_connections;
+    free_connections = slot->next;
+    return slot;
+}
+
+void Connection::operator delete(void* memory) {
+    if (memory == NULL) {
+        return;
+    }
+    FreeConnection* slot = static_cast<FreeConnection*>(memory);
+    slot->next = free_connections;
+    free_connections = slot;
+}
+
+Request::ParseStatus Connection::parseRequest() {
+    Request::ParseStatus status = request.parse(input.data() + input_start, input.size() - input_start);
+    // The parser receives the bytes from the start of the current request.
+    if (status == Request::PARSE_INCOMPLETE) {
+        size_t released = request.releaseDecoded();
+        if (released != 0) {
+            input.erase(input_start + request.getLength(), released);
+            // A chunked body is kept decoded by the Request, so only its undecoded tail stays
+            // in the buffer, which is then bounded by the headers and one chunk line.
+        }
+    }
+    return status;
+}
+
+void Connection::consumeRequest() {
+    input_start += request.getLength();
+    request.reset();
+    arena.reset();
+    // The next pipelined request, if any, starts right after the current one.
+}
+
+void Connection::compactInput() {
+    if (input_start == input.size()) {
+        input.clear();
+        // Everything was consumed. clear() keeps the capacity for the next read.
+    } else if (input_start != 0) {
+        input.erase(0, input_start);
+        // Keep only the bytes of the request that is still incomplete.
+    }
+    input_start = 0;
+}
+
+bool Connection::flushOutput() {
+    size_t before = output.size();
+    if (!output.flush(fd)) {
+        return false;
+    }
+    if (output.size() != before) {
+        last_activity = std::time(NULL);
+    }
+    return true;
+}
+
+bool Connection::hasPendingOutput() const {
+    return !output.empty();
+}
+
+bool Connection::wantsKeepAlive(const Request& request) const {
+    if (max_requests != 0 && requests_served + 1 >= max_requests) {
+        return false;
+        // The connection reached the maximum number of requests allowed.
+    }
+    if (request.hasHeaderToken("Connection", "close", 5)) {
+        return false;
+        // The Connection header is a list of options (e.g., "TE, close"), not a single value.
+    }
+    if (request.getVersion() == "HTTP/1.0") {
+        return request.hasHeaderToken("Connection", "keep-alive", 10);
+        // HTTP/1.0 clients must ask explicitly to keep the connection open.
+    }
+    return true;
+    // HTTP/1.1 connections are persistent by default.
+}
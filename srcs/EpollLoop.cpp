@@ -0,0 +1,88 @@
+#include "EpollLoop.hpp"	// Include the header file for the EpollLoop class
+
+#ifdef __linux__
+# include <unistd.h>		// For close
+# include <fcntl.h>			// For fcntl to set close-on-exec
+# include <cstring>			// For strerror
+# include <cerrno>			// For errno
+# include <stdexcept>		// For std::runtime_error
+
+EpollLoop::EpollLoop(bool edge) : edge_triggered(edge), buffer(1024) {
+    epoll_fd = epoll_create(1024);
+	// The size argument is ignored by current kernels but must be positive.
+    if (epoll_fd == -1) {
+        throw std::runtime_error("Failed to create epoll instance: " + std::string(strerror(errno)));
+    }
+    fcntl(epoll_fd, F_SETFD, FD_CLOEXEC);
+	// CGI scripts are started with fork() and execve(): they must not inherit the instance.
+}
+
+EpollLoop::~EpollLoop() {
+    close(epoll_fd);
+}
+
+void EpollLoop::control(int operation, int fd, int events) {
+    struct epoll_event event;
+    event.events = 0;
+    if (events & EVENT_READ) {
+        event.events |= EPOLLIN | EPOLLRDHUP;
+    }
+    if (events & EVENT_WRITE) {
+        event.events |= EPOLLOUT;
+    }
+    if (edge_triggered) {
+        event.events |= EPOLLET;
+        // In edge-triggered mode, EPOLL_CTL_MOD also re-arms the fd: if it is already
+        // ready for the new events, one event is reported again.
+    }
+    event.data.fd = fd;
+    if (epoll_ctl(epoll_fd, operation, fd, &event) == -1) {
+        throw std::runtime_error("epoll_ctl failed: " + std::string(strerror(errno)));
+    }
+}
+
+void EpollLoop::add(int fd, int events) {
+    control(EPOLL_CTL_ADD, fd, events);
+}
+
+void EpollLoop::modify(int fd, int events) {
+    control(EPOLL_CTL_MOD, fd, events);
+}
+
+void EpollLoop::remove(int fd) {
+    struct epoll_event event;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, &event);
+	// Old kernels need a non-NULL event. Errors are ignored, the fd is being closed anyway.
+}
+
+int EpollLoop::wait(std::vector<Event>& ready, int timeout_ms) {
+    ready.clear();
+    int count = epoll_wait(epoll_fd, &buffer[0], buffer.size(), timeout_ms);
+    for (int i = 0; i < count; ++i) {
+        // Only the ready descriptors are returned, so this loop is O(ready).
+        Event event;
+        event.fd = buffer[i].data.fd;
+        event.events = 0;
+        if (buffer[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP)) {
+            event.events |= EVENT_READ;
+        }
+        if (buffer[i].events & EPOLLOUT) {
+            event.events |= EVENT_WRITE;
+        }
+        if (buffer[i].events & EPOLLERR) {
+            event.events |= EVENT_ERROR;
+        }
+        ready.push_back(event);
+    }
+    return count;
+}
+
+bool EpollLoop::isEdgeTriggered() const {
+    return edge_triggered;
+}
+
+const char* EpollLoop::getName() const {
+    return edge_triggered ? "epoll (edge-triggered)" : "epoll";
+}
+
+#endif
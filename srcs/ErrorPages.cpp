@@ -0,0 +1,102 @@
+#include "ErrorPages.hpp"	// Include the header file for the ErrorPages class
+#include "Response.hpp"		// Include the Response class for the reason phrases
+#include "HotHeaders.hpp"	// Include the HotHeaders class for the Server header
+#include <fstream>			// For std::ifstream to read the error_page_* files
+#include <sstream>			// For std::ostringstream
+#include <cstring>			// For std::memcpy, std::memcmp and std::memset
+
+static const int error_codes[] = {400, 403, 404, 405, 408, 409, 413, 414, 431, 500, 501, 502, 503, 504, 505};
+// Status codes with a prebuilt response, sorted. These are the parse errors, the errors
+// of the static handler, which scanners and broken clients trigger the most, the errors
+// of the uploads (403 and 409) and the errors of the CGI scripts (502 and 504).
+
+ErrorPages::ErrorPages(const Config& config, const MimeTypes& types, const char* current_date) : date(current_date) {
+    std::string root = config.get("root").empty() ? "./www" : config.get("root");
+	// Error pages are global settings: they are found under the global root.
+    for (size_t i = 0; i < sizeof(error_codes) / sizeof(error_codes[0]); ++i) {
+        Page page;
+        page.code = error_codes[i];
+        std::ostringstream key;
+        key << "error_page_" << page.code;
+        std::string path = config.get(key.str());
+        std::string body;
+        std::string content_type = "text/html";
+        std::ifstream file(std::string(root + path).c_str(), std::ios::in | std::ios::binary);
+        if (!path.empty() && file.is_open()) {
+            std::ostringstream content;
+            content << file.rdbuf();
+            body = content.str();
+            content_type = types.find(path);
+            // The configured page is read once; it is not revalidated like the file cache.
+        } else {
+            std::ostringstream content;
+            content << "<h1>" << page.code << " " << Response::getStatusMessage(page.code) << "</h1>";
+            body = content.str();
+        }
+        for (int keep_alive = 0; keep_alive < 2; ++keep_alive) {
+            std::ostringstream head;
+            head << "HTTP/1.1 " << page.code << " " << Response::getStatusMessage(page.code) << "\r\n"
+                << "Server: " << HotHeaders::getServer() << "\r\n"
+                << "Date: ";
+            page.date_offset[keep_alive] = head.str().size();
+            head << std::string(HTTP_DATE_LENGTH, ' ') << "\r\n"
+                << "Content-Type: " << content_type << "\r\n"
+                << "Content-Length: " << body.size() << "\r\n"
+                << "Connection: " << (keep_alive ? "keep-alive" : "close") << "\r\n"
+                << "\r\n";
+            page.head_length[keep_alive] = head.str().size();
+            head << body;
+            page.response[keep_alive] = head.str();
+        }
+        pages.push_back(page);
+    }
+    std::memset(written_date, ' ', HTTP_DATE_LENGTH);
+    updateDate();
+}
+
+const ErrorPages::Page* ErrorPages::find(int code) const {
+    for (size_t i = 0; i < pages.size(); ++i) {
+        if (pages[i].code == code) {
+            return &pages[i];
+        }
+    }
+    return NULL;
+}
+
+bool ErrorPages::has(int code) const {
+    return find(code) != NULL;
+}
+
+void ErrorPages::enqueue(int code, bool keep_alive, bool head, OutputQueue& output) {
+    const std::string& response = get(code, keep_alive);
+    if (head) {
+        const Page* page = find(code) != NULL ? find(code) : find(500);
+        output.append(response.data(), page->head_length[keep_alive ? 1 : 0]);
+        return;
+        // The response to a HEAD keeps the Content-Length of the page, without the page.
+    }
+    output.append(response);
+}
+
+const std::string& ErrorPages::get(int code, bool keep_alive) {
+    updateDate();
+    const Page* page = find(code);
+    if (page == NULL) {
+        page = find(500);
+    }
+    return page->response[keep_alive ? 1 : 0];
+}
+
+void ErrorPages::updateDate() {
+    if (std::memcmp(written_date, date, HTTP_DATE_LENGTH) == 0) {
+        return;
+        // Same second as the last response: the pages are current.
+    }
+    std::memcpy(written_date, date, HTTP_DATE_LENGTH);
+    for (size_t i = 0; i < pages.size(); ++i) {
+        for (int keep_alive = 0; keep_alive < 2; ++keep_alive) {
+            std::memcpy(&pages[i].response[keep_alive][pages[i].date_offset[keep_alive]], date, HTTP_DATE_LENGTH);
+            // The Date has a fixed length, so the rest of the response does not move.
+        }
+    }
+}
@@ -0,0 +1,27 @@
+#include "EventLoop.hpp"	// Include the EventLoop interface
+#include "PollLoop.hpp"		// Include the poll() backend
+#include "EpollLoop.hpp"	// Include the epoll backend (Linux only)
+#include <stdexcept>		// For std::runtime_error
+
+EventLoop::~EventLoop() {}
+
+bool EventLoop::isEdgeTriggered() const {
+    return false;
+	// Backends are level-triggered unless they say otherwise.
+}
+
+EventLoop* EventLoop::create(const Config& config) {
+    std::string name = config.get("event_loop");
+	// Backend chosen in the configuration file.
+#ifdef __linux__
+    if (name.empty() || name == "epoll") {
+        return new EpollLoop(config.get("edge_triggered") == "on");
+		// epoll is the default on Linux.
+    }
+#endif
+    if (name.empty() || name == "poll") {
+        return new PollLoop();
+		// poll is available everywhere, so it is the fallback.
+    }
+    throw std::runtime_error("Unsupported event_loop in config: " + name);
+}
@@ -0,0 +1,37 @@
+#include "FastCGIPool.hpp"	// Include the header file for the FastCGIPool class
+
+FastCGIPool::FastCGIPool() {}
+
+FastCGIPool::~FastCGIPool() {
+    for (size_t i = 0; i < backends.size(); ++i) {
+        delete backends[i];
+    }
+}
+
+int FastCGIPool::acquire(const Router::Location& location, size_t& index) {
+    index = 0;
+    while (index < backends.size() && backends[index]->getAddress() != location.fastcgi_pass) {
+        ++index;
+    }
+    if (index == backends.size()) {
+        backends.push_back(new KeepAlivePool(location.fastcgi_pass, "FastCGI"));
+    }
+    KeepAlivePool& backend = *backends[index];
+    backend.setLimits(location.fastcgi_pool_size, location.fastcgi_keepalive_timeout, location.fastcgi_max_fails,
+        location.fastcgi_fail_timeout);
+    // The settings of the location that uses the backend now: they can change on reload.
+    bool reused;
+    return backend.connect(reused);
+}
+
+void FastCGIPool::release(size_t index, int fd, bool reusable) {
+    backends[index]->release(fd, reusable);
+}
+
+void FastCGIPool::reportFailure(size_t index) {
+    backends[index]->reportFailure();
+}
+
+void FastCGIPool::reportSuccess(size_t index) {
+    backends[index]->reportSuccess();
+}
@@ -0,0 +1,341 @@
+#include "FileCache.hpp"	// Include the header file for the FileCache class
+#include <sys/stat.h>		// For stat
+#include <fcntl.h>			// For open
+#include <unistd.h>			// For read and close
+#include <cstdio>			// For std::snprintf
+#include <ctime>			// For std::strftime and std::gmtime
+#include <zlib.h>			// For deflate to compress the gzip variants
+
+FileCache::FileCache(size_t bytes, size_t file_size, size_t fds, time_t seconds)
+    : total_bytes(0), max_bytes(bytes), max_file_size(file_size), max_fds(fds), validity(seconds),
+      gzip_enabled(false), gzip_min_length(0), gzip_level(Z_DEFAULT_COMPRESSION), hits(0), misses(0),
+      paths(1024) {}
+
+void FileCache::setLimits(size_t bytes, size_t file_size, size_t fds, time_t seconds) {
+    max_bytes = bytes;
+    max_file_size = file_size;
+    max_fds = fds;
+    validity = seconds;
+    evict(NULL);
+    // Smaller limits apply at once. A file loaded with the old max_file_size keeps its
+    // kind (memory or fd) until it changes and is loaded again.
+}
+
+void FileCache::setGzip(bool enabled, size_t min_length, const std::string& types, int level) {
+    level = level >= 1 && level <= 9 ? level : Z_DEFAULT_COMPRESSION;
+    if (enabled == gzip_enabled && min_length == gzip_min_length && types == gzip_types
+        && level == gzip_level) {
+        return;
+        // A reload with the same settings keeps the variants already compressed.
+    }
+    gzip_enabled = enabled;
+    gzip_min_length = min_length;
+    gzip_types = types;
+    gzip_level = level;
+    for (std::map<std::string, Entry*>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        Entry& entry = *it->second;
+        dropGzip(entry);
+        entry.compressible = gzip_enabled && MimeTypes::isType(entry.content_type, gzip_types);
+        entry.gzip_tried = false;
+        entry.gzip_checked = 0;
+        // The variants are built again with the new settings the next time they are asked for.
+    }
+}
+
+void FileCache::setMimeTypes(const MimeTypes& types) {
+    mime_types = types;
+    for (std::map<std::string, Entry*>::iterator it = entries.begin(); it != entries.end(); ++it) {
+        Entry& entry = *it->second;
+        const std::string& content_type = mime_types.find(entry.path);
+        if (content_type == entry.content_type) {
+            continue;
+        }
+        dropGzip(entry);
+        entry.content_type = content_type;
+        entry.compressible = gzip_enabled && MimeTypes::isType(entry.content_type, gzip_types);
+        entry.gzip_tried = false;
+        entry.gzip_checked = 0;
+        // The variant had the old type; it is built again if the new one is compressed too.
+    }
+}
+
+FileCache::~FileCache() {
+    while (!entries.empty()) {
+        remove(entries.begin()->second);
+        // Entries still used by an output queue are destroyed when they are released.
+    }
+}
+
+const FileCache::Entry* FileCache::get(const std::string& path) {
+    time_t now = std::time(NULL);
+    std::map<std::string, Entry*>::iterator it = entries.find(path);
+    if (it != entries.end()) {
+        Entry* entry = it->second;
+        std::list<Entry*>& list = entry->fd == -1 ? lru : fd_lru;
+        if (now - entry->validated < validity) {
+            // The entry was checked recently: it is used without touching the file system.
+            list.splice(list.begin(), list, entry->lru);
+            ++hits;
+            return entry;
+        }
+        struct stat info;
+        if (stat(path.c_str(), &info) == 0 && S_ISREG(info.st_mode) && info.st_mtime == entry->mtime
+            && info.st_size == entry->size && info.st_ino == entry->inode) {
+            // The file did not change: the entry is valid for validity more seconds.
+            entry->validated = now;
+            list.splice(list.begin(), list, entry->lru);
+            ++hits;
+            return entry;
+        }
+        remove(entry);
+        // The file changed or was deleted: the entry is loaded again below.
+        // Downloads in progress keep sending the old file.
+    }
+    ++misses;
+    struct stat info;
+    if (stat(path.c_str(), &info) == -1 || !S_ISREG(info.st_mode)) {
+        return NULL;
+        // Missing files and directories are not cached.
+    }
+    Entry* entry = new Entry;
+    entry->path = path;
+    entry->fd = -1;
+    entry->refs = 0;
+    entry->cached = true;
+    entry->gzip = NULL;
+    entry->gzip_tried = false;
+    entry->gzip_checked = 0;
+    if (!load(*entry, info)) {
+        destroy(entry);
+        return NULL;
+    }
+    entry->validated = now;
+    entries[path] = entry;
+    if (entry->fd == -1) {
+        lru.push_front(entry);
+        entry->lru = lru.begin();
+        total_bytes += entry->content.size();
+    } else {
+        fd_lru.push_front(entry);
+        entry->lru = fd_lru.begin();
+    }
+    evict(entry);
+    return entry;
+}
+
+const FileCache::Entry* FileCache::get(const char* path, size_t length) {
+    lookup.assign(path, length);
+    return get(lookup);
+}
+
+const FileCache::Entry* FileCache::getGzip(const Entry* plain) {
+    Entry& entry = *const_cast<Entry*>(plain);
+    if (!entry.compressible) {
+        return NULL;
+    }
+    time_t now = std::time(NULL);
+    if (now - entry.gzip_checked >= validity) {
+        // The .gz file is looked for again at most once every validity seconds, like the entry itself.
+        entry.gzip_checked = now;
+        if (!loadSidecar(entry) && entry.gzip != NULL && entry.gzip->path != entry.path) {
+            dropGzip(entry);
+            // The .gz file was removed or is older than the file: it is not used anymore.
+        }
+    }
+    if (entry.gzip == NULL && !entry.gzip_tried && entry.fd == -1
+        && entry.content.size() >= gzip_min_length) {
+        compress(entry);
+        // Without a .gz file, files in memory are compressed once and the result is kept.
+        // Big files are only served compressed if they have a .gz file.
+        evict(&entry);
+    }
+    return entry.gzip;
+}
+
+bool FileCache::loadSidecar(Entry& entry) {
+    std::string path = entry.path + ".gz";
+    struct stat info;
+    if (stat(path.c_str(), &info) == -1 || !S_ISREG(info.st_mode) || info.st_mtime < entry.mtime) {
+        return false;
+    }
+    if (entry.gzip != NULL && entry.gzip->path == path && entry.gzip->mtime == info.st_mtime
+        && entry.gzip->size == info.st_size && entry.gzip->inode == info.st_ino) {
+        return true;
+        // The variant already holds this .gz file.
+    }
+    Entry* variant = new Entry;
+    variant->path = path;
+    variant->fd = -1;
+    variant->refs = 0;
+    variant->cached = true;
+    variant->gzip = NULL;
+    if (!load(*variant, info)) {
+        destroy(variant);
+        return false;
+    }
+    dropGzip(entry);
+    variant->compressible = false;
+    variant->content_type = entry.content_type;
+    variant->last_modified = entry.last_modified;
+    entry.gzip = variant;
+    total_bytes += variant->content.size();
+    return true;
+}
+
+void FileCache::compress(Entry& entry) {
+    entry.gzip_tried = true;
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    if (deflateInit2(&stream, gzip_level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return;
+        // 15 + 16 asks zlib for a gzip header and trailer instead of the zlib ones.
+    }
+    std::string content(deflateBound(&stream, entry.content.size()), '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(entry.content.data()));
+    stream.avail_in = entry.content.size();
+    stream.next_out = reinterpret_cast<Bytef*>(&content[0]);
+    stream.avail_out = content.size();
+    int result = deflate(&stream, Z_FINISH);
+    // The bound is large enough for the whole output, so a single call compresses everything.
+    size_t length = stream.total_out;
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END || length >= entry.content.size()) {
+        return;
+        // Content that does not shrink (e.g., already compressed) is sent as it is.
+    }
+    content.resize(length);
+    char buffer[64];
+    Entry* variant = new Entry;
+    variant->path = entry.path;
+    variant->content.swap(content);
+    variant->fd = -1;
+    variant->content_type = entry.content_type;
+    variant->last_modified = entry.last_modified;
+    variant->mtime = entry.mtime;
+    variant->size = length;
+    variant->inode = entry.inode;
+    variant->validated = entry.validated;
+    variant->refs = 0;
+    variant->cached = true;
+    variant->compressible = false;
+    variant->gzip = NULL;
+    std::snprintf(buffer, sizeof(buffer), "%lu", static_cast<unsigned long>(length));
+    variant->content_length = buffer;
+    std::snprintf(buffer, sizeof(buffer), "\"%lx-%lx-gz\"", static_cast<unsigned long>(entry.mtime),
+        static_cast<unsigned long>(entry.size));
+    variant->etag = buffer;
+    // The compressed bytes differ from the file, so they need their own ETag.
+    entry.gzip = variant;
+    total_bytes += length;
+}
+
+void FileCache::dropGzip(Entry& entry) {
+    Entry* variant = entry.gzip;
+    if (variant == NULL) {
+        return;
+    }
+    entry.gzip = NULL;
+    if (entry.cached) {
+        total_bytes -= variant->content.size();
+    }
+    variant->cached = false;
+    if (variant->refs == 0) {
+        destroy(variant);
+        // A .gz file still being sent with sendfile() is destroyed when it is released.
+    }
+}
+
+void FileCache::evict(const Entry* keep) {
+    while (total_bytes > max_bytes && !lru.empty() && lru.back() != keep) {
+        remove(lru.back());
+        // Evict the least recently used entries until the cache fits in max_bytes again.
+    }
+    while (fd_lru.size() > max_fds && fd_lru.back() != keep) {
+        remove(fd_lru.back());
+        // Close the least recently used file descriptors above max_fds.
+    }
+}
+
+bool FileCache::load(Entry& entry, const struct stat& info) {
+    entry.fd = open(entry.path.c_str(), O_RDONLY | O_CLOEXEC);
+    // CGI scripts started by the worker must not inherit the descriptors of the cache.
+    if (entry.fd == -1) {
+        return false;
+    }
+    if (static_cast<size_t>(info.st_size) <= max_file_size && static_cast<size_t>(info.st_size) <= max_bytes) {
+        entry.content.resize(info.st_size);
+        // The size is known, so the content is read in place with a single allocation.
+        size_t done = 0;
+        while (done < entry.content.size()) {
+            ssize_t bytes = read(entry.fd, &entry.content[done], entry.content.size() - done);
+            if (bytes <= 0) {
+                break;
+            }
+            done += bytes;
+        }
+        close(entry.fd);
+        entry.fd = -1;
+        if (done != entry.content.size()) {
+            return false;
+            // The file was truncated while it was read.
+        }
+    }
+    // Big files keep their file descriptor open; the body is sent from it.
+    char buffer[64];
+    entry.mtime = info.st_mtime;
+    entry.size = info.st_size;
+    entry.inode = info.st_ino;
+    entry.content_type = mime_types.find(entry.path);
+    entry.compressible = gzip_enabled && MimeTypes::isType(entry.content_type, gzip_types);
+    // The type is looked up once here, not for every response that sends the entry.
+    std::snprintf(buffer, sizeof(buffer), "%lu", static_cast<unsigned long>(info.st_size));
+    entry.content_length = buffer;
+    std::snprintf(buffer, sizeof(buffer), "\"%lx-%lx\"", static_cast<unsigned long>(info.st_mtime),
+        static_cast<unsigned long>(info.st_size));
+    entry.etag = buffer;
+    // The ETag is built from the modification time and the size, like other servers do.
+    std::strftime(buffer, sizeof(buffer), "%a, %d %b %Y %H:%M:%S GMT", std::gmtime(&info.st_mtime));
+    entry.last_modified = buffer;
+    return true;
+}
+
+void FileCache::remove(Entry* entry) {
+    dropGzip(*entry);
+    if (entry->fd == -1) {
+        total_bytes -= entry->content.size();
+        lru.erase(entry->lru);
+    } else {
+        fd_lru.erase(entry->lru);
+    }
+    entries.erase(entry->path);
+    entry->cached = false;
+    if (entry->refs == 0) {
+        destroy(entry);
+    }
+}
+
+void FileCache::acquire(const Entry* entry) {
+    ++const_cast<Entry*>(entry)->refs;
+}
+
+void FileCache::release(const Entry* entry) {
+    Entry* owned = const_cast<Entry*>(entry);
+    if (--owned->refs == 0 && !owned->cached) {
+        destroy(owned);
+        // The entry was evicted while it was being sent.
+    }
+}
+
+void FileCache::destroy(Entry* entry) {
+    if (entry->fd != -1) {
+        close(entry->fd);
+    }
+    delete entry;
+}
+
+size_t FileCache::getHits() const { return hits; }
+size_t FileCache::getMisses() const { return misses; }
+size_t FileCache::getSize() const { return total_bytes; }
+PathCache& FileCache::getPaths() { return paths; }
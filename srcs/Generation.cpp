@@ -0,0 +1,19 @@
+#include "Generation.hpp"	// Include the header file for the Generation class
+
+Generation::Generation(const Config& cfg, const char* date, unsigned generation_number)
+    : config(cfg), router(config), mime_types(config),
+    error_pages(config, mime_types, date), number(generation_number), refs(1) {}
+// The Router is compiled first: if it throws, nothing else is built.
+
+Generation::~Generation() {}
+
+void Generation::acquire() {
+    ++refs;
+}
+
+void Generation::release() {
+    if (--refs == 0) {
+        delete this;
+        // No request uses this generation anymore.
+    }
+}
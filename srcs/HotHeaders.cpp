@@ -0,0 +1,23 @@
+#include "HotHeaders.hpp"	// Include the header file for the HotHeaders class
+
+HotHeaders::HotHeaders() : current(-1) {
+    update(std::time(NULL));
+}
+
+bool HotHeaders::update(time_t now) {
+    if (now == current) {
+        return false;
+        // Same second: the formatted Date is still right.
+    }
+    current = now;
+    std::strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", std::gmtime(&now));
+    return true;
+}
+
+const char* HotHeaders::getDate() const {
+    return date;
+}
+
+const char* HotHeaders::getServer() {
+    return "webserv";
+}
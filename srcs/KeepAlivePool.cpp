@@ -0,0 +1,147 @@
+#include "KeepAlivePool.hpp"	// Include the header file for the KeepAlivePool class
+#include <sys/un.h>				// For sockaddr_un
+#include <netinet/in.h>			// For sockaddr_in
+#include <netdb.h>				// For getaddrinfo
+#include <fcntl.h>				// For fcntl to make the sockets non-blocking and close-on-exec
+#include <unistd.h>				// For close
+#include <cstring>				// For std::memset, std::memcpy and strerror
+#include <cerrno>				// For errno
+#include <iostream>				// For std::cerr
+
+KeepAlivePool::KeepAlivePool(const std::string& backend_address, const char* log_name)
+    : address(backend_address), name(log_name), size(0), keepalive_timeout(0), max_fails(0), fail_timeout(0),
+    fails(0), down_until(0) {
+    if (!resolve(address, sockaddr, sockaddr_length)) {
+        sockaddr_length = 0;
+        std::cerr << name << ": invalid address " << address << std::endl;
+    }
+    // The address is resolved once, when the backend is added: a name is not looked up per request.
+}
+
+KeepAlivePool::~KeepAlivePool() {
+    for (size_t i = 0; i < idle.size(); ++i) {
+        close(idle[i].fd);
+    }
+}
+
+bool KeepAlivePool::resolve(const std::string& address, struct sockaddr_storage& sockaddr, socklen_t& length) {
+    std::memset(&sockaddr, 0, sizeof(sockaddr));
+    if (address.compare(0, 5, "unix:") == 0) {
+        struct sockaddr_un* un = reinterpret_cast<struct sockaddr_un*>(&sockaddr);
+        std::string path = address.substr(5);
+        if (path.empty() || path.size() >= sizeof(un->sun_path)) {
+            return false;
+        }
+        un->sun_family = AF_UNIX;
+        std::memcpy(un->sun_path, path.c_str(), path.size() + 1);
+        length = sizeof(struct sockaddr_un);
+        return true;
+    }
+    size_t colon = address.rfind(':');
+    if (colon == std::string::npos) {
+        return false;
+    }
+    struct addrinfo hints;
+    struct addrinfo* result;
+    std::memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(address.substr(0, colon).c_str(), address.substr(colon + 1).c_str(), &hints, &result) != 0) {
+        return false;
+    }
+    std::memcpy(&sockaddr, result->ai_addr, result->ai_addrlen);
+    length = result->ai_addrlen;
+    freeaddrinfo(result);
+    return true;
+}
+
+void KeepAlivePool::setLimits(size_t pool_size, time_t timeout, unsigned failures, time_t down_time) {
+    size = pool_size;
+    keepalive_timeout = timeout;
+    max_fails = failures;
+    fail_timeout = down_time;
+}
+
+void KeepAlivePool::closeIdle(time_t now) {
+    size_t kept = 0;
+    for (size_t i = 0; i < idle.size(); ++i) {
+        if (idle[i].since + keepalive_timeout <= now) {
+            close(idle[i].fd);
+        } else {
+            idle[kept++] = idle[i];
+        }
+    }
+    idle.resize(kept);
+    // The pool is only visited when it is used, so an idle connection may outlive its timeout
+    // until the next request; the backend closing it first is handled by connect().
+}
+
+int KeepAlivePool::connect(bool& reused) {
+    time_t now = std::time(NULL);
+    closeIdle(now);
+    reused = true;
+    while (!idle.empty()) {
+        int fd = idle.back().fd;
+        idle.pop_back();
+        char byte;
+        if (recv(fd, &byte, 1, MSG_PEEK | MSG_DONTWAIT) == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return fd;
+            // Nothing to read and no end-of-file: the backend still keeps the connection open.
+        }
+        close(fd);
+        // The backend closed it while it was idle (its own timeout, or its worker was recycled).
+    }
+    reused = false;
+    if (sockaddr_length == 0 || isDown(now)) {
+        return -1;
+        // The backend failed recently: answer at once instead of waiting for it.
+    }
+    int fd = socket(sockaddr.ss_family, SOCK_STREAM, 0);
+    if (fd == -1) {
+        std::cerr << name << ": cannot create a socket: " << strerror(errno) << std::endl;
+        return -1;
+    }
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    if (::connect(fd, reinterpret_cast<struct sockaddr*>(&sockaddr), sockaddr_length) == -1 && errno != EINPROGRESS) {
+        std::cerr << name << ": cannot connect to " << address << ": " << strerror(errno) << std::endl;
+        close(fd);
+        reportFailure();
+        return -1;
+        // Refused at once: nothing listens on the port, or a Unix-domain socket has no
+        // responder or a full accept queue.
+    }
+    return fd;
+    // A TCP connection is usually still being established: the first write waits until it is.
+}
+
+void KeepAlivePool::release(int fd, bool reusable) {
+    if (!reusable || idle.size() >= size) {
+        close(fd);
+        return;
+    }
+    Idle connection;
+    connection.fd = fd;
+    connection.since = std::time(NULL);
+    idle.push_back(connection);
+    // The most recent connection is reused first, so the oldest ones reach their timeout.
+}
+
+void KeepAlivePool::reportFailure() {
+    if (++fails >= max_fails && max_fails != 0) {
+        down_until = std::time(NULL) + fail_timeout;
+        fails = 0;
+        std::cerr << name << ": " << address << " marked down for " << fail_timeout << " s" << std::endl;
+    }
+    // max_fails 0 never marks the backend down.
+}
+
+void KeepAlivePool::reportSuccess() {
+    fails = 0;
+    down_until = 0;
+}
+
+bool KeepAlivePool::isDown(time_t now) const { return now < down_until; }
+// Returns true until fail_timeout seconds passed since the backend was marked down.
+const std::string& KeepAlivePool::getAddress() const { return address; }
+// Returns the address of the backend.
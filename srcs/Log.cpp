@@ -0,0 +1,273 @@
+#include "Log.hpp"		// Include the header file for the Log class
+#include <fcntl.h>		// For open
+#include <unistd.h>		// For write, close and getpid
+#include <sys/uio.h>	// For writev
+#include <sys/time.h>	// For gettimeofday, the base of the deadline of a batch
+#include <signal.h>		// For pthread_sigmask to keep the signals away from the writer
+#include <stdexcept>	// For std::runtime_error
+#include <cstring>		// For std::memcpy and std::strerror
+#include <cstdio>		// For std::snprintf
+#include <cerrno>		// For errno
+#include <ctime>		// For std::time, localtime_r and std::strftime
+
+static size_t roundCapacity(size_t size) {
+    size_t capacity = LOG_MIN_BUFFER;
+    while (capacity < size) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+static int openFile(const std::string& path) {
+    return ::open(path.c_str(), O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+    // O_APPEND: every writev() goes to the end, even if logrotate truncated the file (copytruncate).
+}
+
+Log::Stream::Stream(Log& target) : log(target) {}
+
+Log::Stream::int_type Log::Stream::overflow(int_type c) {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+        return traits_type::not_eof(c);
+    }
+    char character = traits_type::to_char_type(c);
+    xsputn(&character, 1);
+    return c;
+}
+
+std::streamsize Log::Stream::xsputn(const char* data, std::streamsize length) {
+    std::streamsize start = 0;
+    for (std::streamsize i = 0; i < length; ++i) {
+        if (data[i] == '\n') {
+            line.append(data + start, i - start + 1);
+            writeLine();
+            start = i + 1;
+        }
+    }
+    line.append(data + start, length - start);
+    return length;
+}
+
+void Log::Stream::writeLine() {
+    char prefix[64];
+    time_t now = std::time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    size_t length = std::strftime(prefix, sizeof(prefix), "%Y/%m/%d %H:%M:%S ", &local);
+    length += std::snprintf(prefix + length, sizeof(prefix) - length, "[%ld] ", static_cast<long>(getpid()));
+    line.insert(0, prefix, length);
+    log.write(line.data(), line.size());
+    line.clear();
+    // Error messages are rare: building the line in a std::string is not worth avoiding.
+}
+
+Log::Log() : fd(-1), ring(NULL), capacity(0), policy(POLICY_DROP), flush_interval(0), head(0), tail(0),
+    reopen_requested(0), stopping(false), running(false), dropped(0) {
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&wake, NULL);
+    pthread_cond_init(&space, NULL);
+}
+
+Log::~Log() {
+    close();
+    pthread_cond_destroy(&space);
+    pthread_cond_destroy(&wake);
+    pthread_mutex_destroy(&mutex);
+}
+
+void Log::open(const std::string& file, size_t buffer_size, Policy overflow, unsigned interval) {
+    close();
+    int descriptor = openFile(file);
+    if (descriptor == -1) {
+        throw std::runtime_error("Failed to open the log " + file + ": " + std::strerror(errno));
+    }
+    path = file;
+    fd = descriptor;
+    capacity = roundCapacity(buffer_size);
+    ring = new char[capacity];
+    policy = overflow;
+    flush_interval = interval;
+    head = 0;
+    tail = 0;
+    reopen_requested = 0;
+    stopping = false;
+    sigset_t all;
+    sigset_t previous;
+    sigfillset(&all);
+    pthread_sigmask(SIG_SETMASK, &all, &previous);
+    int error = pthread_create(&thread, NULL, run, this);
+    pthread_sigmask(SIG_SETMASK, &previous, NULL);
+    // The thread inherits the mask of its creator: it is created with every signal blocked,
+    // so SIGHUP, SIGCHLD and SIGUSR1 keep waking the event loop up.
+    if (error != 0) {
+        ::close(fd);
+        fd = -1;
+        delete[] ring;
+        ring = NULL;
+        throw std::runtime_error("Failed to start the writer of the log " + file + ": " + std::strerror(error));
+    }
+    running = true;
+}
+
+void Log::close() {
+    if (!running) {
+        return;
+    }
+    pthread_mutex_lock(&mutex);
+    stopping = true;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&mutex);
+    pthread_join(thread, NULL);
+    running = false;
+    ::close(fd);
+    fd = -1;
+    delete[] ring;
+    ring = NULL;
+}
+
+bool Log::isOpen() const {
+    return running;
+}
+
+bool Log::matches(const std::string& file, size_t buffer_size, Policy overflow, unsigned interval) const {
+    return running && path == file && capacity == roundCapacity(buffer_size) && policy == overflow
+        && flush_interval == interval;
+}
+
+bool Log::write(const char* data, size_t length) {
+    if (!running) {
+        return false;
+    }
+    if (length > capacity) {
+        ++dropped;
+        return false;
+    }
+    unsigned long position = head;
+    unsigned long consumed = __atomic_load_n(&tail, __ATOMIC_ACQUIRE);
+    if (capacity - (position - consumed) < length) {
+        if (policy == POLICY_DROP) {
+            ++dropped;
+            return false;
+        }
+        pthread_mutex_lock(&mutex);
+        while (capacity - (position - (consumed = __atomic_load_n(&tail, __ATOMIC_ACQUIRE))) < length) {
+            pthread_cond_signal(&wake);
+            pthread_cond_wait(&space, &mutex);
+        }
+        pthread_mutex_unlock(&mutex);
+        // POLICY_BLOCK: the worker waits for the batch in progress to be written.
+    }
+    size_t offset = position & (capacity - 1);
+    size_t first = capacity - offset < length ? capacity - offset : length;
+    std::memcpy(ring + offset, data, first);
+    std::memcpy(ring, data + first, length - first);
+    __atomic_store_n(&head, position + length, __ATOMIC_SEQ_CST);
+    // The bytes are copied before head is published: the writer never reads a partial record.
+    consumed = __atomic_load_n(&tail, __ATOMIC_SEQ_CST);
+    // tail is read again after head is published. If the writer had not written everything
+    // before this record yet, it reads head after it does, and finds the record.
+    if (position == consumed || (position - consumed < capacity / 2 && position + length - consumed >= capacity / 2)) {
+        pthread_mutex_lock(&mutex);
+        pthread_cond_signal(&wake);
+        pthread_mutex_unlock(&mutex);
+        // First record of a batch, or the ring just became half full: the writer is woken up.
+        // Every other record only costs the copy.
+    }
+    return true;
+}
+
+void Log::reopen() {
+    if (!running) {
+        return;
+    }
+    __atomic_store_n(&reopen_requested, 1, __ATOMIC_RELEASE);
+    pthread_mutex_lock(&mutex);
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&mutex);
+}
+
+unsigned long Log::getDropped() const {
+    return dropped;
+}
+
+Log::Policy Log::parsePolicy(const std::string& value) {
+    return value == "block" ? POLICY_BLOCK : POLICY_DROP;
+}
+
+void* Log::run(void* log) {
+    static_cast<Log*>(log)->writeLoop();
+    return NULL;
+}
+
+void Log::writeLoop() {
+    pthread_mutex_lock(&mutex);
+    while (true) {
+        bool reopening = __atomic_load_n(&reopen_requested, __ATOMIC_ACQUIRE) != 0;
+        unsigned long available = __atomic_load_n(&head, __ATOMIC_SEQ_CST) - tail;
+        if (available == 0 && !reopening) {
+            if (stopping) {
+                break;
+            }
+            pthread_cond_wait(&wake, &mutex);
+            continue;
+            // Nothing to write: the first record of the next batch wakes the writer up.
+        }
+        if (available < capacity / 2 && !reopening && !stopping) {
+            struct timeval now;
+            gettimeofday(&now, NULL);
+            unsigned long nanoseconds = now.tv_usec * 1000UL + (flush_interval % 1000) * 1000000UL;
+            struct timespec deadline;
+            deadline.tv_sec = now.tv_sec + flush_interval / 1000 + nanoseconds / 1000000000UL;
+            deadline.tv_nsec = nanoseconds % 1000000000UL;
+            pthread_cond_timedwait(&wake, &mutex, &deadline);
+            // The batch grows for flush_interval, unless the ring gets half full or the worker
+            // waits for room first.
+        }
+        pthread_mutex_unlock(&mutex);
+        if (__atomic_exchange_n(&reopen_requested, 0, __ATOMIC_ACQ_REL) != 0) {
+            reopenFile();
+        }
+        writeBatch(tail, __atomic_load_n(&head, __ATOMIC_ACQUIRE));
+        pthread_mutex_lock(&mutex);
+        pthread_cond_broadcast(&space);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+void Log::writeBatch(unsigned long from, unsigned long to) {
+    while (from != to) {
+        size_t offset = from & (capacity - 1);
+        size_t length = to - from;
+        struct iovec parts[2];
+        parts[0].iov_base = ring + offset;
+        parts[0].iov_len = capacity - offset < length ? capacity - offset : length;
+        parts[1].iov_base = ring;
+        parts[1].iov_len = length - parts[0].iov_len;
+        ssize_t written = writev(fd, parts, parts[1].iov_len != 0 ? 2 : 1);
+        if (written == -1 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            written = length;
+            // Disk full or I/O error: the batch is lost, the worker must not wait for the disk.
+        }
+        from += written;
+        __atomic_store_n(&tail, from, __ATOMIC_SEQ_CST);
+        // The room is given back as soon as it is written, even in the middle of a batch.
+    }
+}
+
+void Log::reopenFile() {
+    int descriptor = openFile(path);
+    if (descriptor == -1) {
+        char message[512];
+        int length = std::snprintf(message, sizeof(message), "Failed to reopen the log %s: %s\n", path.c_str(),
+            std::strerror(errno));
+        if (::write(STDERR_FILENO, message, length < static_cast<int>(sizeof(message)) ? length : sizeof(message) - 1) == -1) {
+            // Nothing else can be done: the old file is kept.
+        }
+        return;
+        // std::cerr may be the error log itself, and only the event loop may append to a ring.
+    }
+    ::close(fd);
+    fd = descriptor;
+}
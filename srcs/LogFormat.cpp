@@ -0,0 +1,228 @@
+#include "LogFormat.hpp"	// Include the header file for the LogFormat class
+#include <unistd.h>			// For getpid
+#include <stdexcept>		// For std::runtime_error
+#include <cctype>			// For std::isalnum
+
+static const char* const COMBINED = "$remote_addr - - [$time_local] \"$request\" $status $bytes_sent "
+    "\"$http_referer\" \"$http_user_agent\"";
+static const char* const COMMON = "$remote_addr - - [$time_local] \"$request\" $status $bytes_sent";
+// The predefined formats: the Common Log Format and the combined format of Apache and nginx.
+
+static void appendNumber(std::string& line, unsigned long value, size_t min_digits = 1) {
+    char digits[24];
+    char* end = digits + sizeof(digits);
+    char* start = end;
+    do {
+        *--start = '0' + value % 10;
+        value /= 10;
+    } while (value != 0 || static_cast<size_t>(end - start) < min_digits);
+    line.append(start, end - start);
+    // snprintf() parses its format on every call: the numbers of a line are written by hand.
+}
+
+LogFormat::LogFormat() : formatted(-1) {
+    compile("combined");
+    time_local[0] = '\0';
+    time_iso8601[0] = '\0';
+}
+
+LogFormat::Variable LogFormat::findVariable(const std::string& name) {
+    static const struct {
+        const char* name;
+        Variable variable;
+    } variables[] = {
+        { "remote_addr", REMOTE_ADDR }, { "time_local", TIME_LOCAL }, { "time_iso8601", TIME_ISO8601 },
+        { "request", REQUEST }, { "request_method", REQUEST_METHOD }, { "request_uri", REQUEST_URI },
+        { "server_protocol", SERVER_PROTOCOL }, { "status", STATUS }, { "bytes_sent", BYTES_SENT },
+        { "request_time", REQUEST_TIME }, { "connection_requests", CONNECTION_REQUESTS }, { "pid", PID },
+        { "http_host", HTTP_HOST }, { "http_referer", HTTP_REFERER }, { "http_user_agent", HTTP_USER_AGENT }
+    };
+    for (size_t i = 0; i < sizeof(variables) / sizeof(variables[0]); ++i) {
+        if (name == variables[i].name) {
+            return variables[i].variable;
+        }
+    }
+    return TEXT;
+}
+
+void LogFormat::compile(const std::string& format) {
+    const std::string source = format == "combined" || format.empty() ? COMBINED : format == "common" ? COMMON : format;
+    std::vector<Token> compiled;
+    Token literal;
+    literal.variable = TEXT;
+    for (size_t i = 0; i < source.size();) {
+        if (source[i] != '$') {
+            literal.text += source[i++];
+            continue;
+        }
+        size_t start = i + 1;
+        size_t end = start;
+        while (end < source.size() && (std::isalnum(static_cast<unsigned char>(source[end])) || source[end] == '_')) {
+            ++end;
+        }
+        std::string name = source.substr(start, end - start);
+        Variable variable = findVariable(name);
+        if (variable == TEXT) {
+            throw std::runtime_error("Unknown variable in log_format: $" + name);
+        }
+        if (!literal.text.empty()) {
+            compiled.push_back(literal);
+            literal.text.clear();
+        }
+        Token token;
+        token.variable = variable;
+        compiled.push_back(token);
+        i = end;
+    }
+    if (!literal.text.empty()) {
+        compiled.push_back(literal);
+    }
+    tokens.swap(compiled);
+    // The variables are found by name once here; format() only switches on them.
+}
+
+void LogFormat::appendEscaped(std::string& line, const Request::View& value) {
+    if (value.data == NULL || value.length == 0) {
+        line += '-';
+        return;
+    }
+    static const char hex[] = "0123456789ABCDEF";
+    size_t start = 0;
+    for (size_t i = 0; i < value.length; ++i) {
+        unsigned char c = value.data[i];
+        if (c >= 0x20 && c < 0x7f && c != '"' && c != '\\') {
+            continue;
+        }
+        line.append(value.data + start, i - start);
+        char escaped[4] = { '\\', 'x', hex[c >> 4], hex[c & 15] };
+        line.append(escaped, 4);
+        start = i + 1;
+    }
+    line.append(value.data + start, value.length - start);
+    // The runs of plain characters are appended at once: a value rarely has anything to escape.
+}
+
+void LogFormat::format(std::string& line, const Record& record, time_t now) {
+    if (now != formatted) {
+        struct tm local;
+        localtime_r(&now, &local);
+        std::strftime(time_local, sizeof(time_local), "%d/%b/%Y:%H:%M:%S %z", &local);
+        size_t length = std::strftime(time_iso8601, sizeof(time_iso8601), "%Y-%m-%dT%H:%M:%S%z", &local);
+        if (length == 24) {
+            time_iso8601[25] = '\0';
+            time_iso8601[24] = time_iso8601[23];
+            time_iso8601[23] = time_iso8601[22];
+            time_iso8601[22] = ':';
+            // %z is +0200, ISO 8601 wants +02:00.
+        }
+        formatted = now;
+    }
+    line.clear();
+    for (size_t i = 0; i < tokens.size(); ++i) {
+        switch (tokens[i].variable) {
+        case TEXT:
+            line.append(tokens[i].text);
+            break;
+        case REMOTE_ADDR: {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&record.address.s_addr);
+            for (size_t b = 0; b < 4; ++b) {
+                if (b != 0) {
+                    line += '.';
+                }
+                appendNumber(line, bytes[b]);
+            }
+            break;
+            // s_addr is in network order: its first byte is the first number of the address.
+        }
+        case TIME_LOCAL:
+            line.append(time_local);
+            break;
+        case TIME_ISO8601:
+            line.append(time_iso8601);
+            break;
+        case REQUEST:
+            if (record.method.length == 0) {
+                line += '-';
+                break;
+                // The request line was invalid or incomplete.
+            }
+            appendEscaped(line, record.method);
+            line += ' ';
+            appendEscaped(line, record.uri);
+            if (record.protocol.length != 0) {
+                line += ' ';
+                appendEscaped(line, record.protocol);
+            }
+            break;
+        case REQUEST_METHOD:
+            appendEscaped(line, record.method);
+            break;
+        case REQUEST_URI:
+            appendEscaped(line, record.uri);
+            break;
+        case SERVER_PROTOCOL:
+            appendEscaped(line, record.protocol);
+            break;
+        case STATUS:
+            appendNumber(line, record.status);
+            break;
+        case BYTES_SENT:
+            appendNumber(line, record.bytes_sent);
+            break;
+        case REQUEST_TIME: {
+            unsigned long milliseconds = record.request_time / 1000000;
+            appendNumber(line, milliseconds / 1000);
+            line += '.';
+            appendNumber(line, milliseconds % 1000, 3);
+            break;
+        }
+        case CONNECTION_REQUESTS:
+            appendNumber(line, record.requests);
+            break;
+        case PID:
+            appendNumber(line, getpid());
+            break;
+        case HTTP_HOST:
+            appendEscaped(line, record.host);
+            break;
+        case HTTP_REFERER:
+            appendEscaped(line, record.referer);
+            break;
+        case HTTP_USER_AGENT:
+            appendEscaped(line, record.user_agent);
+            break;
+        }
+    }
+    line += '\n';
+}
+
+void LogFormat::capture(Record& record, const Request& request) {
+    record.method = request.getMethodView();
+    record.uri = request.getUriView();
+    record.protocol = request.getVersionView();
+    record.host = request.getHeaderView("Host");
+    record.referer = request.getHeaderView("Referer");
+    record.user_agent = request.getHeaderView("User-Agent");
+}
+
+void LogFormat::save(Record& record, std::string& storage) {
+    Request::View* views[6] = { &record.method, &record.uri, &record.protocol, &record.host, &record.referer,
+        &record.user_agent };
+    size_t total = 0;
+    for (size_t i = 0; i < 6; ++i) {
+        total += views[i]->length;
+    }
+    storage.clear();
+    storage.reserve(total);
+    for (size_t i = 0; i < 6; ++i) {
+        storage.append(views[i]->data != NULL ? views[i]->data : "", views[i]->length);
+    }
+    // The storage is filled before any view is moved: its bytes do not move anymore.
+    size_t offset = 0;
+    for (size_t i = 0; i < 6; ++i) {
+        if (views[i]->data != NULL) {
+            views[i]->data = storage.data() + offset;
+        }
+        offset += views[i]->length;
+    }
+}
@@ -0,0 +1,218 @@
+#include "Master.hpp"	// Include the header file for the Master class
+#include "Server.hpp"	// Include the Server class run by each worker
+#include "Router.hpp"	// Include the Router class to check a reloaded configuration
+#include <sys/wait.h>	// For waitpid and the W* macros
+#include <signal.h>		// For signal handling
+#include <unistd.h>		// For fork, sysconf and _exit
+#include <cstring>		// For strerror
+#include <cerrno>		// For errno
+#include <iostream>		// For std::cerr and std::cout
+#ifdef __linux__
+# include <sched.h>		// For sched_setaffinity to pin a worker to one CPU
+# include <sys/prctl.h>	// For prctl to stop the workers if the master dies
+#endif
+
+static volatile sig_atomic_t g_stop = 0;
+// Set by the signal handler when the master must stop.
+
+static volatile sig_atomic_t g_reload = 0;
+// Set by the signal handler when the configuration must be reloaded.
+
+static void handleStopSignal(int) {
+    g_stop = 1;
+}
+
+static volatile sig_atomic_t g_reopen = 0;
+// Set by the signal handler when the logs must be reopened.
+
+static void handleReloadSignal(int) {
+    g_reload = 1;
+}
+
+static void handleReopenSignal(int) {
+    g_reopen = 1;
+}
+
+Master::Master(const Config& cfg, Metrics& shared_metrics) : config(cfg), metrics(shared_metrics) {
+    workers.resize(workerCount(config));
+    for (size_t i = 0; i < workers.size(); ++i) {
+        workers[i].pid = -1;
+        workers[i].started = 0;
+    }
+    pin_cpus = config.get("worker_cpu_affinity") == "on";
+}
+
+int Master::workerCount(const Config& config) {
+    std::string value = config.get("workers");
+    if (value == "auto") {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        return cpus > 0 ? cpus : 1;
+        // One worker per online CPU.
+    }
+    long count = config.getInt("workers", 1);
+    return count > 0 ? count : 1;
+}
+
+void Master::spawn(size_t index) {
+    pid_t pid = fork();
+    if (pid == -1) {
+        std::cerr << "Failed to fork worker " << index << ": " << strerror(errno) << std::endl;
+        return;
+        // The worker is retried the next time a worker exits or the master wakes up.
+    }
+    if (pid > 0) {
+        workers[index].pid = pid;
+        workers[index].started = std::time(NULL);
+        return;
+    }
+    // Proceso hijo: el worker
+    signal(SIGINT, SIG_DFL);
+    signal(SIGTERM, SIG_DFL);
+    // The worker is stopped by the default action of SIGTERM.
+    // SIGHUP and SIGUSR1 only set g_reload and g_reopen in the copy of the master until the
+    // Server installs its handler.
+#ifdef __linux__
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+    // If the master dies, the kernel sends SIGTERM to the worker.
+    if (pin_cpus) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(index % sysconf(_SC_NPROCESSORS_ONLN), &cpus);
+        if (sched_setaffinity(0, sizeof(cpus), &cpus) == -1) {
+            std::cerr << "Worker " << index << ": cannot pin to a CPU: " << strerror(errno) << std::endl;
+        }
+        // Keeping the worker on one CPU keeps its caches warm.
+    }
+#endif
+    int status = 0;
+    try {
+        Server server(config, metrics, index);
+        // Each worker has its own listening socket (SO_REUSEPORT) and event loop.
+        server.start();
+    } catch (const std::exception& e) {
+        std::cerr << "Worker " << index << " error: " << e.what() << std::endl;
+        status = 1;
+    }
+    _exit(status);
+    // _exit does not run the destructors and atexit handlers inherited from the master.
+}
+
+void Master::reload() {
+    try {
+        Config fresh(config.getPath());
+        Router check(fresh);
+        // The file is parsed and compiled once here, so an invalid file is rejected
+        // without disturbing the workers.
+        if (workerCount(fresh) != static_cast<int>(workers.size())) {
+            std::cerr << "The number of workers is only applied on restart" << std::endl;
+        }
+        config = fresh;
+        pin_cpus = config.get("worker_cpu_affinity") == "on";
+    } catch (const std::exception& e) {
+        std::cerr << "Reload rejected: " << e.what() << std::endl;
+        return;
+    }
+    std::cout << "Master " << getpid() << " reloading " << workers.size() << " workers" << std::endl;
+    for (size_t i = 0; i < workers.size(); ++i) {
+        if (workers[i].pid != -1) {
+            kill(workers[i].pid, SIGHUP);
+            // Each worker reloads between two iterations of its event loop and reports the outcome.
+        }
+    }
+}
+
+void Master::forward(int signal_number) {
+    for (size_t i = 0; i < workers.size(); ++i) {
+        if (workers[i].pid != -1) {
+            kill(workers[i].pid, signal_number);
+        }
+    }
+}
+
+void Master::stopAll() {
+    for (size_t i = 0; i < workers.size(); ++i) {
+        if (workers[i].pid != -1) {
+            kill(workers[i].pid, SIGTERM);
+        }
+    }
+    for (size_t i = 0; i < workers.size(); ++i) {
+        if (workers[i].pid != -1) {
+            waitpid(workers[i].pid, NULL, 0);
+            workers[i].pid = -1;
+        }
+    }
+}
+
+int Master::run() {
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = handleStopSignal;
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    action.sa_handler = handleReloadSignal;
+    sigaction(SIGHUP, &action, NULL);
+    action.sa_handler = handleReopenSignal;
+    sigaction(SIGUSR1, &action, NULL);
+    // Without SA_RESTART, waitpid is interrupted by the signal and the loop checks g_stop,
+    // g_reload and g_reopen.
+
+    for (size_t i = 0; i < workers.size(); ++i) {
+        spawn(i);
+    }
+    std::cout << "Master " << getpid() << " started " << workers.size() << " workers" << std::endl;
+    int exit_status = 0;
+    while (!g_stop) {
+        if (g_reload) {
+            g_reload = 0;
+            reload();
+        }
+        if (g_reopen) {
+            g_reopen = 0;
+            forward(SIGUSR1);
+            // Each worker reopens its own logs; the master writes none.
+        }
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid == -1) {
+            if (errno != EINTR) {
+                sleep(1);
+                // No children left (every fork failed): wait a bit before retrying.
+            }
+            for (size_t i = 0; i < workers.size() && !g_stop; ++i) {
+                if (workers[i].pid == -1) {
+                    spawn(i);
+                }
+            }
+            continue;
+        }
+        for (size_t i = 0; i < workers.size(); ++i) {
+            if (workers[i].pid != pid) {
+                continue;
+            }
+            workers[i].pid = -1;
+            bool quick = std::time(NULL) - workers[i].started < 1;
+            if (WIFEXITED(status) && WEXITSTATUS(status) != 0 && quick) {
+                // The worker failed during start-up (e.g., the port is in use or the config is wrong).
+                // Restarting it would fail again, so the whole server stops.
+                std::cerr << "Worker " << i << " failed to start, stopping" << std::endl;
+                g_stop = 1;
+                exit_status = 1;
+                break;
+            }
+            if (WIFSIGNALED(status)) {
+                std::cerr << "Worker " << i << " (pid " << pid << ") killed by signal "
+                    << WTERMSIG(status) << ", restarting" << std::endl;
+            } else {
+                std::cerr << "Worker " << i << " (pid " << pid << ") exited with status "
+                    << WEXITSTATUS(status) << ", restarting" << std::endl;
+            }
+            if (quick) {
+                sleep(1);
+                // Throttle restarts of a worker that keeps crashing right away.
+            }
+            spawn(i);
+        }
+    }
+    stopAll();
+    return exit_status;
+}
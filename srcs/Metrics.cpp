@@ -0,0 +1,175 @@
+#include "Metrics.hpp"	// Include the header file for the Metrics class
+#include <sys/mman.h>	// For mmap and munmap
+#include <stdexcept>	// For std::runtime_error
+#include <cstring>		// For std::memset, std::strerror and std::strncmp
+#include <cstdio>		// For std::snprintf
+#include <cerrno>		// For errno
+#include <ctime>		// For clock_gettime
+
+static const char* const method_names[Metrics::METHOD_COUNT] = { "GET", "HEAD", "POST", "PUT", "DELETE", "OTHER" };
+// Label of each method, in the order of the Method enum.
+
+#define METRICS_FIRST_EXPORTED 36
+// First bucket written in the output (it ends at 1.28 µs): the shorter ones are added to it.
+
+Metrics::Metrics(size_t workers) : slots(NULL), worker_count(workers == 0 ? 1 : workers) {
+    void* memory = mmap(NULL, worker_count * sizeof(Worker), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        throw std::runtime_error("Failed to map the metrics: " + std::string(std::strerror(errno)));
+    }
+    slots = static_cast<Worker*>(memory);
+    // An anonymous mapping starts filled with zeros. The workers inherit it with fork().
+}
+
+Metrics::~Metrics() {
+    munmap(slots, worker_count * sizeof(Worker));
+}
+
+Metrics::Worker& Metrics::getWorker(size_t index) {
+    Worker& worker = slots[index < worker_count ? index : worker_count - 1];
+    worker.active = 0;
+    // A worker that crashed did not close its connections one by one.
+    return worker;
+}
+
+unsigned long Metrics::now() {
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return time.tv_sec * 1000000000UL + time.tv_nsec;
+    // On Linux the clock is read in the vDSO, without a system call.
+}
+
+Metrics::Method Metrics::getMethod(const char* name, size_t length) {
+    for (size_t i = 0; i < METHOD_OTHER; ++i) {
+        if (std::strlen(method_names[i]) == length && std::strncmp(method_names[i], name, length) == 0) {
+            return static_cast<Method>(i);
+        }
+    }
+    return METHOD_OTHER;
+}
+
+void Metrics::countResponse(Worker& worker, int status) {
+    ++worker.responses[status >= 0 && status < METRICS_MAX_STATUS ? status : 0];
+}
+
+size_t Metrics::findBucket(unsigned long nanoseconds) {
+    if (nanoseconds < METRICS_SUB_BUCKETS) {
+        return nanoseconds;
+    }
+    size_t power = sizeof(unsigned long) * 8 - 1 - __builtin_clzl(nanoseconds);
+    size_t bucket = (power - 1) * METRICS_SUB_BUCKETS + (nanoseconds >> (power - 2)) - METRICS_SUB_BUCKETS;
+    return bucket < METRICS_BUCKETS ? bucket : METRICS_BUCKETS - 1;
+    // The two bits after the highest one choose the bucket within its power of two.
+}
+
+unsigned long Metrics::getBucketEnd(size_t bucket) {
+    if (bucket < METRICS_SUB_BUCKETS) {
+        return bucket + 1;
+    }
+    size_t power = bucket / METRICS_SUB_BUCKETS + 1;
+    unsigned long mantissa = bucket % METRICS_SUB_BUCKETS + METRICS_SUB_BUCKETS;
+    return (mantissa + 1) << (power - 2);
+}
+
+void Metrics::record(Histogram& histogram, unsigned long nanoseconds) {
+    ++histogram.buckets[findBucket(nanoseconds)];
+    ++histogram.count;
+    histogram.sum += nanoseconds;
+}
+
+static void append(std::string& text, const char* format, const char* name, unsigned long value) {
+    char line[256];
+    int length = std::snprintf(line, sizeof(line), format, name, value);
+    text.append(line, length < static_cast<int>(sizeof(line)) ? length : sizeof(line) - 1);
+}
+
+static void appendCounter(std::string& text, const char* name, const char* type, const char* help, unsigned long value) {
+    text.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    text.append("# TYPE ").append(name).append(" ").append(type).append("\n");
+    append(text, "%s %lu\n", name, value);
+}
+
+void Metrics::formatHistogram(std::string& text, const char* name, const char* help, const Histogram& histogram) {
+    text.append("# HELP ").append(name).append(" ").append(help).append("\n");
+    text.append("# TYPE ").append(name).append(" histogram\n");
+    unsigned long cumulative = 0;
+    char line[256];
+    for (size_t i = 0; i < METRICS_BUCKETS - 1; ++i) {
+        cumulative += histogram.buckets[i];
+        if (i >= METRICS_FIRST_EXPORTED) {
+            int length = std::snprintf(line, sizeof(line), "%s_bucket{le=\"%.9g\"} %lu\n", name,
+                getBucketEnd(i) / 1e9, cumulative);
+            text.append(line, length);
+        }
+    }
+    int length = std::snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %lu\n%s_sum %.9f\n%s_count %lu\n",
+        name, histogram.count, name, histogram.sum / 1e9, name, histogram.count);
+    text.append(line, length);
+}
+
+void Metrics::format(std::string& text) const {
+    Worker total;
+    std::memset(&total, 0, sizeof(total));
+    for (size_t w = 0; w < worker_count; ++w) {
+        const Worker& worker = slots[w];
+        total.accepted += worker.accepted;
+        total.active += worker.active;
+        for (size_t i = 0; i < METHOD_COUNT; ++i) {
+            total.requests[i] += worker.requests[i];
+        }
+        for (size_t i = 0; i < METRICS_MAX_STATUS; ++i) {
+            total.responses[i] += worker.responses[i];
+        }
+        total.received += worker.received;
+        total.sent += worker.sent;
+        total.cache_hits += worker.cache_hits;
+        total.cache_misses += worker.cache_misses;
+        total.write_stalls += worker.write_stalls;
+        total.log_dropped += worker.log_dropped;
+        const Histogram* from[2] = { &worker.parse, &worker.handler };
+        Histogram* to[2] = { &total.parse, &total.handler };
+        for (size_t h = 0; h < 2; ++h) {
+            for (size_t i = 0; i < METRICS_BUCKETS; ++i) {
+                to[h]->buckets[i] += from[h]->buckets[i];
+            }
+            to[h]->count += from[h]->count;
+            to[h]->sum += from[h]->sum;
+        }
+    }
+    // The workers are added up: one series per metric, whatever the number of workers.
+    text.clear();
+    appendCounter(text, "webserv_workers", "gauge", "Worker processes.", worker_count);
+    appendCounter(text, "webserv_connections_accepted_total", "counter", "Client connections accepted.", total.accepted);
+    appendCounter(text, "webserv_connections_active", "gauge", "Client connections open.", total.active);
+    text.append("# HELP webserv_requests_total Requests received, by method.\n");
+    text.append("# TYPE webserv_requests_total counter\n");
+    for (size_t i = 0; i < METHOD_COUNT; ++i) {
+        char line[128];
+        int length = std::snprintf(line, sizeof(line), "webserv_requests_total{method=\"%s\"} %lu\n",
+            method_names[i], total.requests[i]);
+        text.append(line, length);
+    }
+    text.append("# HELP webserv_responses_total Responses sent, by status code.\n");
+    text.append("# TYPE webserv_responses_total counter\n");
+    for (size_t i = 0; i < METRICS_MAX_STATUS; ++i) {
+        if (total.responses[i] != 0) {
+            char line[128];
+            int length = std::snprintf(line, sizeof(line), "webserv_responses_total{code=\"%lu\"} %lu\n",
+                static_cast<unsigned long>(i), total.responses[i]);
+            text.append(line, length);
+        }
+    }
+    appendCounter(text, "webserv_received_bytes_total", "counter", "Bytes read from the clients.", total.received);
+    appendCounter(text, "webserv_sent_bytes_total", "counter", "Bytes written to the clients.", total.sent);
+    appendCounter(text, "webserv_file_cache_hits_total", "counter", "File cache lookups answered from memory.",
+        total.cache_hits);
+    appendCounter(text, "webserv_file_cache_misses_total", "counter", "File cache lookups that read the file system.",
+        total.cache_misses);
+    appendCounter(text, "webserv_write_stalls_total", "counter", "Writes that left output because the socket was full.",
+        total.write_stalls);
+    appendCounter(text, "webserv_log_dropped_total", "counter", "Log records dropped because the log buffer was full.",
+        total.log_dropped);
+    formatHistogram(text, "webserv_request_parse_seconds", "Time to parse a request.", total.parse);
+    formatHistogram(text, "webserv_request_handler_seconds",
+        "Time to route a request and queue its response or start its handler.", total.handler);
+}
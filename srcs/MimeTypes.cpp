@@ -0,0 +1,165 @@
+#include "MimeTypes.hpp"	// Include the header file for the MimeTypes class
+#include <fstream>			// For std::ifstream to read the mime_types file
+#include <sstream>			// For std::istringstream to split its lines
+#include <map>				// For std::map to merge the built-in table and the file
+#include <stdexcept>		// For std::runtime_error
+#include <cctype>			// For std::tolower
+
+static const char* const builtin_types[][2] = {
+    { "html", "text/html" }, { "htm", "text/html" }, { "css", "text/css" }, { "txt", "text/plain" },
+    { "csv", "text/csv" }, { "xml", "text/xml" }, { "md", "text/markdown" },
+    { "js", "application/javascript" }, { "mjs", "application/javascript" }, { "json", "application/json" },
+    { "map", "application/json" }, { "wasm", "application/wasm" }, { "pdf", "application/pdf" },
+    { "zip", "application/zip" }, { "gz", "application/gzip" }, { "tar", "application/x-tar" },
+    { "bin", "application/octet-stream" }, { "jpg", "image/jpeg" }, { "jpeg", "image/jpeg" },
+    { "png", "image/png" }, { "gif", "image/gif" }, { "webp", "image/webp" }, { "avif", "image/avif" },
+    { "svg", "image/svg+xml" }, { "ico", "image/x-icon" }, { "bmp", "image/bmp" },
+    { "woff", "font/woff" }, { "woff2", "font/woff2" }, { "ttf", "font/ttf" }, { "otf", "font/otf" },
+    { "mp3", "audio/mpeg" }, { "ogg", "audio/ogg" }, { "wav", "audio/wav" }, { "mp4", "video/mp4" },
+    { "webm", "video/webm" }
+};
+// The types every site serves. A mime_types file adds to them or overrides them.
+
+#define MAX_EXTENSION 16
+// Longest extension looked up. A longer one is not in any table, so it gets default_type.
+
+static std::string toLower(const std::string& value) {
+    std::string lower(value);
+    for (size_t i = 0; i < lower.size(); ++i) {
+        lower[i] = std::tolower(static_cast<unsigned char>(lower[i]));
+    }
+    return lower;
+}
+
+static void readFile(const std::string& file, std::map<std::string, std::string>& extensions) {
+    std::ifstream input(file.c_str());
+    if (!input.is_open()) {
+        throw std::runtime_error("Failed to open mime_types: " + file);
+    }
+    std::string line;
+    while (std::getline(input, line)) {
+        line = line.substr(0, line.find('#'));
+        for (size_t start = 0; start < line.size();) {
+            size_t end = line.find(';', start);
+            end = end == std::string::npos ? line.size() : end;
+            std::istringstream words(line.substr(start, end - start));
+            start = end + 1;
+            // A statement ends at the end of its line (Apache) or at a ; (nginx).
+            std::string type;
+            std::string word;
+            while (words >> word) {
+                if (word == "types" || word == "{" || word == "}" || word == "types{") {
+                    continue;
+                    // The block of the nginx format around the statements.
+                }
+                if (type.empty()) {
+                    if (word.find('/') == std::string::npos) {
+                        throw std::runtime_error("mime_types: extension " + word + " has no type in " + file);
+                    }
+                    type = word;
+                } else {
+                    extensions[toLower(word)] = type;
+                }
+            }
+        }
+    }
+}
+
+MimeTypes::MimeTypes() {
+    build("", "application/octet-stream", "", "");
+}
+
+MimeTypes::MimeTypes(const Config& config) {
+    std::string charset = config.get("charset");
+    build(config.get("mime_types"), config.get("default_type").empty() ? "application/octet-stream"
+        : config.get("default_type"), charset == "off" ? "" : charset,
+        config.get("charset_types").empty() ? "text/html,text/css,text/plain,text/xml,application/javascript,application/json"
+        : config.get("charset_types"));
+}
+
+void MimeTypes::build(const std::string& file, const std::string& default_type, const std::string& charset,
+    const std::string& charset_types) {
+    std::map<std::string, std::string> extensions;
+    for (size_t i = 0; i < sizeof(builtin_types) / sizeof(builtin_types[0]); ++i) {
+        extensions[builtin_types[i][0]] = builtin_types[i][1];
+    }
+    if (!file.empty()) {
+        readFile(file, extensions);
+    }
+    std::map<std::string, size_t> indexes;
+    size_t size = 1;
+    while (size < extensions.size() * 2) {
+        size *= 2;
+    }
+    Slot free_slot;
+    free_slot.type = 0;
+    slots.assign(size, free_slot);
+    types.clear();
+    for (std::map<std::string, std::string>::const_iterator it = extensions.begin(); it != extensions.end(); ++it) {
+        if (it->first.size() > MAX_EXTENSION) {
+            continue;
+        }
+        std::map<std::string, size_t>::iterator known = indexes.find(it->second);
+        if (known == indexes.end()) {
+            known = indexes.insert(std::make_pair(it->second, types.size())).first;
+            types.push_back(it->second + (!charset.empty() && isType(it->second, charset_types) ? "; charset=" + charset : ""));
+            // Each type is stored once, with its charset, however many extensions it has.
+        }
+        size_t index = hash(it->first.data(), it->first.size()) & (size - 1);
+        while (!slots[index].extension.empty()) {
+            index = (index + 1) & (size - 1);
+        }
+        slots[index].extension = it->first;
+        slots[index].type = known->second;
+    }
+    types.push_back(default_type + (!charset.empty() && isType(default_type, charset_types) ? "; charset=" + charset : ""));
+}
+
+unsigned MimeTypes::hash(const char* extension, size_t length) {
+    unsigned value = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        value = (value ^ static_cast<unsigned char>(extension[i])) * 16777619u;
+    }
+    return value;
+}
+
+const std::string& MimeTypes::find(const std::string& path) const {
+    size_t dot = path.size();
+    while (dot > 0 && path[dot - 1] != '.' && path[dot - 1] != '/') {
+        --dot;
+    }
+    if (dot < 2 || path[dot - 1] != '.' || path[dot - 2] == '/' || path.size() - dot > MAX_EXTENSION) {
+        return types.back();
+        // No extension: a name without a dot, or a hidden file like .htaccess.
+    }
+    char extension[MAX_EXTENSION];
+    size_t length = path.size() - dot;
+    for (size_t i = 0; i < length; ++i) {
+        extension[i] = std::tolower(static_cast<unsigned char>(path[dot + i]));
+    }
+    for (size_t index = hash(extension, length) & (slots.size() - 1); !slots[index].extension.empty();
+        index = (index + 1) & (slots.size() - 1)) {
+        if (slots[index].extension.size() == length && slots[index].extension.compare(0, length, extension, length) == 0) {
+            return types[slots[index].type];
+        }
+    }
+    return types.back();
+    // The table is never more than half full, so a free slot always ends the search.
+}
+
+bool MimeTypes::isType(const std::string& content_type, const std::string& list) {
+    size_t length = content_type.find(';');
+    length = length == std::string::npos ? content_type.size() : length;
+    while (length > 0 && content_type[length - 1] == ' ') {
+        --length;
+    }
+    for (size_t start = 0; start < list.size();) {
+        size_t end = list.find_first_of(", ", start);
+        end = end == std::string::npos ? list.size() : end;
+        if (end - start == length && list.compare(start, length, content_type, 0, length) == 0) {
+            return true;
+        }
+        start = end + 1;
+    }
+    return false;
+}
@@ -0,0 +1,166 @@
+#include "OutputQueue.hpp"	// Include the header file for the OutputQueue class
+#include <sys/socket.h>		// For send
+#include <sys/uio.h>		// For writev and struct iovec
+#include <unistd.h>			// For pread
+#include <climits>			// For IOV_MAX
+#include <cerrno>			// For errno
+#ifdef __linux__
+# include <sys/sendfile.h>	// For sendfile
+#endif
+
+#ifndef IOV_MAX
+# define IOV_MAX 16
+#endif
+#define MAX_IOVECS (IOV_MAX < 64 ? IOV_MAX : 64)
+// Maximum number of segments given to a single writev().
+
+OutputQueue::OutputQueue() : head(0), pending(0), queued(0) {}
+
+OutputQueue::~OutputQueue() {
+    for (size_t i = head; i < segments.size(); ++i) {
+        if (segments[i].file != NULL) {
+            FileCache::release(segments[i].file);
+        }
+    }
+}
+
+void OutputQueue::append(const std::string& data) {
+    append(data.data(), data.size());
+}
+
+void OutputQueue::append(const char* data, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    if (segments.size() == head || segments.back().file != NULL) {
+        Segment segment;
+        segment.file = NULL;
+        segment.offset = buffer.size();
+        segment.length = 0;
+        segments.push_back(segment);
+    }
+    buffer.append(data, length);
+    segments.back().length += length;
+    pending += length;
+    queued += length;
+    // The last buffer segment always ends at the end of the buffer, so it just grows.
+    // Merging buffers keeps one segment per group of small responses (e.g., pipelined ones).
+}
+
+void OutputQueue::appendFile(const FileCache::Entry* file, off_t offset, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    Segment segment;
+    segment.file = file;
+    segment.offset = offset;
+    segment.length = length;
+    FileCache::acquire(file);
+    // The entry must stay alive until the segment is sent, even if the cache evicts it.
+    segments.push_back(segment);
+    pending += length;
+    queued += length;
+}
+
+ssize_t OutputQueue::sendFile(int fd, Segment& segment) {
+#ifdef __linux__
+    off_t offset = segment.offset;
+    ssize_t bytes = sendfile(fd, segment.file->fd, &offset, segment.length);
+    // The kernel copies from the page cache to the socket; the offset is passed explicitly,
+    // so several downloads can share the same file descriptor.
+    return bytes;
+#else
+    char data[65536];
+    size_t length = segment.length < sizeof(data) ? segment.length : sizeof(data);
+    ssize_t bytes = pread(segment.file->fd, data, length, segment.offset);
+    if (bytes <= 0) {
+        errno = EIO;
+        return -1;
+    }
+    ssize_t sent = send(fd, data, bytes, 0);
+    return sent;
+#endif
+}
+
+ssize_t OutputQueue::sendMemory(int fd) {
+    struct iovec iov[MAX_IOVECS];
+    int count = 0;
+    for (size_t i = head; i < segments.size() && count < MAX_IOVECS; ++i, ++count) {
+        const Segment& segment = segments[i];
+        if (segment.file == NULL) {
+            iov[count].iov_base = const_cast<char*>(buffer.data()) + segment.offset;
+        } else if (segment.file->fd == -1) {
+            iov[count].iov_base = const_cast<char*>(segment.file->content.data()) + segment.offset;
+            // The body of a file in memory is sent straight from the cache entry.
+        } else {
+            break;
+            // A file segment with a file descriptor is sent with sendfile() on its own.
+        }
+        iov[count].iov_len = segment.length;
+    }
+    return writev(fd, iov, count);
+    // The headers and the body go out in one system call, without joining them first.
+    // SIGPIPE is ignored by the process, so a closed client only makes writev() fail.
+}
+
+void OutputQueue::consume(size_t bytes) {
+    pending -= bytes;
+    while (bytes > 0) {
+        Segment& segment = segments[head];
+        size_t sent = bytes < segment.length ? bytes : segment.length;
+        segment.offset += sent;
+        segment.length -= sent;
+        bytes -= sent;
+        if (segment.length != 0) {
+            break;
+        }
+        if (segment.file != NULL) {
+            FileCache::release(segment.file);
+        }
+        ++head;
+    }
+    if (head == segments.size()) {
+        segments.clear();
+        buffer.clear();
+        head = 0;
+        // Everything was sent: clear() keeps the capacity for the next responses.
+    }
+}
+
+bool OutputQueue::flush(int fd) {
+    while (head < segments.size()) {
+        Segment& segment = segments[head];
+        ssize_t bytes;
+        if (segment.file == NULL || segment.file->fd == -1) {
+            bytes = sendMemory(fd);
+        } else {
+            bytes = sendFile(fd, segment);
+        }
+        if (bytes > 0) {
+            consume(bytes);
+            continue;
+        }
+        if (bytes == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+            // The socket buffer is full, the rest is sent on the next EVENT_WRITE.
+        }
+        return false;
+        // The client is gone, or the file became shorter than expected (bytes == 0).
+    }
+    return true;
+}
+
+bool OutputQueue::empty() const {
+    return pending == 0;
+}
+
+size_t OutputQueue::size() const {
+    return pending;
+}
+
+size_t OutputQueue::getQueued() const {
+    return queued;
+}
@@ -0,0 +1,184 @@
+#include "PathCache.hpp"	// Include the header file for the PathCache class
+#include <sys/stat.h>		// For stat
+#include <dirent.h>			// For opendir, readdir and closedir
+#include <algorithm>		// For std::sort
+#include <cstdio>			// For std::snprintf
+#include <cstring>			// For std::memcmp and std::strchr
+
+struct ListingEntry {
+    std::string name;		// Name of the entry in the directory.
+    bool directory;			// True if the entry is a directory.
+    time_t mtime;			// Modification time of the entry.
+    off_t size;				// Size of the entry, in bytes.
+};
+
+static bool entryBefore(const ListingEntry& a, const ListingEntry& b) {
+    if (a.directory != b.directory) {
+        return a.directory;
+        // The directories come first, like in the listings of nginx.
+    }
+    return a.name < b.name;
+}
+
+static void appendHref(std::string& row, const std::string& name) {
+    static const char hex[] = "0123456789ABCDEF";
+    for (size_t i = 0; i < name.size(); ++i) {
+        unsigned char c = name[i];
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || std::strchr("-._~", c) != NULL) {
+            row += c;
+        } else {
+            row += '%';
+            row += hex[c >> 4];
+            row += hex[c & 15];
+        }
+    }
+    // The name is percent-encoded in the link: a file called "a b#c" must not become a fragment.
+}
+
+static void appendText(std::string& row, const std::string& name) {
+    for (size_t i = 0; i < name.size(); ++i) {
+        switch (name[i]) {
+        case '<': row += "&lt;"; break;
+        case '>': row += "&gt;"; break;
+        case '&': row += "&amp;"; break;
+        case '"': row += "&quot;"; break;
+        default: row += name[i];
+        }
+    }
+}
+
+PathCache::PathCache(size_t size) : slots(roundSize(size)), validity(0), hits(0), misses(0) {}
+
+void PathCache::setLimits(size_t size, time_t seconds) {
+    validity = seconds;
+    if (roundSize(size) != slots.size()) {
+        std::vector<Slot>(roundSize(size)).swap(slots);
+        // The paths would go to other slots: the table starts empty.
+    }
+}
+
+size_t PathCache::roundSize(size_t size) {
+    size_t rounded = 1;
+    while (rounded < size) {
+        rounded *= 2;
+    }
+    return rounded;
+}
+
+PathCache::Slot& PathCache::lookup(const char* path, size_t length) {
+    unsigned hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        hash = (hash ^ static_cast<unsigned char>(path[i])) * 16777619u;
+    }
+    Slot& slot = slots[hash & (slots.size() - 1)];
+    // FNV-1a: the path goes to one slot, there is no chain to follow.
+    time_t now = std::time(NULL);
+    bool same = slot.path.size() == length && std::memcmp(slot.path.data(), path, length) == 0;
+    if (same && now - slot.checked < validity) {
+        ++hits;
+        return slot;
+    }
+    ++misses;
+    if (!same) {
+        slot.path.assign(path, length);
+        slot.has_listing = false;
+        // Another path took the slot.
+    }
+    struct stat info;
+    if (stat(slot.path.c_str(), &info) == -1) {
+        slot.kind = KIND_MISSING;
+        slot.mtime = 0;
+    } else {
+        slot.kind = S_ISREG(info.st_mode) ? KIND_FILE : S_ISDIR(info.st_mode) ? KIND_DIRECTORY : KIND_OTHER;
+        slot.mtime = info.st_mtime;
+    }
+    slot.checked = now;
+    if (slot.kind != KIND_DIRECTORY || slot.mtime != slot.listed) {
+        slot.has_listing = false;
+        // The directory changed since its listing was built.
+    }
+    return slot;
+}
+
+PathCache::Kind PathCache::find(const char* path, size_t length) {
+    return lookup(path, length).kind;
+}
+
+const std::string* PathCache::findListing(const char* path, size_t length) {
+    Slot& slot = lookup(path, length);
+    if (slot.kind != KIND_DIRECTORY) {
+        return NULL;
+    }
+    if (!slot.has_listing) {
+        if (!buildListing(slot.path, slot.listing)) {
+            return NULL;
+        }
+        slot.listed = slot.mtime;
+        slot.has_listing = slot.mtime < slot.checked;
+        // A file added or removed changes the modification time of the directory. A listing
+        // built in the second the directory changed is not kept: a file added later in that
+        // second would not change its modification time, which only counts seconds.
+    }
+    return &slot.listing;
+}
+
+bool PathCache::buildListing(const std::string& path, std::string& listing) {
+    DIR* directory = opendir(path.c_str());
+    if (directory == NULL) {
+        return false;
+    }
+    std::vector<ListingEntry> entries;
+    struct dirent* item;
+    while ((item = readdir(directory)) != NULL) {
+        if (item->d_name[0] == '.') {
+            continue;
+            // ".", ".." and the hidden files are not listed.
+        }
+        ListingEntry entry;
+        entry.name = item->d_name;
+        struct stat info;
+        if (stat((path + "/" + entry.name).c_str(), &info) == -1) {
+            continue;
+            // A broken symbolic link, or a file removed while the directory was read.
+        }
+        entry.directory = S_ISDIR(info.st_mode);
+        entry.mtime = info.st_mtime;
+        entry.size = info.st_size;
+        entries.push_back(entry);
+    }
+    closedir(directory);
+    std::sort(entries.begin(), entries.end(), entryBefore);
+    listing.clear();
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const ListingEntry& entry = entries[i];
+        listing += "<a href=\"";
+        appendHref(listing, entry.name);
+        listing += entry.directory ? "/\">" : "\">";
+        appendText(listing, entry.name);
+        size_t columns = entry.name.size() + (entry.directory ? 1 : 0);
+        listing += entry.directory ? "/</a>" : "</a>";
+        char details[64];
+        char date[32];
+        std::strftime(date, sizeof(date), "%d-%b-%Y %H:%M", std::gmtime(&entry.mtime));
+        if (entry.directory) {
+            std::snprintf(details, sizeof(details), " %s %19s\r\n", date, "-");
+        } else {
+            std::snprintf(details, sizeof(details), " %s %19lu\r\n", date, static_cast<unsigned long>(entry.size));
+        }
+        listing.append(columns < 50 ? 50 - columns : 1, ' ');
+        listing += details;
+        // The names are padded to 50 columns so the dates and sizes line up in the <pre>.
+    }
+    return true;
+}
+
+void PathCache::clear() {
+    for (size_t i = 0; i < slots.size(); ++i) {
+        slots[i].checked = 0;
+        slots[i].path.clear();
+        slots[i].has_listing = false;
+    }
+}
+
+size_t PathCache::getHits() const { return hits; }
+size_t PathCache::getMisses() const { return misses; }
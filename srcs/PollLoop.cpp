@@ -0,0 +1,76 @@
+#include "PollLoop.hpp"	// Include the header file for the PollLoop class
+
+PollLoop::PollLoop() {}
+
+static short toPollEvents(int events) {
+    // Converts EVENT_READ and EVENT_WRITE into the poll() flags.
+    short flags = 0;
+    if (events & EVENT_READ) {
+        flags |= POLLIN;
+    }
+    if (events & EVENT_WRITE) {
+        flags |= POLLOUT;
+    }
+    return flags;
+}
+
+void PollLoop::add(int fd, int events) {
+    if (static_cast<size_t>(fd) >= positions.size()) {
+        positions.resize(fd + 1, -1);
+        // The table grows with the highest fd seen.
+    }
+    struct pollfd pfd;
+    pfd.fd = fd;
+    pfd.events = toPollEvents(events);
+    pfd.revents = 0;
+    positions[fd] = fds.size();
+    fds.push_back(pfd);
+}
+
+void PollLoop::modify(int fd, int events) {
+    fds[positions[fd]].events = toPollEvents(events);
+}
+
+void PollLoop::remove(int fd) {
+    int position = positions[fd];
+    if (position == -1) {
+        return;
+    }
+    fds[position] = fds.back();
+    positions[fds[position].fd] = position;
+    fds.pop_back();
+    positions[fd] = -1;
+    // The last entry takes the place of the removed one, so nothing is shifted.
+}
+
+int PollLoop::wait(std::vector<Event>& ready, int timeout_ms) {
+    ready.clear();
+    int count = poll(fds.empty() ? NULL : &fds[0], fds.size(), timeout_ms);
+    if (count <= 0) {
+        return count;
+    }
+    for (size_t i = 0; i < fds.size() && ready.size() < static_cast<size_t>(count); ++i) {
+        // poll() only marks revents, so the array is scanned until every ready fd is found.
+        if (fds[i].revents == 0) {
+            continue;
+        }
+        Event event;
+        event.fd = fds[i].fd;
+        event.events = 0;
+        if (fds[i].revents & (POLLIN | POLLHUP)) {
+            event.events |= EVENT_READ;
+        }
+        if (fds[i].revents & POLLOUT) {
+            event.events |= EVENT_WRITE;
+        }
+        if (fds[i].revents & (POLLERR | POLLNVAL)) {
+            event.events |= EVENT_ERROR;
+        }
+        ready.push_back(event);
+    }
+    return ready.size();
+}
+
+const char* PollLoop::getName() const {
+    return "poll";
+}
@@ -1,162 +1,479 @@
 #include "Request.hpp"      // Include the header file for the Request class
-#include <sstream>          // For std::istringstream
-
-Request::Request() : method(""), uri(""), version("") {}
-// Constructor initializes the method, uri, and version to empty strings.
-
-bool Request::parse(const std::string& raw_request) {
-    std::istringstream stream(raw_request);
-    // std::istringstream is used to read the raw request string line by line.
-    // The first line will be the request line, and subsequent lines will be headers,
-    // until an empty line is encountered, which indicates the end of headers.
-    // The body, if present, will be read after the headers.
-    std::string line;
-    // std::string is used to store each line of the request.
-    
-    // Parsear la primera línea
-    if (!std::getline(stream, line) || line.empty()) {
-        return false;
-        // If the first line is empty or cannot be read, return false.
-        // This indicates that the request is malformed or incomplete.
-    }
-    if (!parseRequestLine(line)) {
-        return false;
-        // If parsing the request line fails, return false.
-        // This indicates that the request line is not in the expected format.
+#include <cstring>          // For std::memchr
+#include <strings.h>        // For strncasecmp
+
+Request::Request() : data(NULL), max_header_size(0), max_body_size(0) {
+    reset();
+}
+// Constructor prepares the parser for the first request.
+
+void Request::setLimits(size_t header_size, size_t body_size) {
+    max_header_size = header_size;
+    max_body_size = body_size;
+    // The limits are kept by reset(), so they are set once per connection.
+}
+
+void Request::reset() {
+    // Resets the parser state so the object can be reused for the next request of the connection.
+    // headers.clear() keeps the capacity of the vector, so no memory is released or allocated.
+    data = NULL;
+    state = STATE_REQUEST_LINE;
+    position = 0;
+    line_start = 0;
+    error_status = 0;
+    method.offset = method.length = 0;
+    uri.offset = uri.length = 0;
+    version.offset = version.length = 0;
+    path.clear();
+    body.offset = body.length = 0;
+    headers.clear();
+    content_length = 0;
+    chunked = false;
+    decoded.clear();
+}
+
+static bool isTokenChar(char c) {
+    // Returns true if c can be part of a method or a header name (RFC 9110 tchar).
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+        return true;
     }
+    return c != '\0' && std::strchr("!#$%&'*+-.^_`|~", c) != NULL;
+}
 
-    // Parsear cabeceras
-    while (std::getline(stream, line) && line != "\r" && line != "") {
-        // Read headers until an empty line or a line with just a carriage return is encountered.
-        // An empty line indicates the end of headers.
-        // A line with just a carriage return is also treated as an empty line.
-        // This is common in HTTP requests to separate headers from the body.
-        if (!parseHeader(line)) {
-            return false;
-            // If parsing a header fails, return false.
-            // This indicates that the header line is not in the expected format.
-        }
-    }
-
-    // Leer el cuerpo (si existe)
-    std::string body_content;
-    // std::string is used to store the body content.
-    // The body content is read from the stream until the end of the stream.
-    // The body is typically present in POST requests or other methods that send data.
-    // If the request does not have a body, this will remain empty.
-    while (std::getline(stream, line)) {
-    // Read the body line by line until the end of the stream.
-        body_content += line + "\n";
-        // Append each line to the body content, adding a newline character.
-    }
-    body = body_content;
-    // Set the body member variable to the accumulated body content.
-    // This will contain the complete body of the request, including all lines read.
-    // If the body is empty, it means there was no content sent with the request.
-    return true;
-    // Return true if the request was successfully parsed, including the request line, headers, and body.
+Request::ParseStatus Request::parse(const char* bytes, size_t length) {
+    data = bytes;
+    // The buffer may have been reallocated since the last call, so the pointer is refreshed.
+    // Every view is an offset from data, so it is still valid.
+    while (state != STATE_DONE && state != STATE_ERROR) {
+        if (state == STATE_BODY) {
+            // Leer el cuerpo (si existe)
+            if (chunked) {
+                ParseStatus status = parseChunkedBody(length);
+                if (status != PARSE_COMPLETE) {
+                    return status;
+                }
+                break;
+            }
+            if (length - body.offset < content_length) {
+                position = length;
+                return PARSE_INCOMPLETE;
+                // The body has not been fully received yet.
+            }
+            body.length = content_length;
+            position = body.offset + content_length;
+            state = STATE_DONE;
+            break;
+        }
+        const char* newline = static_cast<const char*>(std::memchr(data + position, '\n', length - position));
+        // Search for the end of the current line, only in the bytes not examined yet.
+        size_t end = newline != NULL ? static_cast<size_t>(newline - data) : length;
+        if (max_header_size != 0 && end > max_header_size) {
+            return fail(state == STATE_REQUEST_LINE ? 414 : 431);
+            // The request line, or the request line and the headers together, are too long.
+            // This is checked before the line is complete so a client cannot grow the buffer forever.
+        }
+        if (newline == NULL) {
+            position = length;
+            return PARSE_INCOMPLETE;
+            // The line is not complete, the next call resumes from here.
+        }
+        position = end + 1;
+        size_t start = line_start;
+        line_start = position;
+        if (end > start && data[end - 1] == '\r') {
+            --end;
+            // Lines end with CRLF, but a bare LF is accepted too.
+        }
+        if (state == STATE_REQUEST_LINE) {
+            // Parsear la primera línea
+            if (end == start) {
+                continue;
+                // Empty lines before the request line are ignored (RFC 9112, section 2.2).
+            }
+            if (!parseRequestLine(start, end)) {
+                return PARSE_ERROR;
+            }
+            state = STATE_HEADERS;
+        } else if (end == start) {
+            // An empty line indicates the end of headers.
+            if (!finishHeaders()) {
+                return PARSE_ERROR;
+            }
+            if (chunked || content_length != 0) {
+                return PARSE_BODY;
+                // The caller may stream the body instead of keeping it in the buffer.
+            }
+        } else if (!parseHeader(start, end)) {
+            // Parsear cabeceras
+            return PARSE_ERROR;
+        }
+    }
+    return state == STATE_DONE ? PARSE_COMPLETE : PARSE_ERROR;
 }
 
-bool Request::parseRequestLine(const std::string& line) {
+bool Request::parseRequestLine(size_t start, size_t end) {
     // Parse the request line, which is expected to be in the format:
     // "METHOD URI HTTP/VERSION", e.g., "GET /index.html HTTP/1.1".
     // The method is the HTTP method (e.g., GET, POST), the URI is the resource being requested,
     // and the version is the HTTP version (e.g., HTTP/1.1).
-    std::istringstream line_stream(line);
-    // std::istringstream is used to read the request line.
-    // It allows us to extract the method, URI, and version from the line.
-    // std::istringstream is a stream class to operate on strings.
-    // It provides the same interface as std::istream, allowing us to use extraction operators.
-    // std::istringstream is used to read the request line, which is expected to be in the format:
-    // "METHOD URI HTTP/VERSION", e.g., "GET /index.html HTTP/1.1".
-    // std::string is used to store the method, URI, and version.
-    std::string temp_method, temp_uri, temp_version;
-    // std::string is used to store the method, URI, and version temporarily.
-    // std::string is a standard string class in C++ that represents a sequence of characters.
-    // It is used to store the method (e.g., GET, POST), URI (e.g., /index.html),
-    // and version (e.g., HTTP/1.1) extracted from the request line.
-    if (!(line_stream >> temp_method >> temp_uri >> temp_version)) {
+    size_t i = start;
+    while (i < end && isTokenChar(data[i])) {
+        ++i;
+    }
+    if (i == start || i == end || data[i] != ' ') {
+        fail(400);
+        return false;
+        // The method must be a non-empty token followed by a single space.
+    }
+    method.offset = start;
+    method.length = i - start;
+    uri.offset = ++i;
+    while (i < end && data[i] != ' ') {
+        ++i;
+    }
+    if (i == uri.offset || i == end) {
+        fail(400);
+        return false;
+        // The URI must be non-empty and followed by a single space.
+    }
+    uri.length = i - uri.offset;
+    const char* target = data + uri.offset;
+    const char* target_end = target + uri.length;
+    if (*target != '/' && (strncasecmp(target, "http://", 7) == 0 || strncasecmp(target, "https://", 8) == 0)) {
+        const char* authority = target + (target[4] == ':' ? 7 : 8);
+        while (authority < target_end && *authority != '/' && *authority != '?') {
+            ++authority;
+        }
+        if (authority < target_end && *authority == '/') {
+            target = authority;
+        } else {
+            target = "/";
+            target_end = target + 1;
+        }
+        // The absolute form (RFC 9112, section 3.2.2) is served like its path; an empty path is "/".
+    }
+    const char* query = static_cast<const char*>(std::memchr(target, '?', target_end - target));
+    size_t target_length = (query != NULL ? query : target_end) - target;
+    path.resize(target_length + 1);
+    size_t path_length = 0;
+    if (!normalizePath(&path[0], target, target_length, path_length)) {
+        fail(400);
         return false;
-        // If the extraction fails, return false.
-        // This indicates that the request line is not in the expected format.
-        // The expected format is "METHOD URI HTTP/VERSION", e.g., "GET /index.html HTTP/1.1".
+        // Every later use of the path (the location, the file, the script) sees the same
+        // normalized path, so none of them can be tricked with %2e%2e or "//".
     }
-    if (temp_version != "HTTP/1.1" && temp_version != "HTTP/1.0") {
+    path.resize(path_length);
+    version.offset = ++i;
+    version.length = end - i;
+    if (version.length != 8 || std::strncmp(data + i, "HTTP/1.", 7) != 0
+        || (data[i + 7] != '0' && data[i + 7] != '1')) {
+        // If the version is not HTTP/1.1 or HTTP/1.0, the request is rejected.
+        // A well-formed but unsupported version gets 505, anything else 400.
+        fail(std::strncmp(data + i, "HTTP/", 5) == 0 ? 505 : 400);
         return false;
-        // If the version is not HTTP/1.1 or HTTP/1.0, return false.
-        // This indicates that the request is using an unsupported HTTP version.
     }
-    method = temp_method;       // Set the method member variable to the extracted method.
-    uri = temp_uri;             // Set the uri member variable to the extracted URI. 
-    version = temp_version;     // Set the version member variable to the extracted version.
     return true;
-    // Return true if the request line was successfully parsed.
 }
 
-bool Request::parseHeader(const std::string& line) {
+static int hexValue(char c) {
+    // Returns the value of a hexadecimal digit, or -1.
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+        return (c | 0x20) - 'a' + 10;
+    }
+    return -1;
+}
+
+bool Request::normalizePath(char* output, const char* path, size_t length, size_t& output_length) {
+    if (length == 0 || path[0] != '/') {
+        return false;
+    }
+    size_t out = 0;
+    size_t segment = 0;
+    // Start of the segment being written, just after its slash.
+    for (size_t i = 0; i <= length;) {
+        char c = '/';
+        if (i < length) {
+            c = path[i++];
+            if (c == '%') {
+                int high = i + 1 < length ? hexValue(path[i]) : -1;
+                int low = high != -1 ? hexValue(path[i + 1]) : -1;
+                if (low == -1 || (high == 0 && low == 0)) {
+                    return false;
+                    // A truncated escape, or a NUL that would cut the path short.
+                }
+                c = static_cast<char>(high * 16 + low);
+                i += 2;
+            }
+            if (c != '/') {
+                output[out++] = c;
+                continue;
+            }
+        } else {
+            ++i;
+        }
+        // End of a segment: a slash, or the end of the path.
+        size_t segment_length = out - segment;
+        if (segment_length == 1 && output[segment] == '.') {
+            out = segment;
+        } else if (segment_length == 2 && output[segment] == '.' && output[segment + 1] == '.') {
+            if (segment <= 1) {
+                return false;
+                // ".." above the root.
+            }
+            out = segment - 1;
+            while (output[out - 1] != '/') {
+                --out;
+            }
+        }
+        if (i <= length && (out == 0 || output[out - 1] != '/')) {
+            output[out++] = '/';
+            // A decoded %2F separates segments too; empty segments ("//") are merged.
+        }
+        segment = out;
+    }
+    output_length = out;
+    return true;
+    // Each byte of the output comes from at least one byte of the input, which was already read
+    // when it is written: that is what makes the decoding safe in place.
+}
+
+bool Request::parseHeader(size_t start, size_t end) {
     // Parse a single header line, which is expected to be in the format:
     // "Header-Name: Header-Value", e.g., "Host: localhost".
-    // parseHeader slip the header line into a key-value pair, using the colon (:) as the delimiter.
-    size_t colon_pos = line.find(":");
-    if (colon_pos == std::string::npos) {
+    // The name must be a token directly followed by the colon, and the value
+    // is stored without its leading and trailing whitespace.
+    size_t colon = start;
+    while (colon < end && isTokenChar(data[colon])) {
+        ++colon;
+    }
+    if (colon == start || colon == end || data[colon] != ':') {
+        fail(400);
+        return false;
+        // If there is no colon, or there is whitespace before it, the header is malformed.
+    }
+    size_t value_start = colon + 1;
+    while (value_start < end && (data[value_start] == ' ' || data[value_start] == '\t')) {
+        ++value_start;
+    }
+    size_t value_end = end;
+    while (value_end > value_start && (data[value_end - 1] == ' ' || data[value_end - 1] == '\t')) {
+        --value_end;
+    }
+    Header header;
+    header.name.offset = start;
+    header.name.length = colon - start;
+    header.value.offset = value_start;
+    header.value.length = value_end - value_start;
+    headers.push_back(header);
+    // Store the views of the header, in the order they were received.
+    return true;
+}
+
+bool Request::finishHeaders() {
+    // Once all headers are received, the body length is known.
+    // The body is framed by Content-Length or by the chunked transfer coding.
+    bool has_length = false;
+    for (size_t i = 0; i < headers.size(); ++i) {
+        const Slice& name = headers[i].name;
+        const Slice& value = headers[i].value;
+        if (name.length == 17 && strncasecmp(data + name.offset, "Transfer-Encoding", 17) == 0) {
+            if (value.length != 7 || strncasecmp(data + value.offset, "chunked", 7) != 0 || chunked) {
+                fail(501);
+                return false;
+                // Only chunked alone is supported; other codings (e.g., gzip, chunked) are not.
+            }
+            chunked = true;
+            continue;
+        }
+        if (name.length != 14 || strncasecmp(data + name.offset, "Content-Length", 14) != 0) {
+            continue;
+        }
+        size_t number = 0;
+        for (size_t j = 0; j < value.length; ++j) {
+            char c = data[value.offset + j];
+            if (c < '0' || c > '9' || number > (static_cast<size_t>(-1) - 9) / 10) {
+                fail(400);
+                return false;
+                // The value must be a decimal number that does not overflow.
+            }
+            number = number * 10 + (c - '0');
+        }
+        if (value.length == 0 || (has_length && number != content_length)) {
+            fail(400);
+            return false;
+            // Several Content-Length headers must agree (RFC 9112, section 6.3).
+        }
+        content_length = number;
+        has_length = true;
+    }
+    if (chunked && has_length) {
+        fail(400);
+        return false;
+        // A request with both could be framed differently by a proxy (request smuggling).
+    }
+    if (max_body_size != 0 && content_length > max_body_size) {
+        fail(413);
         return false;
-        // If there is no colon in the line, return false.
-        // This indicates that the header line is not in the expected format.
-        // The colon is used to separate the header name from the header value.
-    }
-    std::string key = line.substr(0, colon_pos);
-    // Extract the key (header name) from the line, which is the part before the colon.
-    // std::string::substr is used to extract a substring from the line.
-    // The key is the header name (e.g., "Host").
-    std::string value = line.substr(colon_pos + 1);
-    // Extract the value (header value) from the line, which is the part after the colon.
-    // std::string::substr is used to extract a substring from the line.
-    // The value is the header value (e.g., "localhost").
-    
-    // Limpiar espacios iniciales y finales en el valor
-    size_t start = value.find_first_not_of(" \t");
-    // Find the first non-whitespace character in the value.
-    size_t end = value.find_last_not_of(" \t\r");
-    // Find the last non-whitespace character in the value.
-    if (start != std::string::npos && end != std::string::npos) {
-    // If both start and end are valid positions, extract the substring.
-        value = value.substr(start, end - start + 1);
-    // std::string::substr is used to extract the substring from start to end.
-    } else {
-        value = "";
-        // If either start or end is not found, set the value to an empty string.
-    }
-    headers[key] = value;
-    // Store the key-value pair in the headers map.
+        // The body is rejected before it is received (client_max_body_size).
+    }
+    body.offset = position;
+    if (chunked) {
+        decoder.reset(true, 0, max_body_size);
+    }
+    state = STATE_BODY;
     return true;
-    // Return true if the header line was successfully parsed.
-    // The headers map is used to store the header names as keys and their corresponding values.
 }
 
-std::string Request::getMethod() const { return method; }
+Request::ParseStatus Request::parseChunkedBody(size_t length) {
+    while (true) {
+        size_t consumed;
+        const char* chunk;
+        size_t chunk_length;
+        BodyDecoder::Status status = decoder.decode(data + position, length - position, consumed, chunk, chunk_length);
+        position += consumed;
+        if (status == BodyDecoder::BODY_DATA) {
+            decoded.append(chunk, chunk_length);
+            continue;
+        }
+        if (status == BodyDecoder::BODY_ERROR) {
+            return fail(decoder.getErrorStatus());
+        }
+        if (status == BodyDecoder::BODY_DONE) {
+            body.length = position - body.offset;
+            state = STATE_DONE;
+            return PARSE_COMPLETE;
+        }
+        return PARSE_INCOMPLETE;
+        // The decoder answers 413 once the decoded body exceeds client_max_body_size. The bytes
+        // decoded so far are dropped from the buffer with releaseDecoded(), so the framing of a
+        // body sent in small chunks does not count against the limit.
+    }
+}
+
+Request::ParseStatus Request::fail(int status) {
+    state = STATE_ERROR;
+    error_status = status;
+    return PARSE_ERROR;
+}
+
+std::string Request::copy(const Slice& slice) const {
+    if (data == NULL) {
+        return "";
+    }
+    return std::string(data + slice.offset, slice.length);
+    // The bytes are only copied when a handler asks for them.
+}
+
+Request::View Request::view(const Slice& slice) const {
+    View result = {data != NULL ? data + slice.offset : NULL, slice.length};
+    return result;
+}
+
+const Request::Header* Request::findHeader(const char* name, size_t length) const {
+    for (size_t i = 0; i < headers.size(); ++i) {
+        if (headers[i].name.length == length && strncasecmp(data + headers[i].name.offset, name, length) == 0) {
+            return &headers[i];
+        }
+    }
+    return NULL;
+}
+
+bool Request::hasHeaderToken(const char* name, const char* token, size_t length) const {
+    size_t name_length = std::strlen(name);
+    for (size_t i = 0; i < headers.size(); ++i) {
+        if (headers[i].name.length != name_length || strncasecmp(data + headers[i].name.offset, name, name_length) != 0) {
+            continue;
+        }
+        const char* value = data + headers[i].value.offset;
+        const char* end = value + headers[i].value.length;
+        while (value < end) {
+            const char* comma = static_cast<const char*>(std::memchr(value, ',', end - value));
+            const char* last = comma != NULL ? comma : end;
+            while (value < last && (*value == ' ' || *value == '\t')) {
+                ++value;
+            }
+            const char* after = last;
+            while (after > value && (after[-1] == ' ' || after[-1] == '\t')) {
+                --after;
+            }
+            if (static_cast<size_t>(after - value) == length && strncasecmp(value, token, length) == 0) {
+                return true;
+            }
+            value = last + 1;
+            // Empty elements ("a, , b") are allowed by the list syntax and skipped (RFC 9110, section 5.6.1).
+        }
+    }
+    return false;
+}
+
+size_t Request::getLength() const { return position; }
+// Returns the number of bytes examined, which is the full request once it is complete.
+int Request::getErrorStatus() const { return error_status; }
+// Returns the HTTP status code of the parse error.
+bool Request::isReadingBody() const { return state == STATE_BODY; }
+// Returns true while the body is being received.
+void Request::streamBody() {
+    position = body.offset;
+    state = STATE_DONE;
+    // The request ends at the empty line; the body stays in the buffer for the caller.
+}
+size_t Request::releaseDecoded() {
+    if (state != STATE_BODY || !chunked) {
+        return 0;
+    }
+    size_t released = position - body.offset;
+    position = body.offset;
+    return released;
+    // The decoded bytes are in decoded: their framing is not needed anymore.
+}
+bool Request::isChunked() const { return chunked; }
+// Returns true if the body uses the chunked transfer coding.
+size_t Request::getContentLength() const { return content_length; }
+// Returns the value of the Content-Length header.
+std::string Request::getMethod() const { return copy(method); }
 // Returns the HTTP method (e.g., GET, POST) of the request.
-std::string Request::getUri() const { return uri; }
+std::string Request::getUri() const { return copy(uri); }
 // Returns the request URI (e.g., /index.html) of the request.
-std::string Request::getVersion() const { return version; }
+std::string Request::getVersion() const { return copy(version); }
 // Returns the HTTP version (e.g., HTTP/1.1) of the request.
 std::string Request::getHeader(const std::string& key) const {
     // Returns the value of a specific header by key.
-    // The key is the name of the header (e.g., "Host").
-    std::map<std::string, std::string>::const_iterator it = headers.find(key);
-    // std::map::find is used to search for the key in the headers map.
-    if (it != headers.end()) {
-        // If the key is found in the headers map, return the corresponding value.
-        // std::map::end returns an iterator to the end of the map, which is one past the last element.
-        // If the key is not found, it returns an iterator to the end of the map.
-        // The value is the header value (e.g., "localhost").
-        return it->second;
-    // it->second is used to access the value associated with the key in the map.
-    }
-    return "";  // If the key is not found, return an empty string.
-}
-std::string Request::getBody() const { return body; }
+    // The key is the name of the header (e.g., "Host"), compared without case.
+    const Header* header = findHeader(key.c_str(), key.size());
+    if (header == NULL) {
+        return "";  // If the key is not found, return an empty string.
+    }
+    return copy(header->value);
+}
+Request::View Request::getMethodView() const { return view(method); }
+Request::View Request::getUriView() const { return view(uri); }
+Request::View Request::getVersionView() const { return view(version); }
+Request::View Request::getPathView() const {
+    View normalized = { path.data(), path.size() };
+    return normalized;
+}
+Request::View Request::getHeaderView(const char* name) const {
+    const Header* header = findHeader(name, std::strlen(name));
+    if (header == NULL) {
+        View none = {NULL, 0};
+        return none;
+    }
+    return view(header->value);
+}
+size_t Request::getHeaderCount() const { return headers.size(); }
+Request::View Request::getHeaderName(size_t index) const { return view(headers[index].name); }
+Request::View Request::getHeaderValue(size_t index) const { return view(headers[index].value); }
+// Give access to every header without copying it.
+std::string Request::getBody() const { return chunked ? decoded : copy(body); }
 // Returns the body of the request, which contains the content sent with the request.
-// The body is typically used in POST requests to send data to the server.
 // If the request does not have a body, this will return an empty string.
-// The body is the content sent with the request, which can be used to send data to the server.
-// The body is typically present in POST requests or other methods that send data.
\ No newline at end of file
+Request::View Request::getBodyView() const {
+    if (chunked) {
+        View result = {decoded.data(), decoded.size()};
+        return result;
+    }
+    return view(body);
+}
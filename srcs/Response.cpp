@@ -1,92 +1,655 @@
 #include "Response.hpp"
-#include <fstream>
-#include <sstream>
-#include <unistd.h>
-#include <fcntl.h>
-
-Response::Response(const Request& req, const Config& cfg) : request(req), config(cfg) {
-    status_code = 200;
-    status_message = "OK";
-    if (request.getMethod() == "GET") {
+#include <cstdio>       // For std::snprintf
+#include <cstdlib>      // For std::strtod
+#include <cstring>      // For std::memset, std::memcmp, std::memcpy, std::strcmp and std::strlen
+#include <ctime>        // For strptime and timegm
+#include <strings.h>    // For strncasecmp
+#include <unistd.h>     // For unlink
+#include <cerrno>       // For errno
+
+#define MAX_RANGES 16
+// Maximum number of ranges served in one multipart/byteranges response.
+// Requests with more ranges get the whole file, so a client cannot make us send many tiny parts.
+
+#define STATUS_LINE(code, reason) { code, "HTTP/1.1 " #code " " reason "\r\n", sizeof("HTTP/1.1 " #code " " reason "\r\n") - 1 }
+// Builds an entry of the status table: the whole status line is a string literal.
+
+const Response::StatusLine Response::status_lines[] = {
+    STATUS_LINE(200, "OK"),
+    STATUS_LINE(201, "Created"),
+    STATUS_LINE(204, "No Content"),
+    STATUS_LINE(206, "Partial Content"),
+    STATUS_LINE(301, "Moved Permanently"),
+    STATUS_LINE(304, "Not Modified"),
+    STATUS_LINE(400, "Bad Request"),
+    STATUS_LINE(403, "Forbidden"),
+    STATUS_LINE(404, "Not Found"),
+    STATUS_LINE(405, "Method Not Allowed"),
+    STATUS_LINE(408, "Request Timeout"),
+    STATUS_LINE(409, "Conflict"),
+    STATUS_LINE(413, "Content Too Large"),
+    STATUS_LINE(414, "URI Too Long"),
+    STATUS_LINE(416, "Range Not Satisfiable"),
+    STATUS_LINE(431, "Request Header Fields Too Large"),
+    STATUS_LINE(500, "Internal Server Error"),
+    STATUS_LINE(501, "Not Implemented"),
+    STATUS_LINE(502, "Bad Gateway"),
+    STATUS_LINE(503, "Service Unavailable"),
+    STATUS_LINE(504, "Gateway Timeout"),
+    STATUS_LINE(505, "HTTP Version Not Supported")
+};
+
+const size_t Response::status_line_count = sizeof(status_lines) / sizeof(status_lines[0]);
+
+Response::Response(const Request& req, const Router::Location& loc, FileCache& file_cache, Arena& memory)
+    : status_code(200), prebuilt_status(0), head(false), field_count(0), body(NULL), body_length(0), body_file(NULL), parts(NULL),
+    part_count(0), boundary(NULL), request(req), location(loc), cache(&file_cache), arena(memory) {
+    content_length[0] = '\0';
+    Request::View method = request.getMethodView();
+    unsigned bit = Router::parseMethod(method.data, method.length);
+    head = bit == Router::METHOD_HEAD;
+	// Whatever the status, the response to a HEAD has no body: enqueue() leaves it out and
+	// keeps the headers of the GET, Content-Length included.
+    if (bit != 0 && (location.methods & bit) == 0) {
+        setError(405);
+        setHeader("Allow", location.allow);
+		// The method exists but the location does not allow it; Allow lists the ones it does.
+    } else if (bit == Router::METHOD_GET || bit == Router::METHOD_HEAD) {
         handleGetRequest();
+    } else if (bit == Router::METHOD_DELETE && !location.upload_store.empty()) {
+        handleDeleteRequest();
     } else {
-        status_code = 501;
-        status_message = "Not Implemented";
-        setBody("<h1>501 Not Implemented</h1>");
+        status_code = prebuilt_status = 501;
+    }
+    if (prebuilt_status != 0) {
+        return;
+        // The Server sends the prebuilt error response instead of this one.
+    }
+    if (status_code != 304 && status_code != 204 && findHeader("Content-Length") == -1) {
+        std::snprintf(content_length, sizeof(content_length), "%lu", static_cast<unsigned long>(body_length));
+        setHeader("Content-Length", content_length);
+		// Cached files already have their Content-Length. A 304 or a 204 has no body, so it has none.
     }
-    std::ostringstream oss;
-    oss << body.length();
-    setHeader("Content-Length", oss.str());
 }
 
-std::string Response::generate() {
-    std::ostringstream response;
-    response << "HTTP/1.1 " << status_code << " " << status_message << "\r\n";
-    for (std::map<std::string, std::string>::const_iterator it = headers.begin(); it != headers.end(); ++it) {
-        response << it->first << ": " << it->second << "\r\n";
+void Response::enqueue(OutputQueue& output) {
+    const StatusLine& status = getStatusLine(status_code);
+    output.append(status.line, status.length);
+    for (size_t i = 0; i < field_count; ++i) {
+        output.append(fields[i].name, std::strlen(fields[i].name));
+        output.append(": ", 2);
+        output.append(fields[i].value, fields[i].length);
+        output.append("\r\n", 2);
+    }
+    output.append("\r\n", 2);
+    // The status line and the headers are copied into the buffer of the connection, which
+    // keeps its capacity between responses, so no memory is allocated after the first ones.
+    if (head) {
+        return;
+    }
+    if (body_file == NULL) {
+        if (body_length != 0) {
+            output.append(body, body_length);
+        }
+        return;
+    }
+    if (parts == NULL) {
+        appendSlice(output, 0, body_file->size);
+        // Only the headers are copied; the body is sent from the cache entry.
+        return;
+    }
+    for (size_t i = 0; i < part_count; ++i) {
+        if (parts[i].header != NULL) {
+            output.append(parts[i].header, parts[i].header_length);
+			// Each part of a multipart/byteranges body has its own small header.
+        }
+        appendSlice(output, parts[i].first, parts[i].last - parts[i].first + 1);
+    }
+    if (boundary != NULL) {
+        output.append("\r\n--", 4);
+        output.append(boundary, std::strlen(boundary));
+        output.append("--\r\n", 4);
     }
-    response << "\r\n" << body;
-    return response.str();
 }
 
-void Response::setStatus(int code, const std::string& message) {
+void Response::appendSlice(OutputQueue& output, off_t offset, size_t length) {
+    output.appendFile(body_file, offset, length);
+	// The slice is sent from the content of the entry, or from its file descriptor
+	// if the file is not in memory. In both cases the file is not copied.
+}
+
+void Response::setStatus(int code) {
     status_code = code;
-    status_message = message;
 }
 
-void Response::setHeader(const std::string& key, const std::string& value) {
-    headers[key] = value;
+int Response::getStatus() const {
+    return status_code;
 }
 
-void Response::setBody(const std::string& body_content) {
-    body = body_content;
+int Response::getPrebuiltStatus() const {
+    return prebuilt_status;
 }
 
-std::string Response::readFile(const std::string& path) {
-    int fd = open(path.c_str(), O_RDONLY);
-    if (fd == -1) {
-        return "";
+void Response::setHeader(const char* name, const char* value) {
+    int index = findHeader(name);
+    if (index == -1) {
+        if (field_count == MAX_RESPONSE_HEADERS) {
+            return;
+        }
+        index = field_count++;
+        fields[index].name = name;
+    }
+    fields[index].value = value;
+    fields[index].length = std::strlen(value);
+}
+
+void Response::setHeader(const char* name, const std::string& value) {
+    setHeader(name, value.c_str());
+    // The value is not copied; the cache entries and the members of the response outlive enqueue().
+}
+
+int Response::findHeader(const char* name) const {
+    for (size_t i = 0; i < field_count; ++i) {
+        if (std::strcmp(fields[i].name, name) == 0) {
+            return i;
+        }
     }
-    std::string content;
-    char buffer[1024];
-    ssize_t bytes;
-    while ((bytes = read(fd, buffer, sizeof(buffer))) > 0) {
-        content.append(buffer, bytes);
+    return -1;
+}
+
+void Response::removeHeader(const char* name) {
+    int index = findHeader(name);
+    if (index == -1) {
+        return;
     }
-    close(fd);
-    return content;
+    for (size_t i = index + 1; i < field_count; ++i) {
+        fields[i - 1] = fields[i];
+    }
+    --field_count;
 }
 
-std::string Response::getContentType(const std::string& path) {
-    if (path.rfind(".html") != std::string::npos) return "text/html";
-    if (path.rfind(".css") != std::string::npos) return "text/css";
-    if (path.rfind(".js") != std::string::npos) return "application/javascript";
-    if (path.rfind(".jpg") != std::string::npos || path.rfind(".jpeg") != std::string::npos) return "image/jpeg";
-    if (path.rfind(".png") != std::string::npos) return "image/png";
-    return "text/plain";
+void Response::setBody(const char* data, size_t length) {
+    body = data;
+    body_length = length;
 }
 
 void Response::handleGetRequest() {
-    std::string root = config.get("root");
-    std::string index = config.get("index");
-    std::string error_page_404 = config.get("error_page_404");
-    std::string path = root + request.getUri();
+    Request::View uri = request.getPathView();
+    char* path = static_cast<char*>(arena.allocate(location.root.size() + uri.length + location.index.size() + 1));
+    size_t length = location.root.size();
+    std::memcpy(path, location.root.data(), length);
+    std::memcpy(path + length, uri.data, uri.length);
+    length += uri.length;
+    // The settings come from the location, found by the Router without copying anything.
+    // The path was normalized by the Request, so it cannot leave the root.
+    PathCache& paths = cache->getPaths();
+    PathCache::Kind kind;
+
+    // Si la URI termina en "/", usar el archivo índice
+    if (length != 0 && path[length - 1] == '/') {
+        size_t directory_length = length;
+        std::memcpy(path + length, location.index.data(), location.index.size());
+        length += location.index.size();
+        if (paths.find(path, length) != PathCache::KIND_FILE) {
+            kind = paths.find(path, directory_length);
+            if (kind == PathCache::KIND_DIRECTORY && location.autoindex) {
+                serveListing(path, directory_length, uri);
+            } else if (kind == PathCache::KIND_DIRECTORY) {
+                setError(403);
+                // A directory without its index file is not listed unless autoindex is on.
+            } else {
+                status_code = prebuilt_status = 404;
+            }
+            return;
+        }
+    } else if ((kind = paths.find(path, length)) == PathCache::KIND_DIRECTORY) {
+        redirectToDirectory();
+        return;
+    } else if (kind != PathCache::KIND_FILE) {
+        status_code = prebuilt_status = 404;
+        return;
+        // A missing file is answered from the path cache, without stat() or open().
+    }
+    path[length] = '\0';
+
+    const FileCache::Entry* entry = serveFile(path, length);
+    if (entry != NULL) {
+        if (entry->compressible) {
+            setHeader("Vary", "Accept-Encoding");
+            // The body depends on Accept-Encoding, so caches must not give the gzip variant to everyone.
+            const FileCache::Entry* variant = acceptsGzip(request.getHeaderView("Accept-Encoding"))
+                ? cache->getGzip(entry) : NULL;
+            if (variant != NULL) {
+                entry = variant;
+                serveEntry(entry);
+                setHeader("Content-Encoding", "gzip");
+            }
+        }
+        if (isNotModified(*entry)) {
+            setNotModified();
+        } else {
+            applyRange(*entry);
+        }
+        return;
+    }
+    status_code = prebuilt_status = 404;
+    // The 404 page (error_page_404) was loaded when the worker started, with its headers.
+}
+
+void Response::redirectToDirectory() {
+    Request::View uri = request.getUriView();
+    const char* query = static_cast<const char*>(std::memchr(uri.data, '?', uri.length));
+    size_t path_length = query != NULL ? static_cast<size_t>(query - uri.data) : uri.length;
+    char* target = static_cast<char*>(arena.allocate(uri.length + 2));
+    std::memcpy(target, uri.data, path_length);
+    target[path_length] = '/';
+    std::memcpy(target + path_length + 1, uri.data + path_length, uri.length - path_length);
+    target[uri.length + 1] = '\0';
+    setError(301);
+    setHeader("Location", target);
+    // The URI is repeated as the client sent it, still encoded, with a slash before the query string.
+}
+
+static size_t copyHtml(char* output, Request::View text) {
+    // Copies text escaped for HTML into output, which has room for 6 bytes per character.
+    size_t length = 0;
+    for (size_t i = 0; i < text.length; ++i) {
+        const char* entity = text.data[i] == '<' ? "&lt;" : text.data[i] == '>' ? "&gt;"
+            : text.data[i] == '&' ? "&amp;" : text.data[i] == '"' ? "&quot;" : NULL;
+        if (entity == NULL) {
+            output[length++] = text.data[i];
+        } else {
+            std::memcpy(output + length, entity, std::strlen(entity));
+            length += std::strlen(entity);
+        }
+    }
+    return length;
+}
+
+void Response::serveListing(const char* directory, size_t length, Request::View uri) {
+    const std::string* rows = cache->getPaths().findListing(directory, length);
+    if (rows == NULL) {
+        setError(403);
+        return;
+        // The directory cannot be read.
+    }
+    static const char head[] = "<html>\r\n<head><title>Index of ";
+    static const char title_end[] = "</title></head>\r\n<body>\r\n<h1>Index of ";
+    static const char parent[] = "</h1><hr><pre><a href=\"../\">../</a>\r\n";
+    static const char tail[] = "</pre><hr></body>\r\n</html>\r\n";
+    char* page = static_cast<char*>(arena.allocate(sizeof(head) + sizeof(title_end) + sizeof(parent) + sizeof(tail)
+        + uri.length * 12 + rows->size()));
+    size_t size = 0;
+    std::memcpy(page + size, head, sizeof(head) - 1);
+    size += sizeof(head) - 1;
+    size += copyHtml(page + size, uri);
+    std::memcpy(page + size, title_end, sizeof(title_end) - 1);
+    size += sizeof(title_end) - 1;
+    size += copyHtml(page + size, uri);
+    std::memcpy(page + size, parent, sizeof(parent) - 1);
+    size += sizeof(parent) - 1;
+    std::memcpy(page + size, rows->data(), rows->size());
+    size += rows->size();
+    std::memcpy(page + size, tail, sizeof(tail) - 1);
+    size += sizeof(tail) - 1;
+    // The rows come from the path cache, built once per change of the directory; only the
+    // title, which depends on the URI, is written for each request.
+    setBody(page, size);
+    setHeader("Content-Type", "text/html");
+}
+
+void Response::handleDeleteRequest() {
+    Request::View uri = request.getPathView();
+    std::string path = Router::findUploadPath(location, uri.data, uri.length);
+    if (path.empty()) {
+        setError(403);
+        return;
+        // The path leaves the upload store.
+    }
+    if (unlink(path.c_str()) == 0) {
+        status_code = 204;
+        cache->getPaths().clear();
+        return;
+        // The path cache must not keep saying that the file exists.
+    }
+    if (errno == ENOENT || errno == ENOTDIR) {
+        status_code = prebuilt_status = 404;
+    } else if (errno == EISDIR || errno == EPERM) {
+        setError(409);
+        // Directories are not removed (unlink reports EPERM or EISDIR for them).
+    } else {
+        setError(errno == EACCES || errno == EROFS ? 403 : 500);
+    }
+}
+
+const FileCache::Entry* Response::serveFile(const char* path, size_t length) {
+    const FileCache::Entry* entry = cache->get(path, length);
+    if (entry != NULL) {
+        serveEntry(entry);
+    }
+    return entry;
+}
+
+void Response::serveEntry(const FileCache::Entry* entry) {
+    // The headers of the file were computed when it was loaded.
+    body_file = entry;
+    body_length = 0;
+    // The body is sent later straight from the entry: from its content if the file is small,
+    // with sendfile() from its file descriptor if it is big.
+    setHeader("Content-Type", entry->content_type);
+    setHeader("Content-Length", entry->content_length);
+    setHeader("Accept-Ranges", "bytes");
+    setHeader("ETag", entry->etag);
+    setHeader("Last-Modified", entry->last_modified);
+}
+
+static void trim(const char*& start, const char*& end) {
+    // Moves start and end inside the spaces and tabs around a list item.
+    while (start < end && (*start == ' ' || *start == '\t')) {
+        ++start;
+    }
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t')) {
+        --end;
+    }
+}
+
+static const char* findItemEnd(const char* position, const char* limit) {
+    // Returns the comma that ends the list item at position, or limit for the last item.
+    const char* comma = static_cast<const char*>(std::memchr(position, ',', limit - position));
+    return comma != NULL ? comma : limit;
+}
+
+static bool equals(Request::View value, const std::string& other) {
+    return value.length == other.size() && std::memcmp(value.data, other.data(), value.length) == 0;
+}
+
+bool Response::acceptsGzip(Request::View accept_encoding) {
+    // Checks Accept-Encoding (RFC 9110, section 12.5.3), e.g., "gzip, deflate;q=0.5, br".
+    // gzip is accepted if it is listed, or if "*" is listed and gzip is not, with a non-zero q.
+    // The header is read where it is, in the buffer of the connection.
+    int gzip = -1;
+    int any = -1;
+	// -1 if the coding is not listed, 0 if it is refused with q=0, 1 if it is accepted.
+    const char* position = accept_encoding.data;
+    const char* limit = accept_encoding.data + accept_encoding.length;
+    while (position < limit) {
+        const char* end = findItemEnd(position, limit);
+        const char* coding = position;
+        const char* semicolon = static_cast<const char*>(std::memchr(position, ';', end - position));
+        const char* coding_end = semicolon != NULL ? semicolon : end;
+        position = end + 1;
+        trim(coding, coding_end);
+        if (coding == coding_end) {
+            continue;
+        }
+        int accepted = 1;
+        for (const char* q = semicolon; q != NULL && q + 1 < end; ++q) {
+            if (q[0] == 'q' && q[1] == '=') {
+                char number[16];
+                size_t length = end - (q + 2) < 15 ? end - (q + 2) : 15;
+                std::memcpy(number, q + 2, length);
+                number[length] = '\0';
+                if (std::strtod(number, NULL) <= 0) {
+                    accepted = 0;
+                }
+                break;
+            }
+        }
+        size_t length = coding_end - coding;
+        if ((length == 4 && strncasecmp(coding, "gzip", 4) == 0) || (length == 6 && strncasecmp(coding, "x-gzip", 6) == 0)) {
+            gzip = accepted;
+        } else if (length == 1 && *coding == '*') {
+            any = accepted;
+        }
+    }
+    return gzip != -1 ? gzip == 1 : any == 1;
+}
+
+static bool parseHttpDate(Request::View value, time_t& date) {
+    // Parses an HTTP-date in the preferred format (e.g., "Sun, 06 Nov 1994 08:49:37 GMT").
+    char text[64];
+    if (value.length >= sizeof(text)) {
+        return false;
+    }
+    std::memcpy(text, value.data, value.length);
+    text[value.length] = '\0';
+	// strptime needs a null-terminated string; a valid date has 29 characters.
+    struct tm tm;
+    std::memset(&tm, 0, sizeof(tm));
+    const char* end = strptime(text, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (end == NULL || *end != '\0') {
+        return false;
+    }
+    date = timegm(&tm);
+    return true;
+}
+
+static bool etagMatches(Request::View list, const std::string& etag) {
+    // Checks If-None-Match: a comma-separated list of entity tags, or "*".
+    // The comparison is weak (RFC 9110, section 13.1.2), so W/"x" matches "x".
+    const char* position = list.data;
+    const char* limit = list.data + list.length;
+    while (position < limit) {
+        const char* end = findItemEnd(position, limit);
+        Request::View tag = { position, 0 };
+        const char* last = end;
+        trim(tag.data, last);
+        tag.length = last - tag.data;
+        if (tag.length >= 2 && std::memcmp(tag.data, "W/", 2) == 0) {
+            tag.data += 2;
+            tag.length -= 2;
+        }
+        if ((tag.length == 1 && *tag.data == '*') || (tag.length != 0 && equals(tag, etag))) {
+            return true;
+        }
+        position = end + 1;
+    }
+    return false;
+}
+
+bool Response::isNotModified(const FileCache::Entry& entry) const {
+    Request::View if_none_match = request.getHeaderView("If-None-Match");
+    if (if_none_match.length != 0) {
+        return etagMatches(if_none_match, entry.etag);
+		// If-None-Match takes precedence over If-Modified-Since.
+    }
+    time_t since;
+    Request::View if_modified_since = request.getHeaderView("If-Modified-Since");
+    return if_modified_since.length != 0 && parseHttpDate(if_modified_since, since) && entry.mtime <= since;
+}
+
+void Response::setNotModified() {
+    status_code = 304;
+    body_file = NULL;
+    body_length = 0;
+    removeHeader("Content-Length");
+    removeHeader("Content-Type");
+	// A 304 only repeats the validators (ETag and Last-Modified); the client keeps its copy.
+}
+
+static off_t parseOffset(const char* data, const char* end) {
+    // Parses the decimal digits in [data, end). Values too big for a file stop growing.
+    off_t value = 0;
+    for (; data < end; ++data) {
+        if (value < (static_cast<off_t>(1) << 58)) {
+            value = value * 10 + (*data - '0');
+        }
+    }
+    return value;
+}
 
-    // Si la URI es "/", usar el archivo índice
-    if (request.getUri() == "/") {
-        path = root + "/" + index;
+static bool parseRangeSpec(const char* spec, size_t length, off_t size, off_t& first, off_t& last, bool& valid) {
+    // Parses one "first-last", "first-" or "-suffix" range of a Range header.
+    // Returns true if the range is satisfiable; valid becomes false if the syntax is wrong.
+    const char* end = spec + length;
+    const char* dash = NULL;
+    for (const char* c = spec; c < end; ++c) {
+        if (*c == '-' && dash == NULL) {
+            dash = c;
+        } else if (*c < '0' || *c > '9') {
+            valid = false;
+            return false;
+            // Only digits and a single dash.
+        }
+    }
+    if (dash == NULL || length == 1) {
+        valid = false;
+        return false;
+    }
+    if (dash == spec) {
+        // Suffix range: the last N bytes.
+        off_t suffix = parseOffset(dash + 1, end);
+        if (suffix == 0 || size == 0) {
+            return false;
+        }
+        first = suffix < size ? size - suffix : 0;
+        last = size - 1;
+        return true;
+    }
+    first = parseOffset(spec, dash);
+    if (dash + 1 == end) {
+        last = size - 1;
+        // Open range: from first to the end of the file.
+    } else {
+        last = parseOffset(dash + 1, end);
+        if (last < first) {
+            valid = false;
+            return false;
+        }
+    }
+    if (first >= size) {
+        return false;
     }
+    if (last >= size) {
+        last = size - 1;
+    }
+    return true;
+}
 
-    std::string content = readFile(path);
-    if (content.empty()) {
-        status_code = 404;
-        status_message = "Not Found";
-        path = root + error_page_404;
-        content = readFile(path);
-        if (content.empty()) {
-            content = "<h1>404 Not Found</h1>";
+void Response::applyRange(const FileCache::Entry& entry) {
+    Request::View header = request.getHeaderView("Range");
+    if (header.length < 6 || std::memcmp(header.data, "bytes=", 6) != 0) {
+        return;
+		// No Range, or a unit other than bytes: the whole file is sent.
+    }
+    Request::View if_range = request.getHeaderView("If-Range");
+    if (if_range.length != 0 && !equals(if_range, entry.etag) && !equals(if_range, entry.last_modified)) {
+        return;
+		// The client's copy is outdated: it gets the whole new file instead of a part.
+    }
+    Part satisfiable[MAX_RANGES];
+    size_t count = 0;
+    size_t specs = 0;
+    bool valid = true;
+    const char* position = header.data + 6;
+    const char* limit = header.data + header.length;
+    while (valid && position <= limit) {
+        const char* end = findItemEnd(position, limit);
+        const char* start = position;
+        const char* last = end;
+        trim(start, last);
+        Part part;
+        specs += start != last;
+        if (start != last && parseRangeSpec(start, last - start, entry.size, part.first, part.last, valid)) {
+            if (count == MAX_RANGES) {
+                return;
+                // Too many ranges: the whole file is sent.
+            }
+            part.header = NULL;
+            part.header_length = 0;
+            satisfiable[count++] = part;
         }
+        position = end + 1;
+    }
+    if (!valid || specs == 0) {
+        return;
+		// A malformed Range header is ignored (RFC 9110, section 14.2). The range set needs at
+		// least one range-spec: "bytes=" or "bytes=," is malformed, not unsatisfiable.
+    }
+    if (count == 0) {
+        body_file = NULL;
+        setError(416);
+        char* content_range = static_cast<char*>(arena.allocate(32));
+        std::snprintf(content_range, 32, "bytes */%lu", static_cast<unsigned long>(entry.size));
+        setHeader("Content-Range", content_range);
+        removeHeader("Content-Length");
+		// None of the ranges overlaps the file.
+        return;
+    }
+    body_file = &entry;
+    parts = static_cast<Part*>(arena.allocate(count * sizeof(Part)));
+    std::memcpy(parts, satisfiable, count * sizeof(Part));
+    part_count = count;
+    status_code = 206;
+    if (count == 1) {
+        char* content_range = static_cast<char*>(arena.allocate(72));
+        std::snprintf(content_range, 72, "bytes %lu-%lu/%lu", static_cast<unsigned long>(parts[0].first),
+            static_cast<unsigned long>(parts[0].last), static_cast<unsigned long>(entry.size));
+        setHeader("Content-Range", content_range);
+        std::snprintf(content_length, sizeof(content_length), "%lu",
+            static_cast<unsigned long>(parts[0].last - parts[0].first + 1));
+        setHeader("Content-Length", content_length);
+        return;
     }
-    setBody(content);
-    setHeader("Content-Type", getContentType(path));
-}
\ No newline at end of file
+    char* mark = static_cast<char*>(arena.allocate(64));
+    size_t boundary_length = std::snprintf(mark, 64, "webserv%lx%lx%lx", static_cast<unsigned long>(entry.mtime),
+        static_cast<unsigned long>(entry.size), static_cast<unsigned long>(count));
+    boundary = mark;
+	// The boundary only has to be absent from the parts; it is derived from the file metadata.
+    size_t length = boundary_length + 8;
+	// Length of the closing "\r\n--boundary--\r\n".
+    for (size_t i = 0; i < count; ++i) {
+        size_t capacity = boundary_length + entry.content_type.size() + 128;
+        char* part = static_cast<char*>(arena.allocate(capacity));
+        parts[i].header_length = std::snprintf(part, capacity,
+            "\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %lu-%lu/%lu\r\n\r\n", boundary,
+            entry.content_type.c_str(), static_cast<unsigned long>(parts[i].first),
+            static_cast<unsigned long>(parts[i].last), static_cast<unsigned long>(entry.size));
+        parts[i].header = part;
+        length += parts[i].header_length + parts[i].last - parts[i].first + 1;
+    }
+    char* multipart_type = static_cast<char*>(arena.allocate(boundary_length + 32));
+    std::snprintf(multipart_type, boundary_length + 32, "multipart/byteranges; boundary=%s", boundary);
+    setHeader("Content-Type", multipart_type);
+    std::snprintf(content_length, sizeof(content_length), "%lu", static_cast<unsigned long>(length));
+    setHeader("Content-Length", content_length);
+}
+
+void Response::setError(int code) {
+    status_code = code;
+    const StatusLine& status = getStatusLine(code);
+    char* error = static_cast<char*>(arena.allocate(status.length + 16));
+    int length = std::snprintf(error, status.length + 16, "<h1>%d %.*s</h1>", code,
+        static_cast<int>(status.length - 15), status.line + 13);
+	// The reason phrase is taken from the status line, without "HTTP/1.1 NNN " and the CRLF.
+    setBody(error, length);
+    setHeader("Content-Type", "text/html");
+}
+
+const Response::StatusLine& Response::getStatusLine(int code) {
+    size_t low = 0;
+    size_t high = status_line_count;
+    while (low < high) {
+        size_t middle = (low + high) / 2;
+        if (status_lines[middle].code < code) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low < status_line_count && status_lines[low].code == code) {
+        return status_lines[low];
+    }
+    return getStatusLine(500);
+    // Every code the server sends is in the table; an unknown one is a bug, reported as 500.
+}
+
+std::string Response::getStatusMessage(int code) {
+    const StatusLine& status = getStatusLine(code);
+    if (status.code != code) {
+        return "";
+        // Codes that are not in the table (e.g., sent by a CGI script) have no known reason.
+    }
+    return std::string(status.line + 13, status.length - 15);
+    // The reason phrase is the status line without "HTTP/1.1 NNN " and the final CRLF.
+}
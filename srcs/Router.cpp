@@ -0,0 +1,399 @@
+#include "Router.hpp"	// Include the header file for the Router class
+#include <algorithm>	// For std::sort and std::lower_bound
+#include <sstream>		// For std::istringstream to split the values with several words
+#include <stdexcept>	// For std::runtime_error
+#include <cctype>		// For std::tolower
+#include <cstring>		// For std::memcmp and std::memchr
+#include <strings.h>	// For strncasecmp
+
+static bool longerPrefix(const Router::Location& a, const Router::Location& b) {
+    return a.prefix.size() > b.prefix.size();
+}
+
+static bool nameBefore(const std::pair<std::string, size_t>& a, const std::pair<std::string, size_t>& b) {
+    return a.first < b.first;
+}
+
+static std::string toLower(const std::string& text) {
+    std::string lower = text;
+    for (size_t i = 0; i < lower.size(); ++i) {
+        lower[i] = std::tolower(static_cast<unsigned char>(lower[i]));
+    }
+    return lower;
+}
+
+static std::vector<std::string> split(const std::string& value) {
+    // Splits a value with several words (e.g., "GET POST") at the spaces.
+    std::vector<std::string> words;
+    std::istringstream stream(value);
+    std::string word;
+    while (stream >> word) {
+        words.push_back(word);
+    }
+    return words;
+}
+
+Router::Router(const Config& config) {
+    const std::vector<Config::UpstreamBlock>& blocks = config.getUpstreams();
+    for (size_t i = 0; i < blocks.size(); ++i) {
+        addUpstream(blocks[i]);
+        // The groups are compiled first, so the locations can refer to them by index.
+    }
+    const std::vector<Config::ServerBlock>& servers = config.getServers();
+    if (servers.empty()) {
+        Config::ServerBlock server;
+        server.settings["listen"] = config.get("port").empty() ? "8080" : config.get("port");
+        server.settings["server_name"] = config.get("server_name");
+        addServer(config, server);
+        // A "key=value" file is a single server: root and index are inherited from the globals.
+    }
+    for (size_t i = 0; i < servers.size(); ++i) {
+        addServer(config, servers[i]);
+    }
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        std::stable_sort(listeners[i].names.begin(), listeners[i].names.end(), nameBefore);
+        // stable_sort keeps the first server of a duplicated name in front, so it wins.
+    }
+}
+
+void Router::addServer(const Config& config, const Config::ServerBlock& server) {
+    std::map<std::string, std::string> inherited;
+    const char* keys[] = {"root", "index", "methods", "autoindex"};
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); ++i) {
+        if (!config.get(keys[i]).empty()) {
+            inherited[keys[i]] = config.get(keys[i]);
+        }
+    }
+    for (std::map<std::string, std::string>::const_iterator it = server.settings.begin(); it != server.settings.end(); ++it) {
+        inherited[it->first] = it->second;
+        // The settings of the server override the global ones.
+    }
+    VirtualHost host;
+    host.names = split(inherited["server_name"]);
+    bool has_root_location = false;
+    for (size_t i = 0; i < server.locations.size(); ++i) {
+        std::map<std::string, std::string> settings = inherited;
+        const std::map<std::string, std::string>& own = server.locations[i].settings;
+        for (std::map<std::string, std::string>::const_iterator it = own.begin(); it != own.end(); ++it) {
+            settings[it->first] = it->second;
+        }
+        host.locations.push_back(compileLocation(server.locations[i].prefix, settings));
+        if (!host.locations.back().proxy_pass.empty()) {
+            host.locations.back().upstream = findUpstream(host.locations.back().proxy_pass);
+        }
+        has_root_location = has_root_location || server.locations[i].prefix == "/";
+    }
+    if (!has_root_location) {
+        host.locations.push_back(compileLocation("/", inherited));
+        // Without a "location /", the settings of the server apply to every other path.
+    }
+    std::stable_sort(host.locations.begin(), host.locations.end(), longerPrefix);
+    size_t index = hosts.size();
+    hosts.push_back(host);
+
+    std::vector<std::string> listen = split(inherited["listen"]);
+    if (listen.empty()) {
+        listen.push_back("8080");
+    }
+    for (size_t i = 0; i < listen.size(); ++i) {
+        if (listen[i] == "default_server") {
+            continue;
+            // Flag of the previous address, handled below.
+        }
+        bool is_default = i + 1 < listen.size() && listen[i + 1] == "default_server";
+        std::string address;
+        std::string port = listen[i];
+        size_t colon = port.rfind(':');
+        if (colon != std::string::npos) {
+            address = port.substr(0, colon);
+            port = port.substr(colon + 1);
+            if (address == "*" || address == "0.0.0.0") {
+                address.clear();
+            }
+        }
+        long number = Config::toInt(port, -1);
+        if (number <= 0 || number > 65535) {
+            throw std::runtime_error("Invalid listen address: " + listen[i]);
+        }
+        size_t l = 0;
+        while (l < listeners.size() && (listeners[l].address != address || listeners[l].port != number)) {
+            ++l;
+        }
+        if (l == listeners.size()) {
+            Listener listener;
+            listener.address = address;
+            listener.port = number;
+            listener.default_host = index;
+            listeners.push_back(listener);
+            // The first server of an address is its default host, unless another one says default_server.
+        } else if (is_default) {
+            listeners[l].default_host = index;
+        }
+        for (size_t n = 0; n < host.names.size(); ++n) {
+            listeners[l].names.push_back(std::make_pair(toLower(host.names[n]), index));
+        }
+    }
+}
+
+Router::Location Router::compileLocation(const std::string& prefix, const std::map<std::string, std::string>& settings) {
+    Location location;
+    location.prefix = prefix;
+    std::map<std::string, std::string>::const_iterator it = settings.find("root");
+    location.root = it != settings.end() ? it->second : "./www";
+    it = settings.find("index");
+    location.index = it != settings.end() ? it->second : "index.html";
+    it = settings.find("autoindex");
+    location.autoindex = it != settings.end() && it->second == "on";
+    location.methods = 0;
+    it = settings.find("methods");
+    std::vector<std::string> methods = split(it != settings.end() ? it->second : "GET");
+    for (size_t i = 0; i < methods.size(); ++i) {
+        unsigned method = parseMethod(methods[i].c_str(), methods[i].size());
+        if (method == 0) {
+            throw std::runtime_error("Unsupported method in config file: " + methods[i]);
+        }
+        if ((location.methods & method) == 0) {
+            location.allow += (location.allow.empty() ? "" : ", ") + methods[i];
+        }
+        location.methods |= method;
+    }
+    it = settings.find("cgi");
+    std::vector<std::string> cgi = split(it != settings.end() ? it->second : "");
+    if (cgi.size() % 2 != 0) {
+        throw std::runtime_error("cgi needs an extension and an interpreter: " + it->second);
+    }
+    for (size_t i = 0; i < cgi.size(); i += 2) {
+        location.cgi.push_back(std::make_pair(cgi[i], cgi[i + 1]));
+        // "cgi .php /usr/bin/php-cgi .py /usr/bin/python3" maps each extension to its interpreter.
+    }
+    it = settings.find("cgi_timeout");
+    location.cgi_timeout = Config::toInt(it != settings.end() ? it->second : "", 30);
+    it = settings.find("fastcgi_pass");
+    location.fastcgi_pass = it != settings.end() ? it->second : "";
+    if (!location.fastcgi_pass.empty() && location.fastcgi_pass.compare(0, 5, "unix:") != 0
+        && Config::toInt(location.fastcgi_pass.substr(location.fastcgi_pass.rfind(':') + 1), -1) <= 0) {
+        throw std::runtime_error("fastcgi_pass needs unix:/path or host:port: " + location.fastcgi_pass);
+    }
+    it = settings.find("fastcgi_pool_size");
+    location.fastcgi_pool_size = Config::toInt(it != settings.end() ? it->second : "", 8);
+    it = settings.find("fastcgi_keepalive_timeout");
+    location.fastcgi_keepalive_timeout = Config::toInt(it != settings.end() ? it->second : "", 60);
+    it = settings.find("fastcgi_max_fails");
+    location.fastcgi_max_fails = Config::toInt(it != settings.end() ? it->second : "", 1);
+    it = settings.find("fastcgi_fail_timeout");
+    location.fastcgi_fail_timeout = Config::toInt(it != settings.end() ? it->second : "", 10);
+    it = settings.find("upload_store");
+    location.upload_store = it != settings.end() ? it->second : "";
+    it = settings.find("proxy_pass");
+    location.proxy_pass = it != settings.end() ? it->second : "";
+    if (location.proxy_pass.compare(0, 7, "http://") == 0) {
+        location.proxy_pass.erase(0, 7);
+    }
+    if (!location.proxy_pass.empty() && location.proxy_pass[location.proxy_pass.size() - 1] == '/') {
+        location.proxy_pass.erase(location.proxy_pass.size() - 1);
+        // The URI of the request is forwarded unchanged, so "http://app/" is the same as "http://app".
+    }
+    location.upstream = 0;
+    it = settings.find("proxy_timeout");
+    location.proxy_timeout = Config::toInt(it != settings.end() ? it->second : "", 60);
+    it = settings.find("metrics");
+    location.metrics = it != settings.end() && it->second == "on";
+    return location;
+}
+
+void Router::addUpstream(const Config::UpstreamBlock& block) {
+    Upstream upstream;
+    upstream.name = block.name;
+    std::map<std::string, std::string>::const_iterator it = block.settings.find("server");
+    std::vector<std::string> words = split(it != block.settings.end() ? it->second : "");
+    // Every "server" directive of the block is joined into one value: the parameters with
+    // an = belong to the address before them.
+    for (size_t i = 0; i < words.size(); ++i) {
+        size_t equals = words[i].find('=');
+        if (equals == std::string::npos) {
+            UpstreamServer server;
+            server.address = words[i];
+            server.weight = 1;
+            server.max_fails = 1;
+            server.fail_timeout = 10;
+            if (Config::toInt(server.address.substr(server.address.rfind(':') + 1), -1) <= 0) {
+                throw std::runtime_error("upstream " + block.name + ": server needs host:port: " + words[i]);
+            }
+            upstream.servers.push_back(server);
+            continue;
+        }
+        std::string name = words[i].substr(0, equals);
+        long value = Config::toInt(words[i].substr(equals + 1), -1);
+        if (upstream.servers.empty() || value < 0 || (name == "weight" && value == 0)) {
+            throw std::runtime_error("upstream " + block.name + ": invalid server parameter: " + words[i]);
+        }
+        UpstreamServer& server = upstream.servers.back();
+        if (name == "weight") {
+            server.weight = value;
+        } else if (name == "max_fails") {
+            server.max_fails = value;
+        } else if (name == "fail_timeout") {
+            server.fail_timeout = value;
+        } else {
+            throw std::runtime_error("upstream " + block.name + ": unknown server parameter: " + words[i]);
+        }
+    }
+    if (upstream.servers.empty()) {
+        throw std::runtime_error("upstream " + block.name + " has no server");
+    }
+    upstream.balance = BALANCE_ROUND_ROBIN;
+    upstream.hash_client = false;
+    if (block.settings.find("least_conn") != block.settings.end()) {
+        upstream.balance = BALANCE_LEAST_CONN;
+    }
+    it = block.settings.find("hash");
+    if (it != block.settings.end()) {
+        if (it->second != "$request_uri" && it->second != "$remote_addr") {
+            throw std::runtime_error("upstream " + block.name + ": hash needs $request_uri or $remote_addr");
+        }
+        upstream.balance = BALANCE_HASH;
+        upstream.hash_client = it->second == "$remote_addr";
+    }
+    it = block.settings.find("keepalive");
+    upstream.keepalive = Config::toInt(it != block.settings.end() ? it->second : "", 16);
+    it = block.settings.find("keepalive_timeout");
+    upstream.keepalive_timeout = Config::toInt(it != block.settings.end() ? it->second : "", 60);
+    upstreams.push_back(upstream);
+}
+
+size_t Router::findUpstream(const std::string& proxy_pass) {
+    for (size_t i = 0; i < upstreams.size(); ++i) {
+        if (upstreams[i].name == proxy_pass) {
+            return i;
+        }
+    }
+    if (Config::toInt(proxy_pass.substr(proxy_pass.rfind(':') + 1), -1) <= 0) {
+        throw std::runtime_error("proxy_pass needs an upstream or host:port: " + proxy_pass);
+    }
+    Config::UpstreamBlock block;
+    block.name = proxy_pass;
+    block.settings["server"] = proxy_pass;
+    addUpstream(block);
+    return upstreams.size() - 1;
+    // "proxy_pass http://127.0.0.1:9000" is a group of one server with the default settings.
+}
+
+const std::vector<Router::Listener>& Router::getListeners() const {
+    return listeners;
+}
+
+const std::vector<Router::Upstream>& Router::getUpstreams() const {
+    return upstreams;
+}
+
+int Router::findListener(const std::string& address, int port) const {
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        if (listeners[i].port == port && listeners[i].address == address) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+const Router::VirtualHost& Router::findHost(size_t listener, const char* host, size_t length) const {
+    const Listener& entry = listeners[listener];
+    if (host == NULL) {
+        return hosts[entry.default_host];
+    }
+    const char* end = host + length;
+    const char* bracket = static_cast<const char*>(std::memchr(host, ']', length));
+    const char* colon = static_cast<const char*>(std::memchr(bracket != NULL ? bracket : host, ':', end - (bracket != NULL ? bracket : host)));
+    if (colon != NULL) {
+        length = colon - host;
+        // The port of the Host header is not part of the name (an IPv6 address keeps its brackets).
+    }
+    if (length > 0 && host[length - 1] == '.') {
+        --length;
+        // "example.com." is the same name as "example.com".
+    }
+    size_t low = 0;
+    size_t high = entry.names.size();
+    while (low < high) {
+        // Binary search without case in the sorted names, comparing the Host bytes in place.
+        size_t middle = (low + high) / 2;
+        const std::string& name = entry.names[middle].first;
+        size_t common = name.size() < length ? name.size() : length;
+        int order = strncasecmp(name.c_str(), host, common);
+        if (order == 0) {
+            order = name.size() < length ? -1 : (name.size() > length ? 1 : 0);
+        }
+        if (order == 0) {
+            return hosts[entry.names[middle].second];
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return hosts[entry.default_host];
+}
+
+const Router::Location* Router::findLocation(const VirtualHost& host, const char* path, size_t length) const {
+    for (size_t i = 0; i < host.locations.size(); ++i) {
+        const std::string& prefix = host.locations[i].prefix;
+        if (prefix.size() <= length && std::memcmp(prefix.data(), path, prefix.size()) == 0) {
+            return &host.locations[i];
+            // The locations are sorted by decreasing length, so this is the longest match.
+        }
+    }
+    return NULL;
+}
+
+const std::string* Router::findInterpreter(const Location& location, const char* path, size_t length,
+    size_t& script_length) {
+    if (location.cgi.empty()) {
+        return NULL;
+    }
+    for (size_t end = 1; end <= length; ++end) {
+        if (end != length && path[end] != '/') {
+            continue;
+            // Only the end of each segment can be the end of a script name.
+        }
+        for (size_t i = 0; i < location.cgi.size(); ++i) {
+            const std::string& extension = location.cgi[i].first;
+            if (extension.size() < end && std::memcmp(path + end - extension.size(), extension.data(), extension.size()) == 0) {
+                script_length = end;
+                return &location.cgi[i].second;
+            }
+        }
+    }
+    return NULL;
+}
+
+std::string Router::findUploadPath(const Location& location, const char* path, size_t length) {
+    std::string name(path + location.prefix.size(), length - location.prefix.size());
+    // The location matched the path, so the path starts with its prefix.
+    if (("/" + name + "/").find("/../") != std::string::npos) {
+        return "";
+        // The file would be outside the store.
+    }
+    size_t start = name.find_first_not_of('/');
+    name.erase(0, start == std::string::npos ? name.size() : start);
+    if (!location.upload_store.empty() && location.upload_store[location.upload_store.size() - 1] == '/') {
+        return location.upload_store + name;
+    }
+    return location.upload_store + "/" + name;
+    // "location /files/ { upload_store ./www/files; }" stores /files/a.txt in ./www/files/a.txt.
+}
+
+unsigned Router::parseMethod(const char* name, size_t length) {
+    static const struct {
+        const char* name;
+        unsigned method;
+    } methods[] = {
+        {"GET", METHOD_GET}, {"HEAD", METHOD_HEAD}, {"POST", METHOD_POST},
+        {"PUT", METHOD_PUT}, {"DELETE", METHOD_DELETE}
+    };
+    for (size_t i = 0; i < sizeof(methods) / sizeof(methods[0]); ++i) {
+        if (std::strlen(methods[i].name) == length && std::memcmp(methods[i].name, name, length) == 0) {
+            return methods[i].method;
+        }
+    }
+    return 0;
+}
@@ -3,179 +3,1382 @@
 #include <unistd.h>		// For close to close file descriptors.
 #include <stdexcept>	// For std::runtime_error to handle exceptions.
 #include <cstring>		// For strerror to get error messages from errno.
+#include <cstdio>		// For std::snprintf to build the head of the metrics response.
+#include <cerrno>		// For errno to tell EAGAIN apart from real read errors.
+#include <netdb.h>		// For getaddrinfo to resolve the address of a listen directive.
+#include <ctime>		// For std::time to track the activity of each connection.
 #include <iostream>		// For std::cerr and std::cout to print error messages and debug information.
+#include <sstream>		// For std::ostringstream to build the prefix of the reload messages.
+#include <csignal>		// For sigaction to reload the configuration on SIGHUP.
+#include <sys/time.h>	// For gettimeofday to measure how long a reload takes.
+#include <sys/stat.h>	// For stat to check that a CGI script exists.
+#include <sys/wait.h>	// For waitpid to reap the CGI scripts.
+#include <arpa/inet.h>	// For inet_ntoa to pass the address of the client to CGI scripts.
 
-Server::Server(const Config& cfg) : config(cfg) {
-    server_fd = -1;
-	// Inicializa el file descriptor del servidor a -1 para indicar que aún no se ha creado.
-    setupSocket();
-	// Configura el socket del servidor utilizando la configuración proporcionada.
+static int g_signal_pipe = -1;
+// Extremo de escritura del pipe que despierta al bucle de eventos cuando llega una señal.
+
+static void handleSignal(int signal_number) {
+    int saved_errno = errno;
+    char byte = signal_number == SIGHUP ? 'R' : signal_number == SIGCHLD ? 'C' : signal_number == SIGUSR1 ? 'O' : 'T';
+    if (write(g_signal_pipe, &byte, 1) == -1) {
+        // El pipe está lleno: el bucle ya tiene trabajo pendiente.
+    }
+    errno = saved_errno;
+	// El manejador solo escribe un byte ('R' recarga, 'C' terminó un script CGI, 'O' reabre
+	// los logs, 'T' detiene el servidor); el trabajo se hace en el bucle, fuera del manejador.
+}
+
+Server::Server(const Config& config, Metrics& shared_metrics, int worker_number) : worker(worker_number), loop(NULL), connection_count(0), timers(std::time(NULL)), file_cache(NULL), generation(NULL), signal_pipe(-1), stopping(false), spare_fd(-1), metrics(shared_metrics), counters(shared_metrics.getWorker(worker_number < 0 ? 0 : worker_number)), error_stream(error_log), saved_cerr(NULL) {
+    loop = EventLoop::create(config);
+	// Crea el bucle de eventos elegido en la configuración (epoll o poll).
+    file_cache = new FileCache(0, 0, 0, 0);
+	// Los límites de la caché se fijan en applySettings, igual que en cada recarga.
+    applySettings(config);
+    try {
+        generation = new Generation(config, hot_headers.getDate(), 1);
+		// Compila los bloques server y location en el Router y construye las páginas de error.
+        file_cache->setMimeTypes(generation->mime_types);
+		// La caché de archivos resuelve el Content-Type de cada archivo una vez, al cargarlo.
+        resolveUpstreams();
+        applyLogs(config);
+		// Abre los logs de acceso y de errores, cada uno con su hilo de escritura.
+        setupSockets();
+		// Abre un socket de escucha por cada dirección de los bloques server (listen).
+        setupSignals();
+		// Prepara el pipe por el que SIGHUP pide recargar la configuración y SIGCHLD avisa del fin de un script CGI.
+        spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+		// Descriptor de reserva para poder rechazar conexiones cuando se agotan los descriptores (EMFILE).
+    } catch (...) {
+        for (size_t i = 0; i < listen_fds.size(); ++i) {
+            close(listen_fds[i]);
+        }
+        if (generation != NULL) {
+            generation->release();
+        }
+        if (saved_cerr != NULL) {
+            std::cerr.rdbuf(saved_cerr);
+        }
+        delete file_cache;
+        delete loop;
+        throw;
+		// El destructor no se ejecuta si el constructor falla, así que se libera el bucle aquí.
+    }
 }
 
 Server::~Server() {
-    if (server_fd != -1) {
-        close(server_fd);
-		// Cierra el socket del servidor si se ha creado.
+    for (size_t i = 0; i < listen_fds.size(); ++i) {
+        close(listen_fds[i]);
+		// Cierra los sockets de escucha que se hayan creado.
     }
-    for (size_t i = 0; i < fds.size(); ++i) {
-        if (fds[i].fd != -1) {
-			// Verifica que el file descriptor del socket del cliente sea válido.
-            close(fds[i].fd);
-			// Cierra cada socket de cliente que se haya abierto si no es -1.
+    for (size_t fd = 0; fd < connections.size(); ++fd) {
+        if (connections[fd] != NULL) {
+			// Verifica que haya una conexión abierta en este file descriptor.
+            close(fd);
+            delete connections[fd];
+			// Cierra cada socket de cliente que se haya abierto y libera su estado
+			// (el destructor del script CGI lo termina y cierra sus pipes).
         }
     }
+    if (spare_fd != -1) {
+        close(spare_fd);
+    }
+    reapChildren();
+    if (signal_pipe != -1) {
+        signal(SIGHUP, SIG_DFL);
+        signal(SIGCHLD, SIG_DFL);
+        signal(SIGUSR1, SIG_DFL);
+        signal(SIGTERM, SIG_DFL);
+        signal(SIGINT, SIG_DFL);
+        close(signal_pipe);
+        close(g_signal_pipe);
+        g_signal_pipe = -1;
+    }
+    generation->release();
+    delete file_cache;
+    delete loop;
+	// Libera la generación de la configuración, la caché de archivos y el bucle de eventos.
+    if (saved_cerr != NULL) {
+        std::cerr.rdbuf(saved_cerr);
+    }
+	// std::cerr vuelve a la salida de errores; los destructores de los logs escriben lo que
+	// queda en sus buffers y detienen sus hilos.
+}
+
+void Server::applySettings(const Config& config) {
+    keepalive_timeout = config.getInt("keepalive_timeout", 15);
+	// Segundos que una conexión keep-alive puede estar inactiva antes de cerrarse.
+    keepalive_requests = config.getInt("keepalive_requests", 100);
+	// Número máximo de solicitudes atendidas en una misma conexión.
+    max_header_size = config.getSize("client_max_header_size", 8192);
+	// Tamaño máximo de la línea de solicitud y las cabeceras (431 si se supera).
+    max_body_size = config.getSize("client_max_body_size", 1024 * 1024);
+	// Tamaño máximo del cuerpo de una solicitud (413 si se supera).
+	// Estos límites se aplican a las conexiones aceptadas después de fijarlos.
+    client_header_timeout = config.getInt("client_header_timeout", 10);
+	// Segundos para recibir la línea de solicitud y las cabeceras completas (408 si se supera).
+    client_body_timeout = config.getInt("client_body_timeout", 60);
+	// Segundos sin recibir nada del cuerpo de una solicitud (408 si se supera).
+    send_timeout = config.getInt("send_timeout", 60);
+	// Segundos sin que el cliente acepte nada de la respuesta.
+	// Los plazos nuevos se aplican la próxima vez que se reprograma cada conexión.
+    worker_connections = config.getInt("worker_connections", 1024);
+	// Conexiones abiertas a la vez por este proceso; las demás se rechazan con un 503.
+    file_cache->setLimits(config.getSize("file_cache_size", 64 * 1024 * 1024),
+        config.getSize("file_cache_max_file", 1024 * 1024), config.getInt("file_cache_max_fds", 256),
+        config.getInt("file_cache_validity", 1));
+	// Caché de archivos estáticos: tamaño total en memoria, tamaño máximo de un archivo en memoria,
+	// descriptores abiertos para los archivos grandes (sendfile) y segundos entre comprobaciones.
+    file_cache->getPaths().setLimits(config.getSize("path_cache_size", 1024), config.getInt("file_cache_validity", 1));
+	// Caché de rutas (archivo, directorio o nada), con la misma validez que la de archivos.
+    file_cache->setGzip(config.get("gzip") != "off", config.getSize("gzip_min_length", 256),
+        config.get("gzip_types").empty() ? "text/html,text/css,application/javascript,text/plain" : config.get("gzip_types"),
+        config.getInt("gzip_comp_level", 6));
+	// Compresión gzip: archivos .gz junto al original, o compresión con zlib una sola vez por archivo.
 }
 
-void Server::setupSocket() {
-    // Obtener puerto de la configuración
-    std::string port_str = config.get("port");
-    if (port_str.empty()) {
-        throw std::runtime_error("No port specified in config");
-		// Si no se especifica un puerto en la configuración, lanza una excepción.
+void Server::applyLogs(const Config& config) {
+    LogFormat format;
+    format.compile(config.get("log_format"));
+	// Se compila aparte: si tiene una variable desconocida, el formato actual no cambia.
+    size_t buffer_size = config.getSize("log_buffer_size", 256 * 1024);
+    Log::Policy policy = Log::parsePolicy(config.get("log_overflow"));
+    long interval = config.getInt("log_flush_interval", 1000);
+    unsigned flush_interval = interval > 0 ? interval : 1;
+	// Tamaño del buffer circular de cada log, qué hacer si se llena (drop o block) y milisegundos
+	// máximos entre el primer registro de una tanda y su escritura.
+    std::string access_path = config.get("access_log");
+    if (access_path.empty() || access_path == "off") {
+        access_log.close();
+    } else if (!access_log.matches(access_path, buffer_size, policy, flush_interval)) {
+        access_log.open(access_path, buffer_size, policy, flush_interval);
+    }
+    std::string error_path = config.get("error_log");
+    bool to_stderr = error_path.empty() || error_path == "stderr";
+    if (saved_cerr != NULL && (to_stderr || !error_log.matches(error_path, buffer_size, policy, flush_interval))) {
+        std::cerr.rdbuf(saved_cerr);
+        saved_cerr = NULL;
+		// Mientras el log de errores se cierra o se reabre, los mensajes van a la salida de errores.
+    }
+    if (to_stderr) {
+        error_log.close();
+    } else if (!error_log.matches(error_path, buffer_size, policy, flush_interval)) {
+        error_log.open(error_path, buffer_size, policy, flush_interval);
+    }
+    if (error_log.isOpen() && saved_cerr == NULL) {
+        saved_cerr = std::cerr.rdbuf(&error_stream);
+		// Los mensajes de std::cerr del worker se escriben en el log de errores sin cambiar
+		// ninguna de las llamadas.
+    }
+    log_format = format;
+}
+
+void Server::setupSignals() {
+    int fds[2];
+    if (pipe(fds) == -1) {
+        throw std::runtime_error("Failed to create the reload pipe: " + std::string(strerror(errno)));
+    }
+    for (int i = 0; i < 2; ++i) {
+        fcntl(fds[i], F_SETFL, O_NONBLOCK);
+        fcntl(fds[i], F_SETFD, FD_CLOEXEC);
+		// No bloqueante para que el manejador nunca se detenga; los procesos hijos no lo heredan.
+    }
+    signal_pipe = fds[0];
+    g_signal_pipe = fds[1];
+    loop->add(signal_pipe, EVENT_READ);
+	// La señal despierta al bucle de eventos aunque esté esperando sin plazo.
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = handleSignal;
+    action.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigaction(SIGHUP, &action, NULL);
+    sigaction(SIGCHLD, &action, NULL);
+	// SIGCHLD solo cuando un script CGI termina, no cuando se detiene.
+    sigaction(SIGUSR1, &action, NULL);
+	// SIGUSR1 reabre los logs después de que logrotate los renombre.
+    sigaction(SIGTERM, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+	// SIGTERM y SIGINT detienen el bucle, así los logs escriben lo que tienen antes de salir.
+}
+
+void Server::reload() {
+    struct timeval start;
+    gettimeofday(&start, NULL);
+    std::ostringstream prefix;
+    if (worker >= 0) {
+        prefix << "Worker " << worker << ": ";
+    }
+    Generation* next;
+    try {
+        next = new Generation(Config(generation->config.getPath()), hot_headers.getDate(), generation->number + 1);
+		// Lee y compila la configuración nueva sin tocar la actual: si falla, todo sigue igual.
+    } catch (const std::exception& e) {
+        std::cerr << prefix.str() << "Reload failed, keeping generation " << generation->number << ": " << e.what() << std::endl;
+        return;
+    }
+    const std::vector<Router::Listener>& current = generation->router.getListeners();
+    const std::vector<Router::Listener>& listeners = next->router.getListeners();
+    std::vector<int> fds(listeners.size(), -1);
+    std::vector<bool> opened(listeners.size(), false);
+    size_t opened_count = 0;
+    try {
+        for (size_t i = 0; i < listeners.size(); ++i) {
+            int index = generation->router.findListener(listeners[i].address, listeners[i].port);
+            if (index != -1) {
+                fds[i] = listen_fds[index];
+				// La dirección no cambió: se conserva el socket y su cola de conexiones pendientes.
+            } else {
+                fds[i] = openListener(listeners[i], next->config.getInt("listen_backlog", 511));
+                opened[i] = true;
+                ++opened_count;
+            }
+        }
+    } catch (const std::exception& e) {
+        for (size_t i = 0; i < listeners.size(); ++i) {
+            if (opened[i]) {
+                close(fds[i]);
+            }
+        }
+        next->release();
+        std::cerr << prefix.str() << "Reload failed, keeping generation " << generation->number << ": " << e.what() << std::endl;
+        return;
+		// Una dirección nueva no se pudo abrir (p. ej., el puerto está en uso): no se cambia nada.
+    }
+    size_t closed_count = 0;
+    for (size_t i = 0; i < current.size(); ++i) {
+        if (next->router.findListener(current[i].address, current[i].port) == -1) {
+            loop->remove(listen_fds[i]);
+            close(listen_fds[i]);
+            ++closed_count;
+			// Las conexiones ya aceptadas en esta dirección siguen abiertas (ver adopt).
+        }
+    }
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        if (opened[i]) {
+            loop->add(fds[i], EVENT_READ);
+        }
+    }
+    if (next->config.get("event_loop") != generation->config.get("event_loop")) {
+        std::cerr << prefix.str() << "event_loop is only applied on restart" << std::endl;
+    }
+    listen_fds.swap(fds);
+    applySettings(next->config);
+    try {
+        applyLogs(next->config);
+    } catch (const std::exception& e) {
+        std::cerr << prefix.str() << "Logs not changed: " << e.what() << std::endl;
+		// Un log que no se pudo abrir (o un log_format inválido) no impide la recarga.
+    }
+    generation->release();
+    generation = next;
+    file_cache->setMimeTypes(generation->mime_types);
+    resolveUpstreams();
+	// Las solicitudes nuevas usan la generación nueva; la anterior se libera cuando la suelte
+	// su última conexión.
+    struct timeval end;
+    gettimeofday(&end, NULL);
+    double elapsed = (end.tv_sec - start.tv_sec) * 1000.0 + (end.tv_usec - start.tv_usec) / 1000.0;
+    std::cout << prefix.str() << "Reloaded configuration (generation " << generation->number << ") in "
+        << elapsed << " ms: " << listeners.size() - opened_count << " listeners kept, " << opened_count
+        << " opened, " << closed_count << " closed" << std::endl;
+}
+
+void Server::resolveUpstreams() {
+    const std::vector<Router::Upstream>& upstreams = generation->router.getUpstreams();
+    generation->upstream_groups.resize(upstreams.size());
+    for (size_t i = 0; i < upstreams.size(); ++i) {
+        generation->upstream_groups[i] = upstream_pool.findGroup(upstreams[i]);
+    }
+	// Los grupos de la generación anterior siguen en el pool para las solicitudes que aún la usan.
+}
+
+void Server::adopt(Connection& connection) {
+    const Router::Listener& listener = connection.generation->router.getListeners()[connection.listener];
+    int index = generation->router.findListener(listener.address, listener.port);
+    if (index == -1) {
+        connection.max_requests = connection.requests_served + 1;
+        return;
+		// Su dirección ya no está en la configuración: la conexión responde a su siguiente
+		// solicitud con la generación anterior y se cierra después.
+    }
+    connection.generation->release();
+    connection.generation = generation;
+    generation->acquire();
+    connection.listener = index;
+	// El índice del listener cambia de una generación a otra; la dirección no.
+}
+
+void Server::setupSockets() {
+    const std::vector<Router::Listener>& listeners = generation->router.getListeners();
+    for (size_t i = 0; i < listeners.size(); ++i) {
+        listen_fds.push_back(openListener(listeners[i], generation->config.getInt("listen_backlog", 511)));
+        loop->add(listen_fds.back(), EVENT_READ);
+		// EVENT_READ en un socket de escucha indica que hay conexiones nuevas por aceptar.
+    }
+}
+
+int Server::openListener(const Router::Listener& listener, int backlog) {
+    // Configurar dirección
+    struct sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));		// Limpia la estructura de dirección
+    address.sin_family = AF_INET;					// Establece la familia de direcciones a IPv4 que es AF_INET
+    address.sin_addr.s_addr = INADDR_ANY;			// Sin dirección, escucha en todas las interfaces de red disponibles.
+    address.sin_port = htons(listener.port);
+	// Convierte el puerto a formato de red (big-endian) usando htons, para que el servidor pueda escuchar en el puerto especificado.
+	// htons convierte el número de puerto de host a formato de red (big-endian) que es el formato utilizado en las redes para transmitir datos.
+    if (!listener.address.empty()) {
+        struct addrinfo hints;
+        struct addrinfo* result;
+        std::memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        if (getaddrinfo(listener.address.c_str(), NULL, &hints, &result) != 0) {
+            throw std::runtime_error("Invalid listen address: " + listener.address);
+        }
+        address.sin_addr = reinterpret_cast<struct sockaddr_in*>(result->ai_addr)->sin_addr;
+        freeaddrinfo(result);
+		// listen 127.0.0.1:8080 o listen localhost:8080 solo acepta conexiones en esa dirección.
     }
-    int port = std::atoi(port_str.c_str());
-	// Convierte el puerto de string a int.
 
     // Crear socket
-    server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd == -1) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
         throw std::runtime_error("Failed to create socket: " + std::string(strerror(errno)));
 		// Si falla la creación del socket, lanza una excepción con el mensaje de error.
     }
 
     // Configurar socket como no bloqueante
-    if (fcntl(server_fd, F_SETFL, O_NONBLOCK) == -1) {
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+	// Los scripts CGI no heredan el socket de escucha.
+    if (fcntl(fd, F_SETFL, O_NONBLOCK) == -1) {
 		// Si falla al configurar el socket como no bloqueante, cierra el socket y lanza una excepción.
-        close(server_fd);
+        close(fd);
         throw std::runtime_error("Failed to set socket to non-blocking: " + std::string(strerror(errno)));
     }
 
-    // Configurar dirección
-    std::memset(&address, 0, sizeof(address));		// Limpia la estructura de dirección
-    address.sin_family = AF_INET;					// Establece la familia de direcciones a IPv4 que es AF_INET
-    address.sin_addr.s_addr = INADDR_ANY;			// Permite que el socket escuche en todas las interfaces de red disponibles.
-    address.sin_port = htons(port);	
-	// Convierte el puerto a formato de red (big-endian) usando htons, para que el servidor pueda escuchar en el puerto especificado.
-	// htons convierte el número de puerto de host a formato de red (big-endian) que es el formato utilizado en las redes para transmitir datos.
+    // Permitir reutilizar el puerto en cuanto se reinicia el servidor
+    int enable = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable)) == -1) {
+		// Sin SO_REUSEADDR, bind falla mientras queden conexiones antiguas en TIME_WAIT.
+        close(fd);
+        throw std::runtime_error("Failed to set SO_REUSEADDR: " + std::string(strerror(errno)));
+    }
+#ifdef SO_REUSEPORT
+    if (worker >= 0 && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) == -1) {
+		// Cada worker tiene su propio socket en el mismo puerto; el kernel reparte las conexiones entre ellos.
+        close(fd);
+        throw std::runtime_error("Failed to set SO_REUSEPORT: " + std::string(strerror(errno)));
+    }
+#endif
 
     // Vincular socket
-    if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
+    if (bind(fd, (struct sockaddr*)&address, sizeof(address)) == -1) {
 		// Si falla la vinculación del socket a la dirección y puerto especificados, cierra el socket y lanza una excepción.
-        close(server_fd);
+        close(fd);
         throw std::runtime_error("Failed to bind socket: " + std::string(strerror(errno)));
     }
 
     // Escuchar conexiones
-    if (listen(server_fd, 10) == -1) {
+    if (listen(fd, backlog) == -1) {
+		// La cola de conexiones pendientes debe ser grande para no rechazar conexiones en picos de carga.
 		// Si falla al escuchar en el socket, cierra el socket y lanza una excepción.
-        close(server_fd);
+        close(fd);
         throw std::runtime_error("Failed to listen on socket: " + std::string(strerror(errno)));
     }
+    return fd;
+}
 
-    // Agregar socket del servidor a fds
-    struct pollfd pfd;		// Estructura pollfd para manejar el socket del servidor.
-    pfd.fd = server_fd;		// Asigna el file descriptor del socket del servidor a la estructura pollfd.
-    pfd.events = POLLIN;	// Establece el evento POLLIN para indicar que el socket está listo para leer.
-    fds.push_back(pfd);		// Agrega la estructura pollfd al vector fds para que pueda ser monitoreada por poll.
+int Server::findListener(int fd) const {
+    for (size_t i = 0; i < listen_fds.size(); ++i) {
+        if (listen_fds[i] == fd) {
+            return i;
+        }
+    }
+    return -1;
+	// Hay muy pocos sockets de escucha, así que basta con recorrerlos.
 }
 
 void Server::handleConnections() {
-	// Maneja las conexiones entrantes utilizando poll
-    while (true) {
-        int ret = poll(&fds[0], fds.size(), -1);
-		// Utiliza poll para esperar eventos en los file descriptors en fds.
+	// Maneja las conexiones entrantes utilizando el bucle de eventos
+    std::cout << "Event loop: " << loop->getName() << std::endl;
+    std::vector<int> expired;
+	// Conexiones cuyo plazo venció en esta iteración, reutilizado en cada despertar.
+    while (!stopping) {
+        int ret = loop->wait(events, timers.nextTimeout(std::time(NULL)));
+		// Espera hasta que algún file descriptor esté listo; solo se devuelven los que lo están.
+		// El plazo de espera es el del próximo vencimiento de la rueda de temporizadores
+		// (sin conexiones, espera sin plazo).
         if (ret == -1) {
-			// Si poll falla, imprime el error y continúa esperando.
-            std::cerr << "Poll error: " << strerror(errno) << std::endl;
+			// Si la espera falla, imprime el error y continúa esperando.
+            if (errno != EINTR) {
+                std::cerr << "Event loop error: " << strerror(errno) << std::endl;
+            }
             continue;
         }
-        for (size_t i = 0; i < fds.size(); ++i) {
-			// Itera sobre los file descriptors en fds
-            if (fds[i].revents & POLLIN) {
-                if (fds[i].fd == server_fd) {
-					// Si el evento es en el socket del servidor, significa que hay una nueva conexión entrante.
-                    // Nueva conexión
-                    struct sockaddr_in client_addr;
-					// Estructura para almacenar la dirección del cliente.
-                    socklen_t addr_len = sizeof(client_addr);
-					// Inicializa la longitud de la dirección del cliente.
-                    int client_fd = accept(server_fd, (struct sockaddr*)&client_addr, &addr_len);
-					// Acepta la nueva conexión y obtiene el file descriptor del cliente.
-                    if (client_fd == -1) {
-						// Si falla al aceptar la conexión, imprime el error y continúa esperando nuevas conexiones.
-                        std::cerr << "Accept error: " << strerror(errno) << std::endl;
-                        continue;
-                    }
-                    // Configurar cliente como no bloqueante
-                    if (fcntl(client_fd, F_SETFL, O_NONBLOCK) == -1) {
-						// Si falla al configurar el socket del cliente como no bloqueante, cierra el socket del
-						// cliente y continúa esperando nuevas conexiones.
-                        close(client_fd);
-                        continue;
-                    }
-                    // Agregar cliente a fds
-                    struct pollfd client_pfd;		// Estructura pollfd para manejar el socket del cliente.
-                    client_pfd.fd = client_fd;		// Asigna el file descriptor del socket del cliente a la estructura pollfd.
-                    client_pfd.events = POLLIN;		// Establece el evento POLLIN para indicar que el socket del cliente está listo para leer.
-                    fds.push_back(client_pfd);		// Agrega la estructura pollfd del cliente al vector fds para que pueda ser monitoreada por poll.
-                    std::cout << "New connection: fd " << client_fd << std::endl;
-					// Imprime un mensaje indicando que se ha aceptado una nueva conexión con el file descriptor del cliente.
-                } else {
-                    // Manejar datos del cliente
-                    char buffer[1024];
-					// Buffer para almacenar los datos recibidos del cliente.
-                    ssize_t bytes = recv(fds[i].fd, buffer, sizeof(buffer) - 1, 0);
-					// Recibe datos del cliente en el socket correspondiente.
-                    if (bytes <= 0) {
-                        // Si bytes es menor o igual a 0, significa que ha ocurrido un error o el cliente ha cerrado la conexión.
-                        close(fds[i].fd);
-						// Cierra el socket del cliente.
-                        fds.erase(fds.begin() + i);
-						// Elimina el socket del cliente de fds.
-                        --i;		// Decrementa i para evitar saltar el siguiente socket en la iteración.
-                        continue;	// Continúa con la siguiente iteración del bucle.
-                    }
-                    buffer[bytes] = '\0';
-
-					// // Asegura que el buffer sea una cadena de caracteres válida al agregar un terminador nulo.
-                    // std::cout << "Received: " << buffer << std::endl;
-					// // Imprime los datos recibidos del cliente.
-                    // // Respuesta simple
-                    // std::string response = "HTTP/1.1 200 OK\r\nContent-Length: 13\r\n\r\nHello, World!";
-					// // Prepara una respuesta simple para enviar al cliente.
-                    // send(fds[i].fd, response.c_str(), response.length(), 0);
-					// // Envía la respuesta al cliente.
-
-                    Request request;
-                    // Crea un objeto Request para manejar la solicitud del cliente.
-                    if (request.parse(std::string(buffer))) {
-                        // Si la solicitud se parsea correctamente, crea una respuesta.
-                        Response response(request, config);
-                        // Crea un objeto Response utilizando la solicitud y la configuración del servidor.
-                        std::string response_str = response.generate();
-                        // Genera la respuesta completa como una cadena de caracteres.
-                        send(fds[i].fd, response_str.c_str(), response_str.length(), 0);
-                        // Envía la respuesta generada al cliente.
-                    } else {
-                        // Si la solicitud no se parsea correctamente, envía una respuesta de error.
-                        std::string error_response = "HTTP/1.1 400 Bad Request\r\nContent-Length: 22\r\n\r\n<h1>400 Bad Request</h1>";
-                        // Prepara una respuesta de error 400 Bad Request.
-                        send(fds[i].fd, error_response.c_str(), error_response.length(), 0);
-                        // Envía la respuesta de error al cliente.
-                    }
-
-                    close(fds[i].fd);
-					// Cierra el socket del cliente después de enviar la respuesta.
-                    fds.erase(fds.begin() + i);
-					// Elimina el socket del cliente de fds.
-                    --i;
-					// Decrementa i para evitar saltar el siguiente socket en la iteración.
+        hot_headers.update(std::time(NULL));
+		// Si cambió el segundo, formatea de nuevo la cabecera Date. Las páginas de error de cada
+		// generación la copian al enviarse, también las de una generación anterior a una recarga.
+        counters.cache_hits = file_cache->getHits();
+        counters.cache_misses = file_cache->getMisses();
+        counters.log_dropped = access_log.getDropped() + error_log.getDropped();
+		// La caché cuenta sus aciertos (y los logs sus registros descartados); se copian a las
+		// métricas una vez por despertar, no por búsqueda.
+        for (size_t i = 0; i < events.size(); ++i) {
+			// Itera solo sobre los file descriptors listos
+            int fd = events[i].fd;
+            if (fd == signal_pipe) {
+                char drain[64];
+                bool reload_requested = false;
+                bool reopen_requested = false;
+                ssize_t bytes;
+                while ((bytes = read(signal_pipe, drain, sizeof(drain))) > 0) {
+                    reload_requested = reload_requested || std::memchr(drain, 'R', bytes) != NULL;
+                    reopen_requested = reopen_requested || std::memchr(drain, 'O', bytes) != NULL;
+                    stopping = stopping || std::memchr(drain, 'T', bytes) != NULL;
                 }
+                if (reopen_requested) {
+                    access_log.reopen();
+                    error_log.reopen();
+					// SIGUSR1: los hilos de los logs abren de nuevo sus rutas antes de la siguiente tanda.
+                }
+                if (reload_requested) {
+                    reload();
+					// SIGHUP: recarga la configuración entre dos iteraciones del bucle, nunca a mitad de una solicitud.
+                }
+                reapChildren();
+				// SIGCHLD: recoge los scripts CGI que terminaron.
+                continue;
+            }
+            if (static_cast<size_t>(fd) < pipes.size() && pipes[fd].connection != NULL) {
+                handleCgi(fd, events[i].events);
+				// Un pipe de un script CGI (o la conexión FastCGI) está listo: cuerpo de la solicitud
+				// o salida del script.
+                continue;
+            }
+            int listener = findListener(fd);
+            if (listener != -1) {
+				// Si el evento es en un socket de escucha, significa que hay conexiones nuevas entrantes.
+                acceptConnections(listener);
+                continue;
             }
+            if (static_cast<size_t>(fd) >= connections.size() || connections[fd] == NULL) {
+                continue;
+				// La conexión ya se cerró durante esta misma iteración.
+            }
+            Connection& connection = *connections[fd];
+            bool keep_open;
+            if (events[i].events & EVENT_ERROR) {
+                keep_open = false;
+				// Error en el socket del cliente.
+            } else if (events[i].events & EVENT_WRITE) {
+                keep_open = handleWrite(connection);
+				// El socket acepta más datos: continúa enviando la respuesta pendiente.
+            } else {
+                keep_open = handleRead(connection);
+				// Hay datos nuevos o el cliente cerró su lado.
+            }
+            if (!keep_open) {
+				// Si el cliente cerró la conexión o no quiere mantenerla abierta, se cierra.
+                closeConnection(fd);
+            } else {
+                updateTimer(connection);
+				// El plazo depende de lo que la conexión está esperando ahora.
+            }
+        }
+        expired.clear();
+        timers.expire(std::time(NULL), expired);
+        for (size_t i = 0; i < expired.size(); ++i) {
+            timeoutConnection(expired[i]);
+			// Solo se visitan las conexiones vencidas, no toda la tabla.
         }
     }
 }
 
+void Server::acceptConnections(size_t listener) {
+    while (true) {
+		// Acepta todas las conexiones pendientes hasta EAGAIN, necesario en modo edge-triggered.
+        struct sockaddr_in client_addr;
+		// Estructura para almacenar la dirección del cliente.
+        socklen_t addr_len = sizeof(client_addr);
+		// Inicializa la longitud de la dirección del cliente.
+        int client_fd = accept(listen_fds[listener], (struct sockaddr*)&client_addr, &addr_len);
+		// Acepta la nueva conexión y obtiene el file descriptor del cliente.
+        if (client_fd == -1 && (errno == EMFILE || errno == ENFILE) && spare_fd != -1) {
+            close(spare_fd);
+            client_fd = accept(listen_fds[listener], NULL, NULL);
+            if (client_fd != -1) {
+                close(client_fd);
+            }
+            spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+            std::cerr << "Accept error: " << strerror(EMFILE) << ", connection dropped" << std::endl;
+            continue;
+			// Sin descriptores libres la conexión se quedaría en la cola y el bucle despertaría
+			// sin parar (level-triggered): se libera el descriptor de reserva para aceptarla y cerrarla.
+        }
+        if (client_fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+				// Si falla al aceptar la conexión, imprime el error y continúa esperando nuevas conexiones.
+                std::cerr << "Accept error: " << strerror(errno) << std::endl;
+            }
+            return;
+        }
+        if (connection_count >= worker_connections) {
+            sendError(client_fd, 503);
+            close(client_fd);
+            continue;
+			// Límite de conexiones alcanzado: se rechaza con un 503 ya construido, sin crear estado.
+        }
+        // Configurar cliente como no bloqueante
+        fcntl(client_fd, F_SETFD, FD_CLOEXEC);
+		// Un script CGI que heredara el socket lo mantendría abierto después de closeConnection.
+        if (fcntl(client_fd, F_SETFL, O_NONBLOCK) == -1) {
+			// Si falla al configurar el socket del cliente como no bloqueante, cierra el socket del
+			// cliente y continúa con la siguiente conexión.
+            close(client_fd);
+            continue;
+        }
+        // Agregar cliente a la tabla de conexiones
+        if (static_cast<size_t>(client_fd) >= connections.size()) {
+            connections.resize(client_fd + 1, NULL);
+			// La tabla crece hasta el file descriptor más alto.
+        }
+        Connection* connection = new Connection(client_fd, listener, generation);
+        connection->max_requests = keepalive_requests;
+        connection->request.setLimits(max_header_size, max_body_size);
+        connection->interest = EVENT_READ;
+        connection->peer = client_addr;
+        connections[client_fd] = connection;
+        ++connection_count;
+        ++counters.accepted;
+        ++counters.active;
+        timers.schedule(connection->timer, connection->request_started + client_header_timeout);
+		// La primera solicitud debe llegar completa antes de client_header_timeout.
+        loop->add(client_fd, EVENT_READ);
+		// Registra el socket del cliente para que el bucle avise cuando haya datos por leer.
+		// No se escribe nada por conexión: las métricas (metrics on) cuentan las conexiones aceptadas.
+    }
+}
+
+bool Server::handleRead(Connection& connection) {
+    // Manejar datos del cliente
+    bool peer_closed = false;
+	// Indica si el cliente cerró su lado de la conexión.
+    bool drained = false;
+	// Indica si se leyó hasta EAGAIN. En modo edge-triggered no llegará otro aviso hasta entonces.
+    char buffer[16384];
+	// Buffer temporal para recibir los datos; se acumulan en connection.input, que crece según haga falta.
+    while (!drained) {
+        size_t received = 0;
+		// Bytes leídos en esta tanda.
+        while (connection.input.size() - connection.input_start < inputLimit(connection)
+            && received < READ_BATCH_SIZE) {
+			// Lee hasta EAGAIN para vaciar el socket con un solo despertar del bucle.
+			// Deja de leer si los bytes pendientes ya superan los límites: el parser responderá antes.
+			// Cada READ_BATCH_SIZE bytes se procesan las solicitudes, así el cuerpo de una subida
+			// se escribe en disco por tandas en vez de acumularse entero en memoria (y el de una
+			// solicitud proxy se pasa al servidor upstream).
+            ssize_t bytes = recv(connection.fd, buffer, sizeof(buffer), 0);
+			// Recibe datos del cliente en el socket correspondiente.
+            if (bytes > 0) {
+                if (connection.input.size() == connection.input_start && connection.requests_served > 0) {
+                    connection.request_started = std::time(NULL);
+					// Empieza una solicitud nueva en una conexión keep-alive.
+                }
+                connection.input.append(buffer, bytes);
+				// Acumula los datos recibidos, ya que pueden contener varias solicitudes o solo una parte de una.
+                received += bytes;
+                continue;
+            }
+            if (bytes == 0) {
+                peer_closed = true;
+                drained = true;
+				// El cliente cerró la conexión, pero se responde a lo que ya envió.
+                break;
+            }
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                drained = true;
+                break;
+				// No hay más datos por ahora.
+            }
+            return false;
+            // Error de lectura: se cierra la conexión.
+        }
+        counters.received += received;
+        connection.last_activity = std::time(NULL);
+        if (!processRequests(connection)) {
+            return false;
+        }
+        if (connection.hasPendingOutput() || connection.close_after_output || (connection.cgi != NULL
+            && (!connection.cgi->acceptsInput() || connection.input.size() - connection.input_start >= READ_BATCH_SIZE))) {
+            break;
+			// Backpressure: no se lee más hasta que se envíe la respuesta.
+			// Al terminar de enviarla, handleWrite vuelve a llamar a handleRead.
+			// Con un script CGI en marcha, las solicitudes siguientes esperan a que termine.
+			// Una solicitud proxy sigue leyendo su cuerpo mientras el upstream lo acepte; si no,
+			// handleCgi vuelve a llamar a handleRead cuando haya enviado lo pendiente.
+        }
+    }
+    if (peer_closed && connection.cgi != NULL) {
+        return false;
+		// El cliente se fue mientras el script CGI trabajaba: closeConnection lo termina.
+    }
+    if (peer_closed) {
+        connection.close_after_output = true;
+        return connection.hasPendingOutput();
+		// Ya no llegarán más solicitudes: cierra en cuanto se envíe lo pendiente.
+    }
+    return true;
+}
+
+bool Server::handleWrite(Connection& connection) {
+    if (!flush(connection)) {
+        return false;
+		// Error de escritura: el cliente ya no está.
+    }
+    if (connection.hasPendingOutput()) {
+        return true;
+		// El socket sigue lleno: se espera al siguiente POLLOUT.
+    }
+    if (connection.cgi != NULL) {
+        watchCgi(connection);
+		// El cliente leyó la respuesta: se vuelve a leer la salida del script CGI si estaba en pausa.
+    }
+    return handleRead(connection);
+	// La respuesta se envió por completo: responde a las solicitudes que quedaron en el buffer
+	// y lee lo que llegó mientras tanto (en modo edge-triggered no habrá otro aviso).
+}
+
+bool Server::processRequests(Connection& connection) {
+    bool throttled = true;
+	// Indica si se dejó de responder por tener demasiados datos pendientes de enviar.
+    while (throttled) {
+        while (connection.cgi == NULL && !connection.close_after_output && connection.output.size() < OUTPUT_HIGH_WATER) {
+			// Responde a cada solicitud completa del buffer (pipelining), en orden.
+			// Si ya hay demasiados datos pendientes de enviar, deja de procesar solicitudes (backpressure).
+			// Mientras un script CGI responde, las solicitudes siguientes esperan a que termine.
+            if (connection.upload != NULL) {
+                if (!receiveUpload(connection)) {
+                    break;
+					// El cuerpo de la subida no está completo: se espera la siguiente lectura.
+                }
+                continue;
+				// Subida terminada: las solicitudes siguientes están detrás de su cuerpo.
+            }
+            if (connection.generation != generation) {
+                adopt(connection);
+				// Hubo una recarga: la solicitud que empieza usa la configuración nueva.
+            }
+            unsigned long parse_start = Metrics::now();
+            Request::ParseStatus status = connection.parseRequest();
+			// Continúa el análisis de la solicitud actual con los bytes recibidos.
+            Request::View method = connection.request.getMethodView();
+            connection.head = Router::parseMethod(method.data, method.length) == Router::METHOD_HEAD;
+			// Las respuestas a un HEAD (también los errores, incluso los de un script CGI que
+			// termina después) no llevan cuerpo.
+            if (status == Request::PARSE_INCOMPLETE) {
+                break;
+				// Faltan bytes: se esperan en la siguiente lectura.
+            }
+            unsigned long handler_start = Metrics::now();
+            const Request& request = connection.request;
+            const Router& router = connection.generation->router;
+            startLog(connection, handler_start);
+            if (status == Request::PARSE_ERROR) {
+                // Si la solicitud no se parsea correctamente, envía una respuesta de error y cierra la conexión.
+                queueError(connection, request.getErrorStatus(), false);
+                logRequest(connection);
+                connection.close_after_output = true;
+                break;
+            }
+            bool keep_alive = connection.wantsKeepAlive(request);
+            Request::View host = request.getHeaderView("Host");
+            Request::View path = request.getPathView();
+            const Router::Location* location = router.findLocation(
+                router.findHost(connection.listener, host.data, host.length), path.data, path.length);
+			// El Router elige el servidor virtual por la cabecera Host y la location por el prefijo de la ruta.
+            bool missing_host = host.data == NULL && request.getVersion() == "HTTP/1.1";
+            if (status == Request::PARSE_BODY) {
+                if (missing_host || location == NULL || (!startProxy(connection, *location, keep_alive)
+                    && !startCgi(connection, *location, keep_alive) && !startUpload(connection, *location, keep_alive))) {
+                    continue;
+					// No es una subida, un proxy ni un script: el cuerpo se acumula en el buffer y la
+					// solicitud se responde cuando esté completa.
+                }
+				// Las cabeceras de la subida se consumen ahora; su cuerpo lo recibe receiveUpload
+				// (o feedCgi, que lo pasa al script, al responder FastCGI o al servidor upstream).
+            } else if (missing_host) {
+                queueError(connection, 400, keep_alive);
+				// HTTP/1.1 exige la cabecera Host (RFC 9112, sección 3.2).
+            } else if (location == NULL) {
+                queueError(connection, 404, keep_alive);
+				// Ninguna location coincide con la ruta (no hay "location /").
+            } else if (location->metrics) {
+                sendMetrics(connection, keep_alive);
+            } else if (!startProxy(connection, *location, keep_alive) && !startCgi(connection, *location, keep_alive)
+                && !startUpload(connection, *location, keep_alive)) {
+                Response response(request, *location, *file_cache, connection.arena);
+                // Crea un objeto Response utilizando la solicitud y la location que le corresponde.
+                sendResponse(connection, response, keep_alive);
+            }
+            ++counters.requests[Metrics::getMethod(method.data, method.length)];
+            Metrics::record(counters.parse, handler_start - parse_start);
+            Metrics::record(counters.handler, Metrics::now() - handler_start);
+			// Solo cuenta la llamada al parser que completó la solicitud, no las que esperaban más
+			// bytes (ni la que encontró las cabeceras de un cuerpo que se acumula en el buffer).
+            if (connection.cgi == NULL && connection.upload == NULL) {
+                logRequest(connection);
+				// La respuesta ya está en la cola: el registro se copia al buffer del log de acceso.
+            } else if (access_log.isOpen()) {
+                LogFormat::save(connection.log_record, connection.log_storage);
+                connection.log_pending = true;
+				// La respuesta llega después de consumir la solicitud: se copian la línea de
+				// solicitud y las cabeceras del registro, y se escribe al terminar (stopCgi o
+				// receiveUpload).
+            }
+            connection.close_after_output = connection.close_after_output
+                || (!keep_alive && connection.cgi == NULL && connection.upload == NULL);
+			// Si un script CGI responde, se decide al terminar su respuesta (finishCgi), y en una
+			// subida al terminar de recibir el cuerpo (receiveUpload).
+            ++connection.requests_served;
+            connection.consumeRequest();
+			// La siguiente solicitud empieza justo después de esta.
+        }
+        if (connection.cgi != NULL && connection.cgi->acceptsInput()) {
+            feedCgi(connection);
+			// El cuerpo en streaming pasa del buffer al script o al upstream según haya sitio.
+        }
+        throttled = !connection.close_after_output && connection.cgi == NULL && connection.output.size() >= OUTPUT_HIGH_WATER;
+        connection.compactInput();
+		// Elimina del buffer los bytes de las solicitudes ya respondidas.
+        if (!flush(connection)) {
+            return false;
+        }
+        if (connection.hasPendingOutput()) {
+            watch(connection, EVENT_WRITE);
+            return true;
+			// El kernel no aceptó toda la respuesta: espera EVENT_WRITE y deja de leer mientras tanto.
+        }
+		// Si el kernel aceptó todo de una vez, se responde a las solicitudes que quedaron en el buffer.
+    }
+    if (connection.cgi != NULL) {
+        watch(connection, connection.input.size() < inputLimit(connection) ? EVENT_READ : 0);
+        return true;
+		// El script CGI sigue respondiendo: se vigila el socket para saber si el cliente se va,
+		// salvo que el buffer ya esté lleno de solicitudes en espera (o del cuerpo que el
+		// upstream aún no aceptó).
+    }
+    watch(connection, EVENT_READ);
+    return !connection.close_after_output;
+	// Todo se envió: cierra si la conexión no es keep-alive, si no espera más solicitudes.
+}
+
+bool Server::startCgi(Connection& connection, const Router::Location& location, bool keep_alive) {
+    Request& request = connection.request;
+    Request::View method = request.getMethodView();
+    unsigned bit = Router::parseMethod(method.data, method.length);
+    if ((bit & location.methods & (Router::METHOD_GET | Router::METHOD_HEAD | Router::METHOD_POST)) == 0) {
+        return false;
+		// Response responde a los métodos no permitidos con un 405.
+    }
+    bool streamed = request.isReadingBody();
+    if (streamed && request.isChunked()) {
+        return false;
+		// Un cuerpo chunked se decodifica entero en el buffer: el script necesita CONTENT_LENGTH
+		// antes de empezar.
+    }
+    Request::View path = request.getPathView();
+    size_t script_length = path.length;
+    const std::string* interpreter = NULL;
+    if (location.fastcgi_pass.empty()) {
+        interpreter = Router::findInterpreter(location, path.data, path.length, script_length);
+        if (interpreter == NULL) {
+            return false;
+			// La ruta no es un script CGI de la location: es un archivo estático.
+        }
+    }
+	// Con fastcgi_pass, el responder FastCGI atiende todas las solicitudes de la location.
+    CGI::Params params;
+    params.interpreter = interpreter != NULL ? *interpreter : "";
+    params.script_name.assign(path.data, script_length);
+    params.path_info.assign(path.data + script_length, path.length - script_length);
+    params.document_root = location.root;
+    char cwd[4096];
+    if (!params.document_root.empty() && params.document_root[0] != '/' && getcwd(cwd, sizeof(cwd)) != NULL) {
+        params.document_root = std::string(cwd) + "/" + params.document_root;
+		// El script se ejecuta en su propio directorio: las rutas que recibe deben ser absolutas.
+    }
+    params.path = params.document_root + params.script_name;
+    struct stat info;
+    int code = 0;
+    if (interpreter != NULL && (stat(params.path.c_str(), &info) == -1 || !S_ISREG(info.st_mode))) {
+        code = 404;
+		// El script no existe. La ruta ya está normalizada (Request::normalizePath), así que no
+		// tiene segmentos ".." que salgan del directorio raíz. Un responder FastCGI puede estar
+		// en otra máquina: comprueba él mismo sus scripts.
+    }
+    Request::View host = request.getHeaderView("Host");
+    params.server_name = host.data != NULL ? std::string(host.data, host.length) : "";
+    if (params.server_name.find(':') != std::string::npos) {
+        params.server_name.erase(params.server_name.find(':'));
+    }
+    params.server_port = connection.generation->router.getListeners()[connection.listener].port;
+    params.remote_addr = inet_ntoa(connection.peer.sin_addr);
+    params.remote_port = ntohs(connection.peer.sin_port);
+    params.keep_alive = keep_alive;
+    params.date = hot_headers.getDate();
+    CGI* cgi = new CGI();
+    if (code == 0 && interpreter == NULL
+        && !cgi->startFastCGI(request, params, fastcgi_pool, location, streamed, max_body_size)) {
+        code = 502;
+		// El responder FastCGI está caído o no acepta conexiones.
+    } else if (code == 0 && interpreter != NULL && !cgi->start(request, params, streamed, max_body_size)) {
+        std::cerr << "CGI error: " << strerror(errno) << std::endl;
+        code = 500;
+		// No se pudo crear el proceso o sus pipes (p. ej., sin descriptores libres).
+    }
+    if (streamed) {
+        request.streamBody();
+		// La solicitud termina en sus cabeceras: feedCgi pasa el cuerpo al script a medida que llega.
+    }
+    if (code != 0) {
+        delete cgi;
+        queueError(connection, code, keep_alive && !streamed);
+        connection.close_after_output = connection.close_after_output || streamed;
+        return true;
+		// El cuerpo no se lee: la conexión se cierra después del error.
+    }
+    connection.cgi = cgi;
+    connection.cgi_timeout = location.cgi_timeout;
+    watchCgi(connection);
+	// El bucle avisa cuando el script envía salida o acepta más cuerpo; el worker nunca espera.
+    return true;
+}
+
+bool Server::startProxy(Connection& connection, const Router::Location& location, bool keep_alive) {
+    Request& request = connection.request;
+    Request::View method = request.getMethodView();
+    unsigned bit = Router::parseMethod(method.data, method.length);
+    if (location.proxy_pass.empty() || (bit != 0 && (bit & location.methods) == 0)) {
+        return false;
+		// Response responde a los métodos no permitidos con un 405. Los métodos que el servidor
+		// no conoce (OPTIONS, PATCH...) se pasan al upstream.
+    }
+    bool streamed = request.isReadingBody();
+    const Router::Upstream& upstream = connection.generation->router.getUpstreams()[location.upstream];
+    CGI::Params params;
+    params.remote_addr = inet_ntoa(connection.peer.sin_addr);
+    params.remote_port = ntohs(connection.peer.sin_port);
+    params.keep_alive = keep_alive;
+    params.date = hot_headers.getDate();
+    CGI* cgi = new CGI();
+    if (!cgi->startProxy(request, params, upstream_pool, upstream,
+        connection.generation->upstream_groups[location.upstream], streamed, max_body_size)) {
+        delete cgi;
+        std::cerr << "Proxy: no server of " << upstream.name << " can be reached" << std::endl;
+        if (streamed) {
+            request.streamBody();
+        }
+        queueError(connection, 502, keep_alive && !streamed);
+        connection.close_after_output = connection.close_after_output || streamed;
+        return true;
+		// Todos los servidores del grupo están caídos o rechazan la conexión. El cuerpo no se
+		// lee: la conexión se cierra después del error.
+    }
+    if (streamed) {
+        request.streamBody();
+		// La solicitud termina en sus cabeceras: feedCgi pasa el cuerpo al upstream.
+    }
+    connection.cgi = cgi;
+    connection.cgi_timeout = location.proxy_timeout;
+    watchCgi(connection);
+	// La conexión con el upstream se vigila como los pipes de un script CGI.
+    return true;
+}
+
+void Server::feedCgi(Connection& connection) {
+    CGI& cgi = *connection.cgi;
+    size_t consumed;
+    CGI::Status status = cgi.feedInput(connection.input.data() + connection.input_start,
+        connection.input.size() - connection.input_start, consumed);
+    connection.input_start += consumed;
+	// Los bytes que tomó se descartan del buffer en compactInput; el resto espera a que el
+	// script (o el upstream) acepte lo que ya tiene.
+    if (status == CGI::CGI_ERROR) {
+        if (!cgi.hasStarted()) {
+            queueError(connection, cgi.getInputError(), false);
+        }
+        connection.close_after_output = true;
+        cgi.kill();
+        stopCgi(connection);
+        return;
+		// Cuerpo inválido o demasiado grande (413): se abandona la solicitud al script o al upstream.
+    }
+    watchCgi(connection);
+}
+
+size_t Server::inputLimit(const Connection& connection) const {
+    if (connection.cgi != NULL && connection.cgi->acceptsInput()) {
+        return READ_BATCH_SIZE;
+    }
+    return max_header_size + max_body_size;
+	// Un cuerpo con Content-Length se acumula entero en el buffer. De un cuerpo chunked solo
+	// queda la parte sin decodificar (parseRequest quita el resto), así que no limita su tamaño.
+}
+
+bool Server::startUpload(Connection& connection, const Router::Location& location, bool keep_alive) {
+    Request& request = connection.request;
+    Request::View method = request.getMethodView();
+    unsigned bit = Router::parseMethod(method.data, method.length);
+    if (location.upload_store.empty() || (bit & location.methods & (Router::METHOD_PUT | Router::METHOD_POST)) == 0) {
+        return false;
+		// Response responde a los métodos no permitidos con un 405.
+    }
+    Request::View path = request.getPathView();
+    size_t script_length;
+    if (bit == Router::METHOD_POST && (!location.fastcgi_pass.empty()
+        || Router::findInterpreter(location, path.data, path.length, script_length) != NULL)) {
+        return false;
+		// El cuerpo de un POST a un script CGI es para el script.
+    }
+    std::string target = Router::findUploadPath(location, path.data, path.length);
+    bool directory = path.data[path.length - 1] == '/';
+    int code = 0;
+    if (target.empty()) {
+        code = 403;
+		// La ruta sale del directorio de subidas.
+    } else if (directory && bit == Router::METHOD_PUT) {
+        code = 409;
+		// PUT necesita el nombre del archivo; un POST a un directorio crea uno nuevo.
+    }
+    Upload* upload = new Upload();
+    if (code == 0) {
+        code = upload->open(target, std::string(path.data, path.length), directory, request, max_body_size, keep_alive);
+    }
+    request.streamBody();
+	// La solicitud termina en sus cabeceras: el cuerpo queda en el buffer para la subida.
+    if (code != 0) {
+        delete upload;
+        queueError(connection, code, false);
+        connection.close_after_output = true;
+        return true;
+		// El cuerpo no se lee: la conexión se cierra después del error.
+    }
+    connection.upload = upload;
+    return true;
+}
+
+bool Server::receiveUpload(Connection& connection) {
+    Upload* upload = connection.upload;
+    size_t consumed;
+    Upload::Status status = upload->write(connection.input.data() + connection.input_start,
+        connection.input.size() - connection.input_start, consumed);
+    connection.input_start += consumed;
+	// Los bytes escritos en disco se descartan del buffer en compactInput.
+    if (status == Upload::UPLOAD_AGAIN) {
+        return false;
+    }
+    if (status == Upload::UPLOAD_ERROR) {
+        queueError(connection, upload->getErrorStatus(), false);
+        connection.close_after_output = true;
+		// Cuerpo inválido, demasiado grande (413) o error de disco: el resto del cuerpo no se lee.
+    } else {
+        int code = upload->commit();
+        if (code >= 400) {
+            queueError(connection, code, upload->keepsAlive());
+        } else {
+            upload->respond(connection.output, code, hot_headers.getDate());
+            countResponse(connection, code);
+            file_cache->getPaths().clear();
+			// El archivo nuevo no debe seguir dando 404 por un resultado guardado en la caché de rutas.
+        }
+        connection.close_after_output = !upload->keepsAlive();
+    }
+    delete upload;
+    connection.upload = NULL;
+	// El destructor borra el archivo temporal si la subida no se completó.
+    logRequest(connection);
+    return true;
+}
+
+void Server::watchCgi(Connection& connection) {
+    const CGI& cgi = *connection.cgi;
+    int input = cgi.getInputFd();
+    int output = cgi.getOutputFd();
+    int reading = connection.output.size() < OUTPUT_HIGH_WATER ? EVENT_READ : 0;
+	// Backpressure: si el cliente lee más despacio de lo que escribe el script, se deja de leer
+	// su salida (el script se bloquea al llenar el pipe) hasta que handleWrite vacíe la cola.
+    int writing = cgi.isWaitingForInput() ? 0 : EVENT_WRITE;
+	// Un cuerpo en streaming sin nada pendiente de enviar espera al cliente, no al upstream.
+    if (input != -1 && input != output) {
+        watchPipe(input, &connection, writing);
+    }
+    if (output != -1) {
+        watchPipe(output, &connection, reading | (input == output ? writing : 0));
+		// Una conexión FastCGI (o con el upstream) es a la vez la entrada y la salida del script.
+    }
+}
+
+void Server::watchPipe(int fd, Connection* connection, int interest) {
+    if (static_cast<size_t>(fd) >= pipes.size()) {
+        Pipe unused = {NULL, 0};
+        pipes.resize(fd + 1, unused);
+    }
+    Pipe& pipe = pipes[fd];
+    if (interest == 0) {
+        if (pipe.connection != NULL) {
+            loop->remove(fd);
+        }
+        pipe.connection = NULL;
+		// Se quita del bucle: un pipe cerrado por el otro extremo avisaría sin parar aunque no se
+		// vigile ningún evento.
+    } else if (pipe.connection == NULL) {
+        loop->add(fd, interest);
+        pipe.connection = connection;
+    } else if (pipe.interest != interest) {
+        loop->modify(fd, interest);
+    }
+    pipe.interest = interest;
+}
+
+void Server::handleCgi(int fd, int events) {
+    Connection& connection = *pipes[fd].connection;
+    CGI& cgi = *connection.cgi;
+    if (fd == cgi.getInputFd() && (events & (EVENT_WRITE | EVENT_ERROR))) {
+        CGI::Status status = cgi.writeInput();
+        while (status == CGI::CGI_AGAIN && cgi.isWaitingForInput()) {
+            if (!handleRead(connection)) {
+                closeConnection(connection.fd);
+                return;
+            }
+            if (connection.cgi == NULL) {
+                updateTimer(connection);
+                return;
+            }
+            if (cgi.isWaitingForInput()) {
+                break;
+            }
+            status = cgi.writeInput();
+			// El upstream aceptó todo el cuerpo recibido: se lee más del cliente (que pudo quedar
+			// sin vigilar, o con datos sin leer en modo edge-triggered) y se envía enseguida,
+			// porque el socket del upstream sigue escribible y no volvería a avisar.
+        }
+        if (status == CGI::CGI_ERROR) {
+            if (!retryCgi(connection)) {
+                finishCgi(connection, status);
+            }
+            return;
+			// La conexión con el responder FastCGI (o con el upstream) falló antes de enviar la
+			// solicitud.
+        }
+        if (status == CGI::CGI_DONE) {
+            if (fd != cgi.getOutputFd()) {
+                watchPipe(fd, NULL, 0);
+            }
+            cgi.closeInput();
+			// Cuerpo entregado (o el script cerró su entrada sin leerlo): el script lee fin de archivo.
+        }
+    }
+    if (fd != cgi.getOutputFd() || (events & (EVENT_READ | EVENT_ERROR)) == 0) {
+        watchCgi(connection);
+        updateTimer(connection);
+        return;
+		// Enviar el cuerpo a un upstream también cuenta como actividad (proxy_timeout).
+    }
+    CGI::Status status;
+    bool full;
+    do {
+        status = cgi.readOutput(connection.output, OUTPUT_HIGH_WATER);
+        full = connection.output.size() >= OUTPUT_HIGH_WATER;
+        if (!flush(connection)) {
+            closeConnection(connection.fd);
+            return;
+			// El cliente ya no está: closeConnection termina el script.
+        }
+    } while (status == CGI::CGI_AGAIN && full && connection.output.size() < OUTPUT_HIGH_WATER);
+	// Si la lectura se detuvo por el límite de salida y no por EAGAIN, pero el cliente aceptó
+	// lo enviado, se sigue leyendo: en modo edge-triggered no llegaría otro aviso.
+    if (status == CGI::CGI_ERROR && retryCgi(connection)) {
+        return;
+    }
+    if (status != CGI::CGI_AGAIN) {
+        finishCgi(connection, status);
+        return;
+    }
+    watchCgi(connection);
+    if (connection.hasPendingOutput()) {
+        watch(connection, EVENT_WRITE);
+    }
+    updateTimer(connection);
+}
+
+bool Server::retryCgi(Connection& connection) {
+    CGI& cgi = *connection.cgi;
+    if (!cgi.canRetry()) {
+        return false;
+    }
+    watchPipe(cgi.getOutputFd(), NULL, 0);
+	// La conexión fallida se quita del bucle antes de que retry() la cierre.
+    if (!cgi.retry()) {
+        return false;
+    }
+    watchCgi(connection);
+    updateTimer(connection);
+    return true;
+	// Nada de la respuesta llegó al cliente: la solicitud se envía al siguiente servidor del grupo.
+}
+
+void Server::finishCgi(Connection& connection, CGI::Status status) {
+    if (status == CGI::CGI_ERROR && !connection.cgi->hasStarted()) {
+        queueError(connection, 502, false);
+		// El script terminó sin cabeceras válidas: 502 Bad Gateway.
+    } else if (connection.cgi->hasStarted()) {
+        countResponse(connection, connection.cgi->getStatus());
+    }
+    connection.close_after_output = status == CGI::CGI_ERROR || !connection.cgi->keepsAlive()
+        || connection.cgi->acceptsInput();
+	// Tras una respuesta cortada, o sin longitud conocida, solo el cierre indica al cliente dónde termina.
+	// Si el upstream respondió antes de recibir todo el cuerpo, el resto del cuerpo no se lee.
+    stopCgi(connection);
+    if (!processRequests(connection)) {
+        closeConnection(connection.fd);
+        return;
+    }
+    updateTimer(connection);
+	// Envía el final de la respuesta y responde a las solicitudes que esperaban en el buffer.
+}
+
+void Server::stopCgi(Connection& connection) {
+    CGI* cgi = connection.cgi;
+    int fds[2] = {cgi->getInputFd(), cgi->getOutputFd()};
+    for (int i = 0; i < 2; ++i) {
+        if (fds[i] != -1) {
+            watchPipe(fds[i], NULL, 0);
+        }
+    }
+	// Se quitan del bucle antes de cerrarlos, o de devolver la conexión FastCGI al pool.
+    if (connection.log_pending) {
+        if (connection.log_record.status == 0 && cgi->hasStarted()) {
+            connection.log_record.status = cgi->getStatus();
+			// La respuesta del script se cortó (cuerpo inválido, cliente que se fue): se registra
+			// el código que ya se había enviado.
+        }
+        logRequest(connection);
+    }
+    pid_t pid = cgi->detach();
+    if (pid > 0) {
+        children.push_back(pid);
+    }
+    delete cgi;
+    connection.cgi = NULL;
+    reapChildren();
+	// Si el proceso ya terminó se recoge ahora; si no, al llegar su SIGCHLD.
+}
+
+void Server::reapChildren() {
+    for (size_t i = 0; i < children.size();) {
+        if (waitpid(children[i], NULL, WNOHANG) != 0) {
+            children[i] = children.back();
+            children.pop_back();
+			// Terminó (o ya no existe): deja de ser un zombi.
+        } else {
+            ++i;
+        }
+    }
+}
+
+void Server::sendResponse(Connection& connection, Response& response, bool keep_alive) {
+    if (response.getPrebuiltStatus() != 0) {
+        queueError(connection, response.getPrebuiltStatus(), keep_alive);
+		// Errores frecuentes (p. ej., 404 de escáneres): una sola copia de la respuesta ya construida.
+        return;
+    }
+    response.setHeader("Server", HotHeaders::getServer());
+    response.setHeader("Date", hot_headers.getDate());
+    response.setHeader("Connection", keep_alive ? "keep-alive" : "close");
+	// Indica al cliente si la conexión seguirá abierta después de esta respuesta.
+    response.enqueue(connection.output);
+	// Añade la respuesta a la cola de salida de la conexión.
+    countResponse(connection, response.getStatus());
+}
+
+void Server::queueError(Connection& connection, int code, bool keep_alive) {
+    connection.generation->error_pages.enqueue(code, keep_alive, connection.head, connection.output);
+    countResponse(connection, code);
+}
+
+void Server::countResponse(Connection& connection, int code) {
+    Metrics::countResponse(counters, code);
+    connection.log_record.status = code;
+}
+
+void Server::startLog(Connection& connection, unsigned long started) {
+    if (!access_log.isOpen()) {
+        return;
+		// Sin log de acceso, una solicitud no busca sus cabeceras Referer y User-Agent.
+    }
+    LogFormat::Record& record = connection.log_record;
+    LogFormat::capture(record, connection.request);
+    record.address = connection.peer.sin_addr;
+    record.status = 0;
+    record.requests = connection.requests_served + 1;
+    connection.log_started = started;
+    connection.log_queued = connection.output.getQueued();
+	// Los bytes de la respuesta son los que se añadan a la cola a partir de aquí.
+}
+
+void Server::logRequest(Connection& connection) {
+    connection.log_pending = false;
+    if (!access_log.isOpen()) {
+        return;
+    }
+    LogFormat::Record& record = connection.log_record;
+    if (record.status == 0) {
+        record.status = 499;
+		// Ninguna respuesta: el cliente cerró la conexión antes (499, como nginx).
+    }
+    record.bytes_sent = connection.output.getQueued() - connection.log_queued;
+    record.request_time = Metrics::now() - connection.log_started;
+    log_format.format(log_line, record, std::time(NULL));
+    access_log.write(log_line.data(), log_line.size());
+	// Solo una copia al buffer circular: el hilo del log escribe en disco por tandas.
+}
+
+void Server::sendMetrics(Connection& connection, bool keep_alive) {
+    Request::View method = connection.request.getMethodView();
+    unsigned bit = Router::parseMethod(method.data, method.length);
+    char head[512];
+    if (bit != Router::METHOD_GET && bit != Router::METHOD_HEAD) {
+        static const char body[] = "<h1>405 Method Not Allowed</h1>";
+        int length = std::snprintf(head, sizeof(head), "HTTP/1.1 405 Method Not Allowed\r\nServer: %s\r\n"
+            "Date: %s\r\nAllow: GET, HEAD\r\nContent-Type: text/html\r\nContent-Length: %lu\r\nConnection: %s\r\n\r\n%s",
+            HotHeaders::getServer(), hot_headers.getDate(), static_cast<unsigned long>(sizeof(body) - 1),
+            keep_alive ? "keep-alive" : "close", body);
+        connection.output.append(head, length);
+        countResponse(connection, 405);
+        return;
+		// Como el 405 de Response, indica en Allow los métodos que acepta la location.
+    }
+    metrics.format(metrics_text);
+	// Suma los contadores de todos los workers en el momento de la consulta.
+    int length = std::snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nServer: %s\r\nDate: %s\r\n"
+        "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\nContent-Length: %lu\r\n"
+        "Cache-Control: no-store\r\nConnection: %s\r\n\r\n", HotHeaders::getServer(), hot_headers.getDate(),
+        static_cast<unsigned long>(metrics_text.size()), keep_alive ? "keep-alive" : "close");
+    connection.output.append(head, length);
+    if (bit == Router::METHOD_GET) {
+        connection.output.append(metrics_text);
+    }
+    countResponse(connection, 200);
+}
+
+bool Server::flush(Connection& connection) {
+    size_t before = connection.output.size();
+    if (!connection.flushOutput()) {
+        return false;
+    }
+    counters.sent += before - connection.output.size();
+    if (connection.hasPendingOutput()) {
+        ++counters.write_stalls;
+		// El socket no aceptó toda la respuesta: el cliente lee más despacio de lo que se escribe.
+    }
+    return true;
+}
+
+void Server::watch(Connection& connection, int interest) {
+    if (connection.interest != interest) {
+        loop->modify(connection.fd, interest);
+        connection.interest = interest;
+		// Solo se llama al sistema cuando cambian los eventos vigilados.
+    }
+}
+
+void Server::closeConnection(int fd) {
+    if (connections[fd]->cgi != NULL) {
+        connections[fd]->cgi->kill();
+        stopCgi(*connections[fd]);
+		// El cliente se fue o venció un plazo: el script ya no tiene a quién responder.
+    }
+    if (connections[fd]->log_pending) {
+        logRequest(*connections[fd]);
+		// Una subida que no terminó.
+    }
+    timers.cancel(connections[fd]->timer);
+    loop->remove(fd);
+	// Deja de vigilar el socket antes de cerrarlo.
+    close(fd);
+	// Cierra el socket del cliente.
+    delete connections[fd];
+    connections[fd] = NULL;
+    --connection_count;
+    --counters.active;
+	// Elimina el estado de la conexión en O(1).
+}
+
+void Server::updateTimer(Connection& connection) {
+    time_t deadline;
+    if (connection.hasPendingOutput()) {
+        deadline = connection.last_activity + send_timeout;
+		// El cliente no lee la respuesta: plazo desde el último envío que avanzó.
+    } else if (connection.cgi != NULL && connection.cgi->isWaitingForInput()) {
+        deadline = connection.last_activity + client_body_timeout;
+		// Cuerpo de una solicitud proxy: el upstream espera al cliente.
+    } else if (connection.cgi != NULL) {
+        deadline = connection.cgi->getLastOutput() + connection.cgi_timeout;
+		// Script CGI: plazo desde su última salida (cgi_timeout de su location, o proxy_timeout).
+    } else if (connection.request.isReadingBody() || connection.upload != NULL) {
+        deadline = connection.last_activity + client_body_timeout;
+		// Cuerpo de la solicitud o de una subida: plazo entre dos lecturas.
+    } else if (connection.input.size() > connection.input_start || connection.requests_served == 0) {
+        deadline = connection.request_started + client_header_timeout;
+		// Cabeceras: plazo total desde el primer byte, que no se alarga con cada byte recibido.
+		// Así un cliente que envía las cabeceras byte a byte (slowloris) no retiene la conexión.
+    } else {
+        deadline = connection.last_activity + keepalive_timeout;
+		// Conexión keep-alive inactiva entre dos solicitudes.
+    }
+    timers.schedule(connection.timer, deadline);
+}
+
+void Server::timeoutConnection(int fd) {
+    Connection& connection = *connections[fd];
+    if (connection.cgi != NULL && !connection.hasPendingOutput()) {
+        if (connection.cgi->isWaitingForInput()) {
+            sendError(fd, 408);
+			// El cliente dejó de enviar el cuerpo de una solicitud proxy.
+        } else {
+            connection.cgi->reportTimeout();
+			// El responder FastCGI o el upstream no contestó a tiempo: cuenta como un fallo.
+            if (!connection.cgi->hasStarted()) {
+                sendError(fd, 504);
+				// El script no envió sus cabeceras a tiempo: 504 Gateway Timeout.
+            }
+        }
+    } else if (!connection.hasPendingOutput()
+        && (connection.input.size() > connection.input_start || connection.upload != NULL)) {
+        sendError(fd, 408);
+		// Solicitud a medias: se avisa al cliente con un 408 antes de cerrar.
+    }
+    closeConnection(fd);
+}
+
+void Server::sendError(int fd, int code) {
+    if (static_cast<size_t>(fd) < connections.size() && connections[fd] != NULL) {
+        connections[fd]->log_record.status = code;
+		// El plazo venció: la solicitud pendiente se registra con este código al cerrar.
+    }
+    const std::string& response = generation->error_pages.get(code, false);
+    ssize_t bytes = send(fd, response.data(), response.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    if (bytes == -1) {
+        return;
+        // Se intenta una sola vez: si el socket no acepta la respuesta, se cierra sin ella.
+    }
+    counters.sent += bytes;
+    Metrics::countResponse(counters, code);
+}
+
 void Server::start() {
     handleConnections();
 	// Inicia el manejo de conexiones, que se ejecuta indefinidamente.
@@ -0,0 +1,92 @@
+#include "TimerWheel.hpp"	// Include the header file for the TimerWheel class
+
+TimerWheel::TimerWheel(time_t now) : slots(TIMER_WHEEL_SLOTS), current(now), count(0) {
+    for (size_t i = 0; i < slots.size(); ++i) {
+        slots[i].prev = &slots[i];
+        slots[i].next = &slots[i];
+        // An empty slot is a head linked to itself.
+    }
+}
+
+void TimerWheel::init(Timer& timer, int fd) {
+    timer.prev = NULL;
+    timer.next = NULL;
+    timer.deadline = 0;
+    timer.fd = fd;
+}
+
+bool TimerWheel::isScheduled(const Timer& timer) {
+    return timer.prev != NULL;
+}
+
+void TimerWheel::unlink(Timer& timer) {
+    timer.prev->next = timer.next;
+    timer.next->prev = timer.prev;
+    timer.prev = NULL;
+    timer.next = NULL;
+}
+
+void TimerWheel::schedule(Timer& timer, time_t deadline) {
+    if (isScheduled(timer)) {
+        if (timer.deadline == deadline) {
+            return;
+            // Most events of a busy connection do not move its deadline to another second.
+        }
+        unlink(timer);
+        --count;
+    }
+    timer.deadline = deadline;
+    time_t second = deadline > current ? deadline : current + 1;
+    // A deadline already passed is expired at the next call to expire().
+    Timer& head = slots[second % TIMER_WHEEL_SLOTS];
+    timer.prev = head.prev;
+    timer.next = &head;
+    head.prev->next = &timer;
+    head.prev = &timer;
+    ++count;
+}
+
+void TimerWheel::cancel(Timer& timer) {
+    if (isScheduled(timer)) {
+        unlink(timer);
+        --count;
+    }
+}
+
+void TimerWheel::expire(time_t now, std::vector<int>& expired) {
+    if (now <= current) {
+        return;
+    }
+    time_t last = now - current > TIMER_WHEEL_SLOTS ? current + TIMER_WHEEL_SLOTS : now;
+    // After a long pause (or a clock jump), one turn of the wheel visits every slot once.
+    for (time_t second = current + 1; second <= last && count > 0; ++second) {
+        Timer& head = slots[second % TIMER_WHEEL_SLOTS];
+        Timer* timer = head.next;
+        while (timer != &head) {
+            Timer* next = timer->next;
+            if (timer->deadline <= now) {
+                unlink(*timer);
+                --count;
+                expired.push_back(timer->fd);
+            }
+            // Timers of a later turn stay in the slot.
+            timer = next;
+        }
+    }
+    current = now;
+}
+
+int TimerWheel::nextTimeout(time_t now) const {
+    if (count == 0) {
+        return -1;
+    }
+    for (time_t second = current + 1; second <= current + TIMER_WHEEL_SLOTS; ++second) {
+        const Timer& head = slots[second % TIMER_WHEEL_SLOTS];
+        if (head.next != &head) {
+            return second > now ? (second - now) * 1000 : 0;
+            // The slot may only hold timers of a later turn: the loop then wakes up for nothing
+            // and asks again, at most once per turn.
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,165 @@
+#include "Upload.hpp"		// Include the header file for the Upload class
+#include "Response.hpp"		// Include the Response class for the reason phrases
+#include "HotHeaders.hpp"	// Include the HotHeaders class for the Server header
+#include <unistd.h>			// For write, close, link and unlink
+#include <fcntl.h>			// For fcntl to make the file close-on-exec
+#include <sys/stat.h>		// For stat and fchmod
+#include <cstdlib>			// For mkstemp
+#include <cstdio>			// For std::rename and std::snprintf
+#include <cerrno>			// For errno
+#include <vector>			// For std::vector, the template of mkstemp
+
+Upload::Upload() : fd(-1), create(false), existed(false), keep_alive(false), error_status(0) {}
+
+Upload::~Upload() {
+    if (fd != -1) {
+        close(fd);
+    }
+    if (!temp_path.empty()) {
+        unlink(temp_path.c_str());
+        // The body did not arrive completely: the target is left as it was.
+    }
+}
+
+int Upload::open(const std::string& target, const std::string& target_uri, bool create_name,
+    const Request& request, size_t max_body_size, bool keep_alive_requested) {
+    path = target;
+    uri = target_uri;
+    create = create_name;
+    keep_alive = keep_alive_requested;
+    std::string directory = create ? path : path.substr(0, path.rfind('/') + 1);
+    if (directory.empty()) {
+        directory = "./";
+    }
+    struct stat info;
+    if (stat(directory.c_str(), &info) == -1 || !S_ISDIR(info.st_mode)) {
+        return errno == EACCES ? 403 : 409;
+        // The directories of the path are not created (as nginx does without create_full_put_path).
+    }
+    if (!create && stat(path.c_str(), &info) == 0) {
+        if (S_ISDIR(info.st_mode)) {
+            return 409;
+        }
+        existed = true;
+    }
+    if (!createTemporary(directory)) {
+        return errno == EACCES || errno == EROFS ? 403 : 500;
+    }
+    decoder.reset(request.isChunked(), request.getContentLength(), max_body_size);
+    return 0;
+}
+
+bool Upload::createTemporary(const std::string& directory) {
+    std::string name = directory + ".upload-XXXXXX";
+    std::vector<char> pattern(name.begin(), name.end());
+    pattern.push_back('\0');
+    fd = mkstemp(&pattern[0]);
+    // The temporary file is in the directory of the target, so rename() never copies it.
+    if (fd == -1) {
+        return false;
+    }
+    temp_path = &pattern[0];
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+	// The CGI scripts started while the upload runs do not inherit the file.
+    fchmod(fd, 0644);
+	// mkstemp creates the file readable only by the server; the uploads are served like any file.
+    if (create) {
+        uri.erase(uri.size() - (path.size() - directory.size()));
+        path = directory + "upload-" + temp_path.substr(temp_path.size() - 6);
+        uri += path.substr(directory.size());
+        // The new file takes the unique part of the temporary name (and replaces the name it
+        // had, if it is named again in commit()).
+    }
+    return true;
+}
+
+Upload::Status Upload::write(const char* data, size_t length, size_t& consumed) {
+    consumed = 0;
+    while (true) {
+        size_t used;
+        const char* chunk;
+        size_t chunk_length;
+        BodyDecoder::Status status = decoder.decode(data + consumed, length - consumed, used, chunk, chunk_length);
+        consumed += used;
+        if (status == BodyDecoder::BODY_DATA) {
+            if (!writeAll(chunk, chunk_length)) {
+                error_status = 500;
+                return UPLOAD_ERROR;
+            }
+            continue;
+            // Each piece goes straight from the input buffer to the file.
+        }
+        if (status == BodyDecoder::BODY_ERROR) {
+            error_status = decoder.getErrorStatus();
+            return UPLOAD_ERROR;
+        }
+        return status == BodyDecoder::BODY_DONE ? UPLOAD_DONE : UPLOAD_AGAIN;
+    }
+}
+
+bool Upload::writeAll(const char* data, size_t length) {
+    while (length > 0) {
+        ssize_t bytes = ::write(fd, data, length);
+        if (bytes == -1 && errno == EINTR) {
+            continue;
+        }
+        if (bytes <= 0) {
+            return false;
+            // ENOSPC or EIO: the upload fails and its temporary file is removed.
+        }
+        data += bytes;
+        length -= bytes;
+    }
+    return true;
+}
+
+int Upload::commit() {
+    int result = close(fd);
+    fd = -1;
+    if (result == -1) {
+        return 500;
+        // Some file systems only report a failed write on close.
+    }
+    if (create) {
+        while (link(temp_path.c_str(), path.c_str()) == -1) {
+            std::string previous = temp_path;
+            if (errno != EEXIST || !createTemporary(path.substr(0, path.rfind('/') + 1))) {
+                return 500;
+                // link() never replaces a file, so a POST cannot overwrite one.
+            }
+            close(fd);
+            fd = -1;
+            if (std::rename(previous.c_str(), temp_path.c_str()) == -1) {
+                unlink(previous.c_str());
+                return 500;
+            }
+            // An earlier upload took the name: its temporary file is gone, so mkstemp could
+            // give the same suffix again. The body moves to a new temporary file, whose suffix
+            // is free among the temporary files, and link() is tried with the name it gives.
+        }
+        unlink(temp_path.c_str());
+    } else if (std::rename(temp_path.c_str(), path.c_str()) == -1) {
+        return 500;
+    }
+    temp_path.clear();
+    return existed ? 204 : 201;
+}
+
+void Upload::respond(OutputQueue& output, int code, const char* date) const {
+    char status[64];
+    std::snprintf(status, sizeof(status), "HTTP/1.1 %d %s\r\n", code, Response::getStatusMessage(code).c_str());
+    std::string response = status;
+    response += std::string("Server: ") + HotHeaders::getServer() + "\r\n";
+    response += std::string("Date: ") + date + "\r\n";
+    if (code == 201) {
+        response += "Location: " + uri + "\r\nContent-Length: 0\r\n";
+        // A 204 has no body, so it has no Content-Length either.
+    }
+    response += keep_alive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+    output.append(response);
+}
+
+int Upload::getErrorStatus() const { return error_status; }
+// Returns the HTTP status code of the error.
+bool Upload::keepsAlive() const { return keep_alive; }
+// Returns true if the connection stays open after the response.
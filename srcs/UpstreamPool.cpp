@@ -0,0 +1,169 @@
+#include "UpstreamPool.hpp"	// Include the header file for the UpstreamPool class
+#include <algorithm>		// For std::sort and std::lower_bound
+#include <cstdio>			// For std::snprintf
+
+UpstreamPool::UpstreamPool() {}
+
+UpstreamPool::~UpstreamPool() {
+    for (size_t i = 0; i < peers.size(); ++i) {
+        delete peers[i].connections;
+    }
+}
+
+unsigned UpstreamPool::hash(const char* data, size_t length) {
+    unsigned value = 2166136261u;
+    for (size_t i = 0; i < length; ++i) {
+        value = (value ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    }
+    value ^= value >> 16;
+    value *= 0x85ebca6bu;
+    value ^= value >> 13;
+    value *= 0xc2b2ae35u;
+    value ^= value >> 16;
+    return value;
+    // FNV-1a barely changes the high bits for keys that differ in their last byte (/a?id=1,
+    // /a?id=2...), which are the ones that place a key on the ring: the final mix of
+    // MurmurHash3 spreads every bit of the key over the whole value.
+}
+
+size_t UpstreamPool::findPeer(const std::string& address) {
+    for (size_t i = 0; i < peers.size(); ++i) {
+        if (peers[i].connections->getAddress() == address) {
+            return i;
+        }
+    }
+    Peer peer;
+    peer.connections = new KeepAlivePool(address, "Upstream");
+    peer.active = 0;
+    peers.push_back(peer);
+    return peers.size() - 1;
+}
+
+size_t UpstreamPool::findGroup(const Router::Upstream& upstream) {
+    std::string servers;
+    for (size_t i = 0; i < upstream.servers.size(); ++i) {
+        char weight[16];
+        std::snprintf(weight, sizeof(weight), "%u", upstream.servers[i].weight);
+        servers += upstream.servers[i].address + "*" + weight + " ";
+    }
+    size_t index = 0;
+    while (index < groups.size() && (groups[index].name != upstream.name || groups[index].servers != servers)) {
+        ++index;
+    }
+    if (index == groups.size()) {
+        groups.push_back(Group());
+        Group& group = groups.back();
+        group.name = upstream.name;
+        group.servers = servers;
+        for (size_t i = 0; i < upstream.servers.size(); ++i) {
+            group.peers.push_back(findPeer(upstream.servers[i].address));
+            for (unsigned point = 0; point < upstream.servers[i].weight * 100; ++point) {
+                char name[300];
+                int length = std::snprintf(name, sizeof(name), "%s#%u", upstream.servers[i].address.c_str(), point);
+                group.ring.push_back(std::make_pair(hash(name, length), i));
+            }
+        }
+        std::sort(group.ring.begin(), group.ring.end());
+        group.current.assign(upstream.servers.size(), 0);
+        group.next = 0;
+        // A reload that changed the servers of the group starts a new one; the servers
+        // themselves, with their idle connections and their health, are kept.
+    }
+    Group& group = groups[index];
+    for (size_t i = 0; i < upstream.servers.size(); ++i) {
+        peers[group.peers[i]].connections->setLimits(upstream.keepalive, upstream.keepalive_timeout,
+            upstream.servers[i].max_fails, upstream.servers[i].fail_timeout);
+    }
+    return index;
+}
+
+long UpstreamPool::choose(Group& group, const Router::Upstream& upstream, unsigned key, time_t now) {
+    size_t count = group.peers.size();
+    if (upstream.balance == Router::BALANCE_HASH) {
+        std::vector<std::pair<unsigned, size_t> >::const_iterator it = std::lower_bound(group.ring.begin(),
+            group.ring.end(), std::make_pair(key, static_cast<size_t>(0)));
+        for (size_t step = 0; step < group.ring.size(); ++step, ++it) {
+            if (it == group.ring.end()) {
+                it = group.ring.begin();
+            }
+            size_t i = it->second;
+            if (!tried[i] && !peers[group.peers[i]].connections->isDown(now)) {
+                return i;
+            }
+        }
+        return -1;
+        // The key goes to the first server after it on the ring; if that one is down, to the
+        // next one, so only its keys move.
+    }
+    long best = -1;
+    if (upstream.balance == Router::BALANCE_LEAST_CONN) {
+        for (size_t step = 0; step < count; ++step) {
+            size_t i = (group.next + step) % count;
+            if (tried[i] || peers[group.peers[i]].connections->isDown(now)) {
+                continue;
+            }
+            if (best == -1 || peers[group.peers[i]].active * upstream.servers[best].weight
+                < peers[group.peers[best]].active * upstream.servers[i].weight) {
+                best = i;
+            }
+        }
+        group.next = (group.next + 1) % count;
+        return best;
+        // active / weight is compared without dividing. Ties go to the first server after
+        // group.next, which moves on every request.
+    }
+    long total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (tried[i] || peers[group.peers[i]].connections->isDown(now)) {
+            continue;
+        }
+        group.current[i] += upstream.servers[i].weight;
+        total += upstream.servers[i].weight;
+        if (best == -1 || group.current[i] > group.current[best]) {
+            best = i;
+        }
+    }
+    if (best != -1) {
+        group.current[best] -= total;
+    }
+    return best;
+    // Smooth weighted round-robin: with weights 5, 1, 1 the order is a a b a c a a, not a a a a a b c.
+}
+
+int UpstreamPool::acquire(size_t index, const Router::Upstream& upstream, const std::string& key, size_t& peer,
+    bool& reused) {
+    Group& group = groups[index];
+    time_t now = std::time(NULL);
+    unsigned key_hash = hash(key.data(), key.size());
+    tried.assign(group.peers.size(), false);
+    long i;
+    while ((i = choose(group, upstream, key_hash, now)) != -1) {
+        peer = group.peers[i];
+        int fd = peers[peer].connections->connect(reused);
+        if (fd != -1) {
+            ++peers[peer].active;
+            return fd;
+        }
+        tried[i] = true;
+        // Refused at once (e.g., nothing listens on the port), which counts as a failure:
+        // the next server is tried.
+    }
+    return -1;
+}
+
+void UpstreamPool::release(size_t index, int fd, bool reusable) {
+    --peers[index].active;
+    peers[index].connections->release(fd, reusable);
+}
+
+void UpstreamPool::reportFailure(size_t index) {
+    peers[index].connections->reportFailure();
+}
+
+void UpstreamPool::reportSuccess(size_t index) {
+    peers[index].connections->reportSuccess();
+}
+
+const std::string& UpstreamPool::getAddress(size_t index) const {
+    return peers[index].connections->getAddress();
+}
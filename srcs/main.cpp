@@ -1,13 +1,25 @@
 #include "Server.hpp"	// Include the Server class header file to define the server functionality.
+#include "Master.hpp"	// Include the Master class to run several worker processes.
+#include <csignal>		// For std::signal to ignore SIGPIPE.
 #include <iostream>		// For std::cerr and std::cout to print error messages and debug information.
 
 int main(int argc, char* argv[]) {
     std::string config_file = (argc > 1) ? argv[1] : "config/default.conf";
 	// Default configuration file is "config/default.conf" if no argument is provided.
+    std::signal(SIGPIPE, SIG_IGN);
+	// Writing to a client that closed the connection must return an error, not kill the server.
+	// writev() and sendfile() have no MSG_NOSIGNAL flag like send().
     try {
         Config config(config_file);
 		// Try to create a Config object with the provided configuration file.
-        Server server(config);
+        Metrics metrics(Master::workerCount(config));
+		// Counters of every worker, in memory shared with the processes forked below.
+        if (Master::workerCount(config) > 1) {
+            Master master(config, metrics);
+			// With several workers, the master forks them and restarts them if they crash.
+            return master.run();
+        }
+        Server server(config, metrics);
 		// Create a Server object with the configuration settings.
         server.start();
 		// Start the server to listen for incoming connections.
@@ -0,0 +1,7 @@
+<?php
+// Test script for the CGI support: prints the request it received.
+header("Content-Type: text/plain");
+echo "Script: ", $_SERVER["SCRIPT_NAME"], "\n";
+echo "Method: ", $_SERVER["REQUEST_METHOD"], "\n";
+echo "Query: ", $_SERVER["QUERY_STRING"], "\n";
+echo "Body: ", file_get_contents("php://input"), "\n";